@@ -951,6 +951,119 @@ static void process_command(conn *c, char *command) {
     return;
 }
 
+/*
+ * Binary requests of the moses client, see moses/src/LM/RemoteClient.h:
+ * an op byte, the number of items and of payload bytes, then the payload.
+ * Their first byte is never ASCII, which tells them from text commands.
+ */
+#define BINARY_OP_VOCAB 0x81
+#define BINARY_OP_PROB 0x82
+#define BINARY_HEADER_SIZE 9
+#define BINARY_MAX_BYTES (64 * 1024 * 1024)
+#define BINARY_MAX_ORDER 16
+
+static uint32_t read_uint32(const char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohl(v);
+}
+
+static void write_uint32(char *p, uint32_t v) {
+    v = htonl(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+/*
+ * if we have a complete binary request in the buffer, process it.
+ * Replies are the number of items then 4 bytes for each: a vocabulary id, or
+ * the bits of a log10 probability.  A malformed request closes the connection.
+ */
+static int try_read_binary(conn *c) {
+    uint32_t count, bytes, i, j;
+    unsigned char op;
+    const char *payload, *end;
+    char *reply;
+    char word[KEY_MAX_LENGTH + 1];
+    int context[BINARY_MAX_ORDER + 1];
+
+    if (c->rbytes < BINARY_HEADER_SIZE)
+        return 0;
+    op = (unsigned char)c->rcurr[0];
+    count = read_uint32(c->rcurr + 1);
+    bytes = read_uint32(c->rcurr + 5);
+    if (bytes > BINARY_MAX_BYTES || count > bytes) {
+        conn_set_state(c, conn_closing);
+        return 1;
+    }
+    if (c->rbytes < BINARY_HEADER_SIZE + (int)bytes)
+        return 0;
+    payload = c->rcurr + BINARY_HEADER_SIZE;
+    end = payload + bytes;
+
+    c->msgcurr = 0;
+    c->msgused = 0;
+    c->iovused = 0;
+    reply = malloc(sizeof(uint32_t) * ((size_t)count + 1));
+    if (add_msghdr(c) != 0 || reply == NULL) {
+        free(reply);
+        conn_set_state(c, conn_closing);
+        return 1;
+    }
+    write_uint32(reply, count);
+    for (i = 0; i < count; i++) {
+        uint32_t result;
+        if (op == BINARY_OP_VOCAB) {
+            uint16_t length;
+            if (end - payload < 2)
+                break;
+            memcpy(&length, payload, sizeof(length));
+            length = ntohs(length);
+            payload += 2;
+            if (end - payload < length)
+                break;
+            if (length > KEY_MAX_LENGTH) {
+                result = (uint32_t)-1;
+            } else {
+                memcpy(word, payload, length);
+                word[length] = '\0';
+                result = (uint32_t)srilm_getvoc(word);
+            }
+            payload += length;
+        } else if (op == BINARY_OP_PROB) {
+            unsigned char n;
+            float p = -999.0f;
+            if (end - payload < 1)
+                break;
+            n = (unsigned char)*payload++;
+            if (n == 0 || n > BINARY_MAX_ORDER || end - payload < 4 * n)
+                break;
+            for (j = 0; j < n; j++) {
+                context[j] = (int)read_uint32(payload);
+                payload += 4;
+            }
+            context[n] = -1;
+            if (context[0] != -1)
+                p = srilm_wordprob(context[0], &context[1]);
+            memcpy(&result, &p, sizeof(result));
+        } else {
+            break;
+        }
+        write_uint32(reply + sizeof(uint32_t) * (i + 1), result);
+    }
+    if (i < count || payload != end) {
+        if (settings.verbose > 0)
+            fprintf(stderr, "Malformed binary request on %d\n", c->sfd);
+        free(reply);
+        conn_set_state(c, conn_closing);
+        return 1;
+    }
+
+    c->rbytes -= BINARY_HEADER_SIZE + bytes;
+    c->rcurr += BINARY_HEADER_SIZE + bytes;
+    write_and_free(c, reply, sizeof(uint32_t) * (count + 1));
+    return 1;
+}
+
 /*
  * if we have a complete line in the buffer, process it.
  */
@@ -962,6 +1075,8 @@ static int try_read_command(conn *c) {
 
     if (c->rbytes == 0)
         return 0;
+    if (!c->udp && (unsigned char)c->rcurr[0] >= BINARY_OP_VOCAB)
+        return try_read_binary(c);
     el = memchr(c->rcurr, '\n', c->rbytes);
     if (!el)
         return 0;
@@ -1,7 +1,11 @@
 #include "util/check.hh"
+#include <algorithm>
+#include <map>
 #include <stdexcept>
 #include <iostream>
 
+#include <sys/time.h>
+
 #include <xmlrpc-c/base.hpp>
 #include <xmlrpc-c/registry.hpp>
 #include <xmlrpc-c/server_abyss.hpp>
@@ -12,6 +16,7 @@
 #include "PhraseDictionaryDynSuffixArray.h"
 #include "TranslationSystem.h"
 #include "LMList.h"
+#include "ThreadPool.h"
 #ifdef LM_ORLM
 #  include "LanguageModelORLM.h"
 #endif
@@ -33,10 +38,116 @@ const TranslationSystem& getTranslationSystem(params_t params)
   return StaticData::Instance().GetTranslationSystem(system_id);
 }
 
+double NowMs()
+{
+  timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
+}
+
+/** Latency and load of the server, for the "stats" method */
+class ServerStats
+{
+public:
+  ServerStats() : m_next(0), m_completed(0), m_rejected(0), m_shared(0),
+    m_updateNext(0), m_updates(0), m_firstUpdateMs(0) {}
+
+  void AddLatency(double ms) {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    AddToWindow(m_latencies, m_next, ms);
+    ++m_completed;
+  }
+
+  //! an update of the phrase table, which took ms
+  void AddUpdate(double ms) {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    if (m_updates == 0) {
+      m_firstUpdateMs = NowMs() - ms;
+    }
+    AddToWindow(m_updateLatencies, m_updateNext, ms);
+    ++m_updates;
+  }
+
+  void AddRejected() {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    ++m_rejected;
+  }
+
+  //! a request answered with the translation of an identical one
+  void AddShared() {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    ++m_shared;
+  }
+
+  void Get(map<string, xmlrpc_c::value>& retData) const {
+    vector<double> latencies, updateLatencies;
+    {
+#ifdef WITH_THREADS
+      boost::mutex::scoped_lock lock(m_mutex);
+#endif
+      latencies = m_latencies;
+      updateLatencies = m_updateLatencies;
+      retData["completed"] = xmlrpc_c::value_int(m_completed);
+      retData["rejected"] = xmlrpc_c::value_int(m_rejected);
+      retData["shared"] = xmlrpc_c::value_int(m_shared);
+      retData["updates"] = xmlrpc_c::value_int(m_updates);
+      const double seconds = (NowMs() - m_firstUpdateMs) / 1000;
+      retData["updates-per-second"] = xmlrpc_c::value_double(m_updates && seconds > 0 ? m_updates / seconds : 0);
+    }
+    retData["latency-p50-ms"] = xmlrpc_c::value_double(Percentile(latencies, 0.5));
+    retData["latency-p99-ms"] = xmlrpc_c::value_double(Percentile(latencies, 0.99));
+    retData["update-p50-ms"] = xmlrpc_c::value_double(Percentile(updateLatencies, 0.5));
+    retData["update-p99-ms"] = xmlrpc_c::value_double(Percentile(updateLatencies, 0.99));
+  }
+
+private:
+  static const size_t kLatencyWindow = 1000;
+
+  // the most recent requests only
+  static void AddToWindow(vector<double>& window, size_t& next, double ms) {
+    if (window.size() < kLatencyWindow) {
+      window.push_back(ms);
+    } else {
+      window[next] = ms;
+      next = (next + 1) % kLatencyWindow;
+    }
+  }
+
+  static double Percentile(vector<double>& values, double p) {
+    if (values.empty()) return 0;
+    vector<double>::iterator nth = values.begin() + (size_t)(p * (values.size() - 1));
+    nth_element(values.begin(), nth, values.end());
+    return *nth;
+  }
+
+  vector<double> m_latencies;
+  size_t m_next;
+  int m_completed;
+  int m_rejected;
+  int m_shared;
+  vector<double> m_updateLatencies;
+  size_t m_updateNext;
+  int m_updates;
+  double m_firstUpdateMs;
+#ifdef WITH_THREADS
+  mutable boost::mutex m_mutex;
+#endif
+};
+
+/** Adds sentence pairs to the phrase table.  Translations carry on while
+  * the table is updated, on the version they started with. */
 class Updater: public xmlrpc_c::method
 {
 public:
-  Updater() {
+  Updater(ServerStats& stats) : m_stats(stats) {
     // signature and help strings are documentation -- the client
     // can query this information with a system.methodSignature and
     // system.methodHelp RPC.
@@ -47,15 +158,23 @@ public:
   execute(xmlrpc_c::paramList const& paramList,
           xmlrpc_c::value *   const  retvalP) {
     const params_t params = paramList.getStruct(0);
-    breakOutParams(params);
+    // several updates may run at once: nothing is kept in the method
+    string source, target, alignment;
+    bool bounded, add2ORLM;
+    breakOutParams(params, source, target, alignment, bounded, add2ORLM);
     const TranslationSystem& system = getTranslationSystem(params);
     const PhraseDictionaryFeature* pdf = system.GetPhraseDictionaries()[0];
     PhraseDictionaryDynSuffixArray* pdsa = (PhraseDictionaryDynSuffixArray*) pdf->GetDictionary();
     cerr << "Inserting into address " << pdsa << endl;
-    pdsa->insertSnt(source_, target_, alignment_);
-    if(add2ORLM_) {       
-      updateORLM();
+    const double start = NowMs();
+    // the LM update is in place before any phrase table version with the
+    // sentence pair: a sentence takes its phrase table version before its LM
+    // version, so one which gets the new phrases gets the new n-grams too
+    if(add2ORLM) {       
+      updateORLM(target);
     }
+    pdsa->insertSnt(source, target, alignment);
+    m_stats.AddUpdate(NowMs() - start);
     cerr << "Done inserting\n";
     //PhraseDictionary* pdsa = (PhraseDictionary*) pdf->GetDictionary(*dummy);
     map<string, xmlrpc_c::value> retData;
@@ -64,9 +183,7 @@ public:
     pdsa = 0;
     *retvalP = xmlrpc_c::value_string("Phrase table updated");
   }
-  string source_, target_, alignment_;
-  bool bounded_, add2ORLM_;
-  void updateORLM() {
+  void updateORLM(const string& target) {
 #ifdef LM_ORLM
     vector<string> vl;
     map<vector<string>, int> ngSet;
@@ -89,7 +206,7 @@ public:
     const int ngOrder(orlm->GetNGramOrder());
     const std::string sBOS = orlm->GetSentenceStart()->GetString();
     const std::string sEOS = orlm->GetSentenceEnd()->GetString();
-    Utils::splitToStr(target_, vl, " ");
+    Utils::splitToStr(target, vl, " ");
     // insert BOS and EOS 
     vl.insert(vl.begin(), sBOS); 
     vl.insert(vl.end(), sEOS);
@@ -107,111 +224,101 @@ public:
     }
     // insert into LM in order from 1grams up (for LM well-formedness)
     cerr << "Inserting " << ngSet.size() << " ngrams into ORLM...\n";
+    LanguageModelORLM::NGramCounts ngrams;
     for(int i=1; i <= ngOrder; ++i) {
       iterate(ngSet, it) {
         if(it->first.size() == i)
-          orlm->UpdateORLM(it->first, it->second);
+          ngrams.push_back(*it);
       }
     }
+    orlm->UpdateORLM(ngrams);
 #endif
   }
-  void breakOutParams(const params_t& params) {
+  void breakOutParams(const params_t& params, string& source, string& target, string& alignment,
+                      bool& bounded, bool& add2ORLM) {
     params_t::const_iterator si = params.find("source");
     if(si == params.end())
       throw xmlrpc_c::fault("Missing source sentence", xmlrpc_c::fault::CODE_PARSE);
-    source_ = xmlrpc_c::value_string(si->second);
-    cerr << "source = " << source_ << endl;
+    source = xmlrpc_c::value_string(si->second);
+    cerr << "source = " << source << endl;
     si = params.find("target");
     if(si == params.end())
       throw xmlrpc_c::fault("Missing target sentence", xmlrpc_c::fault::CODE_PARSE);
-    target_ = xmlrpc_c::value_string(si->second);
-    cerr << "target = " << target_ << endl;
+    target = xmlrpc_c::value_string(si->second);
+    cerr << "target = " << target << endl;
     si = params.find("alignment");
     if(si == params.end())
       throw xmlrpc_c::fault("Missing alignment", xmlrpc_c::fault::CODE_PARSE);
-    alignment_ = xmlrpc_c::value_string(si->second);
-    cerr << "alignment = " << alignment_ << endl;
+    alignment = xmlrpc_c::value_string(si->second);
+    cerr << "alignment = " << alignment << endl;
     si = params.find("bounded");
-    bounded_ = (si != params.end());
+    bounded = (si != params.end());
     si = params.find("updateORLM");
-    add2ORLM_ = (si != params.end());
+    add2ORLM = (si != params.end());
   }
+
+private:
+  ServerStats& m_stats;
 };
 
-class Translator : public xmlrpc_c::method
-{
-public:
-  Translator() {
-    // signature and help strings are documentation -- the client
-    // can query this information with a system.methodSignature and
-    // system.methodHelp RPC.
-    this->_signature = "S:S";
-    this->_help = "Does translation";
+/** The options of a "translate" request */
+struct TranslationRequest {
+  string source;
+  string systemId;
+  bool addAlignInfo;
+  bool addGraphInfo;
+  bool addTopts;
+  bool reportAllFactors;
+
+  //! requests with the same key get the same translation
+  string Key() const {
+    stringstream key;
+    key << systemId << '\t' << addAlignInfo << addGraphInfo << addTopts << reportAllFactors << '\t' << source;
+    return key.str();
   }
+};
 
-  void
-  execute(xmlrpc_c::paramList const& paramList,
-          xmlrpc_c::value *   const  retvalP) {
-
-    const params_t params = paramList.getStruct(0);
-    paramList.verifyEnd(1);
-    params_t::const_iterator si = params.find("text");
-    if (si == params.end()) {
-      throw xmlrpc_c::fault(
-        "Missing source text",
-        xmlrpc_c::fault::CODE_PARSE);
-    }
-    const string source(
-      (xmlrpc_c::value_string(si->second)));
-
-    cerr << "Input: " << source << endl;
-    si = params.find("align");
-    bool addAlignInfo = (si != params.end());
-    si = params.find("sg");
-    bool addGraphInfo = (si != params.end());
-    si = params.find("topt");
-    bool addTopts = (si != params.end());
-    si = params.find("report-all-factors");
-    bool reportAllFactors = (si != params.end());
-
+/** Decodes requests.  All the options are per request: nothing in StaticData
+  * is changed, so several requests may be decoded at once. */
+class Decoder
+{
+public:
+  void Translate(const TranslationRequest& request, map<string, xmlrpc_c::value>& retData) {
+    cerr << "Input: " << request.source << endl;
     const StaticData &staticData = StaticData::Instance();
-
-    if (addGraphInfo) {
-      (const_cast<StaticData&>(staticData)).SetOutputSearchGraph(true);
-    }
-
-    const TranslationSystem& system = getTranslationSystem(params);
+    VERBOSE(1, "Using translation system " << request.systemId << endl;)
+    const TranslationSystem& system = staticData.GetTranslationSystem(request.systemId);
 
     Sentence sentence;
     const vector<FactorType> &inputFactorOrder =
       staticData.GetInputFactorOrder();
-    stringstream in(source + "\n");
+    stringstream in(request.source + "\n");
     sentence.Read(in,inputFactorOrder);
     Manager manager(sentence,staticData.GetSearchAlgorithm(), &system);
+    if (request.addGraphInfo) {
+      manager.SetOutputSearchGraph(true);
+    }
     manager.ProcessSentence();
     const Hypothesis* hypo = manager.GetBestHypothesis();
 
     vector<xmlrpc_c::value> alignInfo;
     stringstream out, graphInfo, transCollOpts;
-    outputHypo(out,hypo,addAlignInfo,alignInfo,reportAllFactors);
+    outputHypo(out,hypo,request.addAlignInfo,alignInfo,request.reportAllFactors);
 
-    map<string, xmlrpc_c::value> retData;
     pair<string, xmlrpc_c::value>
     text("text", xmlrpc_c::value_string(out.str()));
     cerr << "Output: " << out.str() << endl;
-    if (addAlignInfo) {
+    if (request.addAlignInfo) {
       retData.insert(pair<string, xmlrpc_c::value>("align", xmlrpc_c::value_array(alignInfo)));
     }
     retData.insert(text);
 
-    if(addGraphInfo) {
+    if(request.addGraphInfo) {
       insertGraphInfo(manager,retData);
-      (const_cast<StaticData&>(staticData)).SetOutputSearchGraph(false);
     }
-    if (addTopts) {
+    if (request.addTopts) {
       insertTranslationOptions(manager,retData);
     }
-    *retvalP = xmlrpc_c::value_struct(retData);
   }
 
   void outputHypo(ostream& out, const Hypothesis* hypo, bool addAlignmentInfo, vector<xmlrpc_c::value>& alignInfo, bool reportAllFactors = false) {
@@ -301,9 +408,233 @@ public:
     }
     retData.insert(pair<string, xmlrpc_c::value>("topt", xmlrpc_c::value_array(toptsXml)));
   }
+};
 
+#ifdef WITH_THREADS
 
+/** A request waiting for its translation, shared with the identical
+  * requests that arrive before it is decoded */
+class PendingTranslation
+{
+public:
+  explicit PendingTranslation(const TranslationRequest& request)
+    : m_request(request), m_done(false) {}
+
+  const TranslationRequest& GetRequest() const {
+    return m_request;
+  }
+
+  void Finish(const map<string, xmlrpc_c::value>& result, const string& error) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_result = result;
+    m_error = error;
+    m_done = true;
+    m_finished.notify_all();
+  }
 
+  //! wait for the translation; throws a fault if decoding failed
+  void Wait(map<string, xmlrpc_c::value>& retData) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    while (!m_done) {
+      m_finished.wait(lock);
+    }
+    if (!m_error.empty()) {
+      throw xmlrpc_c::fault(m_error, xmlrpc_c::fault::CODE_INTERNAL);
+    }
+    retData = m_result;
+  }
+
+private:
+  TranslationRequest m_request;
+  map<string, xmlrpc_c::value> m_result;
+  string m_error;
+  bool m_done;
+  boost::mutex m_mutex;
+  boost::condition_variable m_finished;
+};
+
+/**
+  * Bounded queue of the requests in front of the decoder ThreadPool.  Each
+  * request is decoded by its own task on the pool.  When the queue is full,
+  * requests are refused straight away, so that clients back off instead of
+  * piling up behind the decoder.  A request identical to one still waiting
+  * for a worker gets that request's translation instead of a task of its own.
+  **/
+class RequestQueue
+{
+public:
+  RequestQueue(size_t threads, size_t limit, ServerStats& stats)
+    : m_pool(threads), m_limit(limit), m_stats(stats) {}
+
+  void Translate(const TranslationRequest& request, map<string, xmlrpc_c::value>& retData) {
+    const string key = request.Key();
+    boost::shared_ptr<PendingTranslation> pending;
+    bool shared = false;
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      Waiting::const_iterator found = m_waiting.find(key);
+      if (found != m_waiting.end()) {
+        pending = found->second;
+        shared = true;
+      } else if (m_limit && m_waiting.size() >= m_limit) {
+        lock.unlock();
+        m_stats.AddRejected();
+        throw xmlrpc_c::fault("Server busy, try again later", xmlrpc_c::fault::CODE_LIMIT_EXCEEDED);
+      } else {
+        pending.reset(new PendingTranslation(request));
+        m_waiting[key] = pending;
+      }
+    }
+    if (shared) {
+      m_stats.AddShared();
+    } else {
+      m_pool.Submit(new TranslationTask(*this, pending));
+    }
+    pending->Wait(retData);
+  }
+
+  size_t Size() const {
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_waiting.size();
+  }
+
+private:
+  typedef map<string, boost::shared_ptr<PendingTranslation> > Waiting;
+
+  class TranslationTask : public Task
+  {
+  public:
+    TranslationTask(RequestQueue& queue, const boost::shared_ptr<PendingTranslation>& pending)
+      : m_queue(queue), m_pending(pending) {}
+    void Run() {
+      m_queue.Run(*m_pending);
+    }
+  private:
+    RequestQueue& m_queue;
+    boost::shared_ptr<PendingTranslation> m_pending;
+  };
+
+  void Run(PendingTranslation& pending) {
+    {
+      // requests from now on may see phrase table updates this one won't,
+      // so they are decoded again
+      boost::mutex::scoped_lock lock(m_mutex);
+      m_waiting.erase(pending.GetRequest().Key());
+    }
+    map<string, xmlrpc_c::value> result;
+    string error;
+    try {
+      m_decoder.Translate(pending.GetRequest(), result);
+    } catch (const xmlrpc_c::fault& e) {
+      error = e.getDescription();
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+    pending.Finish(result, error);
+  }
+
+  ThreadPool m_pool;
+  size_t m_limit;
+  ServerStats& m_stats;
+  Decoder m_decoder;
+  Waiting m_waiting;
+  mutable boost::mutex m_mutex;
+};
+
+#endif
+
+class Translator : public xmlrpc_c::method
+{
+public:
+#ifdef WITH_THREADS
+  Translator(ServerStats& stats, RequestQueue* queue) : m_stats(stats), m_queue(queue) {
+#else
+  Translator(ServerStats& stats) : m_stats(stats) {
+#endif
+    // signature and help strings are documentation -- the client
+    // can query this information with a system.methodSignature and
+    // system.methodHelp RPC.
+    this->_signature = "S:S";
+    this->_help = "Does translation";
+  }
+
+  void
+  execute(xmlrpc_c::paramList const& paramList,
+          xmlrpc_c::value *   const  retvalP) {
+
+    const params_t params = paramList.getStruct(0);
+    paramList.verifyEnd(1);
+    params_t::const_iterator si = params.find("text");
+    if (si == params.end()) {
+      throw xmlrpc_c::fault(
+        "Missing source text",
+        xmlrpc_c::fault::CODE_PARSE);
+    }
+    TranslationRequest request;
+    request.source = xmlrpc_c::value_string(si->second);
+    request.systemId = TranslationSystem::DEFAULT;
+    si = params.find("system");
+    if (si != params.end()) {
+      request.systemId = xmlrpc_c::value_string(si->second);
+    }
+    request.addAlignInfo = (params.find("align") != params.end());
+    request.addGraphInfo = (params.find("sg") != params.end());
+    request.addTopts = (params.find("topt") != params.end());
+    request.reportAllFactors = (params.find("report-all-factors") != params.end());
+
+    const double start = NowMs();
+    map<string, xmlrpc_c::value> retData;
+#ifdef WITH_THREADS
+    if (m_queue) {
+      m_queue->Translate(request, retData);
+    } else
+#endif
+    {
+      m_decoder.Translate(request, retData);
+    }
+    m_stats.AddLatency(NowMs() - start);
+    *retvalP = xmlrpc_c::value_struct(retData);
+  }
+
+private:
+  ServerStats& m_stats;
+#ifdef WITH_THREADS
+  RequestQueue* m_queue;
+#endif
+  Decoder m_decoder;
+};
+
+class StatsReporter : public xmlrpc_c::method
+{
+public:
+#ifdef WITH_THREADS
+  StatsReporter(const ServerStats& stats, const RequestQueue* queue) : m_stats(stats), m_queue(queue) {
+#else
+  StatsReporter(const ServerStats& stats) : m_stats(stats) {
+#endif
+    this->_signature = "S:";
+    this->_help = "Reports latency percentiles, queue depth and phrase table updates";
+  }
+
+  void
+  execute(xmlrpc_c::paramList const& paramList,
+          xmlrpc_c::value *   const  retvalP) {
+    paramList.verifyEnd(0);
+    map<string, xmlrpc_c::value> retData;
+    m_stats.Get(retData);
+    int queued = 0;
+#ifdef WITH_THREADS
+    if (m_queue) queued = m_queue->Size();
+#endif
+    retData["queued"] = xmlrpc_c::value_int(queued);
+    *retvalP = xmlrpc_c::value_struct(retData);
+  }
+
+private:
+  const ServerStats& m_stats;
+#ifdef WITH_THREADS
+  const RequestQueue* m_queue;
+#endif
 };
 
 
@@ -316,6 +647,7 @@ int main(int argc, char** argv)
   int port = 8080;
   const char* logfile = "/dev/null";
   bool isSerial = false;
+  size_t queueLimit = 64;
 
   for (int i = 0; i < argc; ++i) {
     if (!strcmp(argv[i],"--server-port")) {
@@ -334,6 +666,14 @@ int main(int argc, char** argv)
       } else {
         logfile = argv[i];
       }
+    } else if (!strcmp(argv[i],"--server-queue")) {
+      ++i;
+      if (i >= argc) {
+        cerr << "Error: Missing argument to --server-queue" << endl;
+        exit(1);
+      } else {
+        queueLimit = atoi(argv[i]);
+      }
     } else if (!strcmp(argv[i], "--serial")) {
       cerr << "Running single-threaded server" << endl;
       isSerial = true;
@@ -355,11 +695,24 @@ int main(int argc, char** argv)
 
   xmlrpc_c::registry myRegistry;
 
-  xmlrpc_c::methodPtr const translator(new Translator);
-  xmlrpc_c::methodPtr const updater(new Updater);
+  // Requests are decoded by a pool of -threads workers, unless serial
+  ServerStats stats;
+#ifdef WITH_THREADS
+  RequestQueue* queue = NULL;
+  if (!isSerial) {
+    queue = new RequestQueue(StaticData::Instance().ThreadCount(), queueLimit, stats);
+  }
+  xmlrpc_c::methodPtr const translator(new Translator(stats, queue));
+  xmlrpc_c::methodPtr const reporter(new StatsReporter(stats, queue));
+#else
+  xmlrpc_c::methodPtr const translator(new Translator(stats));
+  xmlrpc_c::methodPtr const reporter(new StatsReporter(stats));
+#endif
+  xmlrpc_c::methodPtr const updater(new Updater(stats));
 
   myRegistry.addMethod("translate", translator);
   myRegistry.addMethod("updater", updater);
+  myRegistry.addMethod("stats", reporter);
 
   xmlrpc_c::serverAbyss myAbyssServer(
     myRegistry,
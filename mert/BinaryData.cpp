@@ -0,0 +1,362 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "BinaryData.h"
+#include "FeatureArray.h"
+#include "ScoreArray.h"
+
+using namespace std;
+
+namespace {
+
+const char kMagic[8] = {'M', 'E', 'R', 'T', 'D', 'A', 'T', 'A'};
+const uint32_t kVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;
+  uint64_t blockSize; // including the header
+  uint64_t sentences;
+  uint64_t candidates;
+  uint64_t dense;
+  uint64_t sparse;
+  uint64_t names;
+  uint64_t idBytes;
+  uint64_t nameBytes;
+  uint64_t descriptionBytes;
+};
+
+// Dense values are copied bit for bit.
+char FloatMustBe4Bytes[sizeof(FeatureStatsType) == 4 ? 1 : -1];
+char ScoreMustBe4Bytes[sizeof(ScoreStatsType) == 4 ? 1 : -1];
+
+uint64_t Padded(uint64_t size) {
+  return (size + 7) & ~static_cast<uint64_t>(7);
+}
+
+void Append(string& out, const void* data, size_t size) {
+  out.append(static_cast<const char*>(data), size);
+  out.append(Padded(size) - size, '\0');
+}
+
+template <class T> void Append(string& out, const vector<T>& data) {
+  Append(out, data.empty() ? NULL : &data[0], data.size() * sizeof(T));
+}
+
+// offsets[0..count] start at 0, never decrease and end at total, so every
+// range they delimit lies inside its section
+bool ValidOffsets(const uint64_t* offsets, uint64_t count, uint64_t total) {
+  if (offsets[0] != 0)
+    return false;
+  for (uint64_t i = 0; i < count; ++i) {
+    if (offsets[i+1] < offsets[i])
+      return false;
+  }
+  return offsets[count] == total;
+}
+
+/** Walks through the sections of a block, checking they are inside it. */
+class Sections {
+  public:
+    Sections(const string& filename, const char* begin, const char* end)
+      : m_filename(filename), m_cur(begin), m_end(end) {}
+
+    template <class T> const T* next(uint64_t count) {
+      const uint64_t size = count * sizeof(T);
+      if (count > static_cast<uint64_t>(m_end - m_cur) / sizeof(T)
+          || Padded(size) > static_cast<uint64_t>(m_end - m_cur)) {
+        throw runtime_error("Truncated block in binary data file " + m_filename);
+      }
+      const T* ret = reinterpret_cast<const T*>(m_cur);
+      m_cur += Padded(size);
+      return ret;
+    }
+
+  private:
+    const string& m_filename;
+    const char* m_cur;
+    const char* m_end;
+};
+
+}
+
+bool IsBinaryDataFile(const string& filename) {
+  ifstream in(filename.c_str(), ios::in | ios::binary);
+  char magic[sizeof(kMagic)];
+  in.read(magic, sizeof(magic));
+  return in && !memcmp(magic, kMagic, sizeof(kMagic));
+}
+
+BinaryDataWriter::BinaryDataWriter(BinaryDataKind kind, const string& description)
+  : m_kind(kind), m_description(description), m_dense(0),
+    m_sentenceOffsets(1, 0), m_idOffsets(1, 0), m_sparseOffsets(1, 0),
+    m_nameOffsets(1, 0) {}
+
+void BinaryDataWriter::addSentence(const string& idx, size_t candidates, size_t dense) {
+  if (m_sentenceOffsets.size() == 1) {
+    m_dense = dense;
+  } else if (dense != m_dense && candidates > 0) {
+    throw runtime_error("Sentence " + idx + " has a different number of dense values");
+  }
+  m_sentenceOffsets.push_back(m_sentenceOffsets.back() + candidates);
+  m_ids += idx;
+  m_idOffsets.push_back(m_ids.size());
+}
+
+void BinaryDataWriter::add(const FeatureArray& sentence) {
+  if (m_kind != BINARY_FEATURES)
+    throw runtime_error("Adding features to a binary score file");
+  addSentence(sentence.getIndex(), sentence.size(),
+              sentence.size() ? sentence.get(0).size() : m_dense);
+  for (size_t i = 0; i < sentence.size(); ++i) {
+    const FeatureStats& stats = sentence.get(i);
+    if (stats.size() != m_dense)
+      throw runtime_error("Sentence " + sentence.getIndex() + " has a different number of dense values");
+    const size_t offset = m_values.size();
+    m_values.resize(offset + m_dense);
+    if (m_dense)
+      memcpy(&m_values[offset], stats.getArray(), m_dense * sizeof(uint32_t));
+
+    const SparseVector& sparse = stats.getSparse();
+    for (SparseVector::fvector_t::const_iterator j = sparse.begin(); j != sparse.end(); ++j) {
+      map<size_t, uint32_t>::const_iterator name = m_nameIds.find(j->first);
+      if (name == m_nameIds.end()) {
+        name = m_nameIds.insert(make_pair(j->first, static_cast<uint32_t>(m_nameOffsets.size() - 1))).first;
+        m_names += SparseVector::getName(j->first);
+        m_nameOffsets.push_back(m_names.size());
+      }
+      m_sparseIds.push_back(name->second);
+      m_sparseValues.push_back(j->second);
+    }
+    m_sparseOffsets.push_back(m_sparseIds.size());
+  }
+}
+
+void BinaryDataWriter::add(const ScoreArray& sentence) {
+  if (m_kind != BINARY_SCORES)
+    throw runtime_error("Adding scores to a binary feature file");
+  addSentence(sentence.getIndex(), sentence.size(),
+              sentence.size() ? sentence.get(0).size() : m_dense);
+  for (size_t i = 0; i < sentence.size(); ++i) {
+    const ScoreStats& stats = sentence.get(i);
+    if (stats.size() != m_dense)
+      throw runtime_error("Sentence " + sentence.getIndex() + " has a different number of scores");
+    const size_t offset = m_values.size();
+    m_values.resize(offset + m_dense);
+    if (m_dense)
+      memcpy(&m_values[offset], stats.getArray(), m_dense * sizeof(uint32_t));
+    m_sparseOffsets.push_back(m_sparseIds.size());
+  }
+}
+
+void BinaryDataWriter::write(const string& filename, bool append) const {
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.kind = m_kind;
+  header.sentences = m_sentenceOffsets.size() - 1;
+  header.candidates = m_sentenceOffsets.back();
+  header.dense = m_dense;
+  header.sparse = m_sparseIds.size();
+  header.names = m_nameOffsets.size() - 1;
+  header.idBytes = m_ids.size();
+  header.nameBytes = m_names.size();
+  header.descriptionBytes = m_description.size();
+
+  string block;
+  Append(block, m_sentenceOffsets);
+  Append(block, m_idOffsets);
+  Append(block, m_ids.data(), m_ids.size());
+  Append(block, m_values);
+  Append(block, m_sparseOffsets);
+  Append(block, m_sparseIds);
+  Append(block, m_sparseValues);
+  Append(block, m_nameOffsets);
+  Append(block, m_names.data(), m_names.size());
+  Append(block, m_description.data(), m_description.size());
+  header.blockSize = sizeof(Header) + block.size();
+
+  ofstream out(filename.c_str(), ios::out | ios::binary | (append ? ios::app : ios::trunc));
+  if (!out)
+    throw runtime_error("Unable to open binary data file " + filename);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(block.data(), block.size());
+  if (!out)
+    throw runtime_error("Failed to write binary data file " + filename);
+}
+
+BinaryDataFile::BinaryDataFile(const string& filename)
+  : m_filename(filename), m_kind(BINARY_FEATURES),
+    m_file(util::OpenReadOrThrow(filename.c_str())) {
+  const uint64_t size = util::SizeFile(m_file.get());
+  if (size == util::kBadSize)
+    throw runtime_error("Unable to get the size of " + filename);
+  util::MapRead(util::LAZY, m_file.get(), 0, size, m_memory);
+
+  const char* cur = m_memory.begin();
+  while (cur != m_memory.end()) {
+    if (static_cast<size_t>(m_memory.end() - cur) < sizeof(Header))
+      throw runtime_error("Truncated block header in binary data file " + filename);
+    Header header;
+    memcpy(&header, cur, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)))
+      throw runtime_error("Not a binary data file: " + filename);
+    if (header.version != kVersion)
+      throw runtime_error("Unsupported version or byte order of binary data file " + filename);
+    if (header.kind != BINARY_FEATURES && header.kind != BINARY_SCORES)
+      throw runtime_error("Unknown kind of data in " + filename);
+    if (m_blocks.empty())
+      m_kind = static_cast<BinaryDataKind>(header.kind);
+    else if (header.kind != static_cast<uint32_t>(m_kind))
+      throw runtime_error("Binary data file " + filename + " mixes features and scores");
+    if (header.blockSize < sizeof(Header) || header.blockSize > static_cast<uint64_t>(m_memory.end() - cur))
+      throw runtime_error("Truncated block in binary data file " + filename);
+
+    Sections sections(filename, cur + sizeof(Header), cur + header.blockSize);
+    Block block;
+    block.dense = header.dense;
+    block.sentenceOffsets = sections.next<uint64_t>(header.sentences + 1);
+    block.idOffsets = sections.next<uint64_t>(header.sentences + 1);
+    block.ids = sections.next<char>(header.idBytes);
+    block.values = sections.next<uint32_t>(header.candidates * header.dense);
+    block.sparseOffsets = sections.next<uint64_t>(header.candidates + 1);
+    block.sparseIds = sections.next<uint32_t>(header.sparse);
+    block.sparseValues = sections.next<float>(header.sparse);
+    const uint64_t* nameOffsets = sections.next<uint64_t>(header.names + 1);
+    const char* names = sections.next<char>(header.nameBytes);
+    const char* description = sections.next<char>(header.descriptionBytes);
+    block.description.assign(description, header.descriptionBytes);
+
+    if (!ValidOffsets(block.sentenceOffsets, header.sentences, header.candidates)
+        || !ValidOffsets(block.idOffsets, header.sentences, header.idBytes)
+        || !ValidOffsets(block.sparseOffsets, header.candidates, header.sparse)
+        || !ValidOffsets(nameOffsets, header.names, header.nameBytes))
+      throw runtime_error("Inconsistent block in binary data file " + filename);
+    for (uint64_t i = 0; i < header.sparse; ++i) {
+      if (block.sparseIds[i] >= header.names)
+        throw runtime_error("Sparse feature id out of range in binary data file " + filename);
+    }
+
+    // feature names are interned once per block, not once per value
+    block.nameIds.resize(header.names);
+    for (uint64_t i = 0; i < header.names; ++i) {
+      block.nameIds[i] = SparseVector::getId(string(names + nameOffsets[i], nameOffsets[i+1] - nameOffsets[i]));
+    }
+
+    for (uint64_t i = 0; i < header.sentences; ++i) {
+      m_sentences.push_back(make_pair(m_blocks.size(), i));
+    }
+    m_blocks.push_back(block);
+    cur += header.blockSize;
+  }
+}
+
+string BinaryDataFile::getIndex(size_t sentence) const {
+  const Block& block = getBlock(sentence);
+  const size_t i = m_sentences[sentence].second;
+  return string(block.ids + block.idOffsets[i], block.idOffsets[i+1] - block.idOffsets[i]);
+}
+
+const string& BinaryDataFile::getDescription(size_t sentence) const {
+  return getBlock(sentence).description;
+}
+
+size_t BinaryDataFile::getDenseSize(size_t sentence) const {
+  return getBlock(sentence).dense;
+}
+
+size_t BinaryDataFile::getCandidates(size_t sentence) const {
+  const Block& block = getBlock(sentence);
+  const size_t i = m_sentences[sentence].second;
+  return block.sentenceOffsets[i+1] - block.sentenceOffsets[i];
+}
+
+const uint32_t* BinaryDataFile::getValues(size_t sentence, size_t candidate) const {
+  const Block& block = getBlock(sentence);
+  const size_t row = block.sentenceOffsets[m_sentences[sentence].second] + candidate;
+  return block.values + row * block.dense;
+}
+
+const FeatureStatsType* BinaryDataFile::getFeatures(size_t sentence, size_t candidate) const {
+  return reinterpret_cast<const FeatureStatsType*>(getValues(sentence, candidate));
+}
+
+const ScoreStatsType* BinaryDataFile::getScores(size_t sentence, size_t candidate) const {
+  return reinterpret_cast<const ScoreStatsType*>(getValues(sentence, candidate));
+}
+
+void BinaryDataFile::getSparse(size_t sentence, size_t candidate, SparseVector& out) const {
+  const Block& block = getBlock(sentence);
+  const size_t row = block.sentenceOffsets[m_sentences[sentence].second] + candidate;
+  out.clear();
+  for (uint64_t i = block.sparseOffsets[row]; i < block.sparseOffsets[row+1]; ++i) {
+    out.set(block.nameIds[block.sparseIds[i]], block.sparseValues[i]);
+  }
+}
+
+void BinaryDataFile::get(size_t sentence, FeatureArray& out) const {
+  if (m_kind != BINARY_FEATURES)
+    throw runtime_error(m_filename + " holds scores, not features");
+  const Block& block = getBlock(sentence);
+  const size_t row = block.sentenceOffsets[m_sentences[sentence].second];
+  out.clear();
+  out.setIndex(getIndex(sentence));
+  out.NumberOfFeatures(block.dense);
+  out.Features(block.description);
+
+  FeatureStats entry(block.dense);
+  for (size_t i = 0; i < getCandidates(sentence); ++i) {
+    entry.reset();
+    const FeatureStatsType* values = getFeatures(sentence, i);
+    for (size_t j = 0; j < block.dense; ++j) {
+      entry.add(values[j]);
+    }
+    for (uint64_t j = block.sparseOffsets[row+i]; j < block.sparseOffsets[row+i+1]; ++j) {
+      entry.addSparse(block.nameIds[block.sparseIds[j]], block.sparseValues[j]);
+    }
+    out.add(entry);
+  }
+}
+
+void BinaryDataFile::get(size_t sentence, ScoreArray& out) const {
+  if (m_kind != BINARY_SCORES)
+    throw runtime_error(m_filename + " holds features, not scores");
+  const Block& block = getBlock(sentence);
+  out.clear();
+  out.setIndex(getIndex(sentence));
+  out.NumberOfScores(block.dense);
+  string name = block.description;
+  out.name(name);
+
+  ScoreStats entry(block.dense);
+  for (size_t i = 0; i < getCandidates(sentence); ++i) {
+    entry.reset();
+    const ScoreStatsType* values = getScores(sentence, i);
+    for (size_t j = 0; j < block.dense; ++j) {
+      entry.add(values[j]);
+    }
+    out.add(entry);
+  }
+}
@@ -0,0 +1,154 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef _BINARY_DATA_
+#define _BINARY_DATA_
+
+/**
+  * Columnar binary format for feature and score data, written by the
+  * extractor with --binary and mapped into memory by mert and pro, so
+  * that nothing is parsed when the data is loaded.
+  *
+  * A file is a sequence of blocks, each holding the n-best lists of some
+  * sentences; appending to a file adds a block.  As with the text format,
+  * the lists of a sentence that appears in several blocks are merged on
+  * loading.  A block is a fixed size header followed by these sections,
+  * each padded to 8 bytes:
+  *
+  *   sentence offsets   uint64[sentences+1]   first candidate of each sentence
+  *   id offsets         uint64[sentences+1]   into the sentence ids
+  *   sentence ids       char[]
+  *   dense values       4 bytes[candidates*dense]   float features or int scores
+  *   sparse offsets     uint64[candidates+1]  first sparse entry of each candidate
+  *   sparse ids         uint32[sparse]        into the name table of the block
+  *   sparse values      float[sparse]
+  *   name offsets       uint64[names+1]
+  *   names              char[]
+  *   description        char[]                feature names or scorer type
+  *
+  * Numbers are in the byte order of the machine that wrote the file.
+**/
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "util/file.hh"
+#include "util/mmap.hh"
+
+#include "Types.h"
+
+class FeatureArray;
+class ScoreArray;
+class SparseVector;
+
+enum BinaryDataKind {
+  BINARY_FEATURES = 0,
+  BINARY_SCORES = 1
+};
+
+/** Does the file start like a block of binary data? */
+bool IsBinaryDataFile(const std::string& filename);
+
+/** Collects the n-best lists of some sentences and writes them as one block. */
+class BinaryDataWriter
+{
+  public:
+    BinaryDataWriter(BinaryDataKind kind, const std::string& description);
+
+    void add(const FeatureArray& sentence);
+    void add(const ScoreArray& sentence);
+
+    void write(const std::string& filename, bool append) const;
+
+  private:
+    void addSentence(const std::string& idx, size_t candidates, size_t dense);
+
+    BinaryDataKind m_kind;
+    std::string m_description;
+    size_t m_dense;
+    std::vector<uint64_t> m_sentenceOffsets;
+    std::vector<uint64_t> m_idOffsets;
+    std::string m_ids;
+    std::vector<uint32_t> m_values;
+    std::vector<uint64_t> m_sparseOffsets;
+    std::vector<uint32_t> m_sparseIds;
+    std::vector<float> m_sparseValues;
+    std::map<size_t, uint32_t> m_nameIds; // sparse feature id to id in the block
+    std::vector<uint64_t> m_nameOffsets;
+    std::string m_names;
+};
+
+/** A file of binary data, mapped into memory.  Sentences are numbered in file
+  * order across all blocks. */
+class BinaryDataFile
+{
+  public:
+    explicit BinaryDataFile(const std::string& filename);
+
+    BinaryDataKind kind() const {
+      return m_kind;
+    }
+    inline size_t size() const {
+      return m_sentences.size();
+    }
+
+    std::string getIndex(size_t sentence) const;
+    const std::string& getDescription(size_t sentence) const;
+    size_t getDenseSize(size_t sentence) const;
+    size_t getCandidates(size_t sentence) const;
+
+    //! the dense values of a candidate, getDenseSize() of them
+    const FeatureStatsType* getFeatures(size_t sentence, size_t candidate) const;
+    const ScoreStatsType* getScores(size_t sentence, size_t candidate) const;
+    void getSparse(size_t sentence, size_t candidate, SparseVector& out) const;
+
+    void get(size_t sentence, FeatureArray& out) const;
+    void get(size_t sentence, ScoreArray& out) const;
+
+  private:
+    struct Block {
+      std::string description;
+      size_t dense;
+      const uint64_t* sentenceOffsets;
+      const uint64_t* idOffsets;
+      const char* ids;
+      const uint32_t* values;
+      const uint64_t* sparseOffsets;
+      const uint32_t* sparseIds;
+      const float* sparseValues;
+      std::vector<size_t> nameIds; // id in the block to sparse feature id
+    };
+
+    const Block& getBlock(size_t sentence) const {
+      return m_blocks[m_sentences[sentence].first];
+    }
+    const uint32_t* getValues(size_t sentence, size_t candidate) const;
+
+    std::string m_filename;
+    BinaryDataKind m_kind;
+    util::scoped_fd m_file;
+    util::scoped_memory m_memory;
+    std::vector<Block> m_blocks;
+    std::vector<std::pair<size_t, size_t> > m_sentences; // block and sentence in the block
+};
+
+#endif
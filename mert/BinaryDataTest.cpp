@@ -0,0 +1,302 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "BinaryData.h"
+
+#include "FeatureArray.h"
+#include "ScoreArray.h"
+
+#define BOOST_TEST_MODULE MertBinaryData
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// a file name that is unused until the test writes it
+class TempFile {
+  public:
+    TempFile() {
+      char name[] = "/tmp/mert_binary_data_test_XXXXXX";
+      int fd = mkstemp(name);
+      BOOST_REQUIRE(fd != -1);
+      close(fd);
+      m_name = name;
+    }
+    ~TempFile() {
+      unlink(m_name.c_str());
+    }
+    const string& name() const {
+      return m_name;
+    }
+  private:
+    string m_name;
+};
+
+// candidate i of a sentence has dense values first+i, first+i+1, ... and,
+// for odd i, a sparse feature named after the sentence
+FeatureArray MakeFeatures(const string& idx, size_t candidates, size_t dense, float first) {
+  FeatureArray features;
+  features.setIndex(idx);
+  features.NumberOfFeatures(dense);
+  features.Features("d_0 d_1 d_2");
+  for (size_t i = 0; i < candidates; ++i) {
+    FeatureStats stats;
+    for (size_t j = 0; j < dense; ++j) stats.add(first + i + j);
+    if (i % 2) stats.addSparse("sparse_" + idx, first - i);
+    features.add(stats);
+  }
+  return features;
+}
+
+ScoreArray MakeScores(const string& idx, size_t candidates, size_t size, int first) {
+  ScoreArray scores;
+  scores.setIndex(idx);
+  scores.NumberOfScores(size);
+  for (size_t i = 0; i < candidates; ++i) {
+    ScoreStats stats;
+    for (size_t j = 0; j < size; ++j) stats.add(first + 10 * i + j);
+    scores.add(stats);
+  }
+  return scores;
+}
+
+void CheckEqual(const FeatureArray& expected, const FeatureArray& actual) {
+  BOOST_CHECK_EQUAL(expected.getIndex(), actual.getIndex());
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    const FeatureStats& e = expected.get(i);
+    const FeatureStats& a = actual.get(i);
+    BOOST_REQUIRE_EQUAL(e.size(), a.size());
+    for (size_t j = 0; j < e.size(); ++j) BOOST_CHECK_EQUAL(e.get(j), a.get(j));
+    BOOST_REQUIRE_EQUAL(e.getSparse().size(), a.getSparse().size());
+    for (SparseVector::fvector_t::const_iterator j = e.getSparse().begin(); j != e.getSparse().end(); ++j) {
+      BOOST_CHECK_EQUAL(j->second, a.getSparse().get(j->first));
+    }
+  }
+}
+
+void CheckEqual(const ScoreArray& expected, const ScoreArray& actual) {
+  BOOST_CHECK_EQUAL(expected.getIndex(), actual.getIndex());
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(expected.get(i).size(), actual.get(i).size());
+    for (size_t j = 0; j < expected.get(i).size(); ++j) {
+      BOOST_CHECK_EQUAL(expected.get(i).get(j), actual.get(i).get(j));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FeaturesRoundTrip) {
+  TempFile file;
+  vector<FeatureArray> written;
+  written.push_back(MakeFeatures("0", 3, 3, 1.5));
+  written.push_back(MakeFeatures("1", 0, 3, 0));
+  written.push_back(MakeFeatures("2", 4, 3, -2));
+  written.push_back(MakeFeatures("0", 2, 3, 7));
+  written.push_back(MakeFeatures("3", 5, 3, 0.25));
+
+  // three blocks, the second appended with a sentence seen in the first
+  BinaryDataWriter first(BINARY_FEATURES, "d_0 d_1 d_2");
+  first.add(written[0]);
+  first.add(written[1]);
+  first.write(file.name(), false);
+  BinaryDataWriter second(BINARY_FEATURES, "d_0 d_1 d_2");
+  second.add(written[2]);
+  second.add(written[3]);
+  second.write(file.name(), true);
+  BinaryDataWriter third(BINARY_FEATURES, "d_0 d_1 d_2");
+  third.add(written[4]);
+  third.write(file.name(), true);
+
+  BOOST_REQUIRE(IsBinaryDataFile(file.name()));
+  BinaryDataFile data(file.name());
+  BOOST_CHECK_EQUAL(BINARY_FEATURES, data.kind());
+  BOOST_REQUIRE_EQUAL(written.size(), data.size());
+  for (size_t i = 0; i < written.size(); ++i) {
+    BOOST_CHECK_EQUAL(written[i].getIndex(), data.getIndex(i));
+    BOOST_CHECK_EQUAL("d_0 d_1 d_2", data.getDescription(i));
+    BOOST_CHECK_EQUAL(3u, data.getDenseSize(i));
+    BOOST_REQUIRE_EQUAL(written[i].size(), data.getCandidates(i));
+    for (size_t j = 0; j < written[i].size(); ++j) {
+      const FeatureStatsType* values = data.getFeatures(i, j);
+      for (size_t k = 0; k < 3; ++k) BOOST_CHECK_EQUAL(written[i].get(j).get(k), values[k]);
+      SparseVector sparse;
+      data.getSparse(i, j, sparse);
+      BOOST_CHECK_EQUAL(written[i].get(j).getSparse().size(), sparse.size());
+    }
+    FeatureArray read;
+    data.get(i, read);
+    CheckEqual(written[i], read);
+  }
+  ScoreArray scores;
+  BOOST_CHECK_THROW(data.get(0, scores), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(ScoresRoundTrip) {
+  TempFile file;
+  vector<ScoreArray> written;
+  written.push_back(MakeScores("0", 2, 4, 1));
+  written.push_back(MakeScores("1", 3, 4, 100));
+  written.push_back(MakeScores("2", 1, 4, 1000));
+
+  BinaryDataWriter first(BINARY_SCORES, "BLEU");
+  first.add(written[0]);
+  first.write(file.name(), false);
+  BinaryDataWriter second(BINARY_SCORES, "BLEU");
+  second.add(written[1]);
+  second.add(written[2]);
+  second.write(file.name(), true);
+
+  BinaryDataFile data(file.name());
+  BOOST_CHECK_EQUAL(BINARY_SCORES, data.kind());
+  BOOST_REQUIRE_EQUAL(written.size(), data.size());
+  for (size_t i = 0; i < written.size(); ++i) {
+    BOOST_CHECK_EQUAL("BLEU", data.getDescription(i));
+    BOOST_REQUIRE_EQUAL(written[i].size(), data.getCandidates(i));
+    for (size_t j = 0; j < written[i].size(); ++j) {
+      const ScoreStatsType* values = data.getScores(i, j);
+      for (size_t k = 0; k < 4; ++k) BOOST_CHECK_EQUAL(written[i].get(j).get(k), values[k]);
+    }
+    ScoreArray read;
+    data.get(i, read);
+    CheckEqual(written[i], read);
+  }
+}
+
+// the layout of the block header, as in BinaryData.cpp
+const size_t kSentences = 24, kCandidates = 32, kSparse = 48, kNames = 56,
+    kIdBytes = 64, kHeaderSize = 88;
+
+uint64_t Padded(uint64_t size) {
+  return (size + 7) & ~static_cast<uint64_t>(7);
+}
+
+uint64_t Get(const string& bytes, size_t pos) {
+  uint64_t value;
+  memcpy(&value, bytes.data() + pos, sizeof(value));
+  return value;
+}
+
+void Set(string& bytes, size_t pos, uint64_t value) {
+  memcpy(&bytes[pos], &value, sizeof(value));
+}
+
+// the error loading bytes gives, empty if they load
+string LoadError(const string& bytes) {
+  TempFile file;
+  {
+    ofstream out(file.name().c_str(), ios::out | ios::binary);
+    out.write(bytes.data(), bytes.size());
+  }
+  try {
+    BinaryDataFile data(file.name());
+  } catch (const runtime_error& e) {
+    return e.what();
+  }
+  return "";
+}
+
+void CheckError(const string& bytes, const string& message) {
+  const string error = LoadError(bytes);
+  BOOST_CHECK_MESSAGE(error.find(message) != string::npos,
+                      "expected \"" << message << "\", got \"" << error << "\"");
+}
+
+BOOST_AUTO_TEST_CASE(CorruptFiles) {
+  TempFile file;
+  BinaryDataWriter writer(BINARY_FEATURES, "d_0 d_1 d_2");
+  writer.add(MakeFeatures("10", 3, 3, 1));
+  writer.add(MakeFeatures("11", 2, 3, 5));
+  writer.add(MakeFeatures("12", 2, 3, 9));
+  writer.write(file.name(), false);
+  string good;
+  {
+    ifstream in(file.name().c_str(), ios::in | ios::binary);
+    ostringstream bytes;
+    bytes << in.rdbuf();
+    good = bytes.str();
+  }
+  BOOST_REQUIRE_EQUAL("", LoadError(good));
+
+  // where each section starts
+  const uint64_t sentences = Get(good, kSentences), candidates = Get(good, kCandidates);
+  const uint64_t sparse = Get(good, kSparse), names = Get(good, kNames);
+  const size_t sentenceOffsets = kHeaderSize;
+  const size_t idOffsets = sentenceOffsets + Padded((sentences + 1) * 8);
+  const size_t values = idOffsets + Padded((sentences + 1) * 8) + Padded(Get(good, kIdBytes));
+  const size_t sparseOffsets = values + Padded(candidates * 3 * 4);
+  const size_t sparseIds = sparseOffsets + Padded((candidates + 1) * 8);
+  const size_t nameOffsets = sparseIds + 2 * Padded(sparse * 4);
+  BOOST_REQUIRE_EQUAL(3u, sentences);
+  BOOST_REQUIRE_EQUAL(3u, names);
+
+  CheckError(good.substr(0, kHeaderSize - 8), "Truncated block header");
+  CheckError(good.substr(0, good.size() - 8), "Truncated block");
+  CheckError(good + good.substr(0, 40), "Truncated block header");
+
+  string bad = good;
+  bad[0] = 'X';
+  CheckError(bad, "Not a binary data file");
+
+  // a header that claims more than the block holds
+  bad = good;
+  Set(bad, kCandidates, candidates + 1000);
+  CheckError(bad, "Truncated block");
+
+  // offsets which end right but go backwards, so that a sentence, an id,
+  // a candidate or a name would have a negative length
+  bad = good;
+  Set(bad, sentenceOffsets + 8, Get(good, sentenceOffsets + 16) + 1);
+  CheckError(bad, "Inconsistent block");
+  bad = good;
+  Set(bad, idOffsets + 8, Get(good, idOffsets + 16) + 1);
+  CheckError(bad, "Inconsistent block");
+  bad = good;
+  Set(bad, sparseOffsets + 16, sparse + 1);
+  CheckError(bad, "Inconsistent block");
+  bad = good;
+  Set(bad, nameOffsets + 8, Get(good, nameOffsets + 16) + 1);
+  CheckError(bad, "Inconsistent block");
+
+  // offsets which do not start at 0 or end at the size of their section
+  bad = good;
+  Set(bad, sentenceOffsets, 1);
+  CheckError(bad, "Inconsistent block");
+  bad = good;
+  Set(bad, idOffsets + sentences * 8, Get(good, idOffsets + sentences * 8) + 1);
+  CheckError(bad, "Inconsistent block");
+
+  // a sparse value naming a feature the block does not have
+  bad = good;
+  const uint32_t id = names;
+  memcpy(&bad[sparseIds], &id, sizeof(id));
+  CheckError(bad, "Sparse feature id out of range");
+}
+
+}
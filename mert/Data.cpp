@@ -11,6 +11,11 @@
 #include <cmath>
 #include <fstream>
 
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
 #include "Data.h"
 #include "FileStream.h"
 #include "Scorer.h"
@@ -140,97 +145,139 @@ void Data::remove_duplicates() {
 //END_ADDED
 
 
-void Data::loadnbest(const std::string &file)
+namespace {
+
+// lines of an n-best list scored at once
+const size_t kScoringBatch = 10000;
+
+void PrepareStatsInterleaved(Scorer* scorer, const vector<string>* indices,
+                             const vector<string>* sentences, vector<ScoreStats>* stats,
+                             size_t first, size_t step)
 {
-  TRACE_ERR("loading nbest from " << file << std::endl);
+  for (size_t i = first; i < indices->size(); i += step) {
+    (*stats)[i].clear();
+    scorer->prepareStats((*indices)[i], (*sentences)[i], (*stats)[i]);
+  }
+}
 
-  FeatureStats featentry;
-  ScoreStats scoreentry;
-  std::string sentence_index;
+}
+
+void Data::loadnbest(const std::string &file, size_t threads)
+{
+  TRACE_ERR("loading nbest from " << file << std::endl);
 
   inputfilestream inp(file); // matches a stream with a file. Opens the file
 
   if (!inp.good())
     throw runtime_error("Unable to open: " + file);
 
-  std::string substring, subsubstring, stringBuf;
-  std::string theSentence;
-  std::string::size_type loc;
+  std::string substring, stringBuf;
+  vector<string> indices, sentences, features;
+  vector<ScoreStats> stats;
 
-  while (getline(inp,stringBuf,'\n')) {
-    if (stringBuf.empty()) continue;
+  while (true) {
+    // read a batch of lines
+    indices.clear();
+    sentences.clear();
+    features.clear();
+    while (indices.size() < kScoringBatch && getline(inp,stringBuf,'\n')) {
+      if (stringBuf.empty()) continue;
 
 //              TRACE_ERR("stringBuf: " << stringBuf << std::endl);
 
-    getNextPound(stringBuf, substring, "|||"); //first field
-    sentence_index = substring;
-
-    getNextPound(stringBuf, substring, "|||"); //second field
-    theSentence = substring;
-
-    // adding statistics for error measures
-    featentry.reset();
-    scoreentry.clear();
-
-    theScorer->prepareStats(sentence_index, theSentence, scoreentry);
+      getNextPound(stringBuf, substring, "|||"); //first field
+      indices.push_back(substring);
 
-    scoredata->add(scoreentry, sentence_index);
+      getNextPound(stringBuf, substring, "|||"); //second field
+      sentences.push_back(substring);
 
-    getNextPound(stringBuf, substring, "|||"); //third field
+      getNextPound(stringBuf, substring, "|||"); //third field
+      features.push_back(substring);
+    }
+    if (indices.empty()) break;
+
+    // statistics for error measures, of several lines at once
+    stats.resize(indices.size());
+    const size_t workers = std::max<size_t>(1, std::min(threads, indices.size()));
+#ifdef WITH_THREADS
+    if (workers > 1) {
+      boost::thread_group group;
+      for (size_t t = 0; t < workers; ++t) {
+        group.create_thread(boost::bind(&PrepareStatsInterleaved, theScorer, &indices,
+                                        &sentences, &stats, t, workers));
+      }
+      group.join_all();
+    } else
+#endif
+    {
+      PrepareStatsInterleaved(theScorer, &indices, &sentences, &stats, 0, 1);
+    }
 
-    // examine first line for name of features
-    if (!existsFeatureNames()) {
-      std::string stringsupport=substring;
-      std::string features="";
-      std::string tmpname="";
+    for (size_t i = 0; i < indices.size(); ++i) {
+      scoredata->add(stats[i], indices[i]);
+      addNbestFeatures(indices[i], features[i]);
+    }
+  }
 
-      size_t tmpidx=0;
-      while (!stringsupport.empty()) {
-        //                      TRACE_ERR("Decompounding: " << substring << std::endl);
-        getNextPound(stringsupport, subsubstring);
+  inp.close();
+}
 
-        // string ending with ":" are skipped, because they are the names of the features
-        if ((loc = subsubstring.find_last_of(":")) != subsubstring.length()-1) {
-          features+=tmpname+"_"+stringify(tmpidx)+" ";
-          tmpidx++;
-        }
-        // ignore sparse feature name
-        else if (subsubstring.find("_") != string::npos) {
-          // also ignore its value
-          getNextPound(stringsupport, subsubstring);
-        }
-        // update current feature name
-        else {
-          tmpidx=0;
-          tmpname=subsubstring.substr(0,subsubstring.size() - 1);
-        }
-      }
+void Data::addNbestFeatures(const std::string &sentence_index, std::string substring)
+{
+  FeatureStats featentry;
+  std::string subsubstring;
+  std::string::size_type loc;
 
-      featdata->setFeatureMap(features);
-    }
+  // examine first line for name of features
+  if (!existsFeatureNames()) {
+    std::string stringsupport=substring;
+    std::string features="";
+    std::string tmpname="";
 
-    // adding features
-    while (!substring.empty()) {
-//                      TRACE_ERR("Decompounding: " << substring << std::endl);
-      getNextPound(substring, subsubstring);
+    size_t tmpidx=0;
+    while (!stringsupport.empty()) {
+      //                      TRACE_ERR("Decompounding: " << substring << std::endl);
+      getNextPound(stringsupport, subsubstring);
 
-      // no ':' -> feature value that needs to be stored
+      // string ending with ":" are skipped, because they are the names of the features
       if ((loc = subsubstring.find_last_of(":")) != subsubstring.length()-1) {
-        featentry.add(ConvertStringToFeatureStatsType(subsubstring));
+        features+=tmpname+"_"+stringify(tmpidx)+" ";
+        tmpidx++;
       }
-      // sparse feature name? store as well
+      // ignore sparse feature name
       else if (subsubstring.find("_") != string::npos) {
-        std::string name = subsubstring;
-        getNextPound(substring, subsubstring);
-        featentry.addSparse( name, atof(subsubstring.c_str()) );
-        _sparse_flag = true;
+        // also ignore its value
+        getNextPound(stringsupport, subsubstring);
+      }
+      // update current feature name
+      else {
+        tmpidx=0;
+        tmpname=subsubstring.substr(0,subsubstring.size() - 1);
       }
     }
-    //cerr << "number of sparse features: " << featentry.getSparse().size() << endl;
-    featdata->add(featentry,sentence_index);
+
+    featdata->setFeatureMap(features);
   }
 
-  inp.close();
+  // adding features
+  while (!substring.empty()) {
+//                      TRACE_ERR("Decompounding: " << substring << std::endl);
+    getNextPound(substring, subsubstring);
+
+    // no ':' -> feature value that needs to be stored
+    if ((loc = subsubstring.find_last_of(":")) != subsubstring.length()-1) {
+      featentry.add(ConvertStringToFeatureStatsType(subsubstring));
+    }
+    // sparse feature name? store as well
+    else if (subsubstring.find("_") != string::npos) {
+      std::string name = subsubstring.substr(0, subsubstring.size() - 1);
+      getNextPound(substring, subsubstring);
+      featentry.addSparse( name, atof(subsubstring.c_str()) );
+      _sparse_flag = true;
+    }
+  }
+  //cerr << "number of sparse features: " << featentry.getSparse().size() << endl;
+  featdata->add(featentry,sentence_index);
 }
 
 // TODO
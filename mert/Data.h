@@ -29,6 +29,8 @@ private:
   size_t number_of_scores;
   bool _sparse_flag;
 
+  void addNbestFeatures(const std::string &sentence_index, std::string features);
+
 protected:
   // TODO: Use smart pointers for exceptional-safety.
   ScoreData* scoredata;
@@ -72,7 +74,11 @@ public:
   inline bool hasSparseFeatures() const { return _sparse_flag; }
   void mergeSparseFeatures();
 
-  void loadnbest(const std::string &file);
+  /**
+   * Load an n-best list and compute its score statistics, on several
+   * threads if the scorer allows it.
+   */
+  void loadnbest(const std::string &file, size_t threads = 1);
   
   void load(const std::string &featfile,const std::string &scorefile) {
     featdata->load(featfile);
@@ -85,13 +91,13 @@ public:
   void remove_duplicates();
   //END_ADDED
 
-  void save(const std::string &featfile,const std::string &scorefile, bool bin=false) {
+  void save(const std::string &featfile,const std::string &scorefile, bool bin=false, bool append=false) {
 
     if (bin) cerr << "Binary write mode is selected" << endl;
     else cerr << "Binary write mode is NOT selected" << endl;
 
-    featdata->save(featfile, bin);
-    scoredata->save(scorefile, bin);
+    featdata->save(featfile, bin, append);
+    scoredata->save(scorefile, bin, append);
   }
 
   inline bool existsFeatureNames() const {
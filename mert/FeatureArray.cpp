@@ -71,8 +71,6 @@ void FeatureArray::loadtxt(ifstream& inFile, size_t n)
   for (size_t i=0 ; i < n; i++) {
     entry.loadtxt(inFile);
     add(entry);
-    if (entry.getSparse().size()>0)
-      _sparse_flag = true;
   }
 }
 
@@ -61,6 +61,8 @@ public:
   }
   void add(FeatureStats& e) {
     array_.push_back(e);
+    if (e.getSparse().size() > 0)
+      _sparse_flag = true;
   }
 
   //ADDED BY TS
@@ -9,6 +9,7 @@
 #include "FeatureData.h"
 
 #include <limits>
+#include "BinaryData.h"
 #include "FileStream.h"
 #include "Util.h"
 
@@ -25,13 +26,21 @@ void FeatureData::save(std::ofstream& outFile, bool bin)
     i->save(outFile, bin);
 }
 
-void FeatureData::save(const std::string &file, bool bin)
+void FeatureData::save(const std::string &file, bool bin, bool append)
 {
   if (file.empty()) return;
 
   TRACE_ERR("saving the array into " << file << std::endl);
 
-  std::ofstream outFile(file.c_str(), std::ios::out); // matches a stream with a file. Opens the file
+  if (bin) {
+    BinaryDataWriter writer(BINARY_FEATURES, features);
+    for (featdata_t::const_iterator i = array_.begin(); i != array_.end(); i++)
+      writer.add(*i);
+    writer.write(file, append);
+    return;
+  }
+
+  std::ofstream outFile(file.c_str(), append ? std::ios::app : std::ios::out); // matches a stream with a file. Opens the file
 
   save(outFile, bin);
 
@@ -69,6 +78,20 @@ void FeatureData::load(const std::string &file)
 {
   TRACE_ERR("loading feature data from " << file << std::endl);
 
+  if (IsBinaryDataFile(file)) {
+    BinaryDataFile binFile(file);
+    FeatureArray entry;
+    for (size_t i = 0; i < binFile.size(); ++i) {
+      binFile.get(i, entry);
+      if (size() == 0)
+        setFeatureMap(entry.Features());
+      if (entry.hasSparseFeatures())
+        _sparse_flag = true;
+      add(entry);
+    }
+    return;
+  }
+
   inputfilestream inFile(file); // matches a stream with a file. Opens the file
 
   if (!inFile) {
@@ -85,7 +85,11 @@ public:
     features = f;
   }
 
-  void save(const std::string &file, bool bin=false);
+  /**
+   * With bin, write the columnar format of BinaryData.h. With append, add to
+   * the end of the file instead of replacing it.
+   */
+  void save(const std::string &file, bool bin=false, bool append=false);
   void save(ofstream& outFile, bool bin=false);
   inline void save(bool bin=false) {
     save("/dev/stdout", bin);
@@ -49,9 +49,14 @@ float ParseFloat(const StringPiece& str) {
 
 
 
-FeatureDataIterator::FeatureDataIterator() {}
+FeatureDataIterator::FeatureDataIterator() : m_position(0) {}
 
-FeatureDataIterator::FeatureDataIterator(const string& filename) {
+FeatureDataIterator::FeatureDataIterator(const string& filename) : m_position(0) {
+  if (IsBinaryDataFile(filename)) {
+    m_binary.reset(new BinaryDataFile(filename));
+    readNextBinary();
+    return;
+  }
   m_in.reset(new FilePiece(filename.c_str()));
   readNext();
 }
@@ -99,11 +104,36 @@ void FeatureDataIterator::readNext() {
   }
 }
 
+void FeatureDataIterator::readNextBinary() {
+  m_next.clear();
+  if (m_position == m_binary->size()) {
+    m_binary.reset();
+    return;
+  }
+  if (m_binary->kind() != BINARY_FEATURES) {
+    throw FileFormatException(m_binary->getIndex(m_position), "wrong kind of binary data");
+  }
+  for (size_t i = 0; i < m_binary->getCandidates(m_position); ++i) {
+    m_next.push_back(FeatureDataItem());
+    const FeatureStatsType* dense = m_binary->getFeatures(m_position, i);
+    m_next.back().dense.assign(dense, dense + m_binary->getDenseSize(m_position));
+    m_binary->getSparse(m_position, i, m_next.back().sparse);
+  }
+}
+
 void FeatureDataIterator::increment() {
+  if (m_binary) {
+    ++m_position;
+    readNextBinary();
+    return;
+  }
   readNext();
 }
 
 bool FeatureDataIterator::equal(const FeatureDataIterator& rhs) const {
+  if (m_binary || rhs.m_binary) {
+    return m_binary == rhs.m_binary && m_position == rhs.m_position;
+  }
   if (!m_in && !rhs.m_in) {
     return true;
   } else if (!m_in) {
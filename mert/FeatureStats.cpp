@@ -32,16 +32,22 @@ FeatureStatsType SparseVector::get(size_t id) const {
 }
 
 void SparseVector::set(const string& name, FeatureStatsType value) {
+  fvector_[getId(name)] = value;
+}
+
+void SparseVector::set(size_t id, FeatureStatsType value) {
+  fvector_[id] = value;
+}
+
+size_t SparseVector::getId(const string& name) {
   name2id_t::const_iterator name2id_iter = name2id_.find(name);
-  size_t id = 0;
-  if (name2id_iter == name2id_.end()) {
-    id = id2name_.size();
-    id2name_.push_back(name);
-    name2id_[name] = id;
-  } else {
-    id = name2id_iter->second;
+  if (name2id_iter != name2id_.end()) {
+    return name2id_iter->second;
   }
-  fvector_[id] = value;
+  size_t id = id2name_.size();
+  id2name_.push_back(name);
+  name2id_[name] = id;
+  return id;
 }
 
 void SparseVector::write(ostream& out, const string& sep) const {
@@ -144,6 +150,11 @@ void FeatureStats::addSparse(const string& name, FeatureStatsType v)
   map_.set(name,v);
 }
 
+void FeatureStats::addSparse(size_t id, FeatureStatsType v)
+{
+  map_.set(id,v);
+}
+
 void FeatureStats::set(std::string &theString)
 {
   std::string substring, stringBuf;
@@ -214,7 +225,7 @@ ostream& operator<<(ostream& o, const FeatureStats& e)
     o << e.get(i) << " ";
   }
   // sparse features
-  e.getSparse().write(o,"");
+  e.getSparse().write(o,":");
 
   return o;
 }
@@ -29,10 +29,23 @@ public:
   FeatureStatsType get(const std::string& name) const;
   FeatureStatsType get(size_t id) const;
   void set(const std::string& name, FeatureStatsType value);
+  void set(size_t id, FeatureStatsType value);
   void clear();
   size_t size() const {
     return fvector_.size();
   }
+  fvector_t::const_iterator begin() const {
+    return fvector_.begin();
+  }
+  fvector_t::const_iterator end() const {
+    return fvector_.end();
+  }
+
+  // Ids of feature names are shared by all sparse vectors.
+  static size_t getId(const std::string& name);
+  static const std::string& getName(size_t id) {
+    return id2name_[id];
+  }
 
   void write(std::ostream& out, const std::string& sep = " ") const;
 
@@ -75,6 +88,7 @@ public:
   void expand();
   void add(FeatureStatsType v);
   void addSparse(const string& name, FeatureStatsType v);
+  void addSparse(size_t id, FeatureStatsType v);
 
   void clear() {
     memset((void*)array_, 0, GetArraySizeWithBytes());
@@ -0,0 +1,200 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "LogisticRegression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <iostream>
+
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
+#include "PairBuffer.h"
+
+using namespace std;
+
+namespace {
+
+// number of corrections kept by L-BFGS
+const size_t kMemory = 10;
+
+double dot(const vector<double>& a, const vector<double>& b) {
+  double sum = 0;
+  for (size_t i = 0; i < a.size(); ++i) sum += a[i] * b[i];
+  return sum;
+}
+
+/** Loss and gradient of the pairs [begin, end).  Each pair is a positive
+  * example x and a negative example -x, which have the same loss. */
+void EvaluateRange(const PairBuffer* pairs, const vector<double>* weights,
+                   size_t begin, size_t end, double* loss, vector<double>* gradient) {
+  *loss = 0;
+  gradient->assign(weights->size(), 0);
+  for (size_t row = begin; row < end; ++row) {
+    double margin = 0;
+    for (size_t i = pairs->rowBegin(row); i < pairs->rowEnd(row); ++i) {
+      margin += (*weights)[pairs->column(i)] * pairs->value(i);
+    }
+    // 2 log(1 + exp(-margin)) without overflow
+    if (margin > 0) {
+      *loss += 2 * log1p(exp(-margin));
+    } else {
+      *loss += 2 * (log1p(exp(margin)) - margin);
+    }
+    const double scale = -2 / (1 + exp(margin));
+    for (size_t i = pairs->rowBegin(row); i < pairs->rowEnd(row); ++i) {
+      (*gradient)[pairs->column(i)] += scale * pairs->value(i);
+    }
+  }
+}
+
+}
+
+LogisticRegression::LogisticRegression(size_t iterations, double l2, size_t threads)
+  : m_iterations(iterations), m_l2(l2), m_threads(max<size_t>(1, threads)) {}
+
+double LogisticRegression::evaluate(const PairBuffer& pairs, const vector<double>& weights,
+                                    vector<double>& gradient) const {
+  const size_t shards = max<size_t>(1, min(m_threads, pairs.size()));
+  vector<double> losses(shards);
+  vector<vector<double> > gradients(shards);
+  const size_t shardSize = (pairs.size() + shards - 1) / shards;
+#ifdef WITH_THREADS
+  if (shards > 1) {
+    boost::thread_group workers;
+    for (size_t t = 0; t < shards; ++t) {
+      workers.create_thread(boost::bind(&EvaluateRange, &pairs, &weights,
+                                        min(pairs.size(), t * shardSize),
+                                        min(pairs.size(), (t + 1) * shardSize),
+                                        &losses[t], &gradients[t]));
+    }
+    workers.join_all();
+  } else
+#endif
+  {
+    for (size_t t = 0; t < shards; ++t) {
+      EvaluateRange(&pairs, &weights, min(pairs.size(), t * shardSize),
+                    min(pairs.size(), (t + 1) * shardSize), &losses[t], &gradients[t]);
+    }
+  }
+
+  double loss = 0.5 * m_l2 * dot(weights, weights);
+  gradient.resize(weights.size());
+  for (size_t i = 0; i < weights.size(); ++i) {
+    gradient[i] = m_l2 * weights[i];
+  }
+  for (size_t t = 0; t < shards; ++t) {
+    loss += losses[t];
+    for (size_t i = 0; i < gradient.size(); ++i) {
+      gradient[i] += gradients[t][i];
+    }
+  }
+  return loss;
+}
+
+void LogisticRegression::train(const PairBuffer& pairs) {
+  const size_t dimension = pairs.columns();
+  m_weights.assign(dimension, 0);
+  if (pairs.size() == 0) return;
+
+  vector<double> gradient;
+  double loss = evaluate(pairs, m_weights, gradient);
+  deque<vector<double> > steps, changes;
+  deque<double> curvatures;
+  vector<double> direction(dimension), next(dimension), nextGradient;
+
+  for (size_t iteration = 0; iteration < m_iterations; ++iteration) {
+    // two loop recursion for the quasi-Newton direction
+    direction = gradient;
+    vector<double> alpha(steps.size());
+    for (size_t k = steps.size(); k-- > 0; ) {
+      alpha[k] = dot(steps[k], direction) / curvatures[k];
+      for (size_t i = 0; i < dimension; ++i) direction[i] -= alpha[k] * changes[k][i];
+    }
+    if (!steps.empty()) {
+      const double scale = curvatures.back() / dot(changes.back(), changes.back());
+      for (size_t i = 0; i < dimension; ++i) direction[i] *= scale;
+    }
+    for (size_t k = 0; k < steps.size(); ++k) {
+      const double beta = dot(changes[k], direction) / curvatures[k];
+      for (size_t i = 0; i < dimension; ++i) direction[i] += (alpha[k] - beta) * steps[k][i];
+    }
+    for (size_t i = 0; i < dimension; ++i) direction[i] = -direction[i];
+
+    double slope = dot(gradient, direction);
+    if (slope >= 0) {
+      // not a descent direction, start again from steepest descent
+      steps.clear();
+      changes.clear();
+      curvatures.clear();
+      for (size_t i = 0; i < dimension; ++i) direction[i] = -gradient[i];
+      slope = dot(gradient, direction);
+    }
+    if (slope == 0) break;
+
+    // backtracking line search for sufficient decrease
+    double step = steps.empty() ? 1 / sqrt(-slope) : 1;
+    double nextLoss = loss;
+    bool decreased = false;
+    for (size_t tries = 0; tries < 40; ++tries, step *= 0.5) {
+      for (size_t i = 0; i < dimension; ++i) next[i] = m_weights[i] + step * direction[i];
+      nextLoss = evaluate(pairs, next, nextGradient);
+      if (nextLoss <= loss + 1e-4 * step * slope) {
+        decreased = true;
+        break;
+      }
+    }
+    if (!decreased) break;
+
+    vector<double> s(dimension), y(dimension);
+    for (size_t i = 0; i < dimension; ++i) {
+      s[i] = next[i] - m_weights[i];
+      y[i] = nextGradient[i] - gradient[i];
+    }
+    const double curvature = dot(s, y);
+    if (curvature > 1e-10) {
+      steps.push_back(s);
+      changes.push_back(y);
+      curvatures.push_back(curvature);
+      if (steps.size() > kMemory) {
+        steps.pop_front();
+        changes.pop_front();
+        curvatures.pop_front();
+      }
+    }
+
+    const double improvement = loss - nextLoss;
+    m_weights.swap(next);
+    gradient.swap(nextGradient);
+    loss = nextLoss;
+    cerr << "Iteration " << iteration + 1 << ": loss " << loss << endl;
+    if (improvement < 1e-6 * max(1.0, fabs(loss))) break;
+  }
+}
+
+void LogisticRegression::writeWeights(ostream& out, const PairBuffer& pairs) const {
+  for (size_t i = 0; i < m_weights.size(); ++i) {
+    if (m_weights[i] == 0) continue;
+    out << pairs.columnName(i) << " " << m_weights[i] << "\n";
+  }
+}
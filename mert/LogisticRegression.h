@@ -0,0 +1,60 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef _LOGISTIC_REGRESSION_
+#define _LOGISTIC_REGRESSION_
+
+#include <ostream>
+#include <vector>
+
+class PairBuffer;
+
+/**
+  * Binary logistic regression without bias on the pairs sampled by PRO, a
+  * replacement for running megam on the written pairs.  Each pair counts as
+  * the positive and the negative example megam would see.  The L2
+  * regularised loss is minimised with L-BFGS; the loss and gradient are
+  * computed over blocks of pairs on several threads, and summed in a fixed
+  * order so that the result only depends on the number of threads.
+**/
+class LogisticRegression
+{
+  public:
+    LogisticRegression(size_t iterations, double l2, size_t threads);
+
+    void train(const PairBuffer& pairs);
+
+    const std::vector<double>& getWeights() const {
+      return m_weights;
+    }
+
+    //! weights as written by megam -fvals, one "name weight" line each
+    void writeWeights(std::ostream& out, const PairBuffer& pairs) const;
+
+  private:
+    double evaluate(const PairBuffer& pairs, const std::vector<double>& weights,
+                    std::vector<double>& gradient) const;
+
+    size_t m_iterations;
+    double m_l2;
+    size_t m_threads;
+    std::vector<double> m_weights;
+};
+
+#endif
@@ -0,0 +1,176 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "LogisticRegression.h"
+#include "PairBuffer.h"
+
+#define BOOST_TEST_MODULE MertLogisticRegression
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+FeatureDataItem MakeItem(float f0, float f1, float f2) {
+  FeatureDataItem item;
+  item.dense.push_back(f0);
+  item.dense.push_back(f1);
+  item.dense.push_back(f2);
+  return item;
+}
+
+// the regularised loss of the pairs, straight from its definition
+double Loss(const PairBuffer& pairs, const vector<double>& weights, double l2,
+            vector<double>& gradient) {
+  double loss = 0;
+  gradient.assign(weights.size(), 0);
+  for (size_t i = 0; i < weights.size(); ++i) {
+    loss += 0.5 * l2 * weights[i] * weights[i];
+    gradient[i] = l2 * weights[i];
+  }
+  for (size_t row = 0; row < pairs.size(); ++row) {
+    double margin = 0;
+    for (size_t i = pairs.rowBegin(row); i < pairs.rowEnd(row); ++i) {
+      margin += weights[pairs.column(i)] * pairs.value(i);
+    }
+    loss += 2 * log(1 + exp(-margin));
+    for (size_t i = pairs.rowBegin(row); i < pairs.rowEnd(row); ++i) {
+      gradient[pairs.column(i)] -= 2 * pairs.value(i) / (1 + exp(margin));
+    }
+  }
+  return loss;
+}
+
+double MaxNorm(const vector<double>& v) {
+  double norm = 0;
+  for (size_t i = 0; i < v.size(); ++i) norm = max(norm, fabs(v[i]));
+  return norm;
+}
+
+// noisy pairs whose differences mostly agree with a hidden weight vector
+void MakePairs(PairBuffer& pairs, size_t size) {
+  const float hidden[] = {1.0, -2.0, 0.5};
+  srand(1);
+  for (size_t i = 0; i < size; ++i) {
+    FeatureDataItem a = MakeItem(rand() % 100 / 10.0, rand() % 100 / 10.0, rand() % 100 / 10.0);
+    FeatureDataItem b = MakeItem(rand() % 100 / 10.0, rand() % 100 / 10.0, rand() % 100 / 10.0);
+    float margin = 0;
+    for (size_t j = 0; j < 3; ++j) margin += hidden[j] * (a.dense[j] - b.dense[j]);
+    if (rand() % 10 == 0) margin = -margin;
+    if (margin > 0) {
+      pairs.add(a, b);
+    } else {
+      pairs.add(b, a);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PairBufferRows) {
+  PairBuffer pairs;
+  FeatureDataItem better = MakeItem(1, 2, 3), worse = MakeItem(0.5, 2, 4);
+  better.sparse.set("pb_test_a", 1);
+  worse.sparse.set("pb_test_b", 2);
+  pairs.add(better, worse);
+  BOOST_REQUIRE_EQUAL(1u, pairs.size());
+
+  // the equal feature is left out, the sparse ones follow the dense
+  const size_t a = 3 + SparseVector::getId("pb_test_a");
+  const size_t b = 3 + SparseVector::getId("pb_test_b");
+  BOOST_REQUIRE_EQUAL(4u, pairs.rowEnd(0) - pairs.rowBegin(0));
+  BOOST_CHECK_EQUAL(0u, pairs.column(0));
+  BOOST_CHECK_EQUAL(0.5, pairs.value(0));
+  BOOST_CHECK_EQUAL(2u, pairs.column(1));
+  BOOST_CHECK_EQUAL(-1, pairs.value(1));
+  BOOST_CHECK_EQUAL(a, pairs.column(2));
+  BOOST_CHECK_EQUAL(1, pairs.value(2));
+  BOOST_CHECK_EQUAL(b, pairs.column(3));
+  BOOST_CHECK_EQUAL(-2, pairs.value(3));
+  BOOST_CHECK_EQUAL(max(a, b) + 1, pairs.columns());
+  BOOST_CHECK_EQUAL("F2", pairs.columnName(2));
+  BOOST_CHECK_EQUAL("pb_test_a", pairs.columnName(a));
+
+  PairBuffer other;
+  other.add(MakeItem(1, 1, 1), MakeItem(1, 1, 2));
+  pairs.append(other);
+  BOOST_REQUIRE_EQUAL(2u, pairs.size());
+  BOOST_REQUIRE_EQUAL(1u, pairs.rowEnd(1) - pairs.rowBegin(1));
+  BOOST_CHECK_EQUAL(2u, pairs.column(pairs.rowBegin(1)));
+  BOOST_CHECK_EQUAL(-1, pairs.value(pairs.rowBegin(1)));
+
+  ostringstream megam;
+  other.writeMegam(megam);
+  BOOST_CHECK_EQUAL("1 F2 -1\n0 F2 1\n", megam.str());
+
+  BOOST_CHECK_THROW(pairs.add(MakeItem(1, 1, 1), FeatureDataItem()), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TrainsToTheOptimum) {
+  PairBuffer pairs;
+  MakePairs(pairs, 1000);
+  LogisticRegression learner(100, 1, 1);
+  learner.train(pairs);
+  const vector<double>& weights = learner.getWeights();
+  BOOST_REQUIRE_EQUAL(3u, weights.size());
+
+  vector<double> gradient;
+  Loss(pairs, vector<double>(3, 0), 1, gradient);
+  const double start = MaxNorm(gradient);
+  Loss(pairs, weights, 1, gradient);
+  BOOST_CHECK_SMALL(MaxNorm(gradient) / start, 1e-4);
+
+  // roughly the hidden weights up to scale, given the noise and regularisation
+  BOOST_CHECK_GT(weights[0], 0);
+  BOOST_CHECK_LT(weights[1], 0);
+  BOOST_CHECK_CLOSE(-2.0, weights[1] / weights[0], 25);
+
+  ostringstream out;
+  learner.writeWeights(out, pairs);
+  istringstream in(out.str());
+  string name;
+  double weight;
+  for (size_t i = 0; i < 3; ++i) {
+    BOOST_REQUIRE(in >> name >> weight);
+    BOOST_CHECK_EQUAL(pairs.columnName(i), name);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ThreadsAgree) {
+  PairBuffer pairs;
+  MakePairs(pairs, 1000);
+  LogisticRegression single(100, 1, 1), several(100, 1, 4);
+  single.train(pairs);
+  several.train(pairs);
+  for (size_t i = 0; i < 3; ++i) {
+    BOOST_CHECK_CLOSE(single.getWeights()[i], several.getWeights()[i], 1e-3);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(NoPairs) {
+  PairBuffer pairs;
+  LogisticRegression learner(10, 1, 2);
+  learner.train(pairs);
+  BOOST_CHECK(learner.getWeights().empty());
+}
+
+}
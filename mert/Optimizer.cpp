@@ -4,10 +4,16 @@
 #include "util/check.hh"
 #include <vector>
 #include <limits>
-#include <map>
+#include <algorithm>
 #include <cfloat>
 #include <iostream>
 
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#endif
+
 #include "Point.h"
 #include "Util.h"
 
@@ -30,6 +36,119 @@ inline float intersect(float m1, float b1, float m2, float b2)
   return isect;
 }
 
+/**
+ * A change of 1best for one sentence at position x on the line.
+ */
+struct ThresholdChange {
+  float x;
+  unsigned sentence;
+  unsigned nbest;
+};
+
+inline bool ThresholdChangeLess(const ThresholdChange& a, const ThresholdChange& b)
+{
+  return a.x < b.x;
+}
+
+/**
+ * For each sentence in [begin, end), compute the 1best at x=-inf and the
+ * points on the line origin+x*direction where the 1best changes.
+ * The changes are appended to 'changes' in sentence order, sorted by x
+ * within each sentence.
+ */
+void ComputeEnvelopes(const FeatureData& data, const Point& origin, const Point& direction,
+                      size_t begin, size_t end, vector<unsigned>& first1best,
+                      vector<ThresholdChange>& changes)
+{
+  const float min_int = 0.0001;
+  // The candidates sorted by gradient, as flat arrays.
+  vector<pair<float, unsigned> > order;
+  vector<float> gradient;
+  vector<float> f0;
+  for (size_t S = begin; S < end; S++) {
+    // First, we determine the translation with the best feature score
+    // for each sentence and each value of x.
+    const FeatureArray& candidates = data.get(S);
+    const size_t n = candidates.size();
+    order.resize(n);
+    for (unsigned j = 0; j < n; j++) {
+      // gradient of the feature function for this particular target sentence
+      order[j] = pair<float, unsigned>(direction * candidates.get(j), j);
+    }
+    // Ties are ordered by candidate index.
+    sort(order.begin(), order.end());
+    gradient.resize(n);
+    f0.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      gradient[i] = order[i].first;
+      // compute the feature function at the origin point
+      f0[i] = origin * candidates.get(order[i].second);
+    }
+
+    // Several candidates can have the lowest slope (e.g., for word penalty where the gradient is an integer).
+    // The highest line is the one with the highest f0.
+    size_t current = 0;
+    for (size_t i = 1; i < n && gradient[i] == gradient[0]; i++) {
+      if (f0[i] > f0[current])
+        current = i;
+    }
+    first1best[S] = order[current].second;
+
+    // Now we look for the intersections points indicating a change of 1 best.
+    // We use the fact that the function is convex, which means that the gradient can only go up.
+    const size_t firstchange = changes.size();
+    while (true) {
+      const float m = gradient[current];
+      const float b = f0[current];
+      size_t leftmost = current;
+      float leftmostx = MAX_FLOAT;
+      for (size_t i = current + 1; i < n; i++) {
+        // Look for all candidate with a gradient bigger than the current one, and
+        // find the one with the leftmost intersection.
+        if (m != gradient[i]) {
+          float curintersect = intersect(m, b, gradient[i], f0[i]);
+          if (curintersect <= leftmostx) {
+            // We have found an intersection to the left of the leftmost we had so far.
+            // We might have curintersect==leftmostx for example is 2 candidates are the same
+            // in that case its better to update leftmost to avoid some recomputing later.
+            leftmostx = curintersect;
+            leftmost = i; // this is the new reference
+          }
+        }
+      }
+      if (leftmost == current) {
+        // We didn't find any more intersections.
+        // The rightmost bestindex is the one with the highest slope.
+
+        // They should be equal but there might be.
+        CHECK(abs(gradient[leftmost] - gradient[n - 1]) < 0.0001);
+        // A small difference due to rounding error
+        break;
+      }
+      // We have found the next intersection!
+      ThresholdChange change;
+      change.x = leftmostx;
+      change.sentence = S;
+      change.nbest = order[leftmost].second; // new onebest for Sentence S
+
+      if (changes.size() > firstchange && leftmostx - changes.back().x < min_int) {
+        // Require that the intersection Point be at least min_int to the right of the previous
+        // one (for this sentence). If not, we replace the previous intersection Point with
+        // this one.
+        // Yes, it can even happen that the new intersection Point is slightly to the left of
+        // the old one, because of numerical imprecision. We do not check that we are to the
+        // right of the penultimate point also. It this happen the 1best the interval will
+        // be wrong we are going to replace the previous one by the new one because we do not want to keep
+        // 2 very close threshold: if the minima is there it could be an artifact.
+        changes.back() = change;
+      } else {
+        changes.push_back(change);
+      }
+      current = leftmost;
+    }
+  }
+}
+
 } // namespace
 
 
@@ -44,7 +163,7 @@ void Optimizer::SetFData(FeatureData *_FData)
 }
 
 Optimizer::Optimizer(unsigned Pd, vector<unsigned> i2O, vector<parameter_t> start, unsigned int nrandom)
-    : scorer(NULL), FData(NULL), number_of_random_directions(nrandom)
+    : scorer(NULL), FData(NULL), number_of_random_directions(nrandom), line_search_threads(1)
 {
   // Warning: the init vector is a full set of parameters, of dimension pdim!
   Point::pdim = Pd;
@@ -66,6 +185,11 @@ Optimizer::Optimizer(unsigned Pd, vector<unsigned> i2O, vector<parameter_t> star
   }
 }
 
+void Optimizer::SetLineSearchThreads(size_t threads)
+{
+  line_search_threads = max<size_t>(1, threads);
+}
+
 Optimizer::~Optimizer() {}
 
 statscore_t Optimizer::GetStatScore(const Point& param) const
@@ -77,188 +201,92 @@ statscore_t Optimizer::GetStatScore(const Point& param) const
   return score;
 }
 
-map<float,diff_t >::iterator AddThreshold(map<float,diff_t >& thresholdmap, float newt, pair<unsigned,unsigned> newdiff)
-{
-  map<float,diff_t>::iterator it = thresholdmap.find(newt);
-  if (it != thresholdmap.end()) {
-    // the threshold already exists!! this is very unlikely
-    if (it->second.back().first == newdiff.first)
-      // there was already a diff for this sentence, we change the 1 best;
-      it->second.back().second = newdiff.second;
-    else
-      it->second.push_back(newdiff);
-  } else {
-    // normal case
-    pair<map<float,diff_t>::iterator, bool> ins = thresholdmap.insert(threshold(newt, diff_t(1, newdiff)));
-    CHECK(ins.second);                // we really inserted something
-    it = ins.first;
-  }
-  return it;
-}
-
 statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction, Point& bestpoint) const
 {
   // We are looking for the best Point on the line y=Origin+x*direction
-  float min_int = 0.0001;
-  //typedef pair<unsigned,unsigned> diff;//first the sentence that changes, second is the new 1best for this sentence
-  //list<threshold> thresholdlist;
-
-  map<float,diff_t> thresholdmap;
-  thresholdmap[MIN_FLOAT] = diff_t();
-  vector<unsigned> first1best;       // the vector of nbests for x=-inf
-  for (unsigned int S = 0; S < size(); S++) {
-    map<float,diff_t >::iterator previnserted = thresholdmap.begin();
-    // First, we determine the translation with the best feature score
-    // for each sentence and each value of x.
-    //cerr << "Sentence " << S << endl;
-    multimap<float, unsigned> gradient;
-    vector<float> f0;
-    f0.resize(FData->get(S).size());
-    for (unsigned j = 0; j < FData->get(S).size(); j++) {
-      // gradient of the feature function for this particular target sentence
-      gradient.insert(pair<float, unsigned>(direction * (FData->get(S,j)), j));
-      // compute the feature function at the origin point
-      f0[j] = origin * FData->get(S, j);
-    }
-    // Now let's compute the 1best for each value of x.
 
-    //    vector<pair<float,unsigned> > onebest;
-
-
-    multimap<float,unsigned>::iterator gradientit = gradient.begin();
-    multimap<float,unsigned>::iterator highest_f0 = gradient.begin();
-
-    float smallest = gradientit->first;//smallest gradient
-    // Several candidates can have the lowest slope (e.g., for word penalty where the gradient is an integer).
-
-    gradientit++;
-    while (gradientit != gradient.end() && gradientit->first == smallest) {
-      //   cerr<<"ni"<<gradientit->second<<endl;;
-      //cerr<<"fos"<<f0[gradientit->second]<<" "<<f0[index]<<" "<<index<<endl;
-      if (f0[gradientit->second] > f0[highest_f0->second])
-        highest_f0 = gradientit;//the highest line is the one with he highest f0
-      gradientit++;
+  // First, we compute the upper envelope of each sentence independently:
+  // the 1best at x=-inf and the points where the 1best changes.
+  // Sentences are split in contiguous blocks, one per thread.
+  vector<unsigned> first1best(size());       // the vector of nbests for x=-inf
+  size_t nblocks = max<size_t>(1, min<size_t>(line_search_threads, size()));
+  vector<vector<ThresholdChange> > blockchanges(nblocks);
+  size_t blocksize = (size() + nblocks - 1) / nblocks;
+#ifdef WITH_THREADS
+  if (nblocks > 1) {
+    boost::thread_group threads;
+    for (size_t i = 0; i < nblocks; ++i) {
+      threads.create_thread(boost::bind(&ComputeEnvelopes, boost::cref(*FData),
+                                        boost::cref(origin), boost::cref(direction),
+                                        i * blocksize, min<size_t>(size(), (i + 1) * blocksize),
+                                        boost::ref(first1best), boost::ref(blockchanges[i])));
     }
+    threads.join_all();
+  } else
+#endif
+  {
+    ComputeEnvelopes(*FData, origin, direction, 0, size(), first1best, blockchanges[0]);
+  }
 
-    gradientit = highest_f0;
-    first1best.push_back(highest_f0->second);
-
-    // Now we look for the intersections points indicating a change of 1 best.
-    // We use the fact that the function is convex, which means that the gradient can only go up.
-    while (gradientit != gradient.end()) {
-      map<float,unsigned>::iterator leftmost = gradientit;
-      float m = gradientit->first;
-      float b = f0[gradientit->second];
-      multimap<float,unsigned>::iterator gradientit2 = gradientit;
-      gradientit2++;
-      float leftmostx = MAX_FLOAT;
-      for (; gradientit2 != gradient.end(); gradientit2++) {
-        //cerr<<"--"<<d++<<' '<<gradientit2->first<<' '<<gradientit2->second<<endl;
-        // Look for all candidate with a gradient bigger than the current one, and
-        // find the one with the leftmost intersection.
-        float curintersect;
-        if (m != gradientit2->first) {
-          curintersect = intersect(m, b, gradientit2->first, f0[gradientit2->second]);
-          //cerr << "curintersect: " << curintersect << " leftmostx: " << leftmostx << endl;
-          if (curintersect<=leftmostx) {
-            // We have found an intersection to the left of the leftmost we had so far.
-            // We might have curintersect==leftmostx for example is 2 candidates are the same
-            // in that case its better its better to update leftmost to gradientit2 to avoid some recomputing later.
-            leftmostx = curintersect;
-            leftmost = gradientit2; // this is the new reference
-          }
-        }
-      }
-      if (leftmost == gradientit) {
-        // We didn't find any more intersections.
-        // The rightmost bestindex is the one with the highest slope.
-
-        // They should be equal but there might be.
-        CHECK(abs(leftmost->first-gradient.rbegin()->first) < 0.0001);
-        // A small difference due to rounding error
-        break;
-      }
-      // We have found the next intersection!
-
-      pair<unsigned,unsigned> newd(S, leftmost->second);//new onebest for Sentence S is leftmost->second
-
-      if (leftmostx-previnserted->first < min_int) {
-        // Require that the intersection Point be at least min_int to the right of the previous
-        // one (for this sentence). If not, we replace the previous intersection Point with
-        // this one.
-        // Yes, it can even happen that the new intersection Point is slightly to the left of
-        // the old one, because of numerical imprecision. We do not check that we are to the
-        // right of the penultimate point also. It this happen the 1best the interval will
-        // be wrong we are going to replace previnsert by the new one because we do not want to keep
-        // 2 very close threshold: if the minima is there it could be an artifact.
-
-        map<float,diff_t>::iterator tit = thresholdmap.find(leftmostx);
-        if (tit == previnserted) {
-          // The threshold is the same as before can happen if 2 candidates are the same for example.
-          CHECK(previnserted->second.back().first == newd.first);
-          previnserted->second.back()=newd; // just replace the 1 best for sentence S
-          // previnsert doesn't change
-        } else {
-
-          if (tit == thresholdmap.end()) {
-            thresholdmap[leftmostx]=previnserted->second; // We keep the diffs at previnsert
-            thresholdmap.erase(previnserted); // erase old previnsert
-            previnserted = thresholdmap.find(leftmostx); // point previnsert to the new threshold
-            previnserted->second.back()=newd; // We update the diff for sentence S
-          // Threshold already exists but is not the previous one.
-          } else {
-            // We append the diffs in previnsert to tit before destroying previnsert.
-            tit->second.insert(tit->second.end(),previnserted->second.begin(),previnserted->second.end());
-            CHECK(tit->second.back().first == newd.first);
-            tit->second.back()=newd;    // change diff for sentence S
-            thresholdmap.erase(previnserted); // erase old previnsert
-            previnserted = tit;  // point previnsert to the new threshold
-          }
-        }
-
-        CHECK(previnserted != thresholdmap.end());
-      } else { //normal insertion process
-        previnserted = AddThreshold(thresholdmap, leftmostx, newd);
-      }
-      gradientit = leftmost;
-    } // while (gradientit!=gradient.end()){
-  }   // loop on S
+  // Merge the changes of all sentences by position on the line. The blocks are
+  // in sentence order and each sentence's changes are sorted, so a stable
+  // sort keeps the changes at the same threshold in sentence order.
+  vector<ThresholdChange> changes;
+  size_t nchanges = 0;
+  for (size_t i = 0; i < nblocks; ++i)
+    nchanges += blockchanges[i].size();
+  changes.reserve(nchanges);
+  for (size_t i = 0; i < nblocks; ++i) {
+    changes.insert(changes.end(), blockchanges[i].begin(), blockchanges[i].end());
+    vector<ThresholdChange>().swap(blockchanges[i]);
+  }
+  stable_sort(changes.begin(), changes.end(), ThresholdChangeLess);
 
-  // Now the thresholdlist is up to date: it contains a list of all the parameter_ts where
-  // the function changed its value, along with the nbest list for the interval after each threshold.
+  // thresholds[i] is the parameter_t where the function changes its value,
+  // diffs[i-1] the changes of 1best for the interval after it.
+  vector<float> thresholds(1, MIN_FLOAT);
+  diffs_t diffs;
+  for (size_t i = 0; i < changes.size(); ++i) {
+    pair<unsigned,unsigned> newdiff(changes[i].sentence, changes[i].nbest);
+    if (changes[i].x != thresholds.back()) {
+      thresholds.push_back(changes[i].x);
+      diffs.push_back(diff_t(1, newdiff));
+    } else if (diffs.back().back().first == newdiff.first) {
+      // the threshold already exists!! this is very unlikely
+      // there was already a diff for this sentence, we change the 1 best;
+      diffs.back().back().second = newdiff.second;
+    } else {
+      diffs.back().push_back(newdiff);
+    }
+  }
 
-  map<float,diff_t >::iterator thrit;
   if (verboselevel() > 6) {
-    cerr << "Thresholds:(" << thresholdmap.size() << ")" << endl;
-    for (thrit = thresholdmap.begin(); thrit != thresholdmap.end(); thrit++) {
-      cerr << "x: " << thrit->first << " diffs";
-      for (size_t j = 0; j < thrit->second.size(); ++j) {
-        cerr << " " <<thrit->second[j].first << "," << thrit->second[j].second;
+    cerr << "Thresholds:(" << thresholds.size() << ")" << endl;
+    for (size_t i = 0; i < thresholds.size(); ++i) {
+      cerr << "x: " << thresholds[i] << " diffs";
+      if (i > 0) {
+        for (size_t j = 0; j < diffs[i-1].size(); ++j) {
+          cerr << " " << diffs[i-1][j].first << "," << diffs[i-1][j].second;
+        }
       }
       cerr << endl;
     }
   }
 
   // Last thing to do is compute the Stat score (i.e., BLEU) and find the minimum.
-  thrit = thresholdmap.begin();
-  ++thrit;       // first diff corrrespond to MIN_FLOAT and first1best
-  diffs_t diffs;
-  for (; thrit != thresholdmap.end(); thrit++)
-    diffs.push_back(thrit->second);
   vector<statscore_t> scores = GetIncStatScore(first1best, diffs);
 
-  thrit = thresholdmap.begin();
   statscore_t bestscore = MIN_FLOAT;
   float bestx = MIN_FLOAT;
 
   // We skipped the first el of thresholdlist but GetIncStatScore return 1 more for first1best.
-  CHECK(scores.size() == thresholdmap.size());
+  CHECK(scores.size() == thresholds.size());
   for (unsigned int sc = 0; sc != scores.size(); sc++) {
-    //cerr << "x=" << thrit->first << " => " << scores[sc] << endl;
+    //cerr << "x=" << thresholds[sc] << " => " << scores[sc] << endl;
     if (scores[sc] > bestscore) {
-      // This is the score for the interval [lit2->first, (lit2+1)->first]
+      // This is the score for the interval [thresholds[sc], thresholds[sc+1]]
       // unless we're at the last score, when it's the score
-      // for the interval [lit2->first,+inf].
+      // for the interval [thresholds[sc],+inf].
       bestscore = scores[sc];
 
       // If we're not in [-inf,x1] or [xn,+inf], then just take the value
@@ -266,16 +294,8 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
       // take x to be the last interval boundary + 0.1, and for the leftmost
       // interval, take x to be the first interval boundary - 1000.
       // These values are taken from cmert.
-      float leftx = thrit->first;
-      if (thrit == thresholdmap.begin()) {
-        leftx = MIN_FLOAT;
-      }
-      ++thrit;
-      float rightx = MAX_FLOAT;
-      if (thrit != thresholdmap.end()) {
-        rightx = thrit->first;
-      }
-      --thrit;
+      float leftx = sc == 0 ? MIN_FLOAT : thresholds[sc];
+      float rightx = sc + 1 < thresholds.size() ? thresholds[sc + 1] : MAX_FLOAT;
       //cerr << "leftx: " << leftx << " rightx: " << rightx << endl;
       if (leftx == MIN_FLOAT) {
         bestx = rightx-1000;
@@ -286,7 +306,6 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
       }
       //cerr << "x = " << "set new bestx to: " << bestx << endl;
     }
-    ++thrit;
   }
 
   if (abs(bestx) < 0.00015) {
@@ -360,7 +379,7 @@ statscore_t Optimizer::Run(Point& P) const
 }
 
 
-vector<statscore_t> Optimizer::GetIncStatScore(vector<unsigned> thefirst, vector<vector <pair<unsigned,unsigned> > > thediffs) const
+vector<statscore_t> Optimizer::GetIncStatScore(const vector<unsigned>& thefirst, const diffs_t& thediffs) const
 {
   CHECK(scorer);
 
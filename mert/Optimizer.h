@@ -22,11 +22,17 @@ protected:
   Scorer *scorer;      // no accessor for them only child can use them
   FeatureData *FData;  // no accessor for them only child can use them
   unsigned int number_of_random_directions;
+  size_t line_search_threads;
 
 public:
   Optimizer(unsigned Pd, vector<unsigned> i2O, vector<parameter_t> start, unsigned int nrandom);
   void SetScorer(Scorer *_scorer);
   void SetFData(FeatureData *_FData);
+
+  /**
+   * Number of threads computing the per-sentence envelopes in LineOptimize.
+   */
+  void SetLineSearchThreads(size_t threads);
   virtual ~Optimizer();
 
   unsigned size() const {
@@ -57,7 +63,7 @@ public:
 
   statscore_t GetStatScore(const Point& param) const;
 
-  vector<statscore_t> GetIncStatScore(vector<unsigned> ref, vector<vector<pair<unsigned,unsigned> > >) const;
+  vector<statscore_t> GetIncStatScore(const vector<unsigned>& ref, const diffs_t& diffs) const;
 
   /**
    * Get the optimal Lambda and the best score in a particular direction from a given Point.
@@ -0,0 +1,120 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "PairBuffer.h"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// differences smaller than this are left out, as they always were
+const float kMinDiff = 0.00001;
+
+}
+
+void PairBuffer::add(const FeatureDataItem& better, const FeatureDataItem& worse) {
+  if (better.dense.size() != worse.dense.size()) {
+    throw runtime_error("Translations with different numbers of features");
+  }
+  if (size() == 0) {
+    m_dense = better.dense.size();
+  } else if (m_dense != better.dense.size()) {
+    throw runtime_error("Sentences with different numbers of features");
+  }
+
+  for (size_t j = 0; j < better.dense.size(); ++j) {
+    const float diff = better.dense[j] - worse.dense[j];
+    if (fabs(diff) > kMinDiff) {
+      m_entryColumns.push_back(j);
+      m_values.push_back(diff);
+      m_columns = max(m_columns, j + 1);
+    }
+  }
+  if (better.sparse.size() || worse.sparse.size()) {
+    const SparseVector diff = better.sparse - worse.sparse;
+    for (SparseVector::fvector_t::const_iterator i = diff.begin(); i != diff.end(); ++i) {
+      if (fabs(i->second) < kMinDiff) continue;
+      m_entryColumns.push_back(m_dense + i->first);
+      m_values.push_back(i->second);
+      m_columns = max(m_columns, m_dense + i->first + 1);
+    }
+  }
+  m_offsets.push_back(m_values.size());
+}
+
+void PairBuffer::append(const PairBuffer& other) {
+  if (other.size() == 0) return;
+  if (size() == 0) {
+    m_dense = other.m_dense;
+  } else if (m_dense != other.m_dense) {
+    throw runtime_error("Sentences with different numbers of features");
+  }
+  const size_t base = m_values.size();
+  for (size_t i = 1; i < other.m_offsets.size(); ++i) {
+    m_offsets.push_back(base + other.m_offsets[i]);
+  }
+  m_entryColumns.insert(m_entryColumns.end(), other.m_entryColumns.begin(), other.m_entryColumns.end());
+  m_values.insert(m_values.end(), other.m_values.begin(), other.m_values.end());
+  m_columns = max(m_columns, other.m_columns);
+}
+
+void PairBuffer::clear() {
+  m_dense = 0;
+  m_columns = 0;
+  m_offsets.resize(1);
+  m_entryColumns.clear();
+  m_values.clear();
+}
+
+string PairBuffer::columnName(size_t column) const {
+  if (column >= m_dense) {
+    return SparseVector::getName(column - m_dense);
+  }
+  ostringstream name;
+  name << "F" << column;
+  return name.str();
+}
+
+void PairBuffer::writeRow(ostream& out, size_t row, float sign) const {
+  size_t i = rowBegin(row);
+  for (; i < rowEnd(row) && m_entryColumns[i] < m_dense; ++i) {
+    out << " F" << m_entryColumns[i] << " " << sign * m_values[i];
+  }
+  if (i < rowEnd(row)) {
+    out << " ";
+    for (; i < rowEnd(row); ++i) {
+      out << SparseVector::getName(m_entryColumns[i] - m_dense) << " " << sign * m_values[i] << " ";
+    }
+  }
+}
+
+void PairBuffer::writeMegam(ostream& out) const {
+  for (size_t row = 0; row < size(); ++row) {
+    out << "1";
+    writeRow(out, row, 1);
+    out << "\n";
+    out << "0";
+    writeRow(out, row, -1);
+    out << "\n";
+  }
+}
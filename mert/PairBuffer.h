@@ -0,0 +1,88 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef _PAIR_BUFFER_
+#define _PAIR_BUFFER_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "FeatureDataIterator.h"
+
+/**
+  * The pairs of translations sampled by PRO, held in memory as the feature
+  * differences of the better minus the worse translation, one sparse row
+  * per pair.
+  *
+  * Dense feature j is column j, sparse feature id i is column dense + i, so
+  * the buffers of different sentences can be filled independently and
+  * appended in any order without renumbering.
+**/
+class PairBuffer
+{
+  public:
+    PairBuffer() : m_dense(0), m_columns(0) {
+      m_offsets.push_back(0);
+    }
+
+    void add(const FeatureDataItem& better, const FeatureDataItem& worse);
+    void append(const PairBuffer& other);
+    void clear();
+
+    inline size_t size() const {
+      return m_offsets.size() - 1;
+    }
+    //! one more than the largest column used
+    inline size_t columns() const {
+      return m_columns;
+    }
+    std::string columnName(size_t column) const;
+
+    //! the entries of a row are [rowBegin(i), rowEnd(i))
+    inline size_t rowBegin(size_t row) const {
+      return m_offsets[row];
+    }
+    inline size_t rowEnd(size_t row) const {
+      return m_offsets[row + 1];
+    }
+    inline uint32_t column(size_t entry) const {
+      return m_entryColumns[entry];
+    }
+    inline float value(size_t entry) const {
+      return m_values[entry];
+    }
+
+    /** Write the pairs as megam training data, each pair as a positive
+      * example and the negated difference as a negative one. */
+    void writeMegam(std::ostream& out) const;
+
+  private:
+    void writeRow(std::ostream& out, size_t row, float sign) const;
+
+    size_t m_dense;
+    size_t m_columns;
+    std::vector<size_t> m_offsets;
+    std::vector<uint32_t> m_entryColumns;
+    std::vector<float> m_values;
+};
+
+#endif
@@ -7,6 +7,7 @@
  */
 
 #include "ScoreData.h"
+#include "BinaryData.h"
 #include "Scorer.h"
 #include "Util.h"
 #include "FileStream.h"
@@ -28,13 +29,21 @@ void ScoreData::save(std::ofstream& outFile, bool bin)
   }
 }
 
-void ScoreData::save(const std::string &file, bool bin)
+void ScoreData::save(const std::string &file, bool bin, bool append)
 {
   if (file.empty()) return;
   TRACE_ERR("saving the array into " << file << std::endl);
 
+  if (bin) {
+    BinaryDataWriter writer(BINARY_SCORES, score_type);
+    for (scoredata_t::const_iterator i = array_.begin(); i != array_.end(); i++)
+      writer.add(*i);
+    writer.write(file, append);
+    return;
+  }
+
   // matches a stream with a file. Opens the file.
-  std::ofstream outFile(file.c_str(), std::ios::out);
+  std::ofstream outFile(file.c_str(), append ? std::ios::app : std::ios::out);
 
   ScoreStats entry;
 
@@ -68,6 +77,16 @@ void ScoreData::load(const std::string &file)
 {
   TRACE_ERR("loading score data from " << file << std::endl);
 
+  if (IsBinaryDataFile(file)) {
+    BinaryDataFile binFile(file);
+    ScoreArray entry;
+    for (size_t i = 0; i < binFile.size(); ++i) {
+      binFile.get(i, entry);
+      add(entry);
+    }
+    return;
+  }
+
   inputfilestream inFile(file); // matches a stream with a file. Opens the file
 
   if (!inFile) {
@@ -26,9 +26,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 using namespace std;
 using namespace util;
 
-ScoreDataIterator::ScoreDataIterator() {}
+ScoreDataIterator::ScoreDataIterator() : m_position(0) {}
 
-ScoreDataIterator::ScoreDataIterator(const string& filename) {
+ScoreDataIterator::ScoreDataIterator(const string& filename) : m_position(0) {
+  if (IsBinaryDataFile(filename)) {
+    m_binary.reset(new BinaryDataFile(filename));
+    readNextBinary();
+    return;
+  }
   m_in.reset(new FilePiece(filename.c_str()));
   readNext();
 }
@@ -64,12 +69,35 @@ void ScoreDataIterator::readNext() {
   }
 }
 
+void ScoreDataIterator::readNextBinary() {
+  m_next.clear();
+  if (m_position == m_binary->size()) {
+    m_binary.reset();
+    return;
+  }
+  if (m_binary->kind() != BINARY_SCORES) {
+    throw FileFormatException(m_binary->getIndex(m_position), "wrong kind of binary data");
+  }
+  for (size_t i = 0; i < m_binary->getCandidates(m_position); ++i) {
+    const ScoreStatsType* scores = m_binary->getScores(m_position, i);
+    m_next.push_back(ScoreDataItem(scores, scores + m_binary->getDenseSize(m_position)));
+  }
+}
+
 void ScoreDataIterator::increment() {
+  if (m_binary) {
+    ++m_position;
+    readNextBinary();
+    return;
+  }
   readNext();
 }
 
 
 bool ScoreDataIterator::equal(const ScoreDataIterator& rhs) const {
+  if (m_binary || rhs.m_binary) {
+    return m_binary == rhs.m_binary && m_position == rhs.m_position;
+  }
   if (!m_in && !rhs.m_in) {
     return true;
   } else if (!m_in) {
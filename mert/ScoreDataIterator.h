@@ -32,6 +32,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "util/file_piece.hh"
 #include "util/string_piece.hh"
 
+#include "BinaryData.h"
 #include "FeatureDataIterator.h"
 
 typedef std::vector<float> ScoreDataItem;
@@ -58,7 +59,12 @@ class ScoreDataIterator :
 
     void readNext();
 
+    void readNextBinary();
+
     boost::shared_ptr<util::FilePiece> m_in;
+    // binary data files are mapped instead
+    boost::shared_ptr<BinaryDataFile> m_binary;
+    size_t m_position;
     std::vector<ScoreDataItem> m_next;
 };
 
@@ -0,0 +1,154 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "ScoreStatsCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "util/murmur_hash.hh"
+
+#include "ScoreStats.h"
+
+using namespace std;
+
+namespace {
+
+const char kMagic[8] = {'M', 'E', 'R', 'T', 'S', 'T', 'A', 'T'};
+const uint64_t kVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint64_t version;
+  uint64_t signature;
+  uint64_t numStats;
+  uint64_t entries;
+};
+
+}
+
+ScoreStatsCache::ScoreStatsCache(uint64_t signature)
+  : m_signature(signature), m_numStats(0) {}
+
+uint64_t ScoreStatsCache::hash(const string& text, uint64_t seed) {
+  return util::MurmurHashNative(text.data(), text.size(), seed);
+}
+
+ScoreStatsCache::Key ScoreStatsCache::makeKey(size_t sentence, const string& text) {
+  Key key;
+  key.sentence = sentence;
+  key.candidate = hash(text);
+  return key;
+}
+
+size_t ScoreStatsCache::load(const string& filename) {
+  ifstream in(filename.c_str(), ios::in | ios::binary);
+  if (!in) return 0;
+
+  Header header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      memcmp(header.magic, kMagic, sizeof(kMagic)) || header.version != kVersion) {
+    throw runtime_error(filename + " is not a score statistics cache");
+  }
+  if (header.signature != m_signature) {
+    cerr << "Ignoring " << filename << ", written for other references or another scorer" << endl;
+    return 0;
+  }
+
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  if (!m_entries.empty() && header.numStats != m_numStats) {
+    throw runtime_error(filename + " has a different number of statistics");
+  }
+  m_numStats = header.numStats;
+  Key key;
+  vector<ScoreStatsType> stats(m_numStats + 1); // never empty
+  for (uint64_t i = 0; i < header.entries; ++i) {
+    if (!in.read(reinterpret_cast<char*>(&key), sizeof(key)) ||
+        !in.read(reinterpret_cast<char*>(&stats[0]), m_numStats * sizeof(ScoreStatsType))) {
+      throw runtime_error(filename + " is truncated");
+    }
+    m_entries[key].assign(stats.begin(), stats.begin() + m_numStats);
+  }
+  return header.entries;
+}
+
+void ScoreStatsCache::save(const string& filename) const {
+  ofstream out(filename.c_str(), ios::out | ios::binary);
+  if (!out) {
+    throw runtime_error("Unable to open " + filename);
+  }
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.signature = m_signature;
+  header.numStats = m_numStats;
+  header.entries = m_entries.size();
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (Entries::const_iterator i = m_entries.begin(); i != m_entries.end(); ++i) {
+    out.write(reinterpret_cast<const char*>(&i->first), sizeof(i->first));
+    if (m_numStats) {
+      out.write(reinterpret_cast<const char*>(&i->second[0]), m_numStats * sizeof(ScoreStatsType));
+    }
+  }
+  if (!out) {
+    throw runtime_error("Failed to write " + filename);
+  }
+}
+
+bool ScoreStatsCache::find(size_t sentence, const string& text, ScoreStats& entry) const {
+  const Key key = makeKey(sentence, text);
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  Entries::const_iterator found = m_entries.find(key);
+  if (found == m_entries.end()) return false;
+  entry.reset();
+  for (size_t i = 0; i < found->second.size(); ++i) {
+    entry.add(found->second[i]);
+  }
+  return true;
+}
+
+void ScoreStatsCache::add(size_t sentence, const string& text, const ScoreStats& entry) {
+  const Key key = makeKey(sentence, text);
+  vector<ScoreStatsType> stats(entry.getArray(), entry.getArray() + entry.size());
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  if (m_entries.empty()) {
+    m_numStats = stats.size();
+  } else if (stats.size() != m_numStats) {
+    throw runtime_error("Scorer produced a different number of statistics");
+  }
+  m_entries[key] = stats;
+}
+
+size_t ScoreStatsCache::size() const {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  return m_entries.size();
+}
@@ -0,0 +1,97 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef _SCORE_STATS_CACHE_
+#define _SCORE_STATS_CACHE_
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
+#include "Types.h"
+
+class ScoreStats;
+
+/**
+  * Sufficient statistics of the candidates scored so far, keyed by sentence
+  * id and a hash of the candidate text.  Most candidates of an n-best list
+  * were already in the lists of earlier tuning iterations, so keeping the
+  * cache in a side file between runs of the extractor saves scoring them
+  * again.
+  *
+  * The statistics depend on the scorer, its configuration and the
+  * references, which are summarised by the signature: a file written with
+  * another signature is ignored.  The cache may be used from several
+  * threads.
+  *
+  * The file is a header (magic, version, signature, number of statistics,
+  * number of entries) followed by the entries, each the sentence id, the
+  * candidate hash and the statistics, in native byte order.
+**/
+class ScoreStatsCache
+{
+  public:
+    explicit ScoreStatsCache(uint64_t signature);
+
+    //! hash of the strings, for building signatures
+    static uint64_t hash(const std::string& text, uint64_t seed = 0);
+
+    /** Load the entries of a cache file, if it exists and has the same
+      * signature.  Returns the number of entries loaded. */
+    size_t load(const std::string& filename);
+    void save(const std::string& filename) const;
+
+    bool find(size_t sentence, const std::string& text, ScoreStats& entry) const;
+    void add(size_t sentence, const std::string& text, const ScoreStats& entry);
+
+    size_t size() const;
+
+  private:
+    struct Key {
+      uint64_t sentence;
+      uint64_t candidate;
+
+      bool operator==(const Key& other) const {
+        return sentence == other.sentence && candidate == other.candidate;
+      }
+    };
+    struct KeyHash {
+      size_t operator()(const Key& key) const {
+        return key.candidate ^ (key.sentence * 0x9e3779b97f4a7c15ULL);
+      }
+    };
+    typedef boost::unordered_map<Key, std::vector<ScoreStatsType>, KeyHash> Entries;
+
+    static Key makeKey(size_t sentence, const std::string& text);
+
+    uint64_t m_signature;
+    size_t m_numStats;
+    Entries m_entries;
+#ifdef WITH_THREADS
+    mutable boost::mutex m_mutex;
+#endif
+};
+
+#endif
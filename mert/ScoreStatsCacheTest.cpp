@@ -0,0 +1,201 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "ScoreStatsCache.h"
+
+#include "BleuScorer.h"
+#include "ScoreStats.h"
+
+#define BOOST_TEST_MODULE MertScoreStatsCache
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// a file name that is unused until the test writes it
+class TempFile {
+  public:
+    TempFile() {
+      char name[] = "/tmp/mert_stats_cache_test_XXXXXX";
+      int fd = mkstemp(name);
+      BOOST_REQUIRE(fd != -1);
+      close(fd);
+      m_name = name;
+    }
+    ~TempFile() {
+      unlink(m_name.c_str());
+    }
+    const string& name() const {
+      return m_name;
+    }
+  private:
+    string m_name;
+};
+
+ScoreStats MakeStats(ScoreStatsType first, size_t size) {
+  ScoreStats stats;
+  for (size_t i = 0; i < size; ++i) stats.add(first + i);
+  return stats;
+}
+
+void CheckEqual(const ScoreStats& expected, const ScoreStats& actual) {
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    BOOST_CHECK_EQUAL(expected.get(i), actual.get(i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SaveAndLoad) {
+  TempFile file;
+  ScoreStatsCache cache(42);
+  cache.add(0, "a b c", MakeStats(1, 5));
+  cache.add(0, "a b", MakeStats(10, 5));
+  cache.add(3, "a b c", MakeStats(20, 5));
+  BOOST_CHECK_EQUAL(3u, cache.size());
+  cache.save(file.name());
+
+  ScoreStatsCache loaded(42);
+  BOOST_REQUIRE_EQUAL(3u, loaded.load(file.name()));
+  BOOST_REQUIRE_EQUAL(3u, loaded.size());
+  ScoreStats found;
+  BOOST_REQUIRE(loaded.find(0, "a b c", found));
+  CheckEqual(MakeStats(1, 5), found);
+  BOOST_REQUIRE(loaded.find(0, "a b", found));
+  CheckEqual(MakeStats(10, 5), found);
+  BOOST_REQUIRE(loaded.find(3, "a b c", found));
+  CheckEqual(MakeStats(20, 5), found);
+  // keyed by sentence as well as text
+  BOOST_CHECK(!loaded.find(1, "a b c", found));
+  BOOST_CHECK(!loaded.find(0, "a b c d", found));
+}
+
+BOOST_AUTO_TEST_CASE(MissingFile) {
+  ScoreStatsCache cache(42);
+  BOOST_CHECK_EQUAL(0u, cache.load("/nonexistent/mert_stats_cache"));
+  BOOST_CHECK_EQUAL(0u, cache.size());
+}
+
+BOOST_AUTO_TEST_CASE(OtherSignatureIsIgnored) {
+  TempFile file;
+  ScoreStatsCache cache(42);
+  cache.add(0, "a b c", MakeStats(1, 5));
+  cache.save(file.name());
+
+  ScoreStatsCache other(43);
+  BOOST_CHECK_EQUAL(0u, other.load(file.name()));
+  BOOST_CHECK_EQUAL(0u, other.size());
+}
+
+BOOST_AUTO_TEST_CASE(CorruptFilesAreRejected) {
+  TempFile file;
+  ScoreStatsCache cache(42);
+  cache.add(0, "a b c", MakeStats(1, 5));
+  cache.add(1, "d e", MakeStats(1, 5));
+  cache.save(file.name());
+
+  // drop the last few bytes
+  string contents;
+  {
+    ifstream in(file.name().c_str(), ios::binary);
+    contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  }
+  {
+    ofstream out(file.name().c_str(), ios::binary);
+    out.write(contents.data(), contents.size() - 4);
+  }
+  ScoreStatsCache truncated(42);
+  BOOST_CHECK_THROW(truncated.load(file.name()), runtime_error);
+
+  {
+    ofstream out(file.name().c_str(), ios::binary);
+    out << "not a cache at all, but long enough for a header";
+  }
+  ScoreStatsCache garbage(42);
+  BOOST_CHECK_THROW(garbage.load(file.name()), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(DifferentStatisticsAreRejected) {
+  ScoreStatsCache cache(42);
+  cache.add(0, "a b c", MakeStats(1, 5));
+  BOOST_CHECK_THROW(cache.add(1, "a b c", MakeStats(1, 4)), runtime_error);
+}
+
+// a scorer reading its statistics from a reloaded cache gives what it computes
+BOOST_AUTO_TEST_CASE(ScorerRoundTrip) {
+  TempFile reference, file;
+  {
+    ofstream out(reference.name().c_str());
+    out << "the cat sat on the mat\n" << "a dog barked at the moon\n";
+  }
+  vector<string> references(1, reference.name());
+  const char* candidates[][2] = {
+    {"0", "the cat sat on a mat"}, {"0", "the the the"}, {"1", "a dog barked"},
+    {"1", "the moon barked at a dog"}, {"1", ""}
+  };
+  const size_t numCandidates = sizeof(candidates) / sizeof(candidates[0]);
+
+  BleuScorer plain;
+  plain.setReferenceFiles(references);
+  vector<ScoreStats> expected(numCandidates);
+  for (size_t i = 0; i < numCandidates; ++i) {
+    plain.prepareStats(atoi(candidates[i][0]), candidates[i][1], expected[i]);
+  }
+
+  {
+    ScoreStatsCache cache(7);
+    BleuScorer scorer;
+    scorer.setReferenceFiles(references);
+    scorer.setStatsCache(&cache);
+    for (size_t i = 0; i < numCandidates; ++i) {
+      ScoreStats stats;
+      static_cast<StatisticsBasedScorer&>(scorer).prepareStats(candidates[i][0], candidates[i][1], stats);
+      CheckEqual(expected[i], stats);
+    }
+    BOOST_CHECK_EQUAL(numCandidates, cache.size());
+    cache.save(file.name());
+  }
+
+  ScoreStatsCache cache(7);
+  BOOST_REQUIRE_EQUAL(numCandidates, cache.load(file.name()));
+  for (size_t i = 0; i < numCandidates; ++i) {
+    ScoreStats stats;
+    BOOST_REQUIRE(cache.find(atoi(candidates[i][0]), candidates[i][1], stats));
+    CheckEqual(expected[i], stats);
+  }
+  BleuScorer scorer;
+  scorer.setReferenceFiles(references);
+  scorer.setStatsCache(&cache);
+  for (size_t i = 0; i < numCandidates; ++i) {
+    ScoreStats stats;
+    static_cast<StatisticsBasedScorer&>(scorer).prepareStats(candidates[i][0], candidates[i][1], stats);
+    CheckEqual(expected[i], stats);
+  }
+  BOOST_CHECK_EQUAL(numCandidates, cache.size());
+}
+
+}
@@ -1,5 +1,6 @@
 #include "Scorer.h"
 #include <limits>
+#include "ScoreStatsCache.h"
 
 Scorer::Scorer(const string& name, const string& config)
     : _name(name), _scoreData(0), _preserveCase(true) {
@@ -50,7 +51,7 @@ static float score_average(const statscores_t& scores, size_t start, size_t end)
 }
 
 StatisticsBasedScorer::StatisticsBasedScorer(const string& name, const string& config)
-    : Scorer(name,config) {
+    : Scorer(name,config), _statsCache(NULL) {
   //configure regularisation
   static string KEY_TYPE = "regtype";
   static string KEY_WINDOW = "regwin";
@@ -86,6 +87,18 @@ StatisticsBasedScorer::StatisticsBasedScorer(const string& name, const string& c
   //    cerr << "Using case preservation: " << _preserveCase << endl;
 }
 
+void StatisticsBasedScorer::prepareStats(const string& sindex, const string& text, ScoreStats& entry)
+{
+  const size_t sid = (size_t) atoi(sindex.c_str());
+  if (_statsCache && _statsCache->find(sid, text, entry)) {
+    return;
+  }
+  prepareStats(sid, text, entry);
+  if (_statsCache) {
+    _statsCache->add(sid, text, entry);
+  }
+}
+
 void  StatisticsBasedScorer::score(const candidates_t& candidates, const diffs_t& diffs,
                                    statscores_t& scores) const
 {
@@ -123,10 +136,10 @@ void  StatisticsBasedScorer::score(const candidates_t& candidates, const diffs_t
       size_t sid = diffs[i][j].first;
       size_t nid = diffs[i][j].second;
       size_t last_nid = last_candidates[sid];
+      const ScoreStatsType* next = _scoreData->get(sid,nid).getArray();
+      const ScoreStatsType* last = _scoreData->get(sid,last_nid).getArray();
       for (size_t k  = 0; k < totals.size(); ++k) {
-        int diff = _scoreData->get(sid,nid).get(k)
-                   - _scoreData->get(sid,last_nid).get(k);
-        totals[k] += diff;
+        totals[k] += next[k] - last[k];
       }
       last_candidates[sid] = nid;
     }
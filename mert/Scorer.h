@@ -6,6 +6,9 @@
 #include <stdexcept>
 #include <string>
 #include <vector>
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
 #include "Types.h"
 #include "ScoreData.h"
 
@@ -14,6 +17,7 @@ using namespace std;
 enum ScorerRegularisationStrategy {REG_NONE, REG_AVERAGE, REG_MINIMUM};
 
 class ScoreStats;
+class ScoreStatsCache;
 
 /**
  * Superclass of all scorers and dummy implementation.
@@ -129,10 +133,12 @@ protected:
   /**
    * Tokenise line and encode.
    * Note: We assume that all tokens are separated by single spaces.
+   * May be called by several threads at once.
    */
   void encode(const string& line, vector<int>& encoded) {
     //cerr << line << endl;
     istringstream in (line);
+    vector<string> tokens;
     string token;
     while (in >> token) {
       if (!_preserveCase) {
@@ -140,6 +146,13 @@ protected:
           *i = tolower(*i);
         }
       }
+      tokens.push_back(token);
+    }
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(_encodingsMutex);
+#endif
+    for (vector<string>::const_iterator t = tokens.begin(); t != tokens.end(); ++t) {
+      const string& token = *t;
       encodings_it encoding = _encodings.find(token);
       int encoded_token;
       if (encoding == _encodings.end()) {
@@ -157,6 +170,9 @@ protected:
 
 private:
   map<string,string> _config;
+#ifdef WITH_THREADS
+  boost::mutex _encodingsMutex;
+#endif
 };
 
 
@@ -172,6 +188,21 @@ public:
   virtual void score(const candidates_t& candidates, const diffs_t& diffs,
                      statscores_t& scores) const;
 
+  /**
+   * Look the statistics of the candidate up in the cache, if there is one,
+   * and only compute those that are missing.  Safe to call from several
+   * threads, as long as the scorer's prepareStats() is.
+   */
+  virtual void prepareStats(const string& sindex, const string& text, ScoreStats& entry);
+  using Scorer::prepareStats;
+
+  /**
+   * Share statistics through the cache, which is not owned by the scorer.
+   */
+  void setStatsCache(ScoreStatsCache* cache) {
+    _statsCache = cache;
+  }
+
 protected:
   /**
    * Calculate the actual score.
@@ -181,6 +212,8 @@ protected:
   // regularisation
   ScorerRegularisationStrategy _regularisationStrategy;
   size_t  _regularisationWindow;
+
+  ScoreStatsCache* _statsCache;
 };
 
 #endif // __SCORER_H__
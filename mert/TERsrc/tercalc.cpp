@@ -10,6 +10,9 @@
 //
 //
 #include "tercalc.h"
+
+#include <algorithm>
+
 using namespace std;
 using namespace Tools;
 namespace TERCpp
@@ -30,6 +33,7 @@ terCalc::terCalc()
   BEAM_WIDTH = 20;
   MAX_SHIFT_DIST = 50;
   PRINT_DEBUG = false;
+  refBlocks = 0;
 }
 
 
@@ -125,29 +129,17 @@ int terCalc::WERCalculation ( std::vector< int > ref, std::vector< int > hyp )
 
 terAlignment terCalc::TER ( std::vector< int > hyp, std::vector< int > ref )
 {
-  stringstream s;
-  s.str ( "" );
-  string stringRef ( "" );
-  string stringHyp ( "" );
-  for ( vector<int>::iterator l_it = ref.begin(); l_it != ref.end(); l_it++ ) {
-    if ( l_it == ref.begin() ) {
-      s << ( *l_it );
-    } else {
-      s << " " << ( *l_it );
-    }
+  // an empty sentence used to go through the strings as one empty word
+  if ( hyp.empty() ) {
+    hyp.push_back ( -1 );
   }
-  stringRef = s.str();
-  s.str ( "" );
-  for ( vector<int>::iterator l_itHyp = hyp.begin(); l_itHyp != hyp.end(); l_itHyp++ ) {
-    if ( l_itHyp == hyp.begin() ) {
-      s << ( *l_itHyp );
-    } else {
-      s << " " << ( *l_itHyp );
-    }
+  if ( ref.empty() ) {
+    ref.push_back ( -1 );
   }
-  stringHyp = s.str();
-  s.str ( "" );
-  return TER ( stringToVector ( stringRef , " " ), stringToVector ( stringHyp , " " ) );
+  vecInt aftershift;
+  vector<vecInt> shiftedWords;
+  vector<vecInt> shiftAftershifts;
+  return ComputeTER ( hyp, ref, aftershift, shiftedWords, shiftAftershifts );
 }
 
 int terCalc::WERCalculation ( vector<string> ref, vector<string> hyp )
@@ -398,33 +390,23 @@ int terCalc::WERCalculation ( vector<string> ref, vector<string> hyp )
 // 		return retour;
 // 	}
 
-hashMapInfos terCalc::BuildWordMatches ( vector<string> hyp, vector<string> ref )
+terCalc::wordMatches terCalc::BuildWordMatches ( const vecInt& hyp, const vecInt& ref )
 {
-  hashMap tempHash;
-  hashMapInfos retour;
+  wordMatches retour;
+  boost::unordered_map<int, bool> inHyp;
   for ( int i = 0; i < ( int ) hyp.size(); i++ ) {
-    tempHash.addHasher ( hyp.at ( i ), "" );
+    inHyp[hyp[i]] = true;
   }
-  bool cor[ref.size() ];
+  vector<char> cor ( ref.size() );
   for ( int i = 0; i < ( int ) ref.size(); i++ ) {
-    if ( tempHash.trouve ( ( string ) ref.at ( i ) ) ) {
-      cor[i] = true;
-    } else {
-      cor[i] = false;
-    }
+    cor[i] = ( inHyp.find ( ref[i] ) != inHyp.end() );
   }
   for ( int start = 0; start < ( int ) ref.size(); start++ ) {
     if ( cor[start] ) {
+      vecInt ajouter;
       for ( int end = start; ( ( end < ( int ) ref.size() ) && ( end - start <= MAX_SHIFT_SIZE ) && ( cor[end] ) ); end++ ) {
-        vector<string> ajouter = subVector ( ref, start, end + 1 );
-        string ajouterString = vectorToString ( ajouter );
-        vector<int> values = retour.getValue ( ajouterString );
-        values.push_back ( start );
-        if ( values.size() > 1 ) {
-          retour.setValue ( ajouterString, values );
-        } else {
-          retour.addValue ( ajouterString, values );
-        }
+        ajouter.push_back ( ref[end] );
+        retour[ajouter].push_back ( start );
       }
     }
   }
@@ -440,7 +422,7 @@ bool terCalc::spanIntersection ( vecInt refSpan, vecInt hypSpan )
 }
 
 
-terAlignment terCalc::MinEditDist ( vector<string> hyp, vector<string> ref, vector<vecInt> curHypSpans )
+terAlignment terCalc::MinEditDist ( const vecInt& hyp, const vecInt& ref )
 {
   double current_best = INF;
   double last_best = INF;
@@ -453,26 +435,20 @@ terAlignment terCalc::MinEditDist ( vector<string> hyp, vector<string> ref, vect
   int i, j;
   double cost, icost, dcost;
   double score;
+  const int hypSize = ( int ) hyp.size();
+  const int refSize = ( int ) ref.size();
+  const int width = hypSize + 1;
+  const size_t cells = ( size_t ) ( refSize + 1 ) * width;
 
-//         int hwsize = hyp.size()-1;
-//         int rwsize = ref.size()-1;
   NUM_BEAM_SEARCH_CALLS++;
-// 		if ((ref.size()+1 > sizeof(S)) || (hyp.size()+1 > sizeof(S)))
-// 		{
-// 			int max = ref.size();
-// 			if (hyp.size() > ref.size()) max = hyp.size();
-// 			max += 26; // we only need a +1 here, but let's pad for future use
-// 			S = new double[max][max];
-// 			P = new char[max][max];
-// 		}
-  for ( i = 0; i <= ( int ) ref.size(); i++ ) {
-    for ( j = 0; j <= ( int ) hyp.size(); j++ ) {
-      S[i][j] = -1.0;
-      P[i][j] = '0';
-    }
-  }
-  S[0][0] = 0.0;
-  for ( j = 0; j <= ( int ) hyp.size(); j++ ) {
+  if ( S.size() < cells ) {
+    S.resize ( cells );
+    P.resize ( cells );
+  }
+  std::fill ( S.begin(), S.begin() + cells, -1.0 );
+  std::fill ( P.begin(), P.begin() + cells, '0' );
+  S[0] = 0.0;
+  for ( j = 0; j <= hypSize; j++ ) {
     last_best = current_best;
     current_best = INF;
     first_good = current_first_good;
@@ -481,65 +457,66 @@ terAlignment terCalc::MinEditDist ( vector<string> hyp, vector<string> ref, vect
     cur_last_good = -1;
     last_peak = cur_last_peak;
     cur_last_peak = 0;
-    for ( i = first_good; i <= ( int ) ref.size(); i++ ) {
+    for ( i = first_good; i <= refSize; i++ ) {
       if ( i > last_good ) {
         break;
       }
-      if ( S[i][j] < 0 ) {
+      if ( S[i * width + j] < 0 ) {
         continue;
       }
-      score = S[i][j];
-      if ( ( j < ( int ) hyp.size() ) && ( score > last_best + BEAM_WIDTH ) ) {
+      score = S[i * width + j];
+      if ( ( j < hypSize ) && ( score > last_best + BEAM_WIDTH ) ) {
         continue;
       }
       if ( current_first_good == -1 ) {
         current_first_good = i ;
       }
-      if ( ( i < ( int ) ref.size() ) && ( j < ( int ) hyp.size() ) ) {
-        if ( ( int ) refSpans.size() ==  0 || ( int ) hypSpans.size() ==  0 || spanIntersection ( refSpans.at ( i ), curHypSpans.at ( j ) ) ) {
-          if ( ( int ) ( ref.at ( i ).compare ( hyp.at ( j ) ) ) == 0 ) {
-            cost = match_cost + score;
-            if ( ( S[i+1][j+1] == -1 ) || ( cost < S[i+1][j+1] ) ) {
-              S[i+1][j+1] = cost;
-              P[i+1][j+1] = ' ';
-            }
+      if ( ( i < refSize ) && ( j < hypSize ) ) {
+        const size_t diag = ( i + 1 ) * width + j + 1;
+        if ( ref[i] == hyp[j] ) {
+          cost = match_cost + score;
+          if ( ( S[diag] == -1 ) || ( cost < S[diag] ) ) {
+            S[diag] = cost;
+            P[diag] = ' ';
+          }
+          if ( cost < current_best ) {
+            current_best = cost;
+          }
+          if ( current_best == cost ) {
+            cur_last_peak = i + 1;
+          }
+        } else {
+          cost = substitute_cost + score;
+          if ( ( S[diag] < 0 ) || ( cost < S[diag] ) ) {
+            S[diag] = cost;
+            P[diag] = 'S';
             if ( cost < current_best ) {
               current_best = cost;
             }
             if ( current_best == cost ) {
-              cur_last_peak = i + 1;
-            }
-          } else {
-            cost = substitute_cost + score;
-            if ( ( S[i+1][j+1] < 0 ) || ( cost < S[i+1][j+1] ) ) {
-              S[i+1][j+1] = cost;
-              P[i+1][j+1] = 'S';
-              if ( cost < current_best ) {
-                current_best = cost;
-              }
-              if ( current_best == cost ) {
-                cur_last_peak = i + 1 ;
-              }
+              cur_last_peak = i + 1 ;
             }
           }
         }
       }
       cur_last_good = i + 1;
-      if ( j < ( int ) hyp.size() ) {
+      if ( j < hypSize ) {
+        const size_t right = i * width + j + 1;
         icost = score + insert_cost;
-        if ( ( S[i][j+1] < 0 ) || ( S[i][j+1] > icost ) ) {
-          S[i][j+1] = icost;
-          P[i][j+1] = 'I';
+        if ( ( S[right] < 0 ) || ( S[right] > icost ) ) {
+          S[right] = icost;
+          P[right] = 'I';
           if ( ( cur_last_peak <  i ) && ( current_best ==  icost ) ) {
             cur_last_peak = i;
           }
         }
       }
-      if ( i < ( int ) ref.size() ) {
+      if ( i < refSize ) {
+        const size_t down = ( i + 1 ) * width + j;
         dcost =  score + delete_cost;
-        if ( ( S[ i+1][ j] < 0.0 ) || ( S[i+1][j] > dcost ) ) {
-          S[i+1][j] = dcost;
-          P[i+1][j] = 'D';
+        if ( ( S[down] < 0.0 ) || ( S[down] > dcost ) ) {
+          S[down] = dcost;
+          P[down] = 'D';
           if ( i >= last_good ) {
             last_good = i + 1 ;
           }
@@ -548,102 +525,208 @@ terAlignment terCalc::MinEditDist ( vector<string> hyp, vector<string> ref, vect
     }
   }
 
-
   int tracelength = 0;
-  i = ref.size();
-  j = hyp.size();
+  i = refSize;
+  j = hypSize;
   while ( ( i > 0 ) || ( j > 0 ) ) {
     tracelength++;
-    if ( P[i][j] == ' ' ) {
+    const char step = P[i * width + j];
+    if ( step == ' ' || step == 'S' ) {
       i--;
       j--;
-    } else if ( P[i][j] == 'S' ) {
+    } else if ( step == 'D' ) {
       i--;
-      j--;
-    } else if ( P[i][j] == 'D' ) {
-      i--;
-    } else if ( P[i][j] == 'I' ) {
+    } else if ( step == 'I' ) {
       j--;
     } else {
-      cerr << "ERROR : terCalc::MinEditDist : Invalid path : " << P[i][j] << endl;
+      cerr << "ERROR : terCalc::MinEditDist : Invalid path : " << step << endl;
       exit ( -1 );
     }
   }
   vector<char> path ( tracelength );
-  i = ref.size();
-  j = hyp.size();
+  i = refSize;
+  j = hypSize;
   while ( ( i > 0 ) || ( j > 0 ) ) {
-    path[--tracelength] = P[i][j];
-    if ( P[i][j] == ' ' ) {
+    const char step = P[i * width + j];
+    path[--tracelength] = step;
+    if ( step == ' ' || step == 'S' ) {
       i--;
       j--;
-    } else if ( P[i][j] == 'S' ) {
+    } else if ( step == 'D' ) {
       i--;
-      j--;
-    } else if ( P[i][j] == 'D' ) {
-      i--;
-    } else if ( P[i][j] == 'I' ) {
+    } else if ( step == 'I' ) {
       j--;
     }
   }
   terAlignment to_return;
-  to_return.numWords = ref.size();
+  to_return.numWords = refSize;
   to_return.alignment = path;
-  to_return.numEdits = S[ref.size() ][hyp.size() ];
+  to_return.numEdits = S[refSize * width + hypSize];
   if ( PRINT_DEBUG ) {
     cerr << "BEGIN DEBUG : terCalc::MinEditDist : to_return :" << endl << to_return.toString() << endl << "END DEBUG" << endl;
   }
   return to_return;
 
 }
-terAlignment terCalc::TER ( vector<string> hyp, vector<string> ref )
+
+void terCalc::BuildPeq ( const vecInt& ref )
+{
+  refPeq.clear();
+  refBlocks = ( ref.size() + 63 ) / 64;
+  for ( size_t i = 0; i < ref.size(); i++ ) {
+    vector<uint64_t>& peq = refPeq[ref[i]];
+    peq.resize ( refBlocks, 0 );
+    peq[i / 64] |= ( uint64_t ) 1 << ( i % 64 );
+  }
+}
+
+/* Exact Levenshtein distance of hyp and ref with the bit-parallel algorithm
+   of Myers (1999), in blocks of 64 reference words (Hyyro 2003).  The beam
+   search of MinEditDist never finds fewer edits, so this is a lower bound of
+   its result, at a small fraction of its cost.  BuildPeq must have been called
+   for ref. */
+int terCalc::EditDistance ( const vecInt& hyp, const vecInt& ref )
+{
+  const size_t m = ref.size();
+  if ( m == 0 ) {
+    return ( int ) hyp.size();
+  }
+  const uint64_t lastHigh = ( uint64_t ) 1 << ( ( m - 1 ) % 64 );
+  const uint64_t high = ( uint64_t ) 1 << 63;
+  vector<uint64_t> Pv ( refBlocks, ~ ( uint64_t ) 0 );
+  vector<uint64_t> Mv ( refBlocks, 0 );
+  const vector<uint64_t> none ( refBlocks, 0 );
+  int score = ( int ) m;
+  for ( size_t j = 0; j < hyp.size(); j++ ) {
+    boost::unordered_map<int, vector<uint64_t> >::const_iterator found = refPeq.find ( hyp[j] );
+    const vector<uint64_t>& peq = ( found == refPeq.end() ) ? none : found->second;
+    // the first row of the matrix goes up by one in each column
+    int hin = 1;
+    for ( size_t b = 0; b < refBlocks; b++ ) {
+      const uint64_t hinNeg = ( hin < 0 ) ? 1 : 0;
+      uint64_t Eq = peq[b];
+      const uint64_t Xv = Eq | Mv[b];
+      Eq |= hinNeg;
+      const uint64_t Xh = ( ( ( Eq & Pv[b] ) + Pv[b] ) ^ Pv[b] ) | Eq;
+      uint64_t Ph = Mv[b] | ~ ( Xh | Pv[b] );
+      uint64_t Mh = Pv[b] & Xh;
+      const uint64_t top = ( b + 1 == refBlocks ) ? lastHigh : high;
+      int hout = 0;
+      if ( Ph & top ) {
+        hout = 1;
+      }
+      if ( Mh & top ) {
+        hout = -1;
+      }
+      Ph <<= 1;
+      Mh <<= 1;
+      Mh |= hinNeg;
+      Ph |= ( hin > 0 ) ? 1 : 0;
+      Pv[b] = Mh | ~ ( Xv | Ph );
+      Mv[b] = Ph & Xv;
+      hin = hout;
+    }
+    score += hin;
+  }
+  return score;
+}
+
+int terCalc::LevenshteinDistance ( const vector<int>& hyp, const vector<int>& ref )
 {
-  hashMapInfos rloc = BuildWordMatches ( hyp, ref );
-  terAlignment cur_align = MinEditDist ( hyp, ref, hypSpans );
-  vector<string> cur = hyp;
-  cur_align.hyp = hyp;
-  cur_align.ref = ref;
-  cur_align.aftershift = hyp;
+  BuildPeq ( ref );
+  return EditDistance ( hyp, ref );
+}
+
+terAlignment terCalc::ComputeTER ( const vecInt& hyp, const vecInt& ref, vecInt& aftershift,
+                                   vector<vecInt>& shiftedWords, vector<vecInt>& shiftAftershifts )
+{
+  distanceMemo.clear();
+  BuildPeq ( ref );
+  wordMatches rloc = BuildWordMatches ( hyp, ref );
+  terAlignment cur_align = MinEditDist ( hyp, ref );
+  vecInt cur = hyp;
   double edits = 0;
-//         int numshifts = 0;
 
   vector<terShift> allshifts;
 
-//     cerr << "Initial Alignment:" << endl << cur_align.toString() <<endl;
   if ( PRINT_DEBUG ) {
     cerr << "BEGIN DEBUG : terCalc::TER : cur_align :" << endl << cur_align.toString() << endl << "END DEBUG" << endl;
   }
   while ( true ) {
-    bestShiftStruct returns;
-    returns = CalcBestShift ( cur, hyp, ref, rloc, cur_align );
-    if ( returns.m_empty ) {
+    terShift bestShift;
+    terAlignment best_align;
+    vecInt best_words;
+    if ( ! CalcBestShift ( cur, ref, rloc, cur_align, bestShift, best_align, best_words ) ) {
       break;
     }
-    terShift bestShift = returns.m_best_shift;
-    cur_align = returns.m_best_align;
+    cur_align = best_align;
     edits += bestShift.cost;
     bestShift.alignment = cur_align.alignment;
-    bestShift.aftershift = cur_align.aftershift;
     allshifts.push_back ( bestShift );
-    cur = cur_align.aftershift;
+    shiftedWords.push_back ( vecInt ( cur.begin() + bestShift.start, cur.begin() + bestShift.end + 1 ) );
+    shiftAftershifts.push_back ( best_words );
+    cur.swap ( best_words );
   }
   terAlignment to_return;
   to_return = cur_align;
   to_return.allshifts = allshifts;
   to_return.numEdits += edits;
+  aftershift = cur;
   NUM_SEGMENTS_SCORED++;
   return to_return;
 }
-bestShiftStruct terCalc::CalcBestShift ( vector<string> cur, vector<string> hyp, vector<string> ref, hashMapInfos rloc, terAlignment med_align )
+
+terAlignment terCalc::TER ( vector<string> hyp, vector<string> ref )
+{
+  // the search runs on word ids
+  boost::unordered_map<string, int> ids;
+  vector<string> words;
+  vecInt hypIds;
+  vecInt refIds;
+  for ( int pass = 0; pass < 2; pass++ ) {
+    const vector<string>& sentence = ( pass == 0 ) ? hyp : ref;
+    vecInt& sentenceIds = ( pass == 0 ) ? hypIds : refIds;
+    for ( size_t i = 0; i < sentence.size(); i++ ) {
+      boost::unordered_map<string, int>::const_iterator found = ids.find ( sentence[i] );
+      if ( found == ids.end() ) {
+        found = ids.insert ( make_pair ( sentence[i], ( int ) words.size() ) ).first;
+        words.push_back ( sentence[i] );
+      }
+      sentenceIds.push_back ( found->second );
+    }
+  }
+
+  vecInt aftershift;
+  vector<vecInt> shiftedWords;
+  vector<vecInt> shiftAftershifts;
+  terAlignment to_return = ComputeTER ( hypIds, refIds, aftershift, shiftedWords, shiftAftershifts );
+  to_return.hyp = hyp;
+  to_return.ref = ref;
+  for ( size_t i = 0; i < aftershift.size(); i++ ) {
+    to_return.aftershift.push_back ( words[aftershift[i]] );
+  }
+  for ( size_t s = 0; s < to_return.allshifts.size(); s++ ) {
+    terShift& shift = to_return.allshifts[s];
+    for ( size_t i = 0; i < shiftedWords[s].size(); i++ ) {
+      shift.shifted.push_back ( words[shiftedWords[s][i]] );
+    }
+    for ( size_t i = 0; i < shiftAftershifts[s].size(); i++ ) {
+      shift.aftershift.push_back ( words[shiftAftershifts[s][i]] );
+    }
+  }
+  return to_return;
+}
+
+bool terCalc::CalcBestShift ( const vecInt& cur, const vecInt& ref, const wordMatches& rloc, const terAlignment& med_align,
+                              terShift& best_shift, terAlignment& best_align, vecInt& best_words )
 {
-  bestShiftStruct to_return;
   bool anygain = false;
-  bool herr[ ( int ) hyp.size() ];
-  bool rerr[ ( int ) ref.size() ];
-  int ralign[ ( int ) ref.size() ];
+  vector<char> herr ( cur.size() );
+  vector<char> rerr ( ref.size() );
+  vecInt ralign ( ref.size() );
   FindAlignErr ( med_align, herr, rerr, ralign );
   vector<vecTerShift> poss_shifts;
-  poss_shifts = GatherAllPossShifts ( cur, ref, rloc, med_align, herr, rerr, ralign );
+  poss_shifts = GatherAllPossShifts ( cur, rloc, herr, rerr, ralign );
   double curerr = med_align.numEdits;
   if ( PRINT_DEBUG ) {
     cerr << "BEGIN DEBUG : terCalc::CalcBestShift :" << endl;
@@ -659,8 +742,9 @@ bestShiftStruct terCalc::CalcBestShift ( vector<string> cur, vector<string> hyp,
   double cur_best_shift_cost = 0.0;
   terAlignment cur_best_align = med_align;
   terShift cur_best_shift;
-
-
+  vecInt cur_best_words;
+  // each edit of the alignments costs at least this much
+  const double min_edit_cost = std::min ( substitute_cost, std::min ( insert_cost, delete_cost ) );
 
   for ( int i = ( int ) poss_shifts.size() - 1; i >= 0; i-- ) {
     if ( PRINT_DEBUG ) {
@@ -680,63 +764,51 @@ bestShiftStruct terCalc::CalcBestShift ( vector<string> cur, vector<string> hyp,
       if ( ( curfix > maxfix ) || ( ( cur_best_shift_cost != 0 ) && ( curfix == maxfix ) ) ) {
         break;
       }
-      terShift curshift = ( poss_shifts.at ( i ) ).at ( s );
+      const terShift& curshift = ( poss_shifts.at ( i ) ).at ( s );
 
-      alignmentStruct shiftReturns = PerformShift ( cur, curshift );
-      vector<string> shiftarr = shiftReturns.nwords;
-      vector<vecInt> curHypSpans = shiftReturns.aftershift;
+      vecInt shiftarr = PerformShift ( cur, curshift );
 
-      terAlignment curalign = MinEditDist ( shiftarr, ref, curHypSpans );
+      /* The gain cannot be more than with the exact edit distance, so skip
+         the beam search for the shifts which would not be taken anyway. */
+      boost::unordered_map<vecInt, int, boost::hash<vecInt> >::const_iterator memo = distanceMemo.find ( shiftarr );
+      if ( memo == distanceMemo.end() ) {
+        memo = distanceMemo.insert ( make_pair ( shiftarr, EditDistance ( shiftarr, ref ) ) ).first;
+      }
+      double bound = ( cur_best_align.numEdits + cur_best_shift_cost ) - ( memo->second * min_edit_cost + curshift.cost );
+      if ( ! ( ( bound > 0 ) || ( ( cur_best_shift_cost == 0 ) && ( bound == 0 ) ) ) ) {
+        continue;
+      }
 
-      curalign.hyp = hyp;
-      curalign.ref = ref;
-      curalign.aftershift = shiftarr;
+      terAlignment curalign = MinEditDist ( shiftarr, ref );
 
       double gain = ( cur_best_align.numEdits + cur_best_shift_cost ) - ( curalign.numEdits + curshift.cost );
 
-      // 		if (DEBUG) {
-      // 	string testeuh=terAlignment join(" ", shiftarr);
       if ( PRINT_DEBUG ) {
         cerr << "BEGIN DEBUG : terCalc::CalcBestShift :" << endl;
-        cerr << "Gain for " << curshift.toString() << " is " << gain << ". (result: [" << curalign.join ( " ", shiftarr ) << "]" << endl;
-        cerr << "" << curalign.toString() << "\n" << endl;
+        cerr << "Gain for " << terShift ( curshift ).toString() << " is " << gain << "." << endl;
         cerr << "END DEBUG " << endl;
       }
-      // 		}
-      //
       if ( ( gain > 0 ) || ( ( cur_best_shift_cost == 0 ) && ( gain == 0 ) ) ) {
         anygain = true;
         cur_best_shift = curshift;
         cur_best_shift_cost = curshift.cost;
         cur_best_align = curalign;
-        //           if (DEBUG)
-        if ( PRINT_DEBUG ) {
-          cerr << "BEGIN DEBUG : terCalc::CalcBestShift :" << endl;
-          cerr << "Tmp Choosing shift: " << cur_best_shift.toString() << " gives:\n" << cur_best_align.toString()  << "\n" << endl;
-          cerr << "END DEBUG " << endl;
-        }
+        cur_best_words.swap ( shiftarr );
       }
     }
   }
   if ( anygain ) {
-    to_return.m_best_shift = cur_best_shift;
-    to_return.m_best_align = cur_best_align;
-    to_return.m_empty = false;
-  } else {
-    to_return.m_empty = true;
+    best_shift = cur_best_shift;
+    best_align = cur_best_align;
+    best_words.swap ( cur_best_words );
   }
-  return to_return;
+  return anygain;
 }
 
-void terCalc::FindAlignErr ( terAlignment align, bool* herr, bool* rerr, int* ralign )
+void terCalc::FindAlignErr ( const terAlignment& align, vector<char>& herr, vector<char>& rerr, vecInt& ralign )
 {
   int hpos = -1;
   int rpos = -1;
-  if ( PRINT_DEBUG ) {
-
-    cerr << "BEGIN DEBUG : terCalc::FindAlignErr : " << endl << align.toString() << endl;
-    cerr << "END DEBUG " << endl;
-  }
   for ( int i = 0; i < ( int ) align.alignment.size(); i++ ) {
     char sym = align.alignment[i];
     if ( sym == ' ' ) {
@@ -765,36 +837,26 @@ void terCalc::FindAlignErr ( terAlignment align, bool* herr, bool* rerr, int* ra
   }
 }
 
-vector<vecTerShift> terCalc::GatherAllPossShifts ( vector<string> hyp, vector<string> ref, hashMapInfos rloc, terAlignment align, bool* herr, bool* rerr, int* ralign )
+vector<vecTerShift> terCalc::GatherAllPossShifts ( const vecInt& hyp, const wordMatches& rloc,
+    const vector<char>& herr, const vector<char>& rerr, const vecInt& ralign )
 {
-  vector<vecTerShift> to_return;
-  // Don't even bother to look if shifts can't be done
+  vector<vecTerShift> allshifts;
   if ( ( MAX_SHIFT_SIZE <= 0 ) || ( MAX_SHIFT_DIST <= 0 ) ) {
-// 			terShift[][] to_return = new terShift[0][];
-    return to_return;
+    return allshifts;
   }
+  allshifts.resize ( MAX_SHIFT_SIZE + 1 );
 
-  vector<vecTerShift> allshifts ( MAX_SHIFT_SIZE + 1 );
-
-// 		ArrayList[] allshifts = new ArrayList[MAX_SHIFT_SIZE+1];
-// 		for (int i = 0; i < allshifts.length; i++)
-// 		{
-// 			allshifts[i] = new ArrayList();
-// 		}
-
-// 		List hyplist = Arrays.asList(hyp);
+  vecInt cand;
   for ( int start = 0; start < ( int ) hyp.size(); start++ ) {
-    string subVectorHypString = vectorToString ( subVector ( hyp, start, start + 1 ) );
-    if ( ! rloc.trouve ( subVectorHypString ) ) {
+    cand.assign ( 1, hyp[start] );
+    wordMatches::const_iterator found = rloc.find ( cand );
+    if ( found == rloc.end() ) {
       continue;
     }
 
     bool ok = false;
-    vector<int> mtiVec = rloc.getValue ( subVectorHypString );
-    vector<int>::iterator mti = mtiVec.begin();
-    while ( mti != mtiVec.end() && ( ! ok ) ) {
+    for ( vecInt::const_iterator mti = found->second.begin(); mti != found->second.end() && ( ! ok ); mti++ ) {
       int moveto = ( *mti );
-      mti++;
       if ( ( start != ralign[moveto] ) && ( ( ralign[moveto] - start ) <= MAX_SHIFT_DIST ) && ( ( start - ralign[moveto] - 1 ) <= MAX_SHIFT_DIST ) ) {
         ok = true;
       }
@@ -803,16 +865,17 @@ vector<vecTerShift> terCalc::GatherAllPossShifts ( vector<string> hyp, vector<st
       continue;
     }
     ok = true;
+    cand.clear();
     for ( int end = start; ( ok && ( end < ( int ) hyp.size() ) && ( end < start + MAX_SHIFT_SIZE ) ); end++ ) {
       /* check if cand is good if so, add it */
-      vector<string> cand = subVector ( hyp, start, end + 1 );
+      cand.push_back ( hyp[end] );
       ok = false;
-      if ( ! ( rloc.trouve ( vectorToString ( cand ) ) ) ) {
+      found = rloc.find ( cand );
+      if ( found == rloc.end() ) {
         continue;
       }
 
       bool any_herr = false;
-
       for ( int i = 0; ( ( i <= ( end - start ) ) && ( ! any_herr ) ); i++ ) {
         if ( herr[start+i] ) {
           any_herr = true;
@@ -823,12 +886,8 @@ vector<vecTerShift> terCalc::GatherAllPossShifts ( vector<string> hyp, vector<st
         continue;
       }
 
-      vector<int> movetoitVec;
-      movetoitVec = rloc.getValue ( ( string ) vectorToString ( cand ) );
-      vector<int>::iterator movetoit = movetoitVec.begin();
-      while ( movetoit != movetoitVec.end() ) {
+      for ( vecInt::const_iterator movetoit = found->second.begin(); movetoit != found->second.end(); movetoit++ ) {
         int moveto = ( *movetoit );
-        movetoit++;
         if ( ! ( ( ralign[moveto] != start ) && ( ( ralign[moveto] < start ) || ( ralign[moveto] > end ) ) && ( ( ralign[moveto] - start ) <= MAX_SHIFT_DIST ) && ( ( start - ralign[moveto] ) <= MAX_SHIFT_DIST ) ) ) {
           continue;
         }
@@ -848,184 +907,54 @@ vector<vecTerShift> terCalc::GatherAllPossShifts ( vector<string> hyp, vector<st
           continue;
         }
         for ( int roff = -1; roff <= ( end - start ); roff++ ) {
-          terShift topush;
-          bool topushNull = true;
           if ( ( roff == -1 ) && ( moveto == 0 ) ) {
-            if ( PRINT_DEBUG ) {
-
-              cerr << "BEGIN DEBUG : terCalc::GatherAllPossShifts 01 : " << endl << "Consider making " << start << "..." << end << " moveto: " << moveto << " roff: " << roff << " ralign[mt+roff]: -1" << endl << "END DEBUG" << endl;
-            }
-            terShift t01 ( start, end, -1, -1 );
-            topush = t01;
-            topushNull = false;
+            allshifts[end - start].push_back ( terShift ( start, end, -1, -1 ) );
           } else if ( ( start != ralign[moveto+roff] ) && ( ( roff == 0 ) || ( ralign[moveto+roff] != ralign[moveto] ) ) ) {
-            int newloc = ralign[moveto+roff];
-            if ( PRINT_DEBUG ) {
-
-              cerr << "BEGIN DEBUG : terCalc::GatherAllPossShifts 02 : " << endl << "Consider making " << start << "..." << end << " moveto: " << moveto << " roff: " << roff << " ralign[mt+roff]: " << newloc << endl << "END DEBUG" << endl;
-            }
-            terShift t02 ( start, end, moveto + roff, newloc );
-            topush = t02;
-            topushNull = false;
-          }
-          if ( !topushNull ) {
-            topush.shifted = cand;
-            topush.cost  = shift_cost;
-            if ( PRINT_DEBUG ) {
-
-              cerr << "BEGIN DEBUG : terCalc::GatherAllPossShifts 02 : " << endl;
-              cerr << "start : " << start << endl;
-              cerr << "end : " << end << endl;
-              cerr << "end - start : " << end - start << endl;
-              cerr << "END DEBUG " << endl;
-            }
-            ( allshifts.at ( end - start ) ).push_back ( topush );
+            allshifts[end - start].push_back ( terShift ( start, end, moveto + roff, ralign[moveto+roff] ) );
+          } else {
+            continue;
           }
+          allshifts[end - start].back().cost = shift_cost;
         }
       }
     }
   }
-// 		vector<vecTerShift> to_return;
-  to_return.clear();
-// 		terShift[][] to_return = new terShift[MAX_SHIFT_SIZE+1][];
-  for ( int i = 0; i < MAX_SHIFT_SIZE + 1; i++ ) {
-// 		to_return[i] = (terShift[]) allshifts[i].toArray(new terShift[0]);
-    to_return.push_back ( ( vecTerShift ) allshifts.at ( i ) );
-  }
-  return to_return;
+  return allshifts;
 }
 
 
-alignmentStruct terCalc::PerformShift ( vector<string> words, terShift s )
+vecInt terCalc::PerformShift ( const vecInt& words, const terShift& s )
 {
-  return PerformShift ( words, s.start, s.end, s.newloc );
-}
-
-
-alignmentStruct terCalc::PerformShift ( vector<string> words, int start, int end, int newloc )
-{
-  int c = 0;
-  vector<string> nwords ( words );
-  vector<vecInt> spans ( ( int ) hypSpans.size() );
-  alignmentStruct toreturn;
-// ON EST ICI
-// 		if((int)hypSpans.size()>0) spans = new TERintpair[(int)hypSpans.size()];
-// 		if(DEBUG) {
-  if ( PRINT_DEBUG ) {
-
-    if ( ( int ) hypSpans.size() > 0 ) {
-      cerr << "BEGIN DEBUG : terCalc::PerformShift :" << endl << "word length: " << ( int ) words.size() << " span length: " << ( int ) hypSpans.size() << endl << "END DEBUG " << endl;
-    } else {
-      cerr << "BEGIN DEBUG : terCalc::PerformShift :" << endl << "word length: " << ( int ) words.size() << " span length: null" << endl << "END DEBUG " << endl;
-    }
-  }
-// 		}
+  const int start = s.start;
+  const int end = s.end;
+  const int newloc = s.newloc;
+  vecInt nwords;
+  nwords.reserve ( words.size() );
 
   if ( newloc == -1 ) {
-    for ( int i = start; i <= end; i++ ) {
-      nwords.at ( c++ ) = words.at ( i );
-      if ( ( int ) hypSpans.size() > 0 ) {
-        spans.at ( c - 1 ) = hypSpans.at ( i );
-      }
-    }
-    for ( int i = 0; i <= start - 1; i++ ) {
-      nwords.at ( c++ ) = words.at ( i );
-      if ( ( int ) hypSpans.size() > 0 ) {
-        spans.at ( c - 1 ) = hypSpans.at ( i );
-      }
-    }
-    for ( int i = end + 1; i < ( int ) words.size(); i++ ) {
-      nwords.at ( c++ ) = words.at ( i );
-      if ( ( int ) hypSpans.size() > 0 ) {
-        spans.at ( c - 1 ) = hypSpans.at ( i );
-      }
-    }
+    nwords.insert ( nwords.end(), words.begin() + start, words.begin() + end + 1 );
+    nwords.insert ( nwords.end(), words.begin(), words.begin() + start );
+    nwords.insert ( nwords.end(), words.begin() + end + 1, words.end() );
+  } else if ( newloc < start ) {
+    nwords.insert ( nwords.end(), words.begin(), words.begin() + newloc + 1 );
+    nwords.insert ( nwords.end(), words.begin() + start, words.begin() + end + 1 );
+    nwords.insert ( nwords.end(), words.begin() + newloc + 1, words.begin() + start );
+    nwords.insert ( nwords.end(), words.begin() + end + 1, words.end() );
+  } else if ( newloc > end ) {
+    nwords.insert ( nwords.end(), words.begin(), words.begin() + start );
+    nwords.insert ( nwords.end(), words.begin() + end + 1, words.begin() + newloc + 1 );
+    nwords.insert ( nwords.end(), words.begin() + start, words.begin() + end + 1 );
+    nwords.insert ( nwords.end(), words.begin() + newloc + 1, words.end() );
   } else {
-    if ( newloc < start ) {
-      for ( int i = 0; i <= newloc; i++ ) {
-        nwords.at ( c++ ) = words.at ( i );
-        if ( ( int ) hypSpans.size() > 0 ) {
-          spans.at ( c - 1 ) = hypSpans.at ( i );
-        }
-      }
-      for ( int i = start; i <= end; i++ ) {
-        nwords.at ( c++ ) = words.at ( i );
-        if ( ( int ) hypSpans.size() > 0 ) {
-          spans.at ( c - 1 ) = hypSpans.at ( i );
-        }
-      }
-      for ( int i = newloc + 1; i <= start - 1; i++ ) {
-        nwords.at ( c++ ) = words.at ( i );
-        if ( ( int ) hypSpans.size() > 0 ) {
-          spans.at ( c - 1 ) = hypSpans.at ( i );
-        }
-      }
-      for ( int i = end + 1; i < ( int ) words.size(); i++ ) {
-        nwords.at ( c++ ) = words.at ( i );
-        if ( ( int ) hypSpans.size() > 0 ) {
-          spans.at ( c - 1 ) = hypSpans.at ( i );
-        }
-      }
-    } else {
-      if ( newloc > end ) {
-        for ( int i = 0; i <= start - 1; i++ ) {
-          nwords.at ( c++ ) = words.at ( i );
-          if ( ( int ) hypSpans.size() > 0 ) {
-            spans.at ( c - 1 ) = hypSpans.at ( i );
-          }
-        }
-        for ( int i = end + 1; i <= newloc; i++ ) {
-          nwords.at ( c++ ) = words.at ( i );
-          if ( ( int ) hypSpans.size() > 0 ) {
-            spans.at ( c - 1 ) = hypSpans.at ( i );
-          }
-        }
-        for ( int i = start; i <= end; i++ ) {
-          nwords.at ( c++ ) = words.at ( i );
-          if ( ( int ) hypSpans.size() > 0 ) {
-            spans.at ( c - 1 ) = hypSpans.at ( i );
-          }
-        }
-        for ( int i = newloc + 1; i < ( int ) words.size(); i++ ) {
-          nwords.at ( c++ ) = words.at ( i );
-          if ( ( int ) hypSpans.size() > 0 ) {
-            spans.at ( c - 1 ) = hypSpans.at ( i );
-          }
-        }
-      } else {
-        // we are moving inside of ourselves
-        for ( int i = 0; i <= start - 1; i++ ) {
-          nwords.at ( c++ ) = words.at ( i );
-          if ( ( int ) hypSpans.size() > 0 ) {
-            spans.at ( c - 1 ) = hypSpans.at ( i );
-          }
-        }
-        for ( int i = end + 1; ( i < ( int ) words.size() ) && ( i <= ( end + ( newloc - start ) ) ); i++ ) {
-          nwords.at ( c++ ) = words.at ( i );
-          if ( ( int ) hypSpans.size() > 0 ) {
-            spans.at ( c - 1 ) = hypSpans.at ( i );
-          }
-        }
-        for ( int i = start; i <= end; i++ ) {
-          nwords.at ( c++ ) = words.at ( i );
-          if ( ( int ) hypSpans.size() > 0 ) {
-            spans.at ( c - 1 ) = hypSpans.at ( i );
-          }
-        }
-        for ( int i = ( end + ( newloc - start ) + 1 ); i < ( int ) words.size(); i++ ) {
-          nwords.at ( c++ ) = words.at ( i );
-          if ( ( int ) hypSpans.size() > 0 ) {
-            spans.at ( c - 1 ) = hypSpans.at ( i );
-          }
-        }
-      }
-    }
+    // move inside the shifted words, as far as the end of the sentence
+    const int middle = std::min ( ( int ) words.size(), end + ( newloc - start ) + 1 );
+    nwords.insert ( nwords.end(), words.begin(), words.begin() + start );
+    nwords.insert ( nwords.end(), words.begin() + end + 1, words.begin() + std::max ( end + 1, middle ) );
+    nwords.insert ( nwords.end(), words.begin() + start, words.begin() + end + 1 );
+    nwords.insert ( nwords.end(), words.begin() + std::max ( end + 1, middle ), words.end() );
   }
   NUM_SHIFTS_CONSIDERED++;
-
-  toreturn.nwords = nwords;
-  toreturn.aftershift = spans;
-  return toreturn;
+  return nwords;
 }
 void terCalc::setDebugMode ( bool b )
 {
@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <sstream>
+#include <stdint.h>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 #include "hashMap.h"
 #include "hashMapInfos.h"
 #include "hashMapStringInfos.h"
@@ -40,13 +43,33 @@ private :
   int MAX_SHIFT_DIST;
   bool PRINT_DEBUG;
 
-  /* These are resized by the MIN_EDIT_DIST code if they aren't big enough */
-  double S[1000][1000];
-  char P[1000][1000];
-  vector<vecInt> refSpans;
-  vector<vecInt> hypSpans;
+  /* Cost and path matrices of MinEditDist, grown as needed */
+  vector<double> S;
+  vector<char> P;
   int BEAM_WIDTH;
 
+  /* Positions in the reference of each of its n-grams, up to MAX_SHIFT_SIZE+1 words */
+  typedef boost::unordered_map<vecInt, vecInt, boost::hash<vecInt> > wordMatches;
+  /* Bit vectors of the positions of each reference word, in blocks of 64, for the
+     bit-parallel edit distance */
+  boost::unordered_map<int, vector<uint64_t> > refPeq;
+  size_t refBlocks;
+  /* Edit distances of the shifted hypotheses seen so far, for the current reference */
+  boost::unordered_map<vecInt, int, boost::hash<vecInt> > distanceMemo;
+
+  terAlignment ComputeTER ( const vecInt& hyp, const vecInt& ref, vecInt& aftershift,
+                            vector<vecInt>& shiftedWords, vector<vecInt>& shiftAftershifts );
+  wordMatches BuildWordMatches ( const vecInt& hyp, const vecInt& ref );
+  terAlignment MinEditDist ( const vecInt& hyp, const vecInt& ref );
+  void BuildPeq ( const vecInt& ref );
+  int EditDistance ( const vecInt& hyp, const vecInt& ref );
+  bool CalcBestShift ( const vecInt& cur, const vecInt& ref, const wordMatches& rloc, const terAlignment& med_align,
+                       terShift& best_shift, terAlignment& best_align, vecInt& best_words );
+  void FindAlignErr ( const terAlignment& align, vector<char>& herr, vector<char>& rerr, vecInt& ralign );
+  vector<vecTerShift> GatherAllPossShifts ( const vecInt& hyp, const wordMatches& rloc,
+      const vector<char>& herr, const vector<char>& rerr, const vecInt& ralign );
+  vecInt PerformShift ( const vecInt& words, const terShift& s );
+
 public:
   int shift_cost;
   int insert_cost;
@@ -64,17 +87,14 @@ public:
   int WERCalculation ( vector<int> ref, vector<int> hyp );
 // 	string vectorToString(vector<string> vec);
 // 	vector<string> subVector(vector<string> vec, int start, int end);
-  hashMapInfos BuildWordMatches ( vector<string> hyp, vector<string> ref );
-  terAlignment MinEditDist ( vector<string> hyp, vector<string> ref, vector<vecInt> curHypSpans );
   bool spanIntersection ( vecInt refSpan, vecInt hypSpan );
-  terAlignment TER ( vector<string> hyp, vector<string> ref , float avRefLength );
   terAlignment TER ( vector<string> hyp, vector<string> ref );
+  /* Words are given as ids; the words of the returned alignment are left empty.
+     An empty sentence counts as a single empty word, as it always did. */
   terAlignment TER ( vector<int> hyp, vector<int> ref );
-  bestShiftStruct CalcBestShift ( vector<string> cur, vector<string> hyp, vector<string> ref, hashMapInfos rloc, terAlignment cur_align );
-  void FindAlignErr ( terAlignment align, bool* herr, bool* rerr, int* ralign );
-  vector<vecTerShift> GatherAllPossShifts ( vector<string> hyp, vector<string> ref, hashMapInfos rloc, terAlignment align, bool* herr, bool* rerr, int* ralign );
-  alignmentStruct PerformShift ( vector<string> words, terShift s );
-  alignmentStruct PerformShift ( vector<string> words, int start, int end, int newloc );
+  /* Levenshtein distance of two sentences of word ids, computed as the bound
+     of the shift search is */
+  int LevenshteinDistance ( const vector<int>& hyp, const vector<int>& ref );
 };
 
 }
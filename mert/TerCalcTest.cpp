@@ -0,0 +1,138 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "TERsrc/tercalc.h"
+
+#define BOOST_TEST_MODULE MertTerCalc
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace TERCpp;
+
+namespace {
+
+// the full dynamic programme, without the beam of MinEditDist
+int Levenshtein(const vector<int>& hyp, const vector<int>& ref) {
+  vector<int> previous(ref.size() + 1), current(ref.size() + 1);
+  for (size_t j = 0; j <= ref.size(); ++j) previous[j] = j;
+  for (size_t i = 1; i <= hyp.size(); ++i) {
+    current[0] = i;
+    for (size_t j = 1; j <= ref.size(); ++j) {
+      current[j] = min(min(previous[j] + 1, current[j - 1] + 1),
+                       previous[j - 1] + (hyp[i - 1] == ref[j - 1] ? 0 : 1));
+    }
+    previous.swap(current);
+  }
+  return previous[ref.size()];
+}
+
+vector<int> RandomSentence(size_t length, int vocab) {
+  vector<int> sentence(length);
+  for (size_t i = 0; i < length; ++i) sentence[i] = rand() % vocab;
+  return sentence;
+}
+
+vector<string> Words(const string& text) {
+  vector<string> words;
+  string::size_type start = 0;
+  while (start < text.size()) {
+    string::size_type end = text.find(' ', start);
+    if (end == string::npos) end = text.size();
+    words.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+  return words;
+}
+
+BOOST_AUTO_TEST_CASE(BitParallelMatchesDynamicProgramme) {
+  srand(1);
+  terCalc calc;
+  // lengths on both sides of the 64 word blocks, small vocabularies for many matches
+  const size_t lengths[] = {0, 1, 2, 7, 63, 64, 65, 100, 128, 129, 200};
+  const size_t numLengths = sizeof(lengths) / sizeof(lengths[0]);
+  for (size_t h = 0; h < numLengths; ++h) {
+    for (size_t r = 0; r < numLengths; ++r) {
+      for (int vocab = 2; vocab <= 32; vocab *= 4) {
+        const vector<int> hyp = RandomSentence(lengths[h], vocab);
+        const vector<int> ref = RandomSentence(lengths[r], vocab);
+        BOOST_REQUIRE_EQUAL(Levenshtein(hyp, ref), calc.LevenshteinDistance(hyp, ref));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(BitParallelOnSimilarSentences) {
+  srand(2);
+  terCalc calc;
+  for (size_t step = 0; step < 200; ++step) {
+    const vector<int> ref = RandomSentence(1 + rand() % 150, 50);
+    vector<int> hyp = ref;
+    for (int edits = rand() % 10; edits > 0; --edits) {
+      const size_t pos = rand() % (hyp.size() + 1);
+      switch (rand() % 3) {
+      case 0:
+        hyp.insert(hyp.begin() + pos, rand() % 50);
+        break;
+      case 1:
+        if (pos < hyp.size()) hyp.erase(hyp.begin() + pos);
+        break;
+      default:
+        if (pos < hyp.size()) hyp[pos] = rand() % 50;
+      }
+    }
+    BOOST_REQUIRE_EQUAL(Levenshtein(hyp, ref), calc.LevenshteinDistance(hyp, ref));
+  }
+}
+
+// TER never counts more edits than the edit distance, and the string and id
+// versions agree
+BOOST_AUTO_TEST_CASE(ShiftsOnlyHelp) {
+  srand(3);
+  terCalc calc;
+  for (size_t step = 0; step < 100; ++step) {
+    const vector<int> hyp = RandomSentence(1 + rand() % 30, 8);
+    const vector<int> ref = RandomSentence(1 + rand() % 30, 8);
+    const terAlignment ids = calc.TER(hyp, ref);
+    BOOST_CHECK_LE(ids.numEdits, Levenshtein(hyp, ref));
+    BOOST_CHECK_EQUAL(ref.size(), ids.numWords);
+
+    vector<string> hypWords, refWords;
+    for (size_t i = 0; i < hyp.size(); ++i) hypWords.push_back(string(1, 'a' + hyp[i]));
+    for (size_t i = 0; i < ref.size(); ++i) refWords.push_back(string(1, 'a' + ref[i]));
+    BOOST_CHECK_EQUAL(ids.numEdits, calc.TER(hypWords, refWords).numEdits);
+  }
+}
+
+// the example of Snover et al. (2006): one shift, two substitutions, one insertion
+BOOST_AUTO_TEST_CASE(PaperExample) {
+  terCalc calc;
+  const terAlignment result = calc.TER(
+    Words("SAUDI ARABIA denied THIS WEEK information published in the AMERICAN new york times"),
+    Words("THIS WEEK THE SAUDIS denied information published in the new york times"));
+  BOOST_CHECK_EQUAL(4, result.numEdits);
+  BOOST_CHECK_EQUAL(12, result.numWords);
+  BOOST_CHECK_EQUAL(1u, result.allshifts.size());
+}
+
+}
@@ -75,9 +75,9 @@ void TerScorer::prepareStats ( size_t sid, const string& text, ScoreStats& entry
     }
     averageLength=averageLength/( double ) m_multi_references.size();
     encode ( text, testtokens );
-    terCalc * evaluation=new terCalc();
-    evaluation->setDebugMode ( false );
-    terAlignment tmp_result = evaluation->TER ( reftokens, testtokens );
+    terCalc evaluation;
+    evaluation.setDebugMode ( false );
+    terAlignment tmp_result = evaluation.TER ( testtokens, reftokens );
     tmp_result.averageWords=averageLength;
     if ( ( result.numEdits == 0.0 ) && ( result.averageWords == 0.0 ) ) {
       result = tmp_result;
@@ -0,0 +1,149 @@
+/**
+ * Convert feature and score data files between the text format and the
+ * binary format mapped by mert and pro.  The kind of data is detected from
+ * the input file.
+ **/
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <getopt.h>
+
+#include "BinaryData.h"
+#include "FeatureArray.h"
+#include "FileStream.h"
+#include "ScoreArray.h"
+
+using namespace std;
+
+namespace {
+
+void usage()
+{
+  cerr << "usage: convertdata [options] input output" << endl;
+  cerr << "[--text|-t] write text instead of binary data" << endl;
+  cerr << "[--append|-a] append to the output file instead of replacing it" << endl;
+  cerr << "[--help|-h] print this message and exit" << endl;
+  exit(1);
+}
+
+static struct option long_options[] = {
+  {"text", no_argument, 0, 't'},
+  {"append", no_argument, 0, 'a'},
+  {"help", no_argument, 0, 'h'},
+  {0, 0, 0, 0}
+};
+
+void binaryToText(const string& input, const string& output, bool append)
+{
+  BinaryDataFile data(input);
+  ofstream out(output.c_str(), append ? ios::app : ios::out);
+  if (!out) {
+    throw runtime_error("Unable to open " + output);
+  }
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (data.kind() == BINARY_FEATURES) {
+      FeatureArray entry;
+      data.get(i, entry);
+      entry.savetxt(out);
+    } else {
+      ScoreArray entry;
+      data.get(i, entry);
+      entry.savetxt(out, entry.name());
+    }
+  }
+}
+
+string description(const FeatureArray& entry)
+{
+  return entry.Features();
+}
+
+string description(const ScoreArray& entry)
+{
+  return entry.name();
+}
+
+template <class Array>
+void textToBinary(ifstream& in, BinaryDataKind kind, const string& output, bool append)
+{
+  BinaryDataWriter* writer = NULL;
+  Array entry;
+  while (true) {
+    entry.clear();
+    entry.load(in);
+    if (entry.size() == 0) break;
+    if (!writer) {
+      writer = new BinaryDataWriter(kind, description(entry));
+    }
+    writer->add(entry);
+  }
+  if (writer) {
+    writer->write(output, append);
+    delete writer;
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  bool text = false;
+  bool append = false;
+  int c;
+  int option_index;
+  while ((c = getopt_long(argc, argv, "tah", long_options, &option_index)) != -1) {
+    switch (c) {
+      case 't':
+        text = true;
+        break;
+      case 'a':
+        append = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (argc - optind != 2) {
+    usage();
+  }
+  const string input(argv[optind]);
+  const string output(argv[optind + 1]);
+
+  try {
+    if (IsBinaryDataFile(input)) {
+      if (!text) {
+        throw runtime_error(input + " is already binary");
+      }
+      binaryToText(input, output, append);
+      return 0;
+    }
+    if (text) {
+      throw runtime_error(input + " is already text");
+    }
+
+    inputfilestream in(input);
+    if (!in) {
+      throw runtime_error("Unable to open " + input);
+    }
+    string header;
+    getline(in, header);
+    in.close();
+
+    inputfilestream data(input);
+    if (header.find(FEATURES_TXT_BEGIN) == 0) {
+      textToBinary<FeatureArray>((ifstream&) data, BINARY_FEATURES, output, append);
+    } else if (header.find(SCORES_TXT_BEGIN) == 0) {
+      textToBinary<ScoreArray>((ifstream&) data, BINARY_SCORES, output, append);
+    } else {
+      throw runtime_error(input + " is neither feature nor score data");
+    }
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -4,7 +4,9 @@
  * Developed during the 2nd MT marathon.
  **/
 
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -13,6 +15,7 @@
 #include "Data.h"
 #include "Scorer.h"
 #include "ScorerFactory.h"
+#include "ScoreStatsCache.h"
 #include "Timer.h"
 #include "Util.h"
 
@@ -26,11 +29,16 @@ void usage()
   cerr<<"\tThis is of the form NAME1:VAL1,NAME2:VAL2 etc "<<endl;
   cerr<<"[--reference|-r] comma separated list of reference files"<<endl;
   cerr<<"[--binary|-b] use binary output format (default to text )"<<endl;
+  cerr<<"[--append|-a] append to the output files instead of replacing them"<<endl;
   cerr<<"[--nbest|-n] the nbest file"<<endl;
   cerr<<"[--scfile|-S] the scorer data output file"<<endl;
   cerr<<"[--ffile|-F] the feature data output file"<<endl;
   cerr<<"[--prev-ffile|-E] comma separated list of previous feature data" <<endl;
   cerr<<"[--prev-scfile|-R] comma separated list of previous scorer data"<<endl;
+  cerr<<"[--stats-cache|-C] file caching the score statistics of candidates between runs"<<endl;
+#ifdef WITH_THREADS
+  cerr<<"[--threads|-T] score the nbest with multiple threads (default 1)"<<endl;
+#endif
   cerr<<"[-v] verbose level"<<endl;
   cerr<<"[--help|-h] print this message and exit"<<endl;
   exit(1);
@@ -42,17 +50,39 @@ static struct option long_options[] = {
   {"scconfig",required_argument,0,'c'},
   {"reference",required_argument,0,'r'},
   {"binary",no_argument,0,'b'},
+  {"append",no_argument,0,'a'},
   {"nbest",required_argument,0,'n'},
   {"scfile",required_argument,0,'S'},
   {"ffile",required_argument,0,'F'},
   {"prev-scfile",required_argument,0,'R'},
   {"prev-ffile",required_argument,0,'E'},
+  {"stats-cache",required_argument,0,'C'},
+#ifdef WITH_THREADS
+  {"threads",required_argument,0,'T'},
+#endif
   {"verbose",required_argument,0,'v'},
   {"help",no_argument,0,'h'},
   {0, 0, 0, 0}
 };
 int option_index;
 
+/**
+ * Signature of the statistics computed by the scorer: its type, its
+ * configuration and the contents of the references.
+ */
+static uint64_t statsSignature(const string& type, const string& config,
+                               const vector<string>& referenceFiles)
+{
+  uint64_t signature = ScoreStatsCache::hash(type);
+  signature = ScoreStatsCache::hash(config, signature);
+  for (size_t i = 0; i < referenceFiles.size(); ++i) {
+    ifstream in(referenceFiles[i].c_str(), ios::in | ios::binary);
+    const string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    signature = ScoreStatsCache::hash(contents, signature);
+  }
+  return signature;
+}
+
 int main(int argc, char** argv)
 {
 
@@ -73,10 +103,13 @@ int main(int argc, char** argv)
   string featureDataFile("features.data");
   string prevScoreDataFile("");
   string prevFeatureDataFile("");
+  string statsCacheFile("");
+  size_t threads = 1;
   bool binmode = false;
+  bool appendmode = false;
   int verbosity = 0;
   int c;
-  while ((c=getopt_long (argc,argv, "s:r:n:S:F:R:E:v:hb", long_options, &option_index)) != -1) {
+  while ((c=getopt_long (argc,argv, "s:c:r:n:S:F:R:E:C:T:v:hba", long_options, &option_index)) != -1) {
     switch(c) {
       case 's':
         scorerType = string(optarg);
@@ -90,6 +123,9 @@ int main(int argc, char** argv)
       case 'b':
         binmode = true;
         break;
+      case 'a':
+        appendmode = true;
+        break;
       case 'n':
         nbestFile = string(optarg);
         break;
@@ -105,6 +141,15 @@ int main(int argc, char** argv)
       case 'R':
         prevScoreDataFile = string(optarg);
         break;
+      case 'C':
+        statsCacheFile = string(optarg);
+        break;
+#ifdef WITH_THREADS
+      case 'T':
+        threads = strtol(optarg, NULL, 10);
+        if (threads < 1) threads = 1;
+        break;
+#endif
       case 'v':
         verbosity = atoi(optarg);
         break;
@@ -175,9 +220,23 @@ int main(int argc, char** argv)
 
     PrintUserTime("Previous data loaded");
 
+    // statistics of candidates scored in earlier runs
+    ScoreStatsCache statsCache(statsSignature(scorerType, scorerConfig, referenceFiles));
+    StatisticsBasedScorer* statsScorer = dynamic_cast<StatisticsBasedScorer*>(scorer);
+    if (!statsCacheFile.empty() && statsScorer) {
+      size_t cached = statsCache.load(statsCacheFile);
+      cerr << "Loaded " << cached << " cached score statistics" << endl;
+      statsScorer->setStatsCache(&statsCache);
+    }
+
     // computing score statistics of each nbest file
     for (size_t i=0; i < nbestFiles.size(); i++) {
-      data.loadnbest(nbestFiles.at(i));
+      data.loadnbest(nbestFiles.at(i), threads);
+    }
+
+    if (!statsCacheFile.empty() && statsScorer && !nbestFiles.empty()) {
+      statsScorer->setStatsCache(NULL);
+      statsCache.save(statsCacheFile);
     }
 
     PrintUserTime("Nbest entries loaded and scored");
@@ -191,7 +250,7 @@ int main(int argc, char** argv)
     else
       cerr << "Binary write mode is NOT selected" << endl;
 
-    data.save(featureDataFile, scoreDataFile, binmode);
+    data.save(featureDataFile, scoreDataFile, binmode, appendmode);
     PrintUserTime("Stopping...");
 
     // timer.stop("Stopping...");
@@ -2,6 +2,7 @@
  * \description This is the main for the new version of the mert algorithm developed during the 2nd MT marathon
 */
 
+#include <algorithm>
 #include <limits>
 #include <unistd.h>
 #include <cstdlib>
@@ -370,6 +371,12 @@ int main (int argc, char **argv)
     allTasks.resize(shard_count);
   }
 
+  // threads not needed for the starting points speed up the line search
+  size_t line_search_threads = 1;
+#ifdef WITH_THREADS
+  line_search_threads = std::max<size_t>(1, threads / (allTasks.size() * startingPoints.size()));
+#endif
+
   // launch tasks
   for (size_t i = 0 ; i < allTasks.size(); ++i) {
     Data& data = D;
@@ -378,6 +385,7 @@ int main (int argc, char **argv)
     Optimizer *O = OptimizerFactory::BuildOptimizer(pdim,tooptimize,start_list[0],type,nrandom);
     O->SetScorer(data.getScorer());
     O->SetFData(data.getFeatureData());
+    O->SetLineSearchThreads(line_search_threads);
     //A task for each start point
     for (size_t j = 0; j < startingPoints.size(); ++j) {
       OptimizationTask* task = new OptimizationTask(O, startingPoints[j]);
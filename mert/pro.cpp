@@ -23,21 +23,37 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 /** 
   * This is part of the PRO implementation. It converts the features and scores 
-  * files into a form suitable for input into the megam maxent trainer.
+  * files into a form suitable for input into the megam maxent trainer, or
+  * trains the classifier itself (--train).
+  *
+  * Sentences are sampled in batches on several threads.  Every sentence
+  * draws from its own random number generator, seeded from the random seed
+  * and the sentence number, so the pairs only depend on the seed.
   *
   *   For details of PRO, refer to Hopkins & May (EMNLP 2011)
  **/
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdlib>
 #include <ctime>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
 #include <boost/program_options.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
+#include "util/murmur_hash.hh"
 
 #include "FeatureDataIterator.h"
+#include "LogisticRegression.h"
+#include "PairBuffer.h"
 #include "ScoreDataIterator.h"
 
 using namespace std;
@@ -84,20 +100,74 @@ static float sentenceLevelBleuPlusOne(const vector<float>& stats) {
 	return exp(logbleu);
 }
 
-static void outputSample(ostream& out, const FeatureDataItem& f1, const FeatureDataItem& f2) {
-  // difference in score in regular features
-	for(unsigned int j=0; j<f1.dense.size(); j++)
-		if (abs(f1.dense[j]-f2.dense[j]) > 0.00001)
-			out << " F" << j << " " << (f1.dense[j]-f2.dense[j]);
+//TODO: options
+static const unsigned int n_candidates = 5000; // Gamma, in Hopkins & May
+static const unsigned int n_samples = 50; // Xi, in Hopkins & May
+static const float min_diff = 0.05;
+
+// n-best lists of one sentence from all files, and the pairs sampled from them
+struct Sentence {
+  size_t id;
+  vector<vector<FeatureDataItem> > features;
+  vector<vector<ScoreDataItem> > scores;
+  PairBuffer pairs;
+};
+
+static void samplePairs(Sentence& sentence, uint32_t seed) {
+  vector<pair<size_t,size_t> > hypotheses;
+  //TODO: de-deuping. Collect hashes of score,feature pairs and 
+  //only add index if it's unique.
+  for (size_t i = 0; i < sentence.features.size(); ++i) {
+    for (size_t j = 0; j < sentence.features[i].size(); ++j) {
+      hypotheses.push_back(pair<size_t,size_t>(i,j));
+    }
+  }
+  if (hypotheses.empty()) return;
+
+  const uint64_t key[2] = {seed, sentence.id};
+  boost::mt19937 rng(static_cast<uint32_t>(util::MurmurHashNative(key, sizeof(key))));
 
-  if (f1.sparse.size() || f2.sparse.size()) {
-    out << " ";
+  //collect the candidates
+  vector<SampledPair> samples;
+  vector<float> scores;
+  size_t n_translations = hypotheses.size();
+  for(size_t  i=0; i<n_candidates; i++) {
+    size_t rand1 = rng() % n_translations;
+    pair<size_t,size_t> translation1 = hypotheses[rand1];
+    float bleu1 = sentenceLevelBleuPlusOne(sentence.scores[translation1.first][translation1.second]);
 
-    // sparse features
-    const SparseVector &s1 = f1.sparse;
-    const SparseVector &s2 = f2.sparse;
-    SparseVector diff = s1 - s2;
-    diff.write(out);
+    size_t rand2 = rng() % n_translations;
+    pair<size_t,size_t> translation2 = hypotheses[rand2];
+    float bleu2 = sentenceLevelBleuPlusOne(sentence.scores[translation2.first][translation2.second]);
+
+    if (abs(bleu1-bleu2) < min_diff)
+      continue;
+
+    samples.push_back(SampledPair(translation1, translation2, bleu1-bleu2));
+    scores.push_back(1.0-abs(bleu1-bleu2));
+  }
+
+  float sample_threshold = -1.0;
+  if (samples.size() > n_samples) {
+    nth_element(scores.begin(), scores.begin() + (n_samples-1), scores.end());
+    sample_threshold = 0.99999-scores[n_samples-1];
+  }
+
+  size_t collected = 0;
+  for (size_t i = 0; collected < n_samples && i < samples.size(); ++i) {
+    if (samples[i].getDiff() < sample_threshold) continue;
+    ++collected;
+    const pair<size_t,size_t>& t1 = samples[i].getTranslation1();
+    const pair<size_t,size_t>& t2 = samples[i].getTranslation2();
+    sentence.pairs.add(sentence.features[t1.first][t1.second],
+                       sentence.features[t2.first][t2.second]);
+  }
+}
+
+// sample the sentences first, first + step, ... of a batch
+static void samplePairsInterleaved(vector<Sentence>* batch, size_t first, size_t step, uint32_t seed) {
+  for (size_t i = first; i < batch->size(); i += step) {
+    samplePairs((*batch)[i], seed);
   }
 }
 
@@ -109,10 +179,10 @@ int main(int argc, char** argv)
   vector<string> featureFiles;
   int seed;
   string outputFile;
-  //TODO: options
-	const unsigned int n_candidates = 5000; // Gamma, in Hopkins & May
-	const unsigned int n_samples = 50; // Xi, in Hopkins & May
-	const float min_diff = 0.05;
+  size_t threads = 1;
+  bool train;
+  size_t iterations;
+  double l2;
 
   po::options_description desc("Allowed options");
   desc.add_options()
@@ -121,6 +191,13 @@ int main(int argc, char** argv)
     ("ffile,F", po::value<vector<string> > (&featureFiles), "Feature data files")
     ("random-seed,r", po::value<int>(&seed), "Seed for random number generation")
     ("output-file,o", po::value<string>(&outputFile), "Output file")
+#ifdef WITH_THREADS
+    ("threads,T", po::value<size_t>(&threads)->default_value(1), "Number of threads for sampling and training")
+#endif
+    ("train", po::value(&train)->zero_tokens()->default_value(false),
+     "Train a logistic regression classifier on the pairs and output its weights, as megam -fvals would, instead of the pairs")
+    ("iterations", po::value<size_t>(&iterations)->default_value(30), "Maximum number of training iterations")
+    ("l2", po::value<double>(&l2)->default_value(1.0), "L2 regularisation of the training")
     ;
 
   po::options_description cmdline_options;
@@ -137,11 +214,11 @@ int main(int argc, char** argv)
   
   if (vm.count("random-seed")) {
     cerr << "Initialising random seed to " << seed << endl;
-    srand(seed);
   } else {
     cerr << "Initialising random seed from system clock" << endl;
-    srand(time(NULL));
+    seed = time(NULL);
   }
+  threads = max<size_t>(1, threads);
 
   if (scoreFiles.size() == 0 || featureFiles.size() == 0) {
     cerr << "No data to process" << endl;
@@ -175,90 +252,74 @@ int main(int argc, char** argv)
     scoreDataIters.push_back(ScoreDataIterator(scoreFiles[i]));
   }
 
-  //loop through nbest lists
+  // all pairs, when training
+  PairBuffer pairs;
+
+  //loop through nbest lists, a batch at a time
+  const size_t batch_size = 64 * threads;
+  vector<Sentence> batch;
   size_t sentenceId = 0;
   while(1) {
-    vector<pair<size_t,size_t> > hypotheses;
-    //TODO: de-deuping. Collect hashes of score,feature pairs and 
-    //only add index if it's unique.
-    if (featureDataIters[0] == FeatureDataIterator::end()) {
-      break;
-    }
-    for (size_t i = 0; i < featureFiles.size(); ++i) {
-      if (featureDataIters[i] == FeatureDataIterator::end()) {
-        cerr << "Error: Feature file " << i << " ended prematurely" << endl;
-        exit(1);
-      }
-      if (scoreDataIters[i] == ScoreDataIterator::end()) {
-        cerr << "Error: Score file " << i << " ended prematurely" << endl;
-        exit(1);
-      }
-      if (featureDataIters[i]->size() != scoreDataIters[i]->size()) {
-        cerr << "Error: For sentence " << sentenceId << " features and scores have different size" << endl;
-        exit(1);
-      }
-      for (size_t j = 0; j < featureDataIters[i]->size(); ++j) {
-        hypotheses.push_back(pair<size_t,size_t>(i,j));
+    batch.clear();
+    while (batch.size() < batch_size && featureDataIters[0] != FeatureDataIterator::end()) {
+      batch.push_back(Sentence());
+      Sentence& sentence = batch.back();
+      sentence.id = sentenceId;
+      for (size_t i = 0; i < featureFiles.size(); ++i) {
+        if (featureDataIters[i] == FeatureDataIterator::end()) {
+          cerr << "Error: Feature file " << i << " ended prematurely" << endl;
+          exit(1);
+        }
+        if (scoreDataIters[i] == ScoreDataIterator::end()) {
+          cerr << "Error: Score file " << i << " ended prematurely" << endl;
+          exit(1);
+        }
+        if (featureDataIters[i]->size() != scoreDataIters[i]->size()) {
+          cerr << "Error: For sentence " << sentenceId << " features and scores have different size" << endl;
+          exit(1);
+        }
+        sentence.features.push_back(*featureDataIters[i]);
+        sentence.scores.push_back(*scoreDataIters[i]);
+        ++featureDataIters[i];
+        ++scoreDataIters[i];
       }
+      ++sentenceId;
     }
-
-    //collect the candidates
-    vector<SampledPair> samples;
-    vector<float> scores;
-    size_t n_translations = hypotheses.size();
-    for(size_t  i=0; i<n_candidates; i++) {
-      size_t rand1 = rand() % n_translations;
-      pair<size_t,size_t> translation1 = hypotheses[rand1];
-      float bleu1 = sentenceLevelBleuPlusOne(scoreDataIters[translation1.first]->operator[](translation1.second));
-
-      size_t rand2 = rand() % n_translations;
-      pair<size_t,size_t> translation2 = hypotheses[rand2];
-      float bleu2 = sentenceLevelBleuPlusOne(scoreDataIters[translation2.first]->operator[](translation2.second));
-      
-      /*
-      cerr << "t(" << translation1.first << "," << translation1.second << ") = " << bleu1 <<
-        " t(" << translation2.first << "," << translation2.second << ") = " <<
-          bleu2  << " diff = " << abs(bleu1-bleu2) << endl;
-      */
-      if (abs(bleu1-bleu2) < min_diff)
-        continue;
-      
-      samples.push_back(SampledPair(translation1, translation2, bleu1-bleu2));
-      scores.push_back(1.0-abs(bleu1-bleu2));
+    if (batch.empty()) {
+      break;
     }
 
-    float sample_threshold = -1.0;
-    if (samples.size() > n_samples) {
-      nth_element(scores.begin(), scores.begin() + (n_samples-1), scores.end());
-      sample_threshold = 0.99999-scores[n_samples-1];
+    const size_t workers = min(threads, batch.size());
+#ifdef WITH_THREADS
+    if (workers > 1) {
+      boost::thread_group group;
+      for (size_t t = 0; t < workers; ++t) {
+        group.create_thread(boost::bind(&samplePairsInterleaved, &batch, t, workers, seed));
+      }
+      group.join_all();
+    } else
+#endif
+    {
+      samplePairsInterleaved(&batch, 0, 1, seed);
     }
 
-    size_t collected = 0;
-    for (size_t i = 0; collected < n_samples && i < samples.size(); ++i) {
-      if (samples[i].getDiff() < sample_threshold) continue;
-      ++collected;
-      size_t file_id1 = samples[i].getTranslation1().first;
-      size_t hypo_id1 = samples[i].getTranslation1().second;
-      size_t file_id2 = samples[i].getTranslation2().first;
-      size_t hypo_id2 = samples[i].getTranslation2().second;
-      *out << "1";
-      outputSample(*out, featureDataIters[file_id1]->operator[](hypo_id1),
-                        featureDataIters[file_id2]->operator[](hypo_id2));
-      *out << endl;
-      *out << "0";
-      outputSample(*out, featureDataIters[file_id2]->operator[](hypo_id2),
-                        featureDataIters[file_id1]->operator[](hypo_id1));
-      *out << endl;
-    }
-    //advance all iterators
-    for (size_t i = 0; i < featureFiles.size(); ++i) {
-      ++featureDataIters[i];
-      ++scoreDataIters[i];
+    for (size_t i = 0; i < batch.size(); ++i) {
+      if (train) {
+        pairs.append(batch[i].pairs);
+      } else {
+        batch[i].pairs.writeMegam(*out);
+      }
     }
-    ++sentenceId;
   }
 
+  if (train) {
+    cerr << "Training on " << pairs.size() << " pairs" << endl;
+    LogisticRegression classifier(iterations, l2, threads);
+    classifier.train(pairs);
+    classifier.writeWeights(*out, pairs);
+  }
+
+  out->flush();
   outFile.close();
 
 }
-
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "SearchGraphBinary.h"
+
+using namespace Moses;
+
+// Print a search graph written with -output-search-graph-binary as text, one
+// hypothesis per line, in the spirit of -output-search-graph.
+
+void printHelp()
+{
+  std::cerr << "Usage: printSearchGraphBinary file [sentence-id]\n";
+}
+
+void printGraph(const SearchGraphBinary &graph)
+{
+  const bool phraseBased = graph.flags & SearchGraphBinary::PhraseBased;
+  for (size_t i = 0; i < graph.edges.size(); ++i) {
+    const SearchGraphBinary::Edge &edge = graph.edges[i];
+    std::cout << graph.translationId << " hyp=" << edge.id;
+    if (phraseBased) {
+      std::cout << " stack=" << edge.stack;
+    }
+    if (!edge.tails.empty()) {
+      std::cout << " back=" << edge.tails[0];
+      for (size_t j = 1; j < edge.tails.size(); ++j) {
+        std::cout << "," << edge.tails[j];
+      }
+    }
+    std::cout << " score=" << edge.score << " transition=" << edge.transition;
+    if (edge.winner != edge.id) {
+      std::cout << " recombined=" << edge.winner;
+    }
+    if (phraseBased) {
+      std::cout << " forward=" << edge.forward << " fscore=" << edge.fscore;
+    }
+    if (edge.start <= edge.end) {
+      std::cout << " covered=" << edge.start << "-" << edge.end;
+    }
+    if (!edge.scores.empty()) {
+      std::cout << " scores=[";
+      for (size_t j = 0; j < edge.scores.size(); ++j) {
+        std::cout << " " << edge.scores[j];
+      }
+      std::cout << " ]";
+    }
+    std::cout << " out=";
+    for (size_t j = 0; j < edge.words.size(); ++j) {
+      std::cout << (j ? " " : "") << graph.vocab[edge.words[j]];
+    }
+    std::cout << "\n";
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc > 3) {
+    printHelp();
+    return 1;
+  }
+  std::ifstream in(argv[1], std::ios::in | std::ios::binary);
+  if (!in) {
+    std::cerr << "Cannot open " << argv[1] << "\n";
+    return 1;
+  }
+  const bool onlyOne = argc == 3;
+  const long sentenceId = onlyOne ? atol(argv[2]) : 0;
+
+  SearchGraphBinaryReader reader(in);
+  SearchGraphBinary graph;
+  while (reader.Read(graph)) {
+    if (!onlyOne || graph.translationId == sentenceId) {
+      printGraph(graph);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "InputFileStream.h"
+#include "GenerationTable.h"
+#include "UserMessage.h"
+#include "Util.h"
+
+using namespace Moses;
+
+void printHelp()
+{
+  std::cerr << "Usage:\n"
+            "options: \n"
+            "\t-in      string -- input table file name\n"
+            "\t-out     string -- prefix of the binary table file, written to prefix.bingen\n"
+            "\t-nscores int    -- number of scores to keep, all of them if not specified\n"
+            "The numbers of input and output factors are those of the first line\n"
+            "\n";
+}
+
+int main(int argc, char** argv)
+{
+  std::string inFilePath;
+  std::string outFilePath("out");
+  int numScores = -1;
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if("-in" == arg && i+1 < argc) {
+      ++i;
+      inFilePath = argv[i];
+    } else if("-out" == arg && i+1 < argc) {
+      ++i;
+      outFilePath = argv[i];
+    } else if("-nscores" == arg && i+1 < argc) {
+      ++i;
+      numScores = Scan<int>(argv[i]);
+    } else {
+      printHelp();
+      return 1;
+    }
+  }
+  if(inFilePath.empty()) {
+    printHelp();
+    return 1;
+  }
+
+  // the table is read twice: once for its shape, once for its entries
+  std::vector<std::string> token;
+  {
+    InputFileStream file(inFilePath);
+    std::string line;
+    if(!file.good() || !getline(file, line) || (token = Tokenize(line)).size() < 2) {
+      std::cerr << "Couldn't read a generation table from " << inFilePath << "\n";
+      return 1;
+    }
+  }
+  std::vector<FactorType> input(Tokenize(token[0], "|").size()), output(Tokenize(token[1], "|").size());
+  for(size_t i = 0; i < input.size(); ++i) input[i] = i;
+  for(size_t i = 0; i < output.size(); ++i) output[i] = i;
+  if(numScores < 0) numScores = token.size() - 2;
+
+  std::cerr << "processing " << inFilePath << " to " << outFilePath << ".bingen\n";
+  GenerationTable table(input, output, numScores);
+  InputFileStream file(inFilePath);
+  if(!table.LoadText(file, inFilePath) || !table.SaveBinary(outFilePath + ".bingen")) {
+    UserMessage::Add("Failed to binarize " + inFilePath);
+    return 1;
+  }
+  std::cerr << table.GetNumSources() << " inputs, " << table.GetNumEntries() << " entries\n";
+  return 0;
+}
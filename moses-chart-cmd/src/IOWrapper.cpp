@@ -46,6 +46,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "ChartTranslationOption.h"
 #include "ChartHypothesis.h"
 #include "DotChart.h"
+#include "SearchGraphBinary.h"
 
 
 using namespace std;
@@ -62,11 +63,13 @@ IOWrapper::IOWrapper(const std::vector<FactorType>	&inputFactorOrder
   ,m_inputFactorUsed(inputFactorUsed)
   ,m_nBestStream(NULL)
   ,m_outputSearchGraphStream(NULL)
+  ,m_outputSearchGraphBinaryStream(NULL)
   ,m_detailedTranslationReportingStream(NULL)
   ,m_inputFilePath(inputFilePath)
   ,m_detailOutputCollector(NULL)
   ,m_nBestOutputCollector(NULL)
   ,m_searchGraphOutputCollector(NULL)
+  ,m_searchGraphBinaryWriter(NULL)
   ,m_singleBestOutputCollector(NULL)
 {
   const StaticData &staticData = StaticData::Instance();
@@ -104,6 +107,15 @@ IOWrapper::IOWrapper(const std::vector<FactorType>	&inputFactorOrder
     m_searchGraphOutputCollector = new Moses::OutputCollector(m_outputSearchGraphStream);
   }
 
+  // ... in binary format, written by a background thread
+  if (staticData.GetOutputSearchGraphBinary()) {
+    string fileName = staticData.GetParam("output-search-graph-binary")[0];
+    std::ofstream *file = new std::ofstream(fileName.c_str(), ios::out | ios::binary);
+    m_outputSearchGraphBinaryStream = file;
+    SearchGraphBinaryWriter::WriteHeader(*file);
+    m_searchGraphBinaryWriter = new Moses::OutputWriter(std::vector<std::ostream*>(1, m_outputSearchGraphBinaryStream));
+  }
+
   // detailed translation reporting
   if (staticData.IsDetailedTranslationReportingEnabled()) {
     const std::string &path = staticData.GetDetailedTranslationReportingFilePath();
@@ -121,6 +133,9 @@ IOWrapper::~IOWrapper()
     // outputting n-best to file, rather than stdout. need to close file and delete obj
     delete m_nBestStream;
   }
+  // the binary writer writes until it is deleted
+  delete m_searchGraphBinaryWriter;
+  delete m_outputSearchGraphBinaryStream;
   delete m_outputSearchGraphStream;
   delete m_detailedTranslationReportingStream;
   delete m_detailOutputCollector;
@@ -42,6 +42,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "TranslationSystem.h"
 #include "ChartTrellisPathList.h"
 #include "OutputCollector.h"
+#include "OutputWriter.h"
 #include "ChartHypothesis.h"
 
 namespace Moses
@@ -59,7 +60,7 @@ protected:
   const std::vector<Moses::FactorType>	&m_inputFactorOrder;
   const std::vector<Moses::FactorType>	&m_outputFactorOrder;
   const Moses::FactorMask								&m_inputFactorUsed;
-  std::ostream 									*m_nBestStream, *m_outputSearchGraphStream;
+  std::ostream 									*m_nBestStream, *m_outputSearchGraphStream, *m_outputSearchGraphBinaryStream;
   std::ostream                  *m_detailedTranslationReportingStream;
   std::string										m_inputFilePath;
   std::istream									*m_inputStream;
@@ -67,6 +68,7 @@ protected:
   Moses::OutputCollector                *m_detailOutputCollector;
   Moses::OutputCollector                *m_nBestOutputCollector;
   Moses::OutputCollector                *m_searchGraphOutputCollector;
+  Moses::OutputWriter                   *m_searchGraphBinaryWriter;
   Moses::OutputCollector                *m_singleBestOutputCollector;
 
 public:
@@ -90,6 +92,9 @@ public:
   Moses::OutputCollector *GetSearchGraphOutputCollector() {
     return m_searchGraphOutputCollector;
   }
+  Moses::OutputWriter *GetSearchGraphBinaryWriter() {
+    return m_searchGraphBinaryWriter;
+  }
 
   static void FixPrecision(std::ostream &, size_t size=3);
 };
@@ -127,6 +127,14 @@ public:
       oc->Write(lineNumber, out.str());
     }
 
+    if (staticData.GetOutputSearchGraphBinary()) {
+      std::string out;
+      manager.OutputSearchGraphBinary(lineNumber, out);
+      OutputWriter *writer = m_ioWrapper.GetSearchGraphBinaryWriter();
+      CHECK(writer);
+      writer->Write(lineNumber, out);
+    }
+
     IFVERBOSE(2) {
       PrintUserTime("Sentence Decoding Time:");
     }
@@ -32,7 +32,9 @@ POSSIBILITY OF SUCH DAMAGE.
 
 // example file on how to use moses library
 
+#include <cstdlib>
 #include <iostream>
+#include <map>
 #include <stack>
 #include "TypeDef.h"
 #include "Util.h"
@@ -43,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "StaticData.h"
 #include "DummyScoreProducers.h"
 #include "InputFileStream.h"
+#include "SearchGraphBinary.h"
 
 using namespace std;
 using namespace Moses;
@@ -61,6 +64,7 @@ IOWrapper::IOWrapper(
   ,m_nBestStream(NULL)
   ,m_outputWordGraphStream(NULL)
   ,m_outputSearchGraphStream(NULL)
+  ,m_outputSearchGraphBinaryStream(NULL)
   ,m_detailedTranslationReportingStream(NULL)
   ,m_alignmentOutputStream(NULL)
 {
@@ -83,6 +87,7 @@ IOWrapper::IOWrapper(const std::vector<FactorType>	&inputFactorOrder
   ,m_nBestStream(NULL)
   ,m_outputWordGraphStream(NULL)
   ,m_outputSearchGraphStream(NULL)
+  ,m_outputSearchGraphBinaryStream(NULL)
   ,m_detailedTranslationReportingStream(NULL)
   ,m_alignmentOutputStream(NULL)
 {
@@ -107,6 +112,7 @@ IOWrapper::~IOWrapper()
   if (m_outputSearchGraphStream != NULL) {
     delete m_outputSearchGraphStream;
   }
+  delete m_outputSearchGraphBinaryStream;
   delete m_detailedTranslationReportingStream;
   delete m_alignmentOutputStream;
 }
@@ -154,6 +160,14 @@ void IOWrapper::Initialization(const std::vector<FactorType>	&/*inputFactorOrder
     file->open(fileName.c_str());
   }
 
+  // ... in binary format
+  if (staticData.GetOutputSearchGraphBinary()) {
+    string fileName = staticData.GetParam("output-search-graph-binary")[0];
+    std::ofstream *file = new std::ofstream(fileName.c_str(), ios::out | ios::binary);
+    m_outputSearchGraphBinaryStream = file;
+    SearchGraphBinaryWriter::WriteHeader(*file);
+  }
+
   // detailed translation reporting
   if (staticData.IsDetailedTranslationReportingEnabled()) {
     const std::string &path = staticData.GetDetailedTranslationReportingFilePath();
@@ -172,10 +186,7 @@ void IOWrapper::Initialization(const std::vector<FactorType>	&/*inputFactorOrder
 InputType*IOWrapper::GetInput(InputType* inputType)
 {
   if(inputType->Read(*m_inputStream, m_inputFactorOrder)) {
-    if (long x = inputType->GetTranslationId()) {
-      if (x>=m_translationId) m_translationId = x+1;
-    } else inputType->SetTranslationId(m_translationId++);
-
+    inputType->SetTranslationId(NextTranslationId(inputType->GetTranslationId()));
     return inputType;
   } else {
     delete inputType;
@@ -183,6 +194,63 @@ InputType*IOWrapper::GetInput(InputType* inputType)
   }
 }
 
+long IOWrapper::NextTranslationId(long fromInput)
+{
+  if (fromInput) {
+    if (fromInput>=m_translationId) m_translationId = fromInput+1;
+    return fromInput;
+  }
+  return m_translationId++;
+}
+
+// the id of an input given as "<seg id=1> ... </seg>", 0 if none
+static long SegId(std::string line)
+{
+  std::map<std::string, std::string> meta = ProcessAndStripSGML(line);
+  std::map<std::string, std::string>::const_iterator id = meta.find("id");
+  return id == meta.end() ? 0 : atol(id->second.c_str());
+}
+
+bool IOWrapper::GetInputText(InputTypeEnum inputType, std::string &text, long &translationId)
+{
+  static const char *whitespace = " \t\r\n\v\f";
+  std::string line;
+  long fromInput = 0;
+  text.clear();
+  switch(inputType) {
+  case SentenceInput:
+    // as Sentence::Read, which ignores a last line without an end of line
+    if (getline(*m_inputStream, line, '\n').eof()) return false;
+    text = line + '\n';
+    if (StaticData::Instance().ContinuePartialTranslation()) {
+      // the sentence follows the translation so far and the words it covers
+      size_t loc1 = line.find("|||");
+      size_t loc2 = loc1 == std::string::npos ? loc1 : line.find("|||", loc1 + 3);
+      if (loc2 != std::string::npos) line = line.substr(loc2 + 3);
+    }
+    fromInput = SegId(Trim(line));
+    break;
+  case ConfusionNetworkInput:
+    // the columns, up to the empty line which ends them
+    while (getline(*m_inputStream, line)) {
+      text += line + '\n';
+      if (line.find_first_not_of(whitespace) == std::string::npos) break;
+    }
+    if (text.find_first_not_of(whitespace) == std::string::npos) return false;
+    break;
+  case WordLatticeInput:
+    if (!getline(*m_inputStream, line)) return false;
+    text = line + '\n';
+    fromInput = SegId(line);
+    break;
+  default:
+    TRACE_ERR("Unknown input type: " << inputType << "\n");
+    return false;
+  }
+  translationId = NextTranslationId(fromInput);
+  return true;
+}
+
 /***
  * print surface factor only for the given phrase
  */
@@ -235,33 +303,21 @@ void OutputAlignment(ostream &out, const vector<const Hypothesis *> &edges)
   out << std::endl;
 }
 
-void OutputAlignment(OutputCollector* collector, size_t lineNo , const vector<const Hypothesis *> &edges)
+void OutputAlignment(ostream &out, const Hypothesis *hypo)
 {
-  ostringstream out;
-  OutputAlignment(out, edges);
-  
-  collector->Write(lineNo,out.str());
-}
-
-void OutputAlignment(OutputCollector* collector, size_t lineNo , const Hypothesis *hypo)
-{
-  if (collector) {
-    std::vector<const Hypothesis *> edges;
-    const Hypothesis *currentHypo = hypo;
-    while (currentHypo) {
-      edges.push_back(currentHypo);
-      currentHypo = currentHypo->GetPrevHypo();
-    }
-
-    OutputAlignment(collector,lineNo, edges);
+  std::vector<const Hypothesis *> edges;
+  const Hypothesis *currentHypo = hypo;
+  while (currentHypo) {
+    edges.push_back(currentHypo);
+    currentHypo = currentHypo->GetPrevHypo();
   }
+
+  OutputAlignment(out, edges);
 }
 
-void OutputAlignment(OutputCollector* collector, size_t lineNo , const TrellisPath &path)
+void OutputAlignment(ostream &out, const TrellisPath &path)
 {
-  if (collector) {
-    OutputAlignment(collector,lineNo, path.GetEdges());
-  }
+  OutputAlignment(out, path.GetEdges());
 }
 
 void OutputSurface(std::ostream &out, const Hypothesis *hypo, const std::vector<FactorType> &outputFactorOrder
@@ -45,7 +45,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "FactorTypeSet.h"
 #include "FactorCollection.h"
 #include "Hypothesis.h"
-#include "OutputCollector.h"
 #include "TrellisPathList.h"
 #include "InputFileStream.h"
 #include "InputType.h"
@@ -64,7 +63,7 @@ protected:
   Moses::InputFileStream				*m_inputFile;
   std::istream									*m_inputStream;
   std::ostream 									*m_nBestStream
-  ,*m_outputWordGraphStream,*m_outputSearchGraphStream;
+  ,*m_outputWordGraphStream,*m_outputSearchGraphStream,*m_outputSearchGraphBinaryStream;
   std::ostream                  *m_detailedTranslationReportingStream;
   std::ofstream *m_alignmentOutputStream;
   bool													m_surpressSingleBestOutput;
@@ -92,6 +91,16 @@ public:
 
   Moses::InputType* GetInput(Moses::InputType *inputType);
 
+  //! the text of the next input and its translation id, as GetInput() would read it, but unparsed
+  bool GetInputText(Moses::InputTypeEnum inputType, std::string &text, long &translationId);
+  //! the translation id of an input which gives fromInput, or 0 if it gives none
+  long NextTranslationId(long fromInput);
+
+  //! read the input from another stream, which stays owned by the caller
+  void SetInputStream(std::istream *inputStream) {
+    m_inputStream = inputStream;
+  }
+
   void OutputBestHypo(const Moses::Hypothesis *hypo, long translationId, bool reportSegmentation, bool reportAllFactors);
   void OutputLatticeMBRNBestList(const std::vector<LatticeMBRSolution>& solutions,long translationId);
   void Backtrack(const Moses::Hypothesis *hypo);
@@ -110,6 +119,9 @@ public:
   std::ostream &GetOutputSearchGraphStream() {
     return *m_outputSearchGraphStream;
   }
+  std::ostream &GetOutputSearchGraphBinaryStream() {
+    return *m_outputSearchGraphBinaryStream;
+  }
 
   std::ostream &GetDetailedTranslationReportingStream() {
     assert (m_detailedTranslationReportingStream);
@@ -127,7 +139,7 @@ void OutputBestHypo(const std::vector<Moses::Word>&  mbrBestHypo, long /*transla
                     bool reportSegmentation, bool reportAllFactors, std::ostream& out);
 void OutputBestHypo(const Moses::TrellisPath &path, long /*translationId*/,bool reportSegmentation, bool reportAllFactors, std::ostream &out);
 void OutputInput(std::ostream& os, const Hypothesis* hypo);
-void OutputAlignment(OutputCollector* collector, size_t lineNo, const Hypothesis *hypo);
-void OutputAlignment(OutputCollector* collector, size_t lineNo,  const TrellisPath &path);
+void OutputAlignment(std::ostream &out, const Hypothesis *hypo);
+void OutputAlignment(std::ostream &out, const TrellisPath &path);
 
 #endif
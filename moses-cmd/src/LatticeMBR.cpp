@@ -10,190 +10,295 @@
 #include "LatticeMBR.h"
 #include "StaticData.h"
 #include <algorithm>
+#include <cmath>
 #include <set>
 
 using namespace std;
 
 size_t bleu_order = 4;
 float UNKNGRAMLOGPROB = -20;
-void GetOutputWords(const TrellisPath &path, vector <Word> &translation)
+
+namespace
 {
-  const std::vector<const Hypothesis *> &edges = path.GetEdges();
 
-  // print the surface factor of the translation
-  for (int currEdge = (int)edges.size() - 1 ; currEdge >= 0 ; currEdge--) {
-    const Hypothesis &edge = *edges[currEdge];
-    const Phrase &phrase = edge.GetCurrTargetPhrase();
-    size_t size = phrase.GetSize();
-    for (size_t pos = 0 ; pos < size ; pos++) {
-      translation.push_back(phrase.GetWord(pos));
-    }
-  }
+const size_t MAX_BLEU_ORDER = 4;
+
+typedef LatticeMBRSearchGraph::LatticeEdge LatticeEdge;
+
+/** An n-gram ending in a lattice edge, and the path of edges it was read from */
+struct EdgeNgram {
+  NgramKey key;
+  size_t order;
+  const Word* words[MAX_BLEU_ORDER];
+  size_t path[MAX_BLEU_ORDER]; //< the edges the n-gram was read from
+  size_t pathLength;
+  size_t origin; //< tail of the first edge of the path
+  float pathScore; //< sum of the edge scores along the path
+  size_t count; //< number of times the n-gram was read from the path
+};
+
+bool EdgeNgramLess(const EdgeNgram& a, const EdgeNgram& b)
+{
+  if (a.key != b.key) return a.key < b.key;
+  return lexicographical_compare(a.path, a.path + a.pathLength, b.path, b.path + b.pathLength);
 }
 
+bool SameEdgeNgram(const EdgeNgram& a, const EdgeNgram& b)
+{
+  return a.key == b.key && a.pathLength == b.pathLength && equal(a.path, a.path + a.pathLength, b.path);
+}
 
-void extract_ngrams(const vector<Word >& sentence, map < Phrase, int >  & allngrams)
+/** Log score of an n-gram at a lattice node */
+struct NgramLogScore {
+  NgramKey key;
+  float score;
+  size_t order;
+
+  NgramLogScore(NgramKey key_, float score_, size_t order_)
+    : key(key_), score(score_), order(order_) {}
+
+  bool operator<(const NgramLogScore& other) const {
+    return key < other.key;
+  }
+};
+
+/** log(sum(exp(scores))), taking out the largest term first so the sum can't overflow */
+float LogSumExp(const vector<float>& scores)
 {
-  for (int k = 0; k < (int)bleu_order; k++) {
-    for(int i =0; i < max((int)sentence.size()-k,0); i++) {
-      Phrase ngram( k+1);
-      for ( int j = i; j<= i+k; j++) {
-        ngram.AddWord(sentence[j]);
+  float best = scores[0];
+  for (size_t i = 1; i < scores.size(); ++i) {
+    best = max(best, scores[i]);
+  }
+  float sum = 0.0f;
+  for (size_t i = 0; i < scores.size(); ++i) {
+    sum += exp(scores[i] - best);
+  }
+  return best + log(sum);
+}
+
+/** Sort the scores by n-gram and log-sum the scores of each n-gram */
+void MergeNgramScores(vector<NgramLogScore>& scores, vector<float>& scratch)
+{
+  sort(scores.begin(), scores.end());
+  size_t merged = 0;
+  for (size_t begin = 0, end; begin < scores.size(); begin = end) {
+    end = begin + 1;
+    while (end < scores.size() && scores[end].key == scores[begin].key) {
+      ++end;
+    }
+    scores[merged] = scores[begin];
+    if (end - begin > 1) {
+      scratch.clear();
+      for (size_t i = begin; i < end; ++i) {
+        scratch.push_back(scores[i].score);
       }
-      ++allngrams[ngram];
+      scores[merged].score = LogSumExp(scratch);
     }
+    ++merged;
   }
+  scores.resize(merged, NgramLogScore(EMPTY_NGRAM, 0.0f, 0));
 }
 
-
-
-void NgramScores::addScore(const Hypothesis* node, const Phrase& ngram, float score)
+/** Do the last n words of the phrase and of the n-gram match? */
+bool IsSuffix(const Phrase& phrase, const EdgeNgram& ngram, size_t n)
 {
-  set<Phrase>::const_iterator ngramIter = m_ngrams.find(ngram);
-  if (ngramIter == m_ngrams.end()) {
-    ngramIter = m_ngrams.insert(ngram).first;
-  }
-  map<const Phrase*,float>& ngramScores = m_scores[node];
-  map<const Phrase*,float>::iterator scoreIter = ngramScores.find(&(*ngramIter));
-  if (scoreIter == ngramScores.end()) {
-    ngramScores[&(*ngramIter)] = score;
-  } else {
-    ngramScores[&(*ngramIter)] = log_sum(score,scoreIter->second);
+  for (size_t i = 1; i <= n; ++i) {
+    if (phrase.GetWord(phrase.GetSize() - i) != *ngram.words[ngram.order - i]) {
+      return false;
+    }
   }
+  return true;
 }
 
-NgramScores::NodeScoreIterator NgramScores::nodeBegin(const Hypothesis* node)
+/** Collect the n-grams ending in an edge: those read from its own words, and those of the edges
+ * coming into its tail continued into its words. */
+void GetEdgeNgrams(size_t edgeIndex, const vector<size_t>& tailIncoming, const vector<LatticeEdge>& edges,
+                   const vector< vector<EdgeNgram> >& edgeNgrams, vector<EdgeNgram>& ngrams)
 {
-  return m_scores[node].begin();
+  const LatticeEdge& edge = edges[edgeIndex];
+  const Phrase& words = *edge.words;
+  const size_t size = words.GetSize();
+
+  //Extract the n-grams local to this edge
+  for (size_t start = 0; start < size; ++start) {
+    EdgeNgram ngram;
+    ngram.key = EMPTY_NGRAM;
+    ngram.path[0] = edgeIndex;
+    ngram.pathLength = 1;
+    ngram.origin = edge.tail;
+    ngram.pathScore = edge.score;
+    ngram.count = 1;
+    for (size_t end = start; end < start + bleu_order && end < size; ++end) {
+      ngram.key = ExtendNgram(ngram.key, words.GetWord(end));
+      ngram.words[end - start] = &words.GetWord(end);
+      ngram.order = end - start + 1;
+      ngrams.push_back(ngram);
+    }
+  }
+  //add the n-grams straddling the previous and the current edge
+  for (size_t i = 0; i < tailIncoming.size(); ++i) {
+    const Phrase& prevWords = *edges[tailIncoming[i]].words;
+    const vector<EdgeNgram>& prevNgrams = edgeNgrams[tailIncoming[i]];
+    for (size_t j = 0; j < prevNgrams.size(); ++j) {
+      const EdgeNgram& prevNgram = prevNgrams[j];
+      if (!IsSuffix(prevWords, prevNgram, min(prevNgram.order, prevWords.GetSize()))) {
+        continue;
+      }
+      EdgeNgram ngram = prevNgram;
+      ngram.path[ngram.pathLength++] = edgeIndex;
+      ngram.pathScore += edge.score;
+      for (size_t k = 0; k < size && prevNgram.order + k < bleu_order; ++k) {
+        ngram.key = ExtendNgram(ngram.key, words.GetWord(k));
+        ngram.words[ngram.order++] = &words.GetWord(k);
+        ngrams.push_back(ngram);
+      }
+    }
+  }
+
+  //an n-gram read more than once from the same path is counted
+  sort(ngrams.begin(), ngrams.end(), EdgeNgramLess);
+  size_t merged = 0;
+  for (size_t i = 0; i < ngrams.size(); ++i) {
+    if (merged > 0 && SameEdgeNgram(ngrams[merged - 1], ngrams[i])) {
+      ngrams[merged - 1].count += ngrams[i].count;
+    } else {
+      ngrams[merged++] = ngrams[i];
+    }
+  }
+  ngrams.resize(merged);
 }
 
+}
 
-NgramScores::NodeScoreIterator NgramScores::nodeEnd(const Hypothesis* node)
+NgramKey ExtendNgram(NgramKey ngram, const Word& word)
 {
-  return m_scores[node].end();
+  // words with the same factors are the same word, see Word::Compare()
+  NgramKey x = ngram * 0x9e3779b97f4a7c15ULL;
+  for (size_t i = 0; i < MAX_NUM_FACTORS; ++i) {
+    x = (x ^ reinterpret_cast<size_t>(word[i])) * 0x100000001b3ULL;
+  }
+  // finaliser of splitmix64, so that the low bits depend on every word
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
 }
 
-LatticeMBRSolution::LatticeMBRSolution(const TrellisPath& path, bool isMap) :
-  m_score(0.0f)
+void GetOutputWords(const TrellisPath &path, vector <Word> &translation)
 {
   const std::vector<const Hypothesis *> &edges = path.GetEdges();
 
+  // print the surface factor of the translation
   for (int currEdge = (int)edges.size() - 1 ; currEdge >= 0 ; currEdge--) {
     const Hypothesis &edge = *edges[currEdge];
     const Phrase &phrase = edge.GetCurrTargetPhrase();
     size_t size = phrase.GetSize();
     for (size_t pos = 0 ; pos < size ; pos++) {
-      m_words.push_back(phrase.GetWord(pos));
+      translation.push_back(phrase.GetWord(pos));
     }
   }
-  if (isMap) {
-    m_mapScore = path.GetTotalScore();
-  } else {
-    m_mapScore = 0;
-  }
 }
 
 
-void LatticeMBRSolution::CalcScore(map<Phrase, float>& finalNgramScores, const vector<float>& thetas, float mapWeight)
+void extract_ngrams(const vector<Word >& sentence, NgramCounts& allngrams)
 {
-  m_ngramScores.assign(thetas.size()-1, -10000);
-
-  map < Phrase, int > counts;
-  extract_ngrams(m_words,counts);
-
-  //Now score this translation
-  m_score = thetas[0] * m_words.size();
-
-  //Calculate the ngramScores, working in log space at first
-  for (map < Phrase, int >::iterator ngrams = counts.begin(); ngrams != counts.end(); ++ngrams) {
-    float ngramPosterior = UNKNGRAMLOGPROB;
-    map<Phrase,float>::const_iterator ngramPosteriorIt = finalNgramScores.find(ngrams->first);
-    if (ngramPosteriorIt != finalNgramScores.end()) {
-      ngramPosterior = ngramPosteriorIt->second;
+  allngrams.resize(bleu_order);
+  for (int i = 0; i < (int)sentence.size(); i++) {
+    NgramKey ngram = EMPTY_NGRAM;
+    for (int k = 0; k < (int)bleu_order && i + k < (int)sentence.size(); k++) {
+      ngram = ExtendNgram(ngram, sentence[i+k]);
+      ++allngrams[k][ngram];
     }
-    size_t ngramSize = ngrams->first.GetSize();
-    m_ngramScores[ngramSize-1] = log_sum(log((float)ngrams->second) + ngramPosterior,m_ngramScores[ngramSize-1]);
-  }
-
-  //convert from log to probability and create weighted sum
-  for (size_t i = 0; i < m_ngramScores.size(); ++i) {
-    m_ngramScores[i] = exp(m_ngramScores[i]);
-    m_score += thetas[i+1] * m_ngramScores[i];
   }
-
-
-  //The map score
-  m_score += m_mapScore*mapWeight;
 }
 
-
-void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const Hypothesis* > > & outgoingHyps, map<const Hypothesis*, vector<Edge> >& incomingEdges,
-                    const vector< float> & estimatedScores, const Hypothesis* bestHypo, size_t edgeDensity, float scale)
+LatticeMBRSearchGraph::LatticeMBRSearchGraph(const Manager& manager)
+  : m_bestHypo(manager.GetBestHypothesis())
 {
+  std::map < int, bool > connected;
+  std::map < const Hypothesis*, set <const Hypothesis*> > outgoingHyps;
+  manager.GetForwardBackwardSearchGraph(&connected, &m_hypos, &outgoingHyps, &m_estimatedScores);
 
-  //Need hyp 0 in connectedHyp - Find empty hypothesis
-  VERBOSE(2,"Pruning lattice to edge density " << edgeDensity << endl);
-  const Hypothesis* emptyHyp = connectedHyp.at(0);
+  //Need hyp 0 in the lattice - Find empty hypothesis, and store best score as its score
+  const Hypothesis* emptyHyp = m_hypos.at(0);
   while (emptyHyp->GetId() != 0) {
     emptyHyp = emptyHyp->GetPrevHypo();
   }
-  connectedHyp.push_back(emptyHyp); //Add it to list of hyps
+  const float bestScore = *max_element(m_estimatedScores.begin(), m_estimatedScores.end());
+  m_hypos.push_back(emptyHyp);
+  m_estimatedScores.push_back(bestScore);
 
-  //Need hyp 0's outgoing Hyps
-  for (size_t i = 0; i < connectedHyp.size(); ++i) {
-    if (connectedHyp[i]->GetId() > 0 && connectedHyp[i]->GetPrevHypo()->GetId() == 0)
-      outgoingHyps[emptyHyp].insert(connectedHyp[i]);
+  for (size_t i = 0; i < m_hypos.size(); ++i) {
+    m_index[m_hypos[i]] = i;
   }
-
-  //sort hyps based on estimated scores - do so by copying to multimap
-  multimap<float, const Hypothesis*> sortHypsByVal;
-  for (size_t i =0; i < estimatedScores.size(); ++i) {
-    sortHypsByVal.insert(make_pair<float, const Hypothesis*>(estimatedScores[i], connectedHyp[i]));
+  m_outgoing.resize(m_hypos.size());
+  map < const Hypothesis*, set <const Hypothesis*> >::const_iterator iter;
+  for (iter = outgoingHyps.begin(); iter != outgoingHyps.end(); ++iter) {
+    const size_t from = GetIndex(iter->first);
+    if (from == NOT_FOUND) continue;
+    set <const Hypothesis*>::const_iterator succ;
+    for (succ = iter->second.begin(); succ != iter->second.end(); ++succ) {
+      const size_t to = GetIndex(*succ);
+      if (to != NOT_FOUND) {
+        m_outgoing[from].push_back(to);
+      }
+    }
   }
+}
 
-  multimap<float, const Hypothesis*>::const_iterator it = --sortHypsByVal.end();
-  float bestScore = it->first;
-  //store best score as score of hyp 0
-  sortHypsByVal.insert(make_pair<float, const Hypothesis*>(bestScore, emptyHyp));
+size_t LatticeMBRSearchGraph::GetIndex(const Hypothesis* hypo) const
+{
+  boost::unordered_map<const Hypothesis*, size_t>::const_iterator iter = m_index.find(hypo);
+  return iter == m_index.end() ? NOT_FOUND : iter->second;
+}
 
+void LatticeMBRSearchGraph::Prune(size_t edgeDensity, float scale, vector<size_t>& survivors, vector<LatticeEdge>& edges) const
+{
+  VERBOSE(2,"Pruning lattice to edge density " << edgeDensity << endl);
+
+  //sort hyps based on estimated scores, best first. Ties are taken in reverse order, so the
+  //empty hypothesis (which has the best score) comes first.
+  vector< pair<float, size_t> > sortHypsByVal(m_hypos.size());
+  for (size_t i = 0; i < m_hypos.size(); ++i) {
+    sortHypsByVal[i] = make_pair(m_estimatedScores[i], i);
+  }
+  sort(sortHypsByVal.begin(), sortHypsByVal.end(), greater< pair<float, size_t> >());
 
   IFVERBOSE(3) {
-    for (multimap<float, const Hypothesis*>::const_iterator it = --sortHypsByVal.end(); it != --sortHypsByVal.begin(); --it) {
-      const Hypothesis* currHyp =  it->second;
-      cerr << "Hyp " << currHyp->GetId() << ", estimated score: " << it->first << endl;
+    for (size_t i = 0; i < sortHypsByVal.size(); ++i) {
+      cerr << "Hyp " << m_hypos[sortHypsByVal[i].second]->GetId() << ", estimated score: " << sortHypsByVal[i].first << endl;
     }
   }
 
+  vector<char> surviving(m_hypos.size(), false); //hyps that make the cut
 
-  set <const Hypothesis*> survivingHyps; //store hyps that make the cut in this
-
-  VERBOSE(2, "BEST HYPO TARGET LENGTH : " << bestHypo->GetSize() << endl)
-  size_t numEdgesTotal = edgeDensity * bestHypo->GetSize(); //as per Shankar, aim for (density * target length of MAP solution) arcs
-  size_t numEdgesCreated = 0;
+  VERBOSE(2, "BEST HYPO TARGET LENGTH : " << m_bestHypo->GetSize() << endl)
+  size_t numEdgesTotal = edgeDensity * m_bestHypo->GetSize(); //as per Shankar, aim for (density * target length of MAP solution) arcs
   VERBOSE(2, "Target edge count: " << numEdgesTotal << endl);
 
   float prevScore = -999999;
 
-  //now iterate over multimap
-  for (multimap<float, const Hypothesis*>::const_iterator it = --sortHypsByVal.end(); it != --sortHypsByVal.begin(); --it) {
-    float currEstimatedScore = it->first;
-    const Hypothesis* currHyp =  it->second;
+  for (size_t i = 0; i < sortHypsByVal.size(); ++i) {
+    float currEstimatedScore = sortHypsByVal[i].first;
+    const size_t curr = sortHypsByVal[i].second;
+    const Hypothesis* currHyp = m_hypos[curr];
 
-    if (numEdgesCreated >= numEdgesTotal && prevScore > currEstimatedScore) //if this hyp has equal estimated score to previous, include its edges too
+    if (edges.size() >= numEdgesTotal && prevScore > currEstimatedScore) //if this hyp has equal estimated score to previous, include its edges too
       break;
 
     prevScore = currEstimatedScore;
-    VERBOSE(3, "Num edges created : "<< numEdgesCreated << ", numEdges wanted " << numEdgesTotal << endl)
-    VERBOSE(3, "Considering hyp " << currHyp->GetId() << ", estimated score: " << it->first << endl)
+    VERBOSE(3, "Num edges created : "<< edges.size() << ", numEdges wanted " << numEdgesTotal << endl)
+    VERBOSE(3, "Considering hyp " << currHyp->GetId() << ", estimated score: " << currEstimatedScore << endl)
 
-    survivingHyps.insert(currHyp); //CurrHyp made the cut
+    surviving[curr] = true; //CurrHyp made the cut
+    survivors.push_back(curr);
 
     // is its best predecessor already included ?
-    if (survivingHyps.find(currHyp->GetPrevHypo()) != survivingHyps.end()) { //yes, then add an edge
-      vector <Edge>& edges = incomingEdges[currHyp];
-      Edge winningEdge(currHyp->GetPrevHypo(),currHyp,scale*(currHyp->GetScore() - currHyp->GetPrevHypo()->GetScore()),currHyp->GetCurrTargetPhrase());
-      edges.push_back(winningEdge);
-      ++numEdgesCreated;
+    if (currHyp->GetPrevHypo() != NULL) {
+      const size_t prev = GetIndex(currHyp->GetPrevHypo());
+      if (prev != NOT_FOUND && surviving[prev]) { //yes, then add an edge
+        LatticeEdge winningEdge = {prev, curr, scale*(currHyp->GetScore() - currHyp->GetPrevHypo()->GetScore()), &currHyp->GetCurrTargetPhrase()};
+        edges.push_back(winningEdge);
+      }
     }
 
     //let's try the arcs too
@@ -203,292 +308,208 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
       for (iterArcList = arcList->begin() ; iterArcList != arcList->end() ; ++iterArcList) {
         const Hypothesis *loserHypo = *iterArcList;
         const Hypothesis* loserPrevHypo = loserHypo->GetPrevHypo();
-        if (survivingHyps.find(loserPrevHypo) != survivingHyps.end()) { //found it, add edge
+        const size_t loserPrev = GetIndex(loserPrevHypo);
+        if (loserPrev != NOT_FOUND && surviving[loserPrev]) { //found it, add edge
           double arcScore = loserHypo->GetScore() - loserPrevHypo->GetScore();
-          Edge losingEdge(loserPrevHypo, currHyp, arcScore*scale, loserHypo->GetCurrTargetPhrase());
-          vector <Edge>& edges = incomingEdges[currHyp];
+          LatticeEdge losingEdge = {loserPrev, curr, static_cast<float>(arcScore*scale), &loserHypo->GetCurrTargetPhrase()};
           edges.push_back(losingEdge);
-          ++numEdgesCreated;
         }
       }
     }
 
     //Now if a successor node has already been visited, add an edge connecting the two
-    map < const Hypothesis*, set < const Hypothesis* > >::const_iterator outgoingIt = outgoingHyps.find(currHyp);
-
-    if (outgoingIt != outgoingHyps.end()) {//currHyp does have successors
-      const set<const Hypothesis*> & outHyps = outgoingIt->second; //the successors
-      for (set<const Hypothesis*>::const_iterator outHypIts = outHyps.begin(); outHypIts != outHyps.end(); ++outHypIts) {
-        const Hypothesis* succHyp = *outHypIts;
-
-        if (survivingHyps.find(succHyp) == survivingHyps.end()) //Have we encountered the successor yet?
-          continue; //No, move on to next
-
-        //Curr Hyp can be : a) the best predecessor  of succ b) or an arc attached to succ
-        if (succHyp->GetPrevHypo() == currHyp) { //best predecessor
-          vector <Edge>& succEdges = incomingEdges[succHyp];
-          Edge succWinningEdge(currHyp, succHyp, scale*(succHyp->GetScore() - currHyp->GetScore()), succHyp->GetCurrTargetPhrase());
-          succEdges.push_back(succWinningEdge);
-          survivingHyps.insert(succHyp);
-          ++numEdgesCreated;
-        }
+    const vector<size_t>& outHyps = m_outgoing[curr];
+    for (size_t j = 0; j < outHyps.size(); ++j) {
+      const size_t succ = outHyps[j];
+      if (!surviving[succ]) //Have we encountered the successor yet?
+        continue; //No, move on to next
+      const Hypothesis* succHyp = m_hypos[succ];
+
+      //Curr Hyp can be : a) the best predecessor  of succ b) or an arc attached to succ
+      if (succHyp->GetPrevHypo() == currHyp) { //best predecessor
+        LatticeEdge succWinningEdge = {curr, succ, scale*(succHyp->GetScore() - currHyp->GetScore()), &succHyp->GetCurrTargetPhrase()};
+        edges.push_back(succWinningEdge);
+      }
 
-        //now, let's find an arc
-        const ArcList *arcList = succHyp->GetArcList();
-        if (arcList != NULL) {
-          ArcList::const_iterator iterArcList;
-          //QUESTION: What happens if there's more than one loserPrevHypo?
-          for (iterArcList = arcList->begin() ; iterArcList != arcList->end() ; ++iterArcList) {
-            const Hypothesis *loserHypo = *iterArcList;
-            const Hypothesis* loserPrevHypo = loserHypo->GetPrevHypo();
-            if (loserPrevHypo == currHyp) { //found it
-              vector <Edge>& succEdges = incomingEdges[succHyp];
-              double arcScore = loserHypo->GetScore() - currHyp->GetScore();
-              Edge losingEdge(currHyp, succHyp,scale* arcScore, loserHypo->GetCurrTargetPhrase());
-              succEdges.push_back(losingEdge);
-              ++numEdgesCreated;
-            }
+      //now, let's find an arc
+      const ArcList *arcList = succHyp->GetArcList();
+      if (arcList != NULL) {
+        ArcList::const_iterator iterArcList;
+        for (iterArcList = arcList->begin() ; iterArcList != arcList->end() ; ++iterArcList) {
+          const Hypothesis *loserHypo = *iterArcList;
+          if (loserHypo->GetPrevHypo() == currHyp) { //found it
+            double arcScore = loserHypo->GetScore() - currHyp->GetScore();
+            LatticeEdge losingEdge = {curr, succ, static_cast<float>(scale*arcScore), &loserHypo->GetCurrTargetPhrase()};
+            edges.push_back(losingEdge);
           }
         }
       }
     }
   }
 
-  connectedHyp.clear();
-  for (set <const Hypothesis*>::iterator it =  survivingHyps.begin(); it != survivingHyps.end(); ++it) {
-    connectedHyp.push_back(*it);
-  }
-
-  VERBOSE(2, "Done! Num edges created : "<< numEdgesCreated << ", numEdges wanted " << numEdgesTotal << endl)
-
-  IFVERBOSE(3) {
-    cerr << "Surviving hyps: " ;
-    for (set <const Hypothesis*>::iterator it =  survivingHyps.begin(); it != survivingHyps.end(); ++it) {
-      cerr << (*it)->GetId() << " ";
-    }
-    cerr << endl;
-  }
-
-
+  VERBOSE(2, "Done! Num edges created : "<< edges.size() << ", numEdges wanted " << numEdgesTotal << endl)
 }
 
-void calcNgramExpectations(Lattice & connectedHyp, map<const Hypothesis*, vector<Edge> >& incomingEdges,
-                           map<Phrase, float>& finalNgramScores, bool posteriors)
+void LatticeMBRSearchGraph::CalcNgramScores(size_t edgeDensity, float scale, bool posteriors, NgramScoreTable& ngramScores) const
 {
+  CHECK(bleu_order <= MAX_BLEU_ORDER);
 
-  sort(connectedHyp.begin(),connectedHyp.end(),ascendingCoverageCmp); //sort by increasing source word cov
-
-  /*cerr << "Lattice:" << endl;
-  for (Lattice::const_iterator i = connectedHyp.begin(); i != connectedHyp.end(); ++i) {
-      const Hypothesis* h = *i;
-      cerr << *h << endl;
-      const vector<Edge>& edges = incomingEdges[h];
-      for (size_t e = 0; e < edges.size(); ++e) {
-          cerr << edges[e];
-      }
-  }*/
-
-  map<const Hypothesis*, float> forwardScore;
-  forwardScore[connectedHyp[0]] = 0.0f; //forward score of hyp 0 is 1 (or 0 in logprob space)
-  set< const Hypothesis *> finalHyps; //store completed hyps
+  vector<size_t> survivors;
+  vector<LatticeEdge> edges;
+  Prune(edgeDensity, scale, survivors, edges);
 
-  NgramScores ngramScores;//ngram scores for each hyp
+  //every edge covers more source words, so this is a topological order
+  vector< pair<size_t, size_t> > nodes(survivors.size());
+  for (size_t i = 0; i < survivors.size(); ++i) {
+    nodes[i] = make_pair(m_hypos[survivors[i]]->GetWordsBitmap().GetNumWordsCovered(), survivors[i]);
+  }
+  sort(nodes.begin(), nodes.end());
 
-  for (size_t i = 1; i < connectedHyp.size(); ++i) {
-    const Hypothesis* currHyp = connectedHyp[i];
-    if (currHyp->GetWordsBitmap().IsComplete()) {
-      finalHyps.insert(currHyp);
-    }
+  vector< vector<size_t> > incoming(m_hypos.size());
+  vector<size_t> numOutgoing(m_hypos.size(), 0);
+  for (size_t e = 0; e < edges.size(); ++e) {
+    incoming[edges[e].head].push_back(e);
+    ++numOutgoing[edges[e].tail];
+  }
 
-    VERBOSE(3, "Processing hyp: " << currHyp->GetId() << ", num words cov= " << currHyp->GetWordsBitmap().GetNumWordsCovered() <<  endl)
-
-    vector <Edge> & edges = incomingEdges[currHyp];
-    for (size_t e = 0; e < edges.size(); ++e) {
-      const Edge& edge = edges[e];
-      if (forwardScore.find(currHyp) == forwardScore.end()) {
-        forwardScore[currHyp] = forwardScore[edge.GetTailNode()] + edge.GetScore();
-        VERBOSE(3, "Fwd score["<<currHyp->GetId()<<"] = fwdScore["<<edge.GetTailNode()->GetId() << "] + edge Score: " << edge.GetScore() << endl)
-      } else {
-        forwardScore[currHyp] = log_sum(forwardScore[currHyp], forwardScore[edge.GetTailNode()] + edge.GetScore());
-        VERBOSE(3, "Fwd score["<<currHyp->GetId()<<"] += fwdScore["<<edge.GetTailNode()->GetId() << "] + edge Score: " << edge.GetScore() << endl)
+  //hyps without incoming edges keep a forward score of 1 (0 in logprob space), like hyp 0
+  vector<float> forwardScore(m_hypos.size(), 0.0f);
+  vector< vector<EdgeNgram> > edgeNgrams(edges.size());
+  vector< vector<NgramLogScore> > nodeScores(m_hypos.size()); //ngram scores for each hyp, sorted
+  vector<NgramLogScore> finalScores;
+  vector<float> finalForwardScores;
+  vector<NgramKey> edgeKeys;
+  vector<float> scratch;
+
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const size_t curr = nodes[i].second;
+    const vector<size_t>& currIncoming = incoming[curr];
+
+    VERBOSE(3, "Processing hyp: " << m_hypos[curr]->GetId() << ", num words cov= " << nodes[i].first << endl)
+
+    if (!currIncoming.empty()) {
+      scratch.clear();
+      for (size_t e = 0; e < currIncoming.size(); ++e) {
+        const LatticeEdge& edge = edges[currIncoming[e]];
+        scratch.push_back(forwardScore[edge.tail] + edge.score);
       }
+      forwardScore[curr] = LogSumExp(scratch);
     }
 
-    //Process ngrams now
-    for (size_t j =0 ; j < edges.size(); ++j) {
-      Edge& edge = edges[j];
-      const NgramHistory & incomingPhrases = edge.GetNgrams(incomingEdges);
+    vector<NgramLogScore>& scores = nodeScores[curr];
+    for (size_t e = 0; e < currIncoming.size(); ++e) {
+      const LatticeEdge& edge = edges[currIncoming[e]];
+      vector<EdgeNgram>& ngrams = edgeNgrams[currIncoming[e]];
+      GetEdgeNgrams(currIncoming[e], incoming[edge.tail], edges, edgeNgrams, ngrams);
 
       //let's first score ngrams introduced by this edge
-      for (NgramHistory::const_iterator it = incomingPhrases.begin(); it != incomingPhrases.end(); ++it) {
-        const Phrase& ngram = it->first;
-        const PathCounts& pathCounts = it->second;
-        VERBOSE(4, "Calculating score for: " << it->first << endl)
-
-        for (PathCounts::const_iterator pathCountIt = pathCounts.begin(); pathCountIt != pathCounts.end(); ++pathCountIt) {
-          //Score of an n-gram is forward score of head node of leftmost edge + all edge scores
-          const Path&  path = pathCountIt->first;
-          //cerr << "path count for " << ngram << " is " << pathCountIt->second << endl;
-          float score = forwardScore[path[0]->GetTailNode()];
-          for (size_t i = 0; i < path.size(); ++i) {
-            score += path[i]->GetScore();
-          }
-          //if we're doing expectations, then the number of times the ngram
-          //appears on the path is relevant.
-          size_t count = posteriors ? 1 : pathCountIt->second;
-          for (size_t k = 0; k < count; ++k) {
-            ngramScores.addScore(currHyp,ngram,score);
-          }
+      edgeKeys.clear();
+      for (size_t j = 0; j < ngrams.size(); ++j) {
+        const EdgeNgram& ngram = ngrams[j];
+        //Score of an n-gram is forward score of tail of leftmost edge + all edge scores. If we're doing
+        //expectations, then the number of times the ngram appears on the path is relevant.
+        float score = forwardScore[ngram.origin] + ngram.pathScore;
+        if (!posteriors && ngram.count > 1) {
+          score += log((float)ngram.count);
         }
+        scores.push_back(NgramLogScore(ngram.key, score, ngram.order));
+        edgeKeys.push_back(ngram.key);
       }
+      sort(edgeKeys.begin(), edgeKeys.end());
 
       //Now score ngrams that are just being propagated from the history
-      for (NgramScores::NodeScoreIterator it = ngramScores.nodeBegin(edge.GetTailNode());
-           it != ngramScores.nodeEnd(edge.GetTailNode()); ++it) {
-        const Phrase & currNgram = *(it->first);
-        float currNgramScore = it->second;
-        VERBOSE(4, "Calculating score for: " << currNgram << endl)
-
+      const vector<NgramLogScore>& tailScores = nodeScores[edge.tail];
+      for (size_t j = 0; j < tailScores.size(); ++j) {
         // For posteriors, don't double count ngrams
-        if (!posteriors || incomingPhrases.find(currNgram) == incomingPhrases.end()) {
-          float score = edge.GetScore() + currNgramScore;
-          ngramScores.addScore(currHyp,currNgram,score);
+        if (!posteriors || !binary_search(edgeKeys.begin(), edgeKeys.end(), tailScores[j].key)) {
+          scores.push_back(NgramLogScore(tailScores[j].key, edge.score + tailScores[j].score, tailScores[j].order));
         }
       }
 
-    }
-  }
-
-  float Z = 9999999; //the total score of the lattice
-
-  //Done - Print out ngram posteriors for final hyps
-  for (set< const Hypothesis *>::iterator finalHyp = finalHyps.begin(); finalHyp != finalHyps.end(); ++finalHyp) {
-    const Hypothesis* hyp = *finalHyp;
-
-    for (NgramScores::NodeScoreIterator it = ngramScores.nodeBegin(hyp); it != ngramScores.nodeEnd(hyp); ++it) {
-      const Phrase& ngram = *(it->first);
-      if (finalNgramScores.find(ngram) == finalNgramScores.end()) {
-        finalNgramScores[ngram] = it->second;
-      } else {
-        finalNgramScores[ngram] = log_sum(it->second,  finalNgramScores[ngram]);
+      //all successors of the tail seen, so its scores and the n-grams of its edges aren't needed any more
+      if (--numOutgoing[edge.tail] == 0) {
+        vector<NgramLogScore>().swap(nodeScores[edge.tail]);
+        for (size_t j = 0; j < incoming[edge.tail].size(); ++j) {
+          vector<EdgeNgram>().swap(edgeNgrams[incoming[edge.tail][j]]);
+        }
       }
     }
+    MergeNgramScores(scores, scratch);
 
-    if (Z == 9999999) {
-      Z = forwardScore[hyp];
-    } else {
-      Z = log_sum(Z, forwardScore[hyp]);
+    if (i > 0 && m_hypos[curr]->GetWordsBitmap().IsComplete()) {
+      finalScores.insert(finalScores.end(), scores.begin(), scores.end());
+      finalForwardScores.push_back(forwardScore[curr]);
     }
   }
 
-  //Z *= scale;  //scale the score
-
-  for (map<Phrase, float>::iterator finalScoresIt = finalNgramScores.begin();  finalScoresIt != finalNgramScores.end(); ++finalScoresIt) {
-    finalScoresIt->second =  finalScoresIt->second - Z;
-    IFVERBOSE(2) {
-      VERBOSE(2,finalScoresIt->first << " [" << finalScoresIt->second << "]" << endl);
-    }
+  ngramScores.assign(bleu_order, boost::unordered_map<NgramKey, float>());
+  if (finalForwardScores.empty()) {
+    return;
   }
 
+  //the total score of the lattice
+  const float Z = LogSumExp(finalForwardScores);
+  MergeNgramScores(finalScores, scratch);
+  for (size_t i = 0; i < finalScores.size(); ++i) {
+    ngramScores[finalScores[i].order - 1][finalScores[i].key] = finalScores[i].score - Z;
+  }
+  VERBOSE(2, "Lattice has " << finalScores.size() << " ngrams, total score " << Z << endl);
 }
 
-const NgramHistory& Edge::GetNgrams(map<const Hypothesis*, vector<Edge> > & incomingEdges)
+LatticeMBRSolution::LatticeMBRSolution(const TrellisPath& path, bool isMap) :
+  m_score(0.0f)
 {
+  const std::vector<const Hypothesis *> &edges = path.GetEdges();
 
-  if (m_ngrams.size() > 0)
-    return m_ngrams;
-
-  const Phrase& currPhrase = GetWords();
-  //Extract the n-grams local to this edge
-  for (size_t start = 0; start < currPhrase.GetSize(); ++start) {
-    for (size_t end = start; end < start + bleu_order; ++end) {
-      if (end < currPhrase.GetSize()) {
-        Phrase edgeNgram(end-start+1);
-        for (size_t index = start; index <= end; ++index) {
-          edgeNgram.AddWord(currPhrase.GetWord(index));
-        }
-        //cout << "Inserting Phrase : " << edgeNgram << endl;
-        vector<const Edge*> edgeHistory;
-        edgeHistory.push_back(this);
-        storeNgramHistory(edgeNgram, edgeHistory);
-      } else {
-        break;
-      }
+  for (int currEdge = (int)edges.size() - 1 ; currEdge >= 0 ; currEdge--) {
+    const Hypothesis &edge = *edges[currEdge];
+    const Phrase &phrase = edge.GetCurrTargetPhrase();
+    size_t size = phrase.GetSize();
+    for (size_t pos = 0 ; pos < size ; pos++) {
+      m_words.push_back(phrase.GetWord(pos));
     }
   }
+  if (isMap) {
+    m_mapScore = path.GetTotalScore();
+  } else {
+    m_mapScore = 0;
+  }
+}
 
-  map<const Hypothesis*, vector<Edge> >::iterator it = incomingEdges.find(m_tailNode);
-  if (it != incomingEdges.end()) { //node has incoming edges
-    vector<Edge> & inEdges = it->second;
-
-    for (vector<Edge>::iterator edge = inEdges.begin(); edge != inEdges.end(); ++edge) {//add the ngrams straddling prev and curr edge
-      const NgramHistory & edgeIncomingNgrams = edge->GetNgrams(incomingEdges);
-      for (NgramHistory::const_iterator edgeInNgramHist = edgeIncomingNgrams.begin(); edgeInNgramHist != edgeIncomingNgrams.end(); ++edgeInNgramHist) {
-        const Phrase& edgeIncomingNgram = edgeInNgramHist->first;
-        const PathCounts &  edgeIncomingNgramPaths = edgeInNgramHist->second;
-        size_t back = min(edgeIncomingNgram.GetSize(), edge->GetWordsSize());
-        const Phrase&  edgeWords = edge->GetWords();
-        IFVERBOSE(3) {
-          cerr << "Edge: "<< *edge <<endl;
-          cerr << "edgeWords: " << edgeWords << endl;
-          cerr << "edgeInNgram: " << edgeIncomingNgram << endl;
-        }
 
-        Phrase edgeSuffix(ARRAY_SIZE_INCR);
-        Phrase ngramSuffix(ARRAY_SIZE_INCR);
-        GetPhraseSuffix(edgeWords,back,edgeSuffix);
-        GetPhraseSuffix(edgeIncomingNgram,back,ngramSuffix);
-
-        if (ngramSuffix == edgeSuffix) { //we've got the suffix of previous edge
-          size_t  edgeInNgramSize =  edgeIncomingNgram.GetSize();
-
-          for (size_t i = 0; i < GetWordsSize() && i + edgeInNgramSize < bleu_order ; ++i) {
-            Phrase newNgram(edgeIncomingNgram);
-            for (size_t j = 0; j <= i ; ++j) {
-              newNgram.AddWord(GetWords().GetWord(j));
-            }
-            VERBOSE(3, "Inserting New Phrase : " << newNgram << endl)
-
-            for (PathCounts::const_iterator pathIt = edgeIncomingNgramPaths.begin(); pathIt !=  edgeIncomingNgramPaths.end(); ++pathIt) {
-              Path newNgramPath = pathIt->first;
-              newNgramPath.push_back(this);
-              storeNgramHistory(newNgram, newNgramPath, pathIt->second);
-            }
-          }
-        }
+
+void LatticeMBRSolution::CalcScore(const NgramScoreTable& finalNgramScores, const vector<float>& thetas, float mapWeight)
+{
+  m_ngramScores.assign(thetas.size()-1, -10000);
+
+  NgramCounts counts;
+  extract_ngrams(m_words,counts);
+
+  //Now score this translation
+  m_score = thetas[0] * m_words.size();
+
+  //Calculate the ngramScores, working in log space at first
+  for (size_t order = 0; order < counts.size(); ++order) {
+    const boost::unordered_map<NgramKey, float>& posteriors = finalNgramScores[order];
+    for (boost::unordered_map<NgramKey, int>::const_iterator ngrams = counts[order].begin(); ngrams != counts[order].end(); ++ngrams) {
+      float ngramPosterior = UNKNGRAMLOGPROB;
+      boost::unordered_map<NgramKey, float>::const_iterator ngramPosteriorIt = posteriors.find(ngrams->first);
+      if (ngramPosteriorIt != posteriors.end()) {
+        ngramPosterior = ngramPosteriorIt->second;
       }
+      m_ngramScores[order] = log_sum(log((float)ngrams->second) + ngramPosterior,m_ngramScores[order]);
     }
   }
-  return m_ngrams;
-}
 
-//Add the last lastN words of origPhrase to targetPhrase
-void Edge::GetPhraseSuffix(const Phrase&  origPhrase, size_t lastN, Phrase& targetPhrase) const
-{
-  size_t origSize = origPhrase.GetSize();
-  size_t startIndex = origSize - lastN;
-  for (size_t index = startIndex; index < origPhrase.GetSize(); ++index) {
-    targetPhrase.AddWord(origPhrase.GetWord(index));
+  //convert from log to probability and create weighted sum
+  for (size_t i = 0; i < m_ngramScores.size(); ++i) {
+    m_ngramScores[i] = exp(m_ngramScores[i]);
+    m_score += thetas[i+1] * m_ngramScores[i];
   }
-}
 
-bool Edge::operator< (const Edge& compare ) const
-{
-  if (m_headNode->GetId() < compare.m_headNode->GetId())
-    return true;
-  if (compare.m_headNode->GetId() < m_headNode->GetId())
-    return false;
-  if (m_tailNode->GetId() < compare.m_tailNode->GetId())
-    return true;
-  if (compare.m_tailNode->GetId() < m_tailNode->GetId())
-    return false;
-  return GetScore() <  compare.GetScore();
-}
 
-ostream& operator<< (ostream& out, const Edge& edge)
-{
-  out << "Head: " << edge.m_headNode->GetId() << ", Tail: " << edge.m_tailNode->GetId() << ", Score: " << edge.m_score << ", Phrase: " << edge.m_targetPhrase << endl;
-  return out;
+  //The map score
+  m_score += m_mapScore*mapWeight;
 }
 
 bool ascendingCoverageCmp(const Hypothesis* a, const Hypothesis* b)
@@ -500,16 +521,16 @@ void getLatticeMBRNBest(Manager& manager, TrellisPathList& nBestList,
                         vector<LatticeMBRSolution>& solutions, size_t n)
 {
   const StaticData& staticData = StaticData::Instance();
-  std::map < int, bool > connected;
-  std::vector< const Hypothesis *> connectedList;
-  map<Phrase, float> ngramPosteriors;
-  std::map < const Hypothesis*, set <const Hypothesis*> > outgoingHyps;
-  map<const Hypothesis*, vector<Edge> > incomingEdges;
-  vector< float> estimatedScores;
-  manager.GetForwardBackwardSearchGraph(&connected, &connectedList, &outgoingHyps, &estimatedScores);
-  pruneLatticeFB(connectedList, outgoingHyps, incomingEdges, estimatedScores, manager.GetBestHypothesis(), staticData.GetLatticeMBRPruningFactor(),staticData.GetMBRScale());
-  calcNgramExpectations(connectedList, incomingEdges, ngramPosteriors,true);
+  NgramScoreTable ngramPosteriors;
+  LatticeMBRSearchGraph searchGraph(manager);
+  searchGraph.CalcNgramScores(staticData.GetLatticeMBRPruningFactor(), staticData.GetMBRScale(), true, ngramPosteriors);
+  getLatticeMBRNBest(ngramPosteriors, nBestList, solutions, n);
+}
 
+void getLatticeMBRNBest(const NgramScoreTable& ngramPosteriors, TrellisPathList& nBestList,
+                        vector<LatticeMBRSolution>& solutions, size_t n)
+{
+  const StaticData& staticData = StaticData::Instance();
   vector<float> mbrThetas = staticData.GetLatticeMBRThetas();
   float p = staticData.GetLatticeMBRPrecision();
   float r = staticData.GetLatticeMBRPRatio();
@@ -558,27 +579,16 @@ const TrellisPath doConsensusDecoding(Manager& manager, TrellisPathList& nBestLi
 
   //calculate the ngram expectations
   const StaticData& staticData = StaticData::Instance();
-  std::map < int, bool > connected;
-  std::vector< const Hypothesis *> connectedList;
-  map<Phrase, float> ngramExpectations;
-  std::map < const Hypothesis*, set <const Hypothesis*> > outgoingHyps;
-  map<const Hypothesis*, vector<Edge> > incomingEdges;
-  vector< float> estimatedScores;
-  manager.GetForwardBackwardSearchGraph(&connected, &connectedList, &outgoingHyps, &estimatedScores);
-  pruneLatticeFB(connectedList, outgoingHyps, incomingEdges, estimatedScores, manager.GetBestHypothesis(), staticData.GetLatticeMBRPruningFactor(),staticData.GetMBRScale());
-  calcNgramExpectations(connectedList, incomingEdges, ngramExpectations,false);
+  NgramScoreTable ngramExpectations;
+  LatticeMBRSearchGraph searchGraph(manager);
+  searchGraph.CalcNgramScores(staticData.GetLatticeMBRPruningFactor(), staticData.GetMBRScale(), false, ngramExpectations);
 
   //expected length is sum of expected unigram counts
   //cerr << "Thread " << pthread_self() <<  " Ngram expectations size: " << ngramExpectations.size() << endl;
   float ref_length = 0.0f;
-  for (map<Phrase,float>::const_iterator ref_iter = ngramExpectations.begin();
-       ref_iter != ngramExpectations.end(); ++ref_iter) {
-    //cerr << "Ngram: " << ref_iter->first << " score: " <<
-    //    ref_iter->second << endl;
-    if (ref_iter->first.GetSize() == 1) {
-      ref_length += exp(ref_iter->second);
-      //    cerr << "Expected for " << ref_iter->first << " is " << exp(ref_iter->second) << endl;
-    }
+  for (boost::unordered_map<NgramKey,float>::const_iterator ref_iter = ngramExpectations[0].begin();
+       ref_iter != ngramExpectations[0].end(); ++ref_iter) {
+    ref_length += exp(ref_iter->second);
   }
 
   VERBOSE(2,"REF Length: " << ref_length << endl);
@@ -591,7 +601,7 @@ const TrellisPath doConsensusDecoding(Manager& manager, TrellisPathList& nBestLi
   for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
     const TrellisPath &path = **iter;
     vector<Word> words;
-    map<Phrase,int> ngrams;
+    NgramCounts ngrams;
     GetOutputWords(path,words);
     /*for (size_t i = 0; i < words.size(); ++i) {
         cerr << words[i].GetFactor(0)->GetString() << " ";
@@ -609,13 +619,15 @@ const TrellisPath doConsensusDecoding(Manager& manager, TrellisPathList& nBestLi
       comps[2*i+1] = max(hyp_length-i,0);
     }
 
-    for (map<Phrase,int>::const_iterator hyp_iter = ngrams.begin();
-         hyp_iter != ngrams.end(); ++hyp_iter) {
-      map<Phrase,float>::const_iterator ref_iter = ngramExpectations.find(hyp_iter->first);
-      if (ref_iter != ngramExpectations.end()) {
-        comps[2*(hyp_iter->first.GetSize()-1)] += min(exp(ref_iter->second), (float)(hyp_iter->second));
+    for (size_t order = 0; order < ngrams.size(); ++order) {
+      const boost::unordered_map<NgramKey,float>& expectations = ngramExpectations[order];
+      for (boost::unordered_map<NgramKey,int>::const_iterator hyp_iter = ngrams[order].begin();
+           hyp_iter != ngrams[order].end(); ++hyp_iter) {
+        boost::unordered_map<NgramKey,float>::const_iterator ref_iter = expectations.find(hyp_iter->first);
+        if (ref_iter != expectations.end()) {
+          comps[2*order] += min(exp(ref_iter->second), (float)(hyp_iter->second));
+        }
       }
-
     }
     comps[comps.size()-1] = ref_length;
     /*for (size_t i = 0; i < comps.size(); ++i) {
@@ -13,90 +13,56 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <boost/unordered_map.hpp>
 #include "Hypothesis.h"
 #include "Manager.h"
 #include "TrellisPathList.h"
 
 using namespace Moses;
 
+/** An n-gram is identified by a 64 bit hash of its words, built up a word at a time with ExtendNgram(). */
+typedef unsigned long long NgramKey;
+const NgramKey EMPTY_NGRAM = 0;
+NgramKey ExtendNgram(NgramKey ngram, const Word &word);
 
+/** Log posteriors (or log expected counts) of n-grams, one table per n-gram order (index 0 for unigrams) */
+typedef std::vector< boost::unordered_map<NgramKey, float> > NgramScoreTable;
 
-class Edge;
-
-typedef std::vector< const Hypothesis *> Lattice;
-typedef std::vector<const Edge*> Path;
-typedef std::map<Path, size_t> PathCounts;
-typedef std::map<Phrase, PathCounts > NgramHistory;
-
-class Edge
-{
-  const Hypothesis* m_tailNode;
-  const Hypothesis* m_headNode;
-  float m_score;
-  TargetPhrase m_targetPhrase;
-  NgramHistory m_ngrams;
-
-public:
-  Edge(const Hypothesis* from, const Hypothesis* to, float score, const TargetPhrase& targetPhrase) : m_tailNode(from), m_headNode(to), m_score(score), m_targetPhrase(targetPhrase) {
-    //cout << "Creating new edge from Node " << from->GetId() << ", to Node : " << to->GetId() << ", score: " << score << " phrase: " << targetPhrase << endl;
-  }
-
-  const Hypothesis* GetHeadNode() const {
-    return m_headNode;
-  }
-
-  const Hypothesis* GetTailNode() const {
-    return m_tailNode;
-  }
-
-  float GetScore() const {
-    return m_score;
-  }
-
-  size_t GetWordsSize() const {
-    return m_targetPhrase.GetSize();
-  }
-
-  const Phrase& GetWords() const {
-    return m_targetPhrase;
-  }
-
-  friend std::ostream& operator<< (std::ostream& out, const Edge& edge);
-
-  const NgramHistory&  GetNgrams(  std::map<const Hypothesis*, std::vector<Edge> > & incomingEdges) ;
-
-  bool operator < (const Edge & compare) const;
-
-  void GetPhraseSuffix(const Phrase& origPhrase, size_t lastN, Phrase& targetPhrase) const;
-
-  void storeNgramHistory(const Phrase& phrase, Path & path, size_t count = 1) {
-    m_ngrams[phrase][path]+= count;
-  }
-
-};
+/** Counts of the n-grams of a sentence, one table per n-gram order */
+typedef std::vector< boost::unordered_map<NgramKey, int> > NgramCounts;
 
 /**
-* Data structure to hold the ngram scores as we traverse the lattice. Maps (hypo,ngram) to score
+* The search graph of a sentence in the form needed by lattice MBR and consensus decoding.
+* The forward-backward scores are computed once, so that the lattice can be pruned and
+* scored for several settings (see LatticeMBRGrid).
 */
-class NgramScores
+class LatticeMBRSearchGraph
 {
 public:
-  NgramScores() {}
+  LatticeMBRSearchGraph(const Manager& manager);
 
-  /** logsum this score to the existing score */
-  void addScore(const Hypothesis* node, const Phrase& ngram, float score);
+  /** Calculate the n-gram scores over the lattice pruned to edgeDensity edges per word of the best
+   * translation, with edge scores scaled by scale. Expected counts are clipped at 1 (ie posteriors
+   * are calculated) if posteriors==true. */
+  void CalcNgramScores(size_t edgeDensity, float scale, bool posteriors, NgramScoreTable& ngramScores) const;
 
-  /** Iterate through ngrams for selected node */
-  typedef std::map<const Phrase*, float>::const_iterator NodeScoreIterator;
-  NodeScoreIterator nodeBegin(const Hypothesis* node);
-  NodeScoreIterator nodeEnd(const Hypothesis* node);
+  struct LatticeEdge {
+    size_t tail, head; //< indices of hypotheses
+    float score;
+    const Phrase* words;
+  };
 
 private:
-  std::set<Phrase> m_ngrams;
-  std::map<const Hypothesis*, std::map<const Phrase*, float> > m_scores;
+  void Prune(size_t edgeDensity, float scale, std::vector<size_t>& survivors, std::vector<LatticeEdge>& edges) const;
+  size_t GetIndex(const Hypothesis* hypo) const;
+
+  std::vector<const Hypothesis*> m_hypos; //< connected hypotheses, followed by the empty hypothesis
+  std::vector< std::vector<size_t> > m_outgoing;
+  std::vector<float> m_estimatedScores;
+  boost::unordered_map<const Hypothesis*, size_t> m_index;
+  const Hypothesis* m_bestHypo;
 };
 
-
 /** Holds a lattice mbr solution, and its scores */
 class LatticeMBRSolution
 {
@@ -117,7 +83,7 @@ public:
   }
 
   /** Initialise ngram scores */
-  void CalcScore(std::map<Phrase, float>& finalNgramScores, const std::vector<float>& thetas, float mapWeight);
+  void CalcScore(const NgramScoreTable& finalNgramScores, const std::vector<float>& thetas, float mapWeight);
 
 private:
   std::vector<Word> m_words;
@@ -132,16 +98,11 @@ struct LatticeMBRSolutionComparator {
   }
 };
 
-void pruneLatticeFB(Lattice & connectedHyp, std::map < const Hypothesis*, std::set <const Hypothesis* > > & outgoingHyps, std::map<const Hypothesis*, std::vector<Edge> >& incomingEdges,
-                    const std::vector< float> & estimatedScores, const Hypothesis*, size_t edgeDensity,float scale);
-
 //Use the ngram scores to rerank the nbest list, return at most n solutions
 void getLatticeMBRNBest(Manager& manager, TrellisPathList& nBestList, std::vector<LatticeMBRSolution>& solutions, size_t n);
-//calculate expectated ngram counts, clipping at 1 (ie calculating posteriors) if posteriors==true.
-void calcNgramExpectations(Lattice & connectedHyp, std::map<const Hypothesis*, std::vector<Edge> >& incomingEdges, std::map<Phrase,
-                           float>& finalNgramScores, bool posteriors);
+void getLatticeMBRNBest(const NgramScoreTable& ngramPosteriors, TrellisPathList& nBestList, std::vector<LatticeMBRSolution>& solutions, size_t n);
 void GetOutputFactors(const TrellisPath &path, std::vector <Word> &translation);
-void extract_ngrams(const std::vector<Word >& sentence, std::map < Phrase, int >  & allngrams);
+void extract_ngrams(const std::vector<Word >& sentence, NgramCounts& allngrams);
 bool ascendingCoverageCmp(const Hypothesis* a, const Hypothesis* b);
 std::vector<Word> doLatticeMBR(Manager& manager, TrellisPathList& nBestList);
 const TrellisPath doConsensusDecoding(Manager& manager, TrellisPathList& nBestList);
@@ -178,6 +178,10 @@ int main(int argc, char* argv[])
     manager.ProcessSentence();
     TrellisPathList nBestList;
     manager.CalcNBest(nBestSize, nBestList,true);
+    //the n-gram posteriors only depend on the pruning and the scale, so they are
+    //calculated once for each of those, on the same lattice
+    LatticeMBRSearchGraph searchGraph(manager);
+    map<pair<size_t, float>, NgramScoreTable> ngramPosteriors;
     //grid search
     for (vector<float>::const_iterator pi = pgrid.begin(); pi != pgrid.end(); ++pi) {
       float p = *pi;
@@ -192,7 +196,13 @@ int main(int argc, char* argv[])
             float scale = *scale_i;
             staticData.SetMBRScale(scale);
             cout << lineCount << " ||| " << p << " " << r << " " << prune << " " << scale << " ||| ";
-            vector<Word> mbrBestHypo = doLatticeMBR(manager,nBestList);
+            pair<size_t, float> pruneAndScale(prune, scale);
+            if (ngramPosteriors.find(pruneAndScale) == ngramPosteriors.end()) {
+              searchGraph.CalcNgramScores(prune, scale, true, ngramPosteriors[pruneAndScale]);
+            }
+            vector<LatticeMBRSolution> solutions;
+            getLatticeMBRNBest(ngramPosteriors[pruneAndScale], nBestList, solutions, 1);
+            const vector<Word>& mbrBestHypo = solutions.at(0).GetWords();
             OutputBestHypo(mbrBestHypo, lineCount, staticData.GetReportSegmentation(),
                            staticData.GetReportAllFactors(),cout);
           }
@@ -24,9 +24,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  **/
 
 #include <fstream>
+#include <limits>
 #include <sstream>
 #include <vector>
 
+#include <unistd.h>
+
 #ifdef WIN32
 // Include Visual Leak Detector
 //#include <vld.h>
@@ -41,7 +44,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "mbr.h"
 #include "ThreadPool.h"
 #include "TranslationAnalysis.h"
-#include "OutputCollector.h"
+#include "OutputWriter.h"
+#include "ProcessPool.h"
+#include "SearchGraphBinary.h"
 
 #ifdef HAVE_PROTOBUF
 #include "hypergraph.pb.h"
@@ -53,6 +58,23 @@ using namespace Moses;
 // output floats with three significant digits
 static const size_t PRECISION = 3;
 
+// sentences read ahead of the translation threads, per thread
+static const size_t READ_AHEAD = 4;
+
+// the outputs of a sentence, in the order they go to the OutputWriter
+enum OutputType {
+  BestOutput,
+  DebugOutput,
+  NBestOutput,
+  LatticeSamplesOutput,
+  WordGraphOutput,
+  SearchGraphOutput,
+  SearchGraphBinaryOutput,
+  DetailedTranslationOutput,
+  AlignmentOutput,
+  NumOutputs
+};
+
 /** Enforce rounding */
 void fix(std::ostream& stream, size_t size)
 {
@@ -70,18 +92,9 @@ class TranslationTask : public Task
 
 public:
 
-  TranslationTask(size_t lineNumber,
-                  InputType* source, OutputCollector* outputCollector, OutputCollector* nbestCollector,
-                  OutputCollector* latticeSamplesCollector,
-                  OutputCollector* wordGraphCollector, OutputCollector* searchGraphCollector,
-                  OutputCollector* detailedTranslationCollector,
-                  OutputCollector* alignmentInfoCollector ) :
-    m_source(source), m_lineNumber(lineNumber),
-    m_outputCollector(outputCollector), m_nbestCollector(nbestCollector),
-    m_latticeSamplesCollector(latticeSamplesCollector),
-    m_wordGraphCollector(wordGraphCollector), m_searchGraphCollector(searchGraphCollector),
-    m_detailedTranslationCollector(detailedTranslationCollector),
-    m_alignmentInfoCollector(alignmentInfoCollector) {}
+  TranslationTask(size_t lineNumber, InputType* source, const vector<ostream*> &streams,
+                  OutputWriter* writer) :
+    m_source(source), m_lineNumber(lineNumber), m_streams(streams), m_writer(writer) {}
 
 	/** Translate one sentence
    * gets called by main function implemented at end of this source file */
@@ -105,20 +118,23 @@ public:
     Manager manager(*m_source,staticData.GetSearchAlgorithm(), &system);
     manager.ProcessSentence();
 
+    // all outputs of the sentence, handed to the writer at the end
+    vector<string> outputs(NumOutputs);
+
     // output word graph
-    if (m_wordGraphCollector) {
+    if (Wanted(WordGraphOutput)) {
       ostringstream out;
       fix(out,PRECISION);
       manager.GetWordGraph(m_lineNumber, out);
-      m_wordGraphCollector->Write(m_lineNumber, out.str());
+      outputs[WordGraphOutput] = out.str();
     }
 
     // output search graph
-    if (m_searchGraphCollector) {
+    if (Wanted(SearchGraphOutput)) {
       ostringstream out;
       fix(out,PRECISION);
       manager.OutputSearchGraph(m_lineNumber, out);
-      m_searchGraphCollector->Write(m_lineNumber, out.str());
+      outputs[SearchGraphOutput] = out.str();
 
 #ifdef HAVE_PROTOBUF
       if (staticData.GetOutputSearchGraphPB()) {
@@ -132,8 +148,13 @@ public:
 #endif
     }		
 
+    // output search graph in binary format
+    if (Wanted(SearchGraphBinaryOutput)) {
+      manager.OutputSearchGraphBinary(m_lineNumber, outputs[SearchGraphBinaryOutput]);
+    }
+
     // apply decision rule and output best translation(s)
-    if (m_outputCollector) {
+    if (Wanted(BestOutput)) {
       ostringstream out;
       ostringstream debug;
       fix(debug,PRECISION);
@@ -159,7 +180,11 @@ public:
             staticData.GetOutputFactorOrder(),
             staticData.GetReportSegmentation(),
             staticData.GetReportAllFactors());
-          OutputAlignment(m_alignmentInfoCollector, m_lineNumber, bestHypo);
+          if (Wanted(AlignmentOutput)) {
+            ostringstream alignment;
+            OutputAlignment(alignment, bestHypo);
+            outputs[AlignmentOutput] = alignment.str();
+          }
           IFVERBOSE(1) {
             debug << "BEST TRANSLATION: " << *bestHypo << endl;
           }
@@ -185,14 +210,14 @@ public:
 
         // lattice MBR
         if (staticData.UseLatticeMBR()) {
-          if (m_nbestCollector) {
+          if (Wanted(NBestOutput)) {
             //lattice mbr nbest
             vector<LatticeMBRSolution> solutions;
             size_t n  = min(nBestSize, staticData.GetNBestSize());
             getLatticeMBRNBest(manager,nBestList,solutions,n);
             ostringstream out;
             OutputLatticeMBRNBest(out, solutions,m_lineNumber);
-            m_nbestCollector->Write(m_lineNumber, out.str());
+            outputs[NBestOutput] = out.str();
           } else {
             //Lattice MBR decoding
             vector<Word> mbrBestHypo = doLatticeMBR(manager,nBestList);
@@ -210,7 +235,11 @@ public:
           OutputBestHypo(conBestHypo, m_lineNumber,
                          staticData.GetReportSegmentation(),
                          staticData.GetReportAllFactors(),out);
-          OutputAlignment(m_alignmentInfoCollector, m_lineNumber, conBestHypo);
+          if (Wanted(AlignmentOutput)) {
+            ostringstream alignment;
+            OutputAlignment(alignment, conBestHypo);
+            outputs[AlignmentOutput] = alignment.str();
+          }
           IFVERBOSE(2) {
             PrintUserTime("finished Consensus decoding");
           }
@@ -222,43 +251,50 @@ public:
           OutputBestHypo(mbrBestHypo, m_lineNumber,
                          staticData.GetReportSegmentation(),
                          staticData.GetReportAllFactors(),out);
-          OutputAlignment(m_alignmentInfoCollector, m_lineNumber, mbrBestHypo);
+          if (Wanted(AlignmentOutput)) {
+            ostringstream alignment;
+            OutputAlignment(alignment, mbrBestHypo);
+            outputs[AlignmentOutput] = alignment.str();
+          }
           IFVERBOSE(2) {
             PrintUserTime("finished MBR decoding");
           }
         }
       }
 
-      // report best translation to output collector
-      m_outputCollector->Write(m_lineNumber,out.str(),debug.str());
+      // report best translation
+      outputs[BestOutput] = out.str();
+      outputs[DebugOutput] = debug.str();
     }
 
     // output n-best list
-    if (m_nbestCollector && !staticData.UseLatticeMBR()) {
+    if (Wanted(NBestOutput) && !staticData.UseLatticeMBR()) {
       TrellisPathList nBestList;
       ostringstream out;
       manager.CalcNBest(staticData.GetNBestSize(), nBestList,staticData.GetDistinctNBest());
       OutputNBest(out,nBestList, staticData.GetOutputFactorOrder(), manager.GetTranslationSystem(), m_lineNumber);
-      m_nbestCollector->Write(m_lineNumber, out.str());
+      outputs[NBestOutput] = out.str();
     }
 
     //lattice samples
-    if (m_latticeSamplesCollector) {
+    if (Wanted(LatticeSamplesOutput)) {
       TrellisPathList latticeSamples;
       ostringstream out;
       manager.CalcLatticeSamples(staticData.GetLatticeSamplesSize(), latticeSamples);
       OutputNBest(out,latticeSamples, staticData.GetOutputFactorOrder(), manager.GetTranslationSystem(), m_lineNumber);
-      m_latticeSamplesCollector->Write(m_lineNumber, out.str());
+      outputs[LatticeSamplesOutput] = out.str();
     }
 
     // detailed translation reporting
-    if (m_detailedTranslationCollector) {
+    if (Wanted(DetailedTranslationOutput)) {
       ostringstream out;
       fix(out,PRECISION);
       TranslationAnalysis::PrintTranslationAnalysis(manager.GetTranslationSystem(), out, manager.GetBestHypothesis());
-      m_detailedTranslationCollector->Write(m_lineNumber,out.str());
+      outputs[DetailedTranslationOutput] = out.str();
     }
 
+    Output(m_lineNumber, outputs);
+
     // report additional statistics
     IFVERBOSE(2) {
       PrintUserTime("Sentence Decoding Time:");
@@ -270,20 +306,44 @@ public:
     delete m_source;
   }
 
+protected:
+  //! hand over the outputs of the sentence, in one go so that an output
+  //! left empty does not hold up the others
+  virtual void Output(size_t lineNumber, vector<string> &outputs) {
+    m_writer->Write(lineNumber, outputs);
+  }
+
 private:
+  bool Wanted(OutputType output) const {
+    return m_streams[output] != NULL;
+  }
+
   InputType* m_source;
   size_t m_lineNumber;
-  OutputCollector* m_outputCollector;
-  OutputCollector* m_nbestCollector;
-  OutputCollector* m_latticeSamplesCollector;
-  OutputCollector* m_wordGraphCollector;
-  OutputCollector* m_searchGraphCollector;
-  OutputCollector* m_detailedTranslationCollector;
-  OutputCollector* m_alignmentInfoCollector;
-  std::ofstream *m_alignmentStream;
+  const vector<ostream*> &m_streams;
+  OutputWriter* m_writer;
+};
 
+#ifdef WITH_THREADS
+/** Translates a sentence in a decoder process, and sends the outputs back
+  * to the parent process, which writes them.
+  **/
+class WorkerTranslationTask : public TranslationTask
+{
+public:
+  WorkerTranslationTask(size_t lineNumber, InputType* source, const vector<ostream*> &streams,
+                        ProcessPool* processPool) :
+    TranslationTask(lineNumber, source, streams, NULL), m_processPool(processPool) {}
+
+protected:
+  void Output(size_t lineNumber, vector<string> &outputs) {
+    m_processPool->Send(lineNumber, outputs);
+  }
 
+private:
+  ProcessPool* m_processPool;
 };
+#endif
 
 static void PrintFeatureWeight(const FeatureFunction* ff)
 {
@@ -320,6 +380,62 @@ static void ShowWeights()
   }
 }
 
+#ifdef WITH_THREADS
+/** Decodes in processes forked from this one once the models are loaded,
+  * so that they share the memory of the models.  This process reads the
+  * input and writes the outputs.
+  **/
+static bool DecodeInProcesses(IOWrapper &ioWrapper, const vector<ostream*> &streams)
+{
+  const StaticData &staticData = StaticData::Instance();
+  const size_t maxQueued = staticData.ThreadCount() * READ_AHEAD;
+  ProcessPool processPool(staticData.ProcessCount(), staticData.ThreadCount(), maxQueued,
+                          staticData.PinProcesses());
+
+  if (processPool.IsWorker()) {
+    ThreadPool pool(staticData.ThreadCount());
+    pool.SetQueueLimit(maxQueued);
+    size_t lineNumber;
+    long translationId;
+    string input;
+    while (processPool.Receive(lineNumber, translationId, input)) {
+      istringstream in(input);
+      ioWrapper.SetInputStream(&in);
+      InputType* source = NULL;
+      if (!ReadInput(ioWrapper, staticData.GetInputType(), source)) {
+        TRACE_ERR("ERROR: Failed to read line " << lineNumber << " in a decoder process" << endl);
+        _exit(EXIT_FAILURE);
+      }
+      source->SetTranslationId(translationId);
+      pool.Submit(new WorkerTranslationTask(lineNumber, source, streams, &processPool));
+    }
+    pool.Stop(true);
+    processPool.Close();
+    // only the parent writes, and cleans up
+    _exit(EXIT_SUCCESS);
+  }
+
+  // no bound on the writer: the pool bounds the output waiting for sentences
+  // in flight, and a collector waiting for space could hold up the output
+  // the writer needs
+  OutputWriter writer(streams, numeric_limits<size_t>::max());
+  processPool.Start(&writer);
+
+  // the text of each input is sent as it is, to be parsed by the worker
+  size_t lineCount = 0;
+  long translationId;
+  string input;
+  while(ioWrapper.GetInputText(staticData.GetInputType(), input, translationId)) {
+    if (!processPool.Submit(lineCount, translationId, input)) break;
+    ++lineCount;
+  }
+
+  const bool success = processPool.Stop();
+  writer.Close();
+  return success;
+}
+#endif
+
 /** main function of the command line version of the decoder **/
 int main(int argc, char** argv)
 {
@@ -393,9 +509,7 @@ int main(int argc, char** argv)
   // initialize output streams
   // note: we can't just write to STDOUT or files
   // because multithreading may return sentences in shuffled order
-  auto_ptr<OutputCollector> outputCollector; // for translations
-  auto_ptr<OutputCollector> nbestCollector;  // for n-best lists
-  auto_ptr<OutputCollector> latticeSamplesCollector; //for lattice samples
+  vector<ostream*> streams(NumOutputs, static_cast<ostream*>(NULL));
   auto_ptr<ofstream> nbestOut;
   auto_ptr<ofstream> latticeSamplesOut;
   size_t nbestSize = staticData.GetNBestSize();
@@ -404,7 +518,7 @@ int main(int argc, char** argv)
   if (nbestSize) {
     if (nbestFile == "-" || nbestFile == "/dev/stdout") {
       // nbest to stdout, no 1-best
-      nbestCollector.reset(new OutputCollector());
+      streams[NBestOutput] = &cout;
       output1best = false;
     } else {
       // nbest to file, 1-best to stdout
@@ -413,14 +527,14 @@ int main(int argc, char** argv)
         TRACE_ERR("ERROR: Failed to open " << nbestFile << " for nbest lists" << endl);
         exit(1);
       }
-      nbestCollector.reset(new OutputCollector(nbestOut.get()));
+      streams[NBestOutput] = nbestOut.get();
     }
   }
   size_t latticeSamplesSize = staticData.GetLatticeSamplesSize();
   string latticeSamplesFile = staticData.GetLatticeSamplesFilePath();
   if (latticeSamplesSize) {
     if (latticeSamplesFile == "-" || latticeSamplesFile == "/dev/stdout") {
-      latticeSamplesCollector.reset(new OutputCollector());
+      streams[LatticeSamplesOutput] = &cout;
       output1best = false;
     } else {
       latticeSamplesOut.reset(new ofstream(latticeSamplesFile.c_str()));
@@ -428,40 +542,54 @@ int main(int argc, char** argv)
         TRACE_ERR("ERROR: Failed to open " << latticeSamplesFile << " for lattice samples" << endl);
         exit(1);
       }
-      latticeSamplesCollector.reset(new OutputCollector(latticeSamplesOut.get()));
+      streams[LatticeSamplesOutput] = latticeSamplesOut.get();
     }
   }
   if (output1best) {
-    outputCollector.reset(new OutputCollector());
+    streams[BestOutput] = &cout;
+    streams[DebugOutput] = &cerr;
   }
 
   // initialize stream for word graph (aka: output lattice)
-  auto_ptr<OutputCollector> wordGraphCollector;
   if (staticData.GetOutputWordGraph()) {
-    wordGraphCollector.reset(new OutputCollector(&(ioWrapper->GetOutputWordGraphStream())));
+    streams[WordGraphOutput] = &(ioWrapper->GetOutputWordGraphStream());
   }
 
   // initialize stream for search graph
   // note: this is essentially the same as above, but in a different format
-  auto_ptr<OutputCollector> searchGraphCollector;
   if (staticData.GetOutputSearchGraph()) {
-    searchGraphCollector.reset(new OutputCollector(&(ioWrapper->GetOutputSearchGraphStream())));
+    streams[SearchGraphOutput] = &(ioWrapper->GetOutputSearchGraphStream());
+  }
+
+  // ... and in binary format
+  if (staticData.GetOutputSearchGraphBinary()) {
+    streams[SearchGraphBinaryOutput] = &(ioWrapper->GetOutputSearchGraphBinaryStream());
   }
 
   // initialize stram for details about the decoder run
-  auto_ptr<OutputCollector> detailedTranslationCollector;
   if (staticData.IsDetailedTranslationReportingEnabled()) {
-    detailedTranslationCollector.reset(new OutputCollector(&(ioWrapper->GetDetailedTranslationReportingStream())));
+    streams[DetailedTranslationOutput] = &(ioWrapper->GetDetailedTranslationReportingStream());
   }
 
   // initialize stram for word alignment between input and output
-  auto_ptr<OutputCollector> alignmentInfoCollector;
   if (!staticData.GetAlignmentOutputFile().empty()) {
-    alignmentInfoCollector.reset(new OutputCollector(ioWrapper->GetAlignmentOutputStream()));
+    streams[AlignmentOutput] = ioWrapper->GetAlignmentOutputStream();
   }
 
+#ifdef WITH_THREADS
+  // forked before any of the threads below is started
+  if (staticData.ProcessCount() > 1) {
+    exit(DecodeInProcesses(*ioWrapper, streams) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+#endif
+
+  // all the streams are written in input order by a background thread
+  OutputWriter writer(streams);
+
 #ifdef WITH_THREADS
   ThreadPool pool(staticData.ThreadCount());
+  // reading stops while the translation threads are behind, to bound memory
+  pool.SetQueueLimit(staticData.ThreadCount() * READ_AHEAD);
 #endif
 
   // main loop over set of input sentences
@@ -472,14 +600,7 @@ int main(int argc, char** argv)
       ResetUserTime();
     }
     // set up task of translating one sentence
-    TranslationTask* task =
-      new TranslationTask(lineCount,source, outputCollector.get(),
-                          nbestCollector.get(),
-                          latticeSamplesCollector.get(),
-                          wordGraphCollector.get(),
-                          searchGraphCollector.get(),
-                          detailedTranslationCollector.get(),
-                          alignmentInfoCollector.get() );
+    TranslationTask* task = new TranslationTask(lineCount, source, streams, &writer);
     // execute task
 #ifdef WITH_THREADS
   pool.Submit(task);
@@ -495,6 +616,7 @@ int main(int argc, char** argv)
 #ifdef WITH_THREADS
   pool.Stop(true); //flush remaining jobs
 #endif
+  writer.Close();
 
 #ifndef EXIT_RETURN
   //This avoids that destructors are called (it can take a long time)
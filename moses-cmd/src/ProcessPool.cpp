@@ -0,0 +1,393 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifdef WITH_THREADS
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <boost/bind.hpp>
+
+#include "ProcessPool.h"
+
+using namespace std;
+using namespace Moses;
+
+namespace
+{
+
+// sentences submitted beyond the oldest one still being translated, per
+// sentence a worker may have queued; bounds the outputs waiting for it
+const size_t kWindowFactor = 4;
+
+// bytes of output which may wait for a sentence still being translated
+// before no more input is sent
+const size_t kMaxHeld = 64 << 20;
+
+bool WriteAll(int fd, const char *data, size_t size)
+{
+  while (size) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool ReadAll(int fd, char *data, size_t size)
+{
+  while (size) {
+    ssize_t got = read(fd, data, size);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (got == 0) return false;
+    data += got;
+    size -= got;
+  }
+  return true;
+}
+
+// the processes are on the same machine: integers go in host byte order
+void AppendUint64(std::string &out, uint64_t value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool ReadUint64(int fd, uint64_t &value)
+{
+  return ReadAll(fd, reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+bool ReadString(int fd, std::string &text)
+{
+  uint64_t size;
+  if (!ReadUint64(fd, size)) return false;
+  text.resize(size);
+  return size == 0 || ReadAll(fd, &text[0], size);
+}
+
+#ifdef __linux__
+// the CPUs of a list such as "0-3,8-11"
+void ParseCpuList(const std::string &list, std::vector<int> &cpus)
+{
+  istringstream in(list);
+  string range;
+  while (getline(in, range, ',')) {
+    int first, last;
+    if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+      for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    } else if (sscanf(range.c_str(), "%d", &first) == 1) {
+      cpus.push_back(first);
+    }
+  }
+}
+
+// bind to a NUMA node if there are several, else to one core per thread
+void Pin(size_t worker, size_t threads)
+{
+  vector<vector<int> > nodes;
+  for (size_t node = 0; ; ++node) {
+    ostringstream path;
+    path << "/sys/devices/system/node/node" << node << "/cpulist";
+    ifstream in(path.str().c_str());
+    if (!in) break;
+    string list;
+    getline(in, list);
+    vector<int> cpus;
+    ParseCpuList(list, cpus);
+    // nodes with memory only have no CPUs
+    if (!cpus.empty()) nodes.push_back(cpus);
+  }
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  if (nodes.size() > 1) {
+    const vector<int> &node = nodes[worker % nodes.size()];
+    for (size_t i = 0; i < node.size(); ++i) {
+      CPU_SET(node[i], &cpus);
+    }
+  } else {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) count = 1;
+    for (size_t i = 0; i < threads; ++i) {
+      CPU_SET((worker * threads + i) % count, &cpus);
+    }
+  }
+  if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+    cerr << "Unable to bind decoder process " << worker << ": " << strerror(errno) << endl;
+  }
+}
+#else
+void Pin(size_t, size_t)
+{
+  cerr << "Binding decoder processes is only supported on Linux" << endl;
+}
+#endif
+
+}
+
+ProcessPool::ProcessPool(size_t processes, size_t threadsPerProcess, size_t maxQueued, bool pin)
+  : m_worker(-1)
+  , m_queued(processes, 0)
+  , m_maxQueued(maxQueued ? maxQueued : 1)
+  , m_window(kWindowFactor * processes * m_maxQueued)
+  , m_heldBytes(0)
+  , m_failed(false)
+  , m_writer(NULL)
+{
+  // a process whose other end has gone fails its writes, instead of being
+  // killed with what it has not written yet
+  signal(SIGPIPE, SIG_IGN);
+
+  // what is buffered now would be written by every process
+  cout.flush();
+  cerr.flush();
+  fflush(NULL);
+
+  for (size_t i = 0; i < processes; ++i) {
+    int toWorker[2], fromWorker[2];
+    if (pipe(toWorker) || pipe(fromWorker)) {
+      cerr << "Unable to create the pipes of decoder process " << i << ": " << strerror(errno) << endl;
+      exit(1);
+    }
+    const pid_t pid = fork();
+    if (pid < 0) {
+      cerr << "Unable to fork decoder process " << i << ": " << strerror(errno) << endl;
+      exit(1);
+    }
+    if (pid == 0) {
+      // the ends of the pipes of the other workers would keep them open
+      for (size_t j = 0; j < m_inputs.size(); ++j) {
+        close(m_inputs[j]);
+        close(m_outputs[j]);
+      }
+      close(toWorker[1]);
+      close(fromWorker[0]);
+      m_inputs.assign(1, toWorker[0]);
+      m_outputs.assign(1, fromWorker[1]);
+      m_pids.clear();
+      m_worker = i;
+      if (pin) {
+        Pin(i, threadsPerProcess);
+      }
+      return;
+    }
+    close(toWorker[0]);
+    close(fromWorker[1]);
+    m_inputs.push_back(toWorker[1]);
+    m_outputs.push_back(fromWorker[0]);
+    m_pids.push_back(pid);
+  }
+}
+
+ProcessPool::~ProcessPool()
+{
+  for (size_t i = 0; i < m_inputs.size(); ++i) {
+    if (m_inputs[i] >= 0) close(m_inputs[i]);
+  }
+  if (IsWorker() && m_outputs[0] >= 0) {
+    close(m_outputs[0]);
+  }
+}
+
+void ProcessPool::Start(OutputWriter *writer)
+{
+  m_writer = writer;
+  for (size_t i = 0; i < m_outputs.size(); ++i) {
+    m_collectors.create_thread(boost::bind(&ProcessPool::Collect, this, i));
+  }
+}
+
+bool ProcessPool::Submit(size_t id, long translationId, const std::string &input)
+{
+  size_t worker;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    while (true) {
+      if (m_failed) return false;
+      worker = 0;
+      for (size_t i = 1; i < m_queued.size(); ++i) {
+        if (m_queued[i] < m_queued[worker]) worker = i;
+      }
+      const bool behind = !m_inFlight.empty() && id >= *m_inFlight.begin() + m_window;
+      if (m_queued[worker] < m_maxQueued && !behind && m_heldBytes <= kMaxHeld) break;
+      m_done.wait(lock);
+    }
+    ++m_queued[worker];
+    m_inFlight.insert(id);
+  }
+
+  string frame;
+  AppendUint64(frame, id);
+  AppendUint64(frame, static_cast<uint64_t>(translationId));
+  AppendUint64(frame, input.size());
+  frame += input;
+  if (!WriteAll(m_inputs[worker], frame.data(), frame.size())) {
+    cerr << "Unable to send input to decoder process " << worker << ": " << strerror(errno) << endl;
+    Fail();
+    return false;
+  }
+  return true;
+}
+
+void ProcessPool::Fail()
+{
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_failed = true;
+  }
+  m_done.notify_all();
+}
+
+void ProcessPool::Collect(size_t worker)
+{
+  const int fd = m_outputs[worker];
+  while (true) {
+    uint64_t id, count;
+    if (!ReadUint64(fd, id)) break;
+    vector<string> outputs;
+    bool complete = ReadUint64(fd, count);
+    if (complete) {
+      outputs.resize(count);
+      for (size_t i = 0; complete && i < count; ++i) {
+        complete = ReadString(fd, outputs[i]);
+      }
+    }
+    if (!complete) {
+      cerr << "Truncated output from decoder process " << worker << endl;
+      Fail();
+      return;
+    }
+    size_t bytes = 0;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      bytes += outputs[i].size();
+    }
+    m_writer->Write(id, outputs);
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      --m_queued[worker];
+      m_inFlight.erase(id);
+      // the writer keeps these until the sentences before them are done
+      if (!m_inFlight.empty() && id > *m_inFlight.begin()) {
+        m_held[id] = bytes;
+        m_heldBytes += bytes;
+      }
+      while (!m_held.empty() && (m_inFlight.empty() || m_held.begin()->first < *m_inFlight.begin())) {
+        m_heldBytes -= m_held.begin()->second;
+        m_held.erase(m_held.begin());
+      }
+    }
+    m_done.notify_all();
+  }
+
+  bool failed;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    failed = m_queued[worker] > 0;
+    if (failed) {
+      cerr << "Decoder process " << worker << " ended with " << m_queued[worker]
+           << " sentences untranslated" << endl;
+    }
+  }
+  if (failed) {
+    Fail();
+  }
+}
+
+bool ProcessPool::Stop()
+{
+  // the workers end once they have read all their input
+  for (size_t i = 0; i < m_inputs.size(); ++i) {
+    close(m_inputs[i]);
+    m_inputs[i] = -1;
+  }
+  m_collectors.join_all();
+  bool success = true;
+  for (size_t i = 0; i < m_pids.size(); ++i) {
+    int status;
+    while (waitpid(m_pids[i], &status, 0) < 0 && errno == EINTR) {}
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      cerr << "Decoder process " << i << " failed" << endl;
+      success = false;
+    }
+    close(m_outputs[i]);
+  }
+  boost::mutex::scoped_lock lock(m_mutex);
+  return success && !m_failed;
+}
+
+bool ProcessPool::Receive(size_t &id, long &translationId, std::string &input)
+{
+  uint64_t value, translation;
+  if (!ReadUint64(m_inputs[0], value)) return false;
+  if (!ReadUint64(m_inputs[0], translation) || !ReadString(m_inputs[0], input)) {
+    cerr << "Truncated input in decoder process " << m_worker << endl;
+    exit(1);
+  }
+  id = value;
+  translationId = static_cast<long>(translation);
+  return true;
+}
+
+void ProcessPool::Send(size_t id, const std::vector<std::string> &outputs)
+{
+  string frame;
+  AppendUint64(frame, id);
+  AppendUint64(frame, outputs.size());
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    AppendUint64(frame, outputs[i].size());
+    frame += outputs[i];
+  }
+  boost::mutex::scoped_lock lock(m_mutex);
+  if (!WriteAll(m_outputs[0], frame.data(), frame.size())) {
+    cerr << "Unable to send output from decoder process " << m_worker << ": " << strerror(errno) << endl;
+    exit(1);
+  }
+}
+
+void ProcessPool::Close()
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  close(m_outputs[0]);
+  m_outputs[0] = -1;
+}
+
+#endif
@@ -0,0 +1,110 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_cmd_ProcessPool_h
+#define moses_cmd_ProcessPool_h
+
+#ifdef WITH_THREADS
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/thread.hpp>
+
+#include "OutputWriter.h"
+
+/** Decoder processes forked once the models are loaded.
+ *
+ * The workers share the pages of the models with the parent copy-on-write,
+ * so N processes cost little more memory than one, and each can be bound to
+ * a NUMA node of its own.  The parent reads the input and sends the text of
+ * each sentence to the least busy worker, which parses it; the outputs come
+ * back on a pipe of each worker, and are put in order by an OutputWriter.
+ * If a worker fails, no more input is sent, and Stop() returns false once
+ * the outputs of the other workers are collected.
+ *
+ * The pool must be created before any other thread is started: only the
+ * forking thread lives on in the workers.
+ */
+class ProcessPool
+{
+public:
+  //! fork the workers; the constructor returns in the parent and in each worker
+  ProcessPool(size_t processes, size_t threadsPerProcess, size_t maxQueued, bool pin);
+  ~ProcessPool();
+
+  bool IsWorker() const {
+    return m_worker >= 0;
+  }
+
+  //! parent: collect the outputs of the workers into writer
+  void Start(Moses::OutputWriter *writer);
+
+  //! parent: send an input, blocks while every worker has maxQueued of them,
+  //! or while too much output waits for a sentence still being translated.
+  //! False once a worker has failed
+  bool Submit(size_t id, long translationId, const std::string &input);
+
+  //! parent: wait for the outputs of everything submitted and for the workers to end,
+  //! false if one of them failed
+  bool Stop();
+
+  //! worker: the next input, false once there are no more
+  bool Receive(size_t &id, long &translationId, std::string &input);
+
+  //! worker: send back the outputs of an input; may be called by several threads
+  void Send(size_t id, const std::vector<std::string> &outputs);
+
+  //! worker: no Send() may follow
+  void Close();
+
+private:
+  ProcessPool(const ProcessPool&);
+  void operator=(const ProcessPool&);
+
+  void Collect(size_t worker);
+  void Fail();
+
+  int m_worker; //< index of this worker, -1 in the parent
+  std::vector<pid_t> m_pids;
+  std::vector<int> m_inputs; //< pipe to each worker, or from the parent in a worker
+  std::vector<int> m_outputs; //< pipe from each worker, or to the parent in a worker
+  std::vector<size_t> m_queued; //< inputs sent to each worker without outputs yet
+  size_t m_maxQueued;
+  std::set<size_t> m_inFlight; //< ids of the inputs without outputs yet
+  size_t m_window; //< how far Submit() may get ahead of the oldest of them
+  std::map<size_t, size_t> m_held; //< bytes of the outputs behind the oldest of them
+  size_t m_heldBytes;
+  bool m_failed;
+  Moses::OutputWriter *m_writer;
+
+  boost::mutex m_mutex;
+  boost::condition_variable m_done;
+  boost::thread_group m_collectors;
+};
+
+#endif
+
+#endif
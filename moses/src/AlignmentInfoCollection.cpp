@@ -38,6 +38,9 @@ const AlignmentInfo &AlignmentInfoCollection::GetEmptyAlignmentInfo() const
 const AlignmentInfo *AlignmentInfoCollection::Add(
     const std::set<std::pair<size_t,size_t> > &pairs)
 {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
   std::pair<AlignmentInfoSet::iterator, bool> ret =
     m_collection.insert(AlignmentInfo(pairs));
   return &(*ret.first);
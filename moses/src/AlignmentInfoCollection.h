@@ -23,6 +23,10 @@
 
 #include <set>
 
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
 namespace Moses
 {
 
@@ -50,6 +54,10 @@ class AlignmentInfoCollection
   static AlignmentInfoCollection s_instance;
   AlignmentInfoSet m_collection;
   const AlignmentInfo *m_emptyAlignmentInfo;
+#ifdef WITH_THREADS
+  // phrase tables may be loaded by several threads at once
+  boost::mutex m_mutex;
+#endif
 };
 
 }
@@ -15,19 +15,48 @@ BilingualDynSuffixArray::BilingualDynSuffixArray():
 { 
 	m_srcSA = 0; 
 	m_trgSA = 0;
-	m_srcCorpus = new std::vector<wordID_t>();
-	m_trgCorpus = new std::vector<wordID_t>();
-	m_srcVocab = new Vocab(false);
-	m_trgVocab = new Vocab(false);
+	m_srcCorpus = new corpus_t();
+	m_trgCorpus = new corpus_t();
+	m_srcVocab.reset(new Vocab(false));
+	m_trgVocab.reset(new Vocab(false));
+#ifdef WITH_THREADS
+	m_vocabMutex.reset(new boost::shared_mutex());
+#endif
 	m_scoreCmp = 0;
 }
 
+BilingualDynSuffixArray::BilingualDynSuffixArray(const BilingualDynSuffixArray& other):
+	m_srcCorpus(new corpus_t(*other.m_srcCorpus)),
+	m_trgCorpus(new corpus_t(*other.m_trgCorpus)),
+	m_inputFactors(other.m_inputFactors),
+	m_outputFactors(other.m_outputFactors),
+	m_srcSntBreaks(other.m_srcSntBreaks),
+	m_trgSntBreaks(other.m_trgSntBreaks),
+	m_srcVocab(other.m_srcVocab),
+	m_trgVocab(other.m_trgVocab),
+#ifdef WITH_THREADS
+	m_vocabMutex(other.m_vocabMutex),
+#endif
+	m_scoreCmp(other.m_scoreCmp ? new ScoresComp(*other.m_scoreCmp) : 0),
+	m_alignments(other.m_alignments),
+	m_rawAlignments(other.m_rawAlignments),
+	m_maxPhraseLength(other.m_maxPhraseLength),
+	m_maxSampleSize(other.m_maxSampleSize)
+{
+	m_srcSA = other.m_srcSA ? new DynSuffixArray(*other.m_srcSA, m_srcCorpus) : 0;
+	m_trgSA = other.m_trgSA ? new DynSuffixArray(*other.m_trgSA, m_trgCorpus) : 0;
+	// other is still being read, and may be caching word probabilities
+#ifdef WITH_THREADS
+	boost::shared_lock<boost::shared_mutex> lock(other.m_wordPairCacheMutex);
+#endif
+	m_wordPairCache = other.m_wordPairCache;
+	m_freqWordsCached = other.m_freqWordsCached;
+}
+
 BilingualDynSuffixArray::~BilingualDynSuffixArray() 
 {
 	if(m_srcSA) delete m_srcSA;
 	if(m_trgSA) delete m_trgSA;
-	if(m_srcVocab) delete m_srcVocab;
-	if(m_trgVocab) delete m_trgVocab;
 	if(m_srcCorpus) delete m_srcCorpus;
 	if(m_trgCorpus) delete m_trgCorpus;
 	if(m_scoreCmp) delete m_scoreCmp;
@@ -46,9 +75,9 @@ bool BilingualDynSuffixArray::Load(
 	InputFileStream sourceStrme(source);
 	InputFileStream targetStrme(target);
 	cerr << "Loading source corpus...\n";	
-	LoadCorpus(sourceStrme, m_inputFactors, *m_srcCorpus, m_srcSntBreaks, m_srcVocab);
+	LoadCorpus(sourceStrme, m_inputFactors, *m_srcCorpus, m_srcSntBreaks, m_srcVocab.get());
 	cerr << "Loading target corpus...\n";	
-	LoadCorpus(targetStrme, m_outputFactors,*m_trgCorpus, m_trgSntBreaks, m_trgVocab);
+	LoadCorpus(targetStrme, m_outputFactors,*m_trgCorpus, m_trgSntBreaks, m_trgVocab.get());
 	CHECK(m_srcSntBreaks.size() == m_trgSntBreaks.size());
 
 	// build suffix arrays and auxilliary arrays
@@ -176,7 +205,7 @@ void BilingualDynSuffixArray::CleanUp()
 }
 
 int BilingualDynSuffixArray::LoadCorpus(InputFileStream& corpus, const FactorList& factors,
-	std::vector<wordID_t>& cArray, std::vector<wordID_t>& sntArray,
+	corpus_t& cArray, ChunkedVector<unsigned>& sntArray,
   Vocab* vocab) 
 {
 	std::string line, word;
@@ -202,6 +231,9 @@ int BilingualDynSuffixArray::LoadCorpus(InputFileStream& corpus, const FactorLis
 bool BilingualDynSuffixArray::GetLocalVocabIDs(const Phrase& src, SAPhrase &output) const 
 {
 	// looks up the SA vocab ids for the current src phrase
+#ifdef WITH_THREADS
+	boost::shared_lock<boost::shared_mutex> lock(*m_vocabMutex);
+#endif
 	size_t phraseSize = src.GetSize();
 	for (size_t pos = 0; pos < phraseSize; ++pos) {
 		const Word &word = src.GetWord(pos);
@@ -226,7 +258,6 @@ pair<float, float> BilingualDynSuffixArray::GetLexicalWeight(const PhrasePair& p
 	std::map<pair<wordID_t, wordID_t>, float> targetProbs; // collect sum of target probs given source words
 	//const SentenceAlignment& alignment = m_alignments[phrasepair.m_sntIndex];
 	const SentenceAlignment& alignment = GetSentenceAlignment(phrasepair.m_sntIndex);
-	std::map<pair<wordID_t, wordID_t>, pair<float, float> >::const_iterator itrCache; 
 	// for each source word
 	for(int srcIdx = phrasepair.m_startSource; srcIdx <= phrasepair.m_endSource; ++srcIdx) {
 		float srcSumPairProbs(0);
@@ -235,14 +266,9 @@ pair<float, float> BilingualDynSuffixArray::GetLexicalWeight(const PhrasePair& p
     // for each target word aligned to this source word in this alignment
 		if(srcWordAlignments.size() == 0) { // get p(NULL|src)
 			pair<wordID_t, wordID_t> wordpair = make_pair(srcWord, m_srcVocab->GetkOOVWordID());
-			itrCache = m_wordPairCache.find(wordpair);
-			if(itrCache == m_wordPairCache.end()) { // if not in cache
-				CacheWordProbs(srcWord);
-				itrCache = m_wordPairCache.find(wordpair); // search cache again
-			}
-			CHECK(itrCache != m_wordPairCache.end());
-			srcSumPairProbs += itrCache->second.first;
-			targetProbs[wordpair] = itrCache->second.second;
+			pair<float, float> probs = GetWordPairProbs(wordpair.first, wordpair.second);
+			srcSumPairProbs += probs.first;
+			targetProbs[wordpair] = probs.second;
 		}
 		else { // extract p(trg|src) 
 			for(size_t i = 0; i < srcWordAlignments.size(); ++i) { // for each aligned word
@@ -250,14 +276,9 @@ pair<float, float> BilingualDynSuffixArray::GetLexicalWeight(const PhrasePair& p
 				wordID_t trgWord = m_trgCorpus->at(trgIdx + m_trgSntBreaks[phrasepair.m_sntIndex]);
 				// get probability of this source->target word pair
 				pair<wordID_t, wordID_t> wordpair = make_pair(srcWord, trgWord);
-				itrCache = m_wordPairCache.find(wordpair);
-				if(itrCache == m_wordPairCache.end()) { // if not in cache
-          CacheWordProbs(srcWord);
-					itrCache = m_wordPairCache.find(wordpair); // search cache again
-				}
-				CHECK(itrCache != m_wordPairCache.end());
-				srcSumPairProbs += itrCache->second.first;
-				targetProbs[wordpair] = itrCache->second.second;	
+				pair<float, float> probs = GetWordPairProbs(wordpair.first, wordpair.second);
+				srcSumPairProbs += probs.first;
+				targetProbs[wordpair] = probs.second;	
 			} 
 		}
 		float srcNormalizer = srcWordAlignments.size() < 2 ? 1.0 : 1.0 / float(srcWordAlignments.size());
@@ -329,13 +350,36 @@ void BilingualDynSuffixArray::CacheWordProbs(wordID_t srcWord) const
 	}
 	// now we've gotten counts of all target words aligned to this source word
 	// get probs and cache all pairs
+#ifdef WITH_THREADS
+	boost::unique_lock<boost::shared_mutex> lock(m_wordPairCacheMutex);
+#endif
 	for(std::map<wordID_t, int>::const_iterator itrCnt = counts.begin();
 			itrCnt != counts.end(); ++itrCnt) {
-		pair<wordID_t, wordID_t> wordPair = make_pair(srcWord, itrCnt->first);
 		float srcTrgPrb = float(itrCnt->second) / float(denom);	// gives p(src->trg)
 		float trgSrcPrb = float(itrCnt->second) / float(counts.size()); // gives p(trg->src) 
-		m_wordPairCache[wordPair] = pair<float, float>(srcTrgPrb, trgSrcPrb);
+		m_wordPairCache[WordPairKey(srcWord, itrCnt->first)] = pair<float, float>(srcTrgPrb, trgSrcPrb);
+	}
+}
+
+pair<float, float> BilingualDynSuffixArray::GetWordPairProbs(wordID_t srcWord, wordID_t trgWord) const
+{
+	const uint64_t key = WordPairKey(srcWord, trgWord);
+	{
+#ifdef WITH_THREADS
+		boost::shared_lock<boost::shared_mutex> lock(m_wordPairCacheMutex);
+#endif
+		WordPairCache::const_iterator itrCache = m_wordPairCache.find(key);
+		if(itrCache != m_wordPairCache.end()) return itrCache->second;
 	}
+	// not in cache. another thread may be caching the same source word, which
+	// is harmless as both compute the same probabilities
+	CacheWordProbs(srcWord);
+#ifdef WITH_THREADS
+	boost::shared_lock<boost::shared_mutex> lock(m_wordPairCacheMutex);
+#endif
+	WordPairCache::const_iterator itrCache = m_wordPairCache.find(key); // search cache again
+	CHECK(itrCache != m_wordPairCache.end());
+	return itrCache->second;
 }
 
 SAPhrase BilingualDynSuffixArray::TrgPhraseFromSntIdx(const PhrasePair& phrasepair) const 
@@ -354,6 +398,9 @@ SAPhrase BilingualDynSuffixArray::TrgPhraseFromSntIdx(const PhrasePair& phrasepa
 TargetPhrase* BilingualDynSuffixArray::GetMosesFactorIDs(const SAPhrase& phrase) const 
 {
 	TargetPhrase* targetPhrase = new TargetPhrase(Output);
+#ifdef WITH_THREADS
+	boost::shared_lock<boost::shared_mutex> lock(*m_vocabMutex);
+#endif
 	for(size_t i=0; i < phrase.words.size(); ++i) { // look up trg words
 		Word& word = m_trgVocab->GetWord( phrase.words[i]);
 		CHECK(word != m_trgVocab->GetkOOVWord());
@@ -427,13 +474,11 @@ void BilingualDynSuffixArray::GetTargetPhrasesByLexicalWeight(const Phrase& src,
 }
 
 std::vector<int> BilingualDynSuffixArray::GetSntIndexes(std::vector<unsigned>& wrdIndices, 
-	const int sourceSize, const std::vector<unsigned>& sntBreaks) const 
+	const int sourceSize, const ChunkedVector<unsigned>& sntBreaks) const 
 {
-	std::vector<unsigned>::const_iterator vit;
 	std::vector<int> sntIndexes; 
 	for(size_t i=0; i < wrdIndices.size(); ++i) {
-		vit = std::upper_bound(sntBreaks.begin(), sntBreaks.end(), wrdIndices[i]);
-		int index = int(vit - sntBreaks.begin()) - 1;
+		int index = int(sntBreaks.upper_bound(wrdIndices[i])) - 1;
 		// check for phrases that cross sentence boundaries
 		if(wrdIndices[i] - sourceSize + 1 < sntBreaks.at(index)) 
 			sntIndexes.push_back(-1);	// set bad flag
@@ -460,11 +505,26 @@ void BilingualDynSuffixArray::addSntPair(string& source, string& target, string&
   cerr << "old source corpus size = " << oldSrcCrpSize << "\told target size = " << oldTrgCrpSize << endl;
   Phrase sphrase(ARRAY_SIZE_INCR);
   sphrase.CreateFromString(m_inputFactors, source, factorDelimiter);
-  m_srcVocab->MakeOpen();
+  Phrase tphrase(ARRAY_SIZE_INCR);
+  tphrase.CreateFromString(m_outputFactors, target, factorDelimiter);
   wordID_t sIDs[sphrase.GetSize()];
-  // store words in vocabulary and corpus
-  for(int i = sphrase.GetSize()-1; i >= 0; --i) {
-    sIDs[i] = m_srcVocab->GetWordID(sphrase.GetWord(i));  // get vocab id backwards
+  wordID_t tIDs[tphrase.GetSize()];
+  {
+    // the vocabularies are shared with the versions being decoded on
+#ifdef WITH_THREADS
+    boost::unique_lock<boost::shared_mutex> lock(*m_vocabMutex);
+#endif
+    m_srcVocab->MakeOpen();
+    // store words in vocabulary and corpus
+    for(int i = sphrase.GetSize()-1; i >= 0; --i) {
+      sIDs[i] = m_srcVocab->GetWordID(sphrase.GetWord(i));  // get vocab id backwards
+    }
+    m_srcVocab->MakeClosed();
+    m_trgVocab->MakeOpen();
+    for(int i = tphrase.GetSize()-1; i >= 0; --i) {
+      tIDs[i] = m_trgVocab->GetWordID(tphrase.GetWord(i));  // get vocab id
+    }
+    m_trgVocab->MakeClosed();
   }
   for(size_t i = 0; i < sphrase.GetSize(); ++i) {
     srcFactor.push_back(sIDs[i]);
@@ -472,14 +532,6 @@ void BilingualDynSuffixArray::addSntPair(string& source, string& target, string&
     m_srcCorpus->push_back(srcFactor.back()); // add word to corpus
   }
   m_srcSntBreaks.push_back(oldSrcCrpSize); // former end of corpus is index of new sentence 
-  m_srcVocab->MakeClosed();
-  Phrase tphrase(ARRAY_SIZE_INCR);
-  tphrase.CreateFromString(m_outputFactors, target, factorDelimiter);
-  m_trgVocab->MakeOpen();
-  wordID_t tIDs[tphrase.GetSize()];
-  for(int i = tphrase.GetSize()-1; i >= 0; --i) {
-    tIDs[i] = m_trgVocab->GetWordID(tphrase.GetWord(i));  // get vocab id
-  }
   for(size_t i = 0; i < tphrase.GetSize(); ++i) {
     trgFactor.push_back(tIDs[i]);
     cerr << "trgFactor[" << (trgFactor.size() - 1) << "] = " << trgFactor.back() << endl;
@@ -492,7 +544,6 @@ void BilingualDynSuffixArray::addSntPair(string& source, string& target, string&
   cerr << "gets to 3\n";
   //m_trgSA->Insert(&trgFactor, oldTrgCrpSize);
   LoadRawAlignments(alignment);
-  m_trgVocab->MakeClosed();
   //for(size_t i=0; i < sphrase.GetSize(); ++i)
     //ClearWordInCache(sIDs[i]);
   
@@ -500,17 +551,15 @@ void BilingualDynSuffixArray::addSntPair(string& source, string& target, string&
 void BilingualDynSuffixArray::ClearWordInCache(wordID_t srcWord) {
   if(m_freqWordsCached.find(srcWord) != m_freqWordsCached.end())
     return;
-	std::map<std::pair<wordID_t, wordID_t>, std::pair<float, float> >::iterator it,
-    first, last;
-  for(it = m_wordPairCache.begin(); it != m_wordPairCache.end(); ++it) {
-    if(it->first.first == srcWord) {  // all source words grouped 
-      first = it; // copy first entry of srcWord
-      last = it++;
-      while(it != m_wordPairCache.end() && (it->first.first == srcWord)) {
-        last = it++;
-      }
-    }
-    m_wordPairCache.erase(first, last);
+#ifdef WITH_THREADS
+  boost::unique_lock<boost::shared_mutex> lock(m_wordPairCacheMutex);
+#endif
+  WordPairCache::iterator it = m_wordPairCache.begin();
+  while(it != m_wordPairCache.end()) {
+    if(wordID_t(it->first >> 32) == srcWord)
+      it = m_wordPairCache.erase(it);
+    else
+      ++it;
   }
 }
 SentenceAlignment::SentenceAlignment(int sntIndex, int sourceSize, int targetSize) 
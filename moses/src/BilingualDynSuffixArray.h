@@ -9,6 +9,12 @@
 #include "InputFileStream.h"
 #include "FactorTypeSet.h"
 
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread/shared_mutex.hpp>
+#endif
+
 namespace Moses {
 
 class SAPhrase
@@ -50,8 +56,8 @@ class SentenceAlignment
 public:
 	SentenceAlignment(int sntIndex, int sourceSize, int targetSize);
 	int m_sntIndex;
-	std::vector<wordID_t>* trgSnt;
-	std::vector<wordID_t>* srcSnt;
+	const corpus_t* trgSnt;
+	const corpus_t* srcSnt;
 	std::vector<int> numberAligned; 
 	std::vector< std::vector<int> > alignedList; 
 	bool Extract(int maxPhraseLength, std::vector<PhrasePair*> &ret, int startSource, int endSource) const;
@@ -80,6 +86,10 @@ private:
 class BilingualDynSuffixArray {
 public: 
 	BilingualDynSuffixArray();
+	//! a copy which can be updated while other is being read. the corpora,
+	//! suffix arrays and alignments share the parts an update leaves
+	//! unchanged with other, and the vocabularies are shared outright
+	BilingualDynSuffixArray(const BilingualDynSuffixArray& other);
 	~BilingualDynSuffixArray();
 	bool Load( const std::vector<FactorType>& inputFactors,
 		const std::vector<FactorType>& outputTactors,
@@ -89,27 +99,42 @@ public:
 	void CleanUp();
   void addSntPair(string& source, string& target, string& alignment);
 private:
+	void operator=(const BilingualDynSuffixArray&);
+
 	DynSuffixArray* m_srcSA;
 	DynSuffixArray* m_trgSA;
-	std::vector<wordID_t>* m_srcCorpus;
-	std::vector<wordID_t>* m_trgCorpus;
+	corpus_t* m_srcCorpus;
+	corpus_t* m_trgCorpus;
   std::vector<FactorType> m_inputFactors;
   std::vector<FactorType> m_outputFactors;
 
-	std::vector<unsigned> m_srcSntBreaks, m_trgSntBreaks;
+	ChunkedVector<unsigned> m_srcSntBreaks, m_trgSntBreaks;
 
-	Vocab* m_srcVocab, *m_trgVocab;
+	// words are only ever added to the vocabularies, so all the copies share
+	// them: a version which doesn't have a word yet finds it in no sentence
+	boost::shared_ptr<Vocab> m_srcVocab, m_trgVocab;
+#ifdef WITH_THREADS
+	//! read lock for lookups, write lock for adding the words of a sentence pair
+	boost::shared_ptr<boost::shared_mutex> m_vocabMutex;
+#endif
 	ScoresComp* m_scoreCmp;
 
 	std::vector<SentenceAlignment> m_alignments;
-	std::vector<std::vector<short> > m_rawAlignments;
+	ChunkedVector<std::vector<short> > m_rawAlignments;
 
-	mutable std::map<std::pair<wordID_t, wordID_t>, std::pair<float, float> > m_wordPairCache; 
+	// lexical probabilities keyed by (source word << 32 | target word). shared
+	// by all decoding threads, so lookups take a read lock and filling in the
+	// probabilities of a new source word takes a write lock
+	typedef boost::unordered_map<uint64_t, std::pair<float, float> > WordPairCache;
+	mutable WordPairCache m_wordPairCache;
+#ifdef WITH_THREADS
+	mutable boost::shared_mutex m_wordPairCacheMutex;
+#endif
   mutable std::set<wordID_t> m_freqWordsCached;
 	const size_t m_maxPhraseLength, m_maxSampleSize;
 
 	int LoadCorpus(InputFileStream&, const std::vector<FactorType>& factors, 
-		std::vector<wordID_t>&, std::vector<wordID_t>&,
+		corpus_t&, ChunkedVector<unsigned>&,
     Vocab*);
 	int LoadAlignments(InputFileStream& aligs);
 	int LoadRawAlignments(InputFileStream& aligs);
@@ -119,11 +144,14 @@ private:
 	SentenceAlignment GetSentenceAlignment(const int, bool=false) const; 
 	int SampleSelection(std::vector<unsigned>&, int = 300) const;
 
-	std::vector<int> GetSntIndexes(std::vector<unsigned>&, int, const std::vector<unsigned>&) const;	
+	std::vector<int> GetSntIndexes(std::vector<unsigned>&, int, const ChunkedVector<unsigned>&) const;	
 	TargetPhrase* GetMosesFactorIDs(const SAPhrase&) const;
 	SAPhrase TrgPhraseFromSntIdx(const PhrasePair&) const;
 	bool GetLocalVocabIDs(const Phrase&, SAPhrase &) const;
 	void CacheWordProbs(wordID_t) const;
+	std::pair<float, float> GetWordPairProbs(wordID_t, wordID_t) const;
+	static uint64_t WordPairKey(wordID_t srcWord, wordID_t trgWord)
+	{ return (uint64_t(srcWord) << 32) | uint64_t(trgWord); }
   void CacheFreqWords() const;
   void ClearWordInCache(wordID_t);
 	std::pair<float, float> GetLexicalWeight(const PhrasePair&) const;
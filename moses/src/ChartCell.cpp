@@ -183,12 +183,12 @@ size_t ChartCell::GetSize() const
   return ret;
 }
 
-void ChartCell::GetSearchGraph(long translationId, std::ostream &outputSearchGraphStream, const std::map<unsigned, bool> &reachable) const
+void ChartCell::GetSearchGraph(const std::vector<bool> &reachable, std::vector<const ChartHypothesis*> &searchGraph) const
 {
   std::map<Word, ChartHypothesisCollection>::const_iterator iterOutside;
   for (iterOutside = m_hypoColl.begin(); iterOutside != m_hypoColl.end(); ++iterOutside) {
     const ChartHypothesisCollection &coll = iterOutside->second;
-    coll.GetSearchGraph(translationId, outputSearchGraphStream, reachable);
+    coll.GetSearchGraph(reachable, searchGraph);
   }
 }
 
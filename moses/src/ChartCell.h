@@ -90,7 +90,7 @@ public:
     return m_coverage < compare.m_coverage;
   }
 
-  void GetSearchGraph(long translationId, std::ostream &outputSearchGraphStream, const std::map<unsigned,bool> &reachable) const;
+  void GetSearchGraph(const std::vector<bool> &reachable, std::vector<const ChartHypothesis*> &searchGraph) const;
 
 };
 
@@ -254,14 +254,14 @@ void ChartHypothesisCollection::CleanupArcList()
   }
 }
 
-void ChartHypothesisCollection::GetSearchGraph(long translationId, std::ostream &outputSearchGraphStream, const std::map<unsigned, bool> &reachable) const
+void ChartHypothesisCollection::GetSearchGraph(const std::vector<bool> &reachable, std::vector<const ChartHypothesis*> &searchGraph) const
 {
+  const bool unpruned = StaticData::Instance().GetUnprunedSearchGraph();
   HCType::const_iterator iter;
   for (iter = m_hypos.begin() ; iter != m_hypos.end() ; ++iter) {
-    ChartHypothesis &mainHypo = **iter;
-    if (StaticData::Instance().GetUnprunedSearchGraph() ||
-        reachable.find(mainHypo.GetId()) != reachable.end()) {
-      outputSearchGraphStream << translationId << " " << mainHypo << endl;
+    const ChartHypothesis &mainHypo = **iter;
+    if (unpruned || reachable[mainHypo.GetId()]) {
+      searchGraph.push_back(&mainHypo);
     }
 
     const ChartArcList *arcList = mainHypo.GetArcList();
@@ -269,8 +269,8 @@ void ChartHypothesisCollection::GetSearchGraph(long translationId, std::ostream
       ChartArcList::const_iterator iterArc;
       for (iterArc = arcList->begin(); iterArc != arcList->end(); ++iterArc) {
         const ChartHypothesis &arc = **iterArc;
-        if (reachable.find(arc.GetId()) != reachable.end()) {
-          outputSearchGraphStream << translationId << " " << arc << endl;
+        if (reachable[arc.GetId()]) {
+          searchGraph.push_back(&arc);
         }
       }
     }
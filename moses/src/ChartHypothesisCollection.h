@@ -115,7 +115,7 @@ public:
 
   float GetBestScore() const { return m_bestScore; }
 
-  void GetSearchGraph(long translationId, std::ostream &outputSearchGraphStream, const std::map<unsigned,bool> &reachable) const;
+  void GetSearchGraph(const std::vector<bool> &reachable, std::vector<const ChartHypothesis*> &searchGraph) const;
 
 };
 
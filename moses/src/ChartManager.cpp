@@ -23,12 +23,16 @@
 #include "ChartManager.h"
 #include "ChartCell.h"
 #include "ChartHypothesis.h"
-#include "ChartTrellisDetourQueue.h"
 #include "ChartTrellisNode.h"
 #include "ChartTrellisPath.h"
 #include "ChartTrellisPathList.h"
 #include "StaticData.h"
 #include "DecodeStep.h"
+#include "LazyKBest.h"
+#include "SearchGraphBinary.h"
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_set.hpp>
 
 using namespace std;
 using namespace Moses;
@@ -141,13 +145,70 @@ const ChartHypothesis *ChartManager::GetBestHypothesis() const
   }
 }
 
+namespace
+{
+//! the chart search hypergraph, as seen by LazyKBest
+struct ChartHypothesisGraphTraits {
+  typedef ChartArcList ArcList;
+  static const ChartHypothesis *GetWinningHypo(const ChartHypothesis &hypo) {
+    return hypo.GetWinningHypothesis();
+  }
+  static const ArcList *GetArcList(const ChartHypothesis &hypo) {
+    return hypo.GetArcList();
+  }
+  static size_t GetNumPrevHypos(const ChartHypothesis &hypo) {
+    return hypo.GetPrevHypos().size();
+  }
+  static const ChartHypothesis *GetPrevHypo(const ChartHypothesis &hypo, size_t i) {
+    return hypo.GetPrevHypos()[i];
+  }
+};
+
+typedef LazyKBest<ChartHypothesis, ChartHypothesisGraphTraits> ChartKBest;
+
+//! the output factors of a derivation's target words, for distinct n-best
+//! lists. factors are unique, so equal pointers mean equal strings
+typedef vector<const Factor*> Surface;
+
+void AppendSurface(const ChartKBest::Derivation &derivation, const vector<FactorType> &outputFactors, Surface &surface)
+{
+  const TargetPhrase &currTargetPhrase = derivation.edge->GetCurrTargetPhrase();
+  const AlignmentInfo::NonTermIndexMap &nonTermIndexMap =
+    currTargetPhrase.GetAlignmentInfo().GetNonTermIndexMap();
+  for (size_t pos = 0; pos < currTargetPhrase.GetSize(); ++pos) {
+    const Word &word = currTargetPhrase.GetWord(pos);
+    if (word.IsNonTerminal()) {
+      AppendSurface(*derivation.children[nonTermIndexMap[pos]], outputFactors, surface);
+    } else {
+      for (size_t i = 0; i < outputFactors.size(); ++i) {
+        surface.push_back(word[outputFactors[i]]);
+      }
+    }
+  }
+}
+
+ChartTrellisNode *CreateTrellisNode(const ChartKBest::Derivation &derivation)
+{
+  ChartTrellisNode::NodeChildren children;
+  children.reserve(derivation.children.size());
+  for (size_t i = 0; i < derivation.children.size(); ++i) {
+    children.push_back(CreateTrellisNode(*derivation.children[i]));
+  }
+  return new ChartTrellisNode(*derivation.edge, children);
+}
+}
+
+/** Extract the n-best derivations of the best hypothesis of the whole
+ *  sentence, and its arcs, with LazyKBest. Trellis paths are only built
+ *  for the derivations that go into the list, and duplicate translations
+ *  are recognised by their output factors before anything is built.
+ */
 void ChartManager::CalcNBest(size_t count, ChartTrellisPathList &ret,bool onlyDistinct) const
 {
   size_t size = m_source.GetSize();
   if (count == 0 || size == 0)
     return;
 
-  // Build a ChartTrellisPath for the 1-best path, if any.
   WordsRange range(0, size-1);
   const ChartCell &lastCell = m_hypoStackColl.Get(range);
   const ChartHypothesis *hypo = lastCell.GetBestHypothesis();
@@ -155,71 +216,48 @@ void ChartManager::CalcNBest(size_t count, ChartTrellisPathList &ret,bool onlyDi
     // no hypothesis
     return;
   }
-  boost::shared_ptr<ChartTrellisPath> basePath(new ChartTrellisPath(*hypo));
-
-  // Add it to the n-best list.
-  ret.Add(basePath);
-  if (count == 1) {
-    return;
-  }
-
-  // Record the output phrase if distinct translations are required.
-  set<Phrase> distinctHyps;
-  if (onlyDistinct) {
-    distinctHyps.insert(basePath->GetOutputPhrase());
-  }
+  ChartKBest kBest(vector<const ChartHypothesis*>(1, hypo));
 
-  // Set a limit on the number of detours to pop.  If the n-best list is
-  // restricted to distinct translations then this limit should be bigger
+  // Set a limit on the number of derivations to look at.  If the n-best list
+  // is restricted to distinct translations then this limit should be bigger
   // than n.  The n-best factor determines how much bigger the limit should be.
   const size_t nBestFactor = StaticData::Instance().GetNBestFactor();
   size_t popLimit;
   if (!onlyDistinct) {
-    popLimit = count-1;
+    popLimit = count;
   } else if (nBestFactor == 0) {
     // 0 = 'unlimited.'  This actually sets a large-ish limit in case too many
     // translations are identical.
-    popLimit = count * 1000;
+    popLimit = count * 1000 + 1;
   } else {
-    popLimit = count * nBestFactor;
+    popLimit = count * nBestFactor + 1;
   }
 
-  // Create an empty priority queue of detour objects.  It is bounded to
-  // contain no more than popLimit items.
-  ChartTrellisDetourQueue contenders(popLimit);
-
-  // Create a ChartTrellisDetour for each single-point deviation from basePath
-  // and add them to the queue.
-  CreateDeviantPaths(basePath, contenders);
+  // hashed, and compared word by word when the hashes match
+  boost::unordered_set<Surface> distinctHyps;
+  const vector<FactorType> &outputFactors = StaticData::Instance().GetOutputFactorOrder();
 
   // MAIN loop
-  for (size_t i = 0;
-       ret.GetSize() < count && !contenders.Empty() && i < popLimit;
-       ++i) {
-    // Get the best detour from the queue.
-    std::auto_ptr<const ChartTrellisDetour> detour(contenders.Pop());
-    CHECK(detour.get());
-
-    // Create a full base path from the chosen detour.
-    basePath.reset(new ChartTrellisPath(*detour));
-
-    // Generate new detours from this base path and add them to the queue of
-    // contenders.  The new detours deviate from the base path by a single
-    // replacement along the previous detour sub-path.
-    CHECK(basePath->GetDeviationPoint());
-    CreateDeviantPaths(basePath, *(basePath->GetDeviationPoint()), contenders);
+  Surface surface;
+  for (size_t i = 0; ret.GetSize() < count && i < popLimit; ++i) {
+    const ChartKBest::Derivation *derivation = kBest.Get(i);
+    if (derivation == NULL) {
+      break;
+    }
+    // the virtual root has the derivation of hypo as its only child
+    derivation = derivation->children[0];
 
     // If the n-best list is allowed to contain duplicate translations (at the
     // surface level) then add the new path unconditionally, otherwise check
     // whether the translation has seen before.
-    if (!onlyDistinct) {
-      ret.Add(basePath);
-    } else {
-      Phrase tgtPhrase = basePath->GetOutputPhrase();
-      if (distinctHyps.insert(tgtPhrase).second) {
-        ret.Add(basePath);
+    if (onlyDistinct) {
+      surface.clear();
+      AppendSurface(*derivation, outputFactors, surface);
+      if (!distinctHyps.insert(surface).second) {
+        continue;
       }
     }
+    ret.Add(boost::shared_ptr<ChartTrellisPath>(new ChartTrellisPath(CreateTrellisNode(*derivation))));
   }
 }
 
@@ -228,11 +266,69 @@ void ChartManager::CalcDecoderStatistics() const
 }
 
 void ChartManager::GetSearchGraph(long translationId, std::ostream &outputSearchGraphStream) const
+{
+  std::vector<const ChartHypothesis*> searchGraph;
+  GetSearchGraph(searchGraph);
+  for (size_t i = 0; i < searchGraph.size(); ++i) {
+    outputSearchGraphStream << translationId << " " << *searchGraph[i] << endl;
+  }
+}
+
+void ChartManager::OutputSearchGraphBinary(long translationId, std::string &out) const
+{
+  const StaticData &staticData = StaticData::Instance();
+  const std::vector<FactorType> &outputFactorOrder = staticData.GetOutputFactorOrder();
+
+  std::vector<const ChartHypothesis*> searchGraph;
+  GetSearchGraph(searchGraph);
+
+  SearchGraphBinary graph;
+  SearchGraphBinaryWriter writer(graph);
+  graph.translationId = translationId;
+  graph.numScores = staticData.GetScoreIndexManager().GetTotalNumberOfScores();
+  graph.edges.resize(searchGraph.size());
+
+  for (size_t i = 0; i < searchGraph.size(); ++i) {
+    const ChartHypothesis &hypo = *searchGraph[i];
+    SearchGraphBinary::Edge &edge = graph.edges[i];
+
+    edge.id = hypo.GetId();
+    edge.winner = hypo.GetWinningHypothesis() ? hypo.GetWinningHypothesis()->GetId() : edge.id;
+    edge.start = hypo.GetCurrSourceRange().GetStartPos();
+    edge.end = hypo.GetCurrSourceRange().GetEndPos();
+    edge.score = hypo.GetTotalScore();
+    edge.transition = hypo.GetTotalScore();
+    ScoreComponentCollection scores = hypo.GetScoreBreakdown();
+
+    const std::vector<const ChartHypothesis*> &prevHypos = hypo.GetPrevHypos();
+    for (size_t j = 0; j < prevHypos.size(); ++j) {
+      edge.tails.push_back(prevHypos[j]->GetId());
+      edge.transition -= prevHypos[j]->GetTotalScore();
+      scores.MinusEquals(prevHypos[j]->GetScoreBreakdown());
+    }
+
+    const TargetPhrase &targetPhrase = hypo.GetCurrTargetPhrase();
+    edge.words.resize(targetPhrase.GetSize());
+    for (size_t pos = 0; pos < targetPhrase.GetSize(); ++pos) {
+      edge.words[pos] = writer.AddWord(targetPhrase.GetWord(pos).GetString(outputFactorOrder, false));
+    }
+
+    edge.scores.resize(graph.numScores);
+    for (size_t j = 0; j < graph.numScores; ++j) {
+      edge.scores[j] = scores[j];
+    }
+  }
+
+  writer.Encode(out);
+}
+
+void ChartManager::GetSearchGraph(std::vector<const ChartHypothesis*> &searchGraph) const
 {
   size_t size = m_source.GetSize();
 
 	// which hypotheses are reachable?
-	std::map<unsigned,bool> reachable;
+	// hypothesis ids are handed out consecutively by GetNextHypoId()
+	std::vector<bool> reachable(m_hypothesisId, false);
 	WordsRange fullRange(0, size-1);
 	const ChartCell &lastCell = m_hypoStackColl.Get(fullRange);
   const ChartHypothesis *hypo = lastCell.GetBestHypothesis();
@@ -247,18 +343,17 @@ void ChartManager::GetSearchGraph(long translationId, std::ostream &outputSearch
     for (size_t startPos = 0; startPos <= size-width; ++startPos) {
       size_t endPos = startPos + width - 1;
       WordsRange range(startPos, endPos);
-      TRACE_ERR(" " << range << "=");
 
       const ChartCell &cell = m_hypoStackColl.Get(range);
-      cell.GetSearchGraph(translationId, outputSearchGraphStream, reachable);
+      cell.GetSearchGraph(reachable, searchGraph);
     }
   }
 }
 
-void ChartManager::FindReachableHypotheses( const ChartHypothesis *hypo, std::map<unsigned,bool> &reachable ) const
+void ChartManager::FindReachableHypotheses( const ChartHypothesis *hypo, std::vector<bool> &reachable ) const
 {
 	// do not recurse, if already visited
-	if (reachable.find(hypo->GetId()) != reachable.end())
+	if (reachable[hypo->GetId()])
 	{
 		return;
 	}
@@ -282,34 +377,4 @@ void ChartManager::FindReachableHypotheses( const ChartHypothesis *hypo, std::ma
 	}
 }
 
-void ChartManager::CreateDeviantPaths(
-    boost::shared_ptr<const ChartTrellisPath> basePath,
-    ChartTrellisDetourQueue &q)
-{
-  CreateDeviantPaths(basePath, basePath->GetFinalNode(), q);
-}
-
-void ChartManager::CreateDeviantPaths(
-    boost::shared_ptr<const ChartTrellisPath> basePath,
-    const ChartTrellisNode &substitutedNode,
-    ChartTrellisDetourQueue &queue)
-{
-  const ChartArcList *arcList = substitutedNode.GetHypothesis().GetArcList();
-  if (arcList) {
-    for (ChartArcList::const_iterator iter = arcList->begin();
-         iter != arcList->end(); ++iter) {
-      const ChartHypothesis &replacement = **iter;
-      queue.Push(new ChartTrellisDetour(basePath, substitutedNode,
-                                        replacement));
-    }
-  }
-  // recusively create deviant paths for child nodes
-  const ChartTrellisNode::NodeChildren &children = substitutedNode.GetChildren();
-  ChartTrellisNode::NodeChildren::const_iterator iter;
-  for (iter = children.begin(); iter != children.end(); ++iter) {
-    const ChartTrellisNode &child = **iter;
-    CreateDeviantPaths(basePath, child, queue);
-  }
-}
-
 } // namespace Moses
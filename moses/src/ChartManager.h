@@ -37,21 +37,12 @@ namespace Moses
 {
 
 class ChartHypothesis;
-class ChartTrellisDetourQueue;
-class ChartTrellisNode;
 class ChartTrellisPath;
 class ChartTrellisPathList;
 
 class ChartManager
 {
 private:
-  static void CreateDeviantPaths(boost::shared_ptr<const ChartTrellisPath>,
-                                 ChartTrellisDetourQueue &);
-
-  static void CreateDeviantPaths(boost::shared_ptr<const ChartTrellisPath>,
-                                 const ChartTrellisNode &,
-                                 ChartTrellisDetourQueue &);
-
   InputType const& m_source; /**< source sentence to be translated */
   ChartCellCollection m_hypoStackColl;
   ChartTranslationOptionCollection m_transOptColl; /**< pre-computed list of translation options for the phrases in this sentence */
@@ -69,7 +60,10 @@ public:
   void CalcNBest(size_t count, ChartTrellisPathList &ret,bool onlyDistinct=0) const;
 
   void GetSearchGraph(long translationId, std::ostream &outputSearchGraphStream) const;
-	void FindReachableHypotheses( const ChartHypothesis *hypo, std::map<unsigned,bool> &reachable ) const; /* auxilliary function for GetSearchGraph */
+  //! append the search graph as a record of the -output-search-graph-binary format
+  void OutputSearchGraphBinary(long translationId, std::string &out) const;
+  void GetSearchGraph(std::vector<const ChartHypothesis*> &searchGraph) const;
+	void FindReachableHypotheses( const ChartHypothesis *hypo, std::vector<bool> &reachable ) const; /* auxilliary function for GetSearchGraph */
 
   const InputType& GetSource() const {
     return m_source;
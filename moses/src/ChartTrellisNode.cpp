@@ -22,7 +22,6 @@
 #include "ChartTrellisNode.h"
 
 #include "ChartHypothesis.h"
-#include "ChartTrellisDetour.h"
 #include "ChartTrellisPath.h"
 #include "StaticData.h"
 #include "DotChart.h"
@@ -36,36 +35,12 @@ ChartTrellisNode::ChartTrellisNode(const ChartHypothesis &hypo)
   CreateChildren();
 }
 
-ChartTrellisNode::ChartTrellisNode(const ChartTrellisDetour &detour,
-                                   ChartTrellisNode *&deviationPoint)
-    : m_hypo((&detour.GetBasePath().GetFinalNode() == &detour.GetSubstitutedNode())
-             ? detour.GetReplacementHypo()
-             : detour.GetBasePath().GetFinalNode().GetHypothesis())
-{
-  if (&m_hypo == &detour.GetReplacementHypo()) {
-    deviationPoint = this;
-    CreateChildren();
-  } else {
-    CreateChildren(detour.GetBasePath().GetFinalNode(),
-                   detour.GetSubstitutedNode(), detour.GetReplacementHypo(),
-                   deviationPoint);
-  }
-}
-
-ChartTrellisNode::ChartTrellisNode(const ChartTrellisNode &root,
-                                   const ChartTrellisNode &substitutedNode,
-                                   const ChartHypothesis &replacementHypo,
-                                   ChartTrellisNode *&deviationPoint)
-    : m_hypo((&root == &substitutedNode)
-             ? replacementHypo
-             : root.GetHypothesis())
+ChartTrellisNode::ChartTrellisNode(const ChartHypothesis &hypo,
+                                   NodeChildren &children)
+    : m_hypo(hypo)
 {
-  if (&root == &substitutedNode) {
-    deviationPoint = this;
-    CreateChildren();
-  } else {
-    CreateChildren(root, substitutedNode, replacementHypo, deviationPoint);
-  }
+  CHECK(children.size() == hypo.GetPrevHypos().size());
+  m_children.swap(children);
 }
 
 ChartTrellisNode::~ChartTrellisNode()
@@ -113,21 +88,4 @@ void ChartTrellisNode::CreateChildren()
   }
 }
 
-void ChartTrellisNode::CreateChildren(const ChartTrellisNode &rootNode,
-                                      const ChartTrellisNode &substitutedNode,
-                                      const ChartHypothesis &replacementHypo,
-                                      ChartTrellisNode *&deviationPoint)
-{
-  CHECK(m_children.empty());
-  const NodeChildren &children = rootNode.GetChildren();
-  m_children.reserve(children.size());
-  for (size_t ind = 0; ind < children.size(); ++ind) {
-    const ChartTrellisNode *origChild = children[ind];
-    ChartTrellisNode *child = new ChartTrellisNode(*origChild, substitutedNode,
-                                                   replacementHypo,
-                                                   deviationPoint);
-    m_children.push_back(child);
-  }
-}
-
 }
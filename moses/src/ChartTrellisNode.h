@@ -28,7 +28,6 @@ namespace Moses
 {
 class ScoreComponentCollection;
 class ChartHypothesis;
-class ChartTrellisDetour;
 
 class ChartTrellisNode
 {
@@ -36,7 +35,8 @@ class ChartTrellisNode
   typedef std::vector<ChartTrellisNode*> NodeChildren;
 
   ChartTrellisNode(const ChartHypothesis &hypo);
-  ChartTrellisNode(const ChartTrellisDetour &, ChartTrellisNode *&);
+  //! takes ownership of the children, which replace those of hypo
+  ChartTrellisNode(const ChartHypothesis &hypo, NodeChildren &children);
 
   ~ChartTrellisNode();
 
@@ -52,12 +52,7 @@ class ChartTrellisNode
   ChartTrellisNode(const ChartTrellisNode &);  // Not implemented
   ChartTrellisNode& operator=(const ChartTrellisNode &);  // Not implemented
 
-  ChartTrellisNode(const ChartTrellisNode &, const ChartTrellisNode &,
-                   const ChartHypothesis &, ChartTrellisNode *&);
-
   void CreateChildren();
-  void CreateChildren(const ChartTrellisNode &, const ChartTrellisNode &,
-                      const ChartHypothesis &, ChartTrellisNode *&);
 
   const ChartHypothesis &m_hypo;
   NodeChildren m_children;
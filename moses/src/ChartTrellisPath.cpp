@@ -22,8 +22,6 @@
 #include "ChartTrellisPath.h"
 
 #include "ChartHypothesis.h"
-#include "ChartTrellisDetour.h"
-#include "ChartTrellisDetourQueue.h"
 #include "ChartTrellisNode.h"
 
 namespace Moses
@@ -31,23 +29,40 @@ namespace Moses
 
 ChartTrellisPath::ChartTrellisPath(const ChartHypothesis &hypo)
     : m_finalNode(new ChartTrellisNode(hypo))
-    , m_deviationPoint(NULL)
     , m_scoreBreakdown(hypo.GetScoreBreakdown())
     , m_totalScore(hypo.GetTotalScore())
 {
 }
 
-ChartTrellisPath::ChartTrellisPath(const ChartTrellisDetour &detour)
-   : m_finalNode(new ChartTrellisNode(detour, m_deviationPoint))
-   , m_scoreBreakdown(detour.GetBasePath().m_scoreBreakdown)
-   , m_totalScore(0)
+ChartTrellisPath::ChartTrellisPath(ChartTrellisNode *finalNode)
+   : m_finalNode(finalNode)
+   , m_scoreBreakdown(finalNode->GetHypothesis().GetScoreBreakdown())
+   , m_totalScore(finalNode->GetHypothesis().GetTotalScore())
 {
-  CHECK(m_deviationPoint);
-  ScoreComponentCollection scoreChange;
-  scoreChange = detour.GetReplacementHypo().GetScoreBreakdown();
-  scoreChange.MinusEquals(detour.GetSubstitutedNode().GetHypothesis().GetScoreBreakdown());
-  m_scoreBreakdown.PlusEquals(scoreChange);
-  m_totalScore = m_scoreBreakdown.GetWeightedScore();
+  bool changed = false;
+  AddScoreChanges(*m_finalNode, m_scoreBreakdown, changed);
+  if (changed) {
+    m_totalScore = m_scoreBreakdown.GetWeightedScore();
+  }
+}
+
+/** Wherever a node's child differs from the previous hypothesis the node's
+ *  hypothesis was built from, add the difference in scores.
+ */
+void ChartTrellisPath::AddScoreChanges(const ChartTrellisNode &node,
+                                       ScoreComponentCollection &scoreBreakdown,
+                                       bool &changed)
+{
+  const std::vector<const ChartHypothesis*> &prevHypos = node.GetHypothesis().GetPrevHypos();
+  for (size_t i = 0; i < prevHypos.size(); ++i) {
+    const ChartTrellisNode &child = node.GetChild(i);
+    if (&child.GetHypothesis() != prevHypos[i]) {
+      scoreBreakdown.PlusEquals(child.GetHypothesis().GetScoreBreakdown());
+      scoreBreakdown.MinusEquals(prevHypos[i]->GetScoreBreakdown());
+      changed = true;
+    }
+    AddScoreChanges(child, scoreBreakdown, changed);
+  }
 }
 
 ChartTrellisPath::~ChartTrellisPath()
@@ -30,22 +30,19 @@ namespace Moses
 {
 
 class ChartHypothesis;
-class ChartTrellisDetour;
-class ChartTrellisDetourQueue;
 class ChartTrellisNode;
 
 class ChartTrellisPath
 {
  public:
   ChartTrellisPath(const ChartHypothesis &hypo);
-  ChartTrellisPath(const ChartTrellisDetour &detour);
+  //! takes ownership of finalNode, which may use any hypotheses for its descendents
+  explicit ChartTrellisPath(ChartTrellisNode *finalNode);
 
   ~ChartTrellisPath();
 
   const ChartTrellisNode &GetFinalNode() const { return *m_finalNode; }
 
-  const ChartTrellisNode *GetDeviationPoint() const { return m_deviationPoint; }
-
   //! get score for this path throught trellis
   float GetTotalScore() const { return m_totalScore; }
 
@@ -58,10 +55,11 @@ class ChartTrellisPath
 
  private:
   ChartTrellisPath(const ChartTrellisPath &);  // Not implemented
+  static void AddScoreChanges(const ChartTrellisNode &, ScoreComponentCollection &,
+                              bool &changed);
   ChartTrellisPath &operator=(const ChartTrellisPath &);  // Not implemented
 
   ChartTrellisNode *m_finalNode;
-  ChartTrellisNode *m_deviationPoint;
   ScoreComponentCollection m_scoreBreakdown;
   float m_totalScore;
 };
@@ -0,0 +1,219 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_ChunkedVector_h
+#define moses_ChunkedVector_h
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "util/check.hh"
+
+namespace Moses
+{
+
+/** A vector stored in chunks which are shared between copies.
+ *
+ * Copying costs a pointer per chunk, and a chunk is only duplicated when the
+ * copy which changes it shares it with another. This lets a copy be updated
+ * while the original is read by other threads, as long as each copy is only
+ * changed by one thread. Elements can be inserted and erased anywhere; a
+ * chunk is split when it grows to twice the chunk size.
+ */
+template <typename T>
+class ChunkedVector
+{
+public:
+  explicit ChunkedVector(size_t chunkSize = 1024)
+    : m_size(0), m_chunkSize(chunkSize) {}
+
+  template <typename Iterator>
+  ChunkedVector(Iterator begin, Iterator end, size_t chunkSize = 1024)
+    : m_size(0), m_chunkSize(chunkSize) {
+    for (; begin != end; ++begin) push_back(*begin);
+  }
+
+  size_t size() const {
+    return m_size;
+  }
+  bool empty() const {
+    return m_size == 0;
+  }
+
+  const T &operator[](size_t i) const {
+    const size_t chunk = ChunkOf(i);
+    return (*m_chunks[chunk])[i - m_starts[chunk]];
+  }
+  const T &at(size_t i) const {
+    CHECK(i < m_size);
+    return (*this)[i];
+  }
+  const T &back() const {
+    return m_chunks.back()->back();
+  }
+
+  void set(size_t i, const T &value) {
+    CHECK(i < m_size);
+    const size_t chunk = ChunkOf(i);
+    Writable(chunk)[i - m_starts[chunk]] = value;
+  }
+
+  void push_back(const T &value) {
+    if (m_chunks.empty() || m_chunks.back()->size() >= m_chunkSize) {
+      m_starts.push_back(m_size);
+      m_chunks.push_back(ChunkPtr(new Chunk()));
+      m_chunks.back()->reserve(m_chunkSize);
+    }
+    Writable(m_chunks.size() - 1).push_back(value);
+    ++m_size;
+  }
+
+  void insert(size_t i, const T &value) {
+    CHECK(i <= m_size);
+    if (i == m_size) {
+      push_back(value);
+      return;
+    }
+    const size_t chunk = ChunkOf(i);
+    Chunk &values = Writable(chunk);
+    values.insert(values.begin() + (i - m_starts[chunk]), value);
+    ++m_size;
+    for (size_t c = chunk + 1; c < m_starts.size(); ++c) ++m_starts[c];
+    if (values.size() >= 2 * m_chunkSize) Split(chunk);
+  }
+
+  void erase(size_t i) {
+    CHECK(i < m_size);
+    const size_t chunk = ChunkOf(i);
+    Chunk &values = Writable(chunk);
+    values.erase(values.begin() + (i - m_starts[chunk]));
+    --m_size;
+    for (size_t c = chunk + 1; c < m_starts.size(); ++c) --m_starts[c];
+    if (values.empty()) {
+      m_chunks.erase(m_chunks.begin() + chunk);
+      m_starts.erase(m_starts.begin() + chunk);
+    }
+  }
+
+  //! number of elements equal to value in [0, end)
+  size_t count(const T &value, size_t end) const {
+    CHECK(end <= m_size);
+    size_t ret = 0;
+    for (size_t c = 0; c < m_chunks.size() && m_starts[c] < end; ++c) {
+      const Chunk &values = *m_chunks[c];
+      const size_t n = std::min(values.size(), end - m_starts[c]);
+      ret += std::count(values.begin(), values.begin() + n, value);
+    }
+    return ret;
+  }
+
+  //! index of the first element equal to value, or size() if there is none
+  size_t find(const T &value) const {
+    for (size_t c = 0; c < m_chunks.size(); ++c) {
+      const Chunk &values = *m_chunks[c];
+      typename Chunk::const_iterator found = std::find(values.begin(), values.end(), value);
+      if (found != values.end()) return m_starts[c] + (found - values.begin());
+    }
+    return m_size;
+  }
+
+  //! as std::lower_bound and std::upper_bound, for sorted contents
+  size_t lower_bound(const T &value) const {
+    // first chunk whose last element is not less than value
+    size_t lo = 0, hi = m_chunks.size();
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (m_chunks[mid]->back() < value) lo = mid + 1;
+      else hi = mid;
+    }
+    if (lo == m_chunks.size()) return m_size;
+    const Chunk &values = *m_chunks[lo];
+    return m_starts[lo] + (std::lower_bound(values.begin(), values.end(), value) - values.begin());
+  }
+  size_t upper_bound(const T &value) const {
+    // first chunk whose last element is greater than value
+    size_t lo = 0, hi = m_chunks.size();
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (value < m_chunks[mid]->back()) hi = mid;
+      else lo = mid + 1;
+    }
+    if (lo == m_chunks.size()) return m_size;
+    const Chunk &values = *m_chunks[lo];
+    return m_starts[lo] + (std::upper_bound(values.begin(), values.end(), value) - values.begin());
+  }
+
+  //! replaces every element v with op(v)
+  template <typename UnaryOp>
+  void transform(UnaryOp op) {
+    for (size_t c = 0; c < m_chunks.size(); ++c) {
+      Chunk &values = Writable(c);
+      std::transform(values.begin(), values.end(), values.begin(), op);
+    }
+  }
+
+  void copy_to(std::vector<T> &out) const {
+    out.clear();
+    out.reserve(m_size);
+    for (size_t c = 0; c < m_chunks.size(); ++c) {
+      out.insert(out.end(), m_chunks[c]->begin(), m_chunks[c]->end());
+    }
+  }
+
+private:
+  typedef std::vector<T> Chunk;
+  typedef boost::shared_ptr<Chunk> ChunkPtr;
+
+  std::vector<ChunkPtr> m_chunks;
+  //! index of the first element of each chunk
+  std::vector<size_t> m_starts;
+  size_t m_size, m_chunkSize;
+
+  size_t ChunkOf(size_t i) const {
+    return std::upper_bound(m_starts.begin(), m_starts.end(), i) - m_starts.begin() - 1;
+  }
+
+  // the chunk, copied first if another vector shares it
+  Chunk &Writable(size_t chunk) {
+    if (!m_chunks[chunk].unique()) {
+      ChunkPtr copy(new Chunk());
+      copy->reserve(std::max(m_chunks[chunk]->size(), m_chunkSize));
+      copy->insert(copy->end(), m_chunks[chunk]->begin(), m_chunks[chunk]->end());
+      m_chunks[chunk] = copy;
+    }
+    return *m_chunks[chunk];
+  }
+
+  void Split(size_t chunk) {
+    Chunk &values = *m_chunks[chunk];
+    const size_t half = values.size() / 2;
+    ChunkPtr second(new Chunk(values.begin() + half, values.end()));
+    values.erase(values.begin() + half, values.end());
+    m_chunks.insert(m_chunks.begin() + chunk + 1, second);
+    m_starts.insert(m_starts.begin() + chunk + 1, m_starts[chunk] + half);
+  }
+};
+
+}
+
+#endif
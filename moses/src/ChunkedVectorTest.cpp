@@ -0,0 +1,114 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+#include "ChunkedVector.h"
+
+using namespace Moses;
+
+namespace
+{
+
+void CheckEqual(const ChunkedVector<int> &chunked, const std::vector<int> &expected)
+{
+  BOOST_REQUIRE_EQUAL(expected.size(), chunked.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(expected[i], chunked[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MatchesVector)
+{
+  srand(1);
+  ChunkedVector<int> chunked(4);
+  std::vector<int> expected;
+  for (size_t step = 0; step < 2000; ++step) {
+    const int value = rand() % 10;
+    switch (expected.empty() ? 0 : rand() % 4) {
+    case 0:
+      chunked.push_back(value);
+      expected.push_back(value);
+      break;
+    case 1: {
+      const size_t i = rand() % (expected.size() + 1);
+      chunked.insert(i, value);
+      expected.insert(expected.begin() + i, value);
+      break;
+    }
+    case 2: {
+      const size_t i = rand() % expected.size();
+      chunked.erase(i);
+      expected.erase(expected.begin() + i);
+      break;
+    }
+    case 3: {
+      const size_t i = rand() % expected.size();
+      chunked.set(i, value);
+      expected[i] = value;
+      break;
+    }
+    }
+    CheckEqual(chunked, expected);
+    const size_t end = rand() % (expected.size() + 1);
+    BOOST_CHECK_EQUAL(size_t(std::count(expected.begin(), expected.begin() + end, value)),
+                      chunked.count(value, end));
+    BOOST_CHECK_EQUAL(size_t(std::find(expected.begin(), expected.end(), value) - expected.begin()),
+                      chunked.find(value));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Bounds)
+{
+  std::vector<int> expected;
+  for (int i = 0; i < 50; ++i) expected.push_back(i / 3 * 2);
+  ChunkedVector<int> chunked(expected.begin(), expected.end(), 4);
+  for (int value = -1; value < 40; ++value) {
+    BOOST_CHECK_EQUAL(size_t(std::lower_bound(expected.begin(), expected.end(), value) - expected.begin()),
+                      chunked.lower_bound(value));
+    BOOST_CHECK_EQUAL(size_t(std::upper_bound(expected.begin(), expected.end(), value) - expected.begin()),
+                      chunked.upper_bound(value));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CopiesDontSeeChanges)
+{
+  std::vector<int> expected;
+  for (int i = 0; i < 100; ++i) expected.push_back(i);
+  ChunkedVector<int> original(expected.begin(), expected.end(), 8);
+  ChunkedVector<int> copy(original);
+  copy.set(3, -1);
+  copy.insert(50, -2);
+  copy.erase(90);
+  copy.push_back(-3);
+  CheckEqual(original, expected);
+  std::vector<int> copied;
+  copy.copy_to(copied);
+  BOOST_CHECK_EQUAL(-1, copied[3]);
+  BOOST_CHECK_EQUAL(-2, copied[50]);
+  BOOST_CHECK_EQUAL(-3, copied.back());
+  BOOST_CHECK_EQUAL(expected.size() + 1, copied.size());
+}
+
+}
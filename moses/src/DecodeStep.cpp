@@ -22,10 +22,36 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "DecodeStep.h"
 #include "PhraseDictionaryMemory.h"
 #include "GenerationDictionary.h"
+#include "TranslationOption.h"
 #include "StaticData.h"
 
 namespace Moses
 {
+
+namespace
+{
+
+class WordDeletionExpansion : public PartialExpansion
+{
+public:
+  WordDeletionExpansion(const TranslationSystem* system, const TranslationOption &input)
+    : m_system(system), m_input(&input) {}
+
+  TranslationOption *Next() {
+    if (!m_input) return NULL;
+    TranslationOption *newTransOpt = new TranslationOption(*m_input);
+    newTransOpt->CalcScore(m_system);
+    m_input = NULL;
+    return newTransOpt;
+  }
+
+private:
+  const TranslationSystem* m_system;
+  const TranslationOption *m_input;
+};
+
+}
+
 DecodeStep::DecodeStep(const DecodeFeature *decodeFeature, const DecodeStep* prev) :
   m_decodeFeature(decodeFeature)
 {
@@ -61,6 +87,12 @@ const GenerationDictionary* DecodeStep::GetGenerationDictionaryFeature() const
   return dynamic_cast<const GenerationDictionary*>(m_decodeFeature);
 }
 
+PartialExpansion *DecodeStep::ExpandWordDeletion(const TranslationSystem* system
+    , const TranslationOption &inputPartialTranslOpt)
+{
+  return new WordDeletionExpansion(system, inputPartialTranslOpt);
+}
+
 }
 
 
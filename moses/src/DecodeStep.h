@@ -39,6 +39,17 @@ class FactorCollection;
 class InputType;
 class TranslationSystem;
 
+/*! The extensions of one partial translation option by a decode step, created
+ * one at a time and roughly best first, so that the caller can stop early */
+class PartialExpansion
+{
+public:
+  virtual ~PartialExpansion() {}
+
+  //! the next extension, scored with CalcScore(); NULL once there are none
+  virtual TranslationOption *Next() = 0;
+};
+
 /*! Specification for a decoding step.
  * The factored translation model consists of Translation and Generation
  * steps, which consult a Dictionary of phrase translations or word
@@ -103,9 +114,20 @@ public:
                        , TranslationOptionCollection *toc
                        , bool adhereTableLimit) const = 0;
 
+  /*! Like Process(), but returns the extensions lazily.  Deleted by the caller */
+  virtual PartialExpansion *Expand(const TranslationSystem* system
+                                   , const TranslationOption &inputPartialTranslOpt
+                                   , TranslationOptionCollection *toc
+                                   , bool adhereTableLimit) const = 0;
+
   /** Do any sentence specific initialisation */
   virtual void InitializeBeforeSentenceProcessing(InputType const&) const {}
 
+protected:
+  //! the only extension of an option translating to no words: itself
+  static PartialExpansion *ExpandWordDeletion(const TranslationSystem* system
+      , const TranslationOption &inputPartialTranslOpt);
+
 };
 
 }
@@ -19,12 +19,16 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 ***********************************************************************/
 
+#include <algorithm>
+#include <queue>
+
 #include "DecodeStepGeneration.h"
 #include "GenerationDictionary.h"
 #include "TranslationOption.h"
 #include "TranslationOptionCollection.h"
 #include "PartialTranslOptColl.h"
 #include "FactorCollection.h"
+#include "StaticData.h"
 
 namespace Moses
 {
@@ -49,26 +53,16 @@ TranslationOption *DecodeStepGeneration::MergeGeneration(const TranslationOption
   return newTransOpt;
 }
 
-// helpers
-typedef pair<Word, ScoreComponentCollection> WordPair;
-typedef list< WordPair > WordList;
-// 1st = word
-// 2nd = score
-typedef list< WordPair >::const_iterator WordListIterator;
-
-/** used in generation: increases iterators when looping through the exponential number of generation expansions */
-inline void IncrementIterators(vector< WordListIterator > &wordListIterVector
-                               , const vector< WordList > &wordListVector)
+/** used in generation: increases the indices of the chosen output words when looping through the exponential number of generation expansions */
+inline void IncrementChoices(vector<size_t> &choices, const vector<OutputWordCollection> &wordCollVector)
 {
-  for (size_t currPos = 0 ; currPos < wordListVector.size() ; currPos++) {
-    WordListIterator &iter = wordListIterVector[currPos];
-    iter++;
-    if (iter != wordListVector[currPos].end()) {
+  for (size_t currPos = 0 ; currPos < wordCollVector.size() ; currPos++) {
+    if (++choices[currPos] < wordCollVector[currPos].size()) {
       // eg. 4 -> 5
       return;
     } else {
       //  eg 9 -> 10
-      iter = wordListVector[currPos].begin();
+      choices[currPos] = 0;
     }
   }
 }
@@ -96,45 +90,32 @@ void DecodeStepGeneration::Process(const TranslationSystem* system
   const Phrase &targetPhrase  = inputPartialTranslOpt.GetTargetPhrase();
   size_t targetLength         = targetPhrase.GetSize();
 
-  // generation list for each word in phrase
-  vector< WordList > wordListVector(targetLength);
+  // generation list for each word in phrase, views into the dictionary
+  vector<OutputWordCollection> wordCollVector(targetLength);
 
   // create generation list
-  int wordListVectorPos = 0;
   for (size_t currPos = 0 ; currPos < targetLength ; currPos++) { // going thorugh all words
-    // generatable factors for this word to be put in wordList
-    WordList &wordList = wordListVector[wordListVectorPos];
     const Word &word = targetPhrase.GetWord(currPos);
 
     // consult dictionary for possible generations for this word
-    const OutputWordCollection *wordColl = generationDictionary->FindWord(word);
+    wordCollVector[currPos] = generationDictionary->FindWord(word);
 
-    if (wordColl == NULL) {
+    if (wordCollVector[currPos].empty()) {
       // word not found in generation dictionary
       //toc->ProcessUnknownWord(sourceWordsRange.GetStartPos(), factorCollection);
       return; // can't be part of a phrase, special handling
-    } else {
-      // sort(*wordColl, CompareWordCollScore);
-      OutputWordCollection::const_iterator iterWordColl;
-      for (iterWordColl = wordColl->begin() ; iterWordColl != wordColl->end(); ++iterWordColl) {
-        const Word &outputWord = (*iterWordColl).first;
-        const ScoreComponentCollection& score = (*iterWordColl).second;
-        // enter into word list generated factor(s) and its(their) score(s)
-        wordList.push_back(WordPair(outputWord, score));
-      }
-
-      wordListVectorPos++; // done, next word
     }
   }
 
-  // use generation list (wordList)
-  // set up iterators (total number of expansions)
+  // use generation list
+  // set up choices (total number of expansions)
   size_t numIteration = 1;
-  vector< WordListIterator >  wordListIterVector(targetLength);
+  vector< size_t >            choices(targetLength, 0);
+  vector< Word >              outputWords(targetLength);
   vector< const Word* >       mergeWords(targetLength);
   for (size_t currPos = 0 ; currPos < targetLength ; currPos++) {
-    wordListIterVector[currPos] = wordListVector[currPos].begin();
-    numIteration *= wordListVector[currPos].size();
+    mergeWords[currPos] = &outputWords[currPos];
+    numIteration *= wordCollVector[currPos].size();
   }
 
   // go thru each possible factor for each word & create hypothesis
@@ -143,9 +124,9 @@ void DecodeStepGeneration::Process(const TranslationSystem* system
 
     // create vector of words with new factors for last phrase
     for (size_t currPos = 0 ; currPos < targetLength ; currPos++) {
-      const WordPair &wordPair = *wordListIterVector[currPos];
-      mergeWords[currPos] = &(wordPair.first);
-      generationScore.PlusEquals(wordPair.second);
+      const OutputWordCollection &wordColl = wordCollVector[currPos];
+      wordColl.SetWord(choices[currPos], outputWords[currPos]);
+      generationScore.PlusEquals(generationDictionary, wordColl.GetScores(choices[currPos]));
     }
 
     // merge with existing trans opt
@@ -155,11 +136,137 @@ void DecodeStepGeneration::Process(const TranslationSystem* system
       outputPartialTranslOptColl.Add(system, newTransOpt);
     }
 
-    // increment iterators
-    IncrementIterators(wordListIterVector, wordListVector);
+    // increment choices
+    IncrementChoices(choices, wordCollVector);
   }
 }
 
-}
+/** the generations of a partial option, best first by their generation
+ * score.  Each word's output words are ranked by their weighted score, and
+ * the combinations of ranks are enumerated lazily from a heap: a combination
+ * leads to those with one rank further down at or after the position it
+ * changed last, so that each one is reached once.
+ */
+class DecodeStepGeneration::Expansion : public PartialExpansion
+{
+public:
+  Expansion(const DecodeStepGeneration &step, const TranslationSystem* system
+            , const TranslationOption &input, std::vector<OutputWordCollection> &wordCollVector)
+    : m_step(step), m_system(system), m_input(input)
+    , m_outputWords(wordCollVector.size()), m_mergeWords(wordCollVector.size())
+    , m_order(wordCollVector.size()), m_weighted(wordCollVector.size()) {
+    m_wordCollVector.swap(wordCollVector);
+    const GenerationDictionary *dict = m_step.GetGenerationDictionaryFeature();
+    const std::vector<float> &weights = StaticData::Instance().GetAllWeights();
+    const size_t begin = StaticData::Instance().GetScoreIndexManager().GetBeginIndex(dict->GetScoreBookkeepingID());
+    const size_t numScores = dict->GetNumScoreComponents();
+
+    Choice best;
+    best.score = 0;
+    best.ranks.resize(m_wordCollVector.size(), 0);
+    best.changed = 0;
+    for (size_t currPos = 0 ; currPos < m_wordCollVector.size() ; currPos++) {
+      m_mergeWords[currPos] = &m_outputWords[currPos];
+      const OutputWordCollection &wordColl = m_wordCollVector[currPos];
+      std::vector<std::pair<float, size_t> > ranked(wordColl.size());
+      for (size_t i = 0; i < wordColl.size(); ++i) {
+        const float *scores = wordColl.GetScores(i);
+        float score = 0;
+        for (size_t j = 0; j < numScores; ++j) {
+          score += weights[begin + j] * scores[j];
+        }
+        ranked[i] = std::make_pair(-score, i);
+      }
+      std::sort(ranked.begin(), ranked.end());
+      for (size_t i = 0; i < ranked.size(); ++i) {
+        m_order[currPos].push_back(ranked[i].second);
+        m_weighted[currPos].push_back(-ranked[i].first);
+      }
+      best.score += m_weighted[currPos][0];
+    }
+    // empty if a word has no generation
+    if (!m_wordCollVector.empty()) {
+      m_frontier.push(best);
+    }
+  }
+
+  TranslationOption *Next() {
+    while (!m_frontier.empty()) {
+      const Choice choice = m_frontier.top();
+      m_frontier.pop();
+      for (size_t currPos = choice.changed ; currPos < choice.ranks.size() ; currPos++) {
+        const size_t rank = choice.ranks[currPos];
+        if (rank + 1 < m_order[currPos].size()) {
+          Choice next(choice);
+          next.ranks[currPos]++;
+          next.score += m_weighted[currPos][rank + 1] - m_weighted[currPos][rank];
+          next.changed = currPos;
+          m_frontier.push(next);
+        }
+      }
+
+      ScoreComponentCollection generationScore;
+      for (size_t currPos = 0 ; currPos < choice.ranks.size() ; currPos++) {
+        const OutputWordCollection &wordColl = m_wordCollVector[currPos];
+        const size_t i = m_order[currPos][choice.ranks[currPos]];
+        wordColl.SetWord(i, m_outputWords[currPos]);
+        generationScore.PlusEquals(m_step.GetGenerationDictionaryFeature(), wordColl.GetScores(i));
+      }
+      Phrase genPhrase(m_mergeWords);
+      TranslationOption *newTransOpt = m_step.MergeGeneration(m_input, genPhrase, generationScore);
+      if (newTransOpt != NULL) {
+        newTransOpt->CalcScore(m_system);
+        return newTransOpt;
+      }
+    }
+    return NULL;
+  }
+
+private:
+  struct Choice {
+    float score;
+    std::vector<size_t> ranks;
+    size_t changed;
+    bool operator<(const Choice &other) const {
+      return score < other.score;
+    }
+  };
 
+  const DecodeStepGeneration &m_step;
+  const TranslationSystem* m_system;
+  const TranslationOption &m_input;
+  std::vector<OutputWordCollection> m_wordCollVector;
+  std::vector<Word> m_outputWords;
+  std::vector<const Word*> m_mergeWords;
+  // per word, the indices of the output words best first, and their weighted scores
+  std::vector<std::vector<size_t> > m_order;
+  std::vector<std::vector<float> > m_weighted;
+  std::priority_queue<Choice> m_frontier;
+};
 
+PartialExpansion *DecodeStepGeneration::Expand(const TranslationSystem* system
+    , const TranslationOption &inputPartialTranslOpt
+    , TranslationOptionCollection * /* toc */
+    , bool /*adhereTableLimit*/) const
+{
+  const Phrase &targetPhrase  = inputPartialTranslOpt.GetTargetPhrase();
+  size_t targetLength         = targetPhrase.GetSize();
+  if (targetLength == 0) {
+    // word deletion
+    return ExpandWordDeletion(system, inputPartialTranslOpt);
+  }
+
+  const GenerationDictionary* generationDictionary  = GetGenerationDictionaryFeature();
+  vector<OutputWordCollection> wordCollVector(targetLength);
+  for (size_t currPos = 0 ; currPos < targetLength ; currPos++) {
+    wordCollVector[currPos] = generationDictionary->FindWord(targetPhrase.GetWord(currPos));
+    if (wordCollVector[currPos].empty()) {
+      // no generation for this word, so none for the phrase
+      wordCollVector.clear();
+      break;
+    }
+  }
+  return new Expansion(*this, system, inputPartialTranslOpt, wordCollVector);
+}
+
+}
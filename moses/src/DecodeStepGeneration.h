@@ -45,7 +45,14 @@ public:
                        , TranslationOptionCollection *toc
                        , bool adhereTableLimit) const;
 
+  virtual PartialExpansion *Expand(const TranslationSystem* system
+                                   , const TranslationOption &inputPartialTranslOpt
+                                   , TranslationOptionCollection *toc
+                                   , bool adhereTableLimit) const;
+
 private:
+  class Expansion;
+
   /*! create new TranslationOption from merging oldTO with mergePhrase
   	This function runs IsCompatible() to ensure the two can be merged
   */
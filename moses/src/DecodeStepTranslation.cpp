@@ -19,6 +19,8 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 ***********************************************************************/
 
+#include <algorithm>
+
 #include "DecodeStepTranslation.h"
 #include "PhraseDictionaryMemory.h"
 #include "TranslationOption.h"
@@ -92,6 +94,76 @@ void DecodeStepTranslation::Process(const TranslationSystem* system
 }
 
 
+/** helper, best target phrases first */
+inline bool CompareTargetPhraseScore(const TargetPhrase *a, const TargetPhrase *b)
+{
+  return a->GetFutureScore() > b->GetFutureScore();
+}
+
+/** the target phrases of the input span with as many words as the partial
+ * option, merged in the order of their scores in the phrase table */
+class DecodeStepTranslation::Expansion : public PartialExpansion
+{
+public:
+  Expansion(const DecodeStepTranslation &step, const TranslationSystem* system
+            , const TranslationOption &input, std::vector<const TargetPhrase*> &targetPhrases)
+    : m_step(step), m_system(system), m_input(input), m_next(0) {
+    m_targetPhrases.swap(targetPhrases);
+    std::sort(m_targetPhrases.begin(), m_targetPhrases.end(), CompareTargetPhraseScore);
+  }
+
+  TranslationOption *Next() {
+    while (m_next < m_targetPhrases.size()) {
+      TranslationOption *newTransOpt = m_step.MergeTranslation(m_input, *m_targetPhrases[m_next++]);
+      if (newTransOpt != NULL) {
+        newTransOpt->CalcScore(m_system);
+        return newTransOpt;
+      }
+    }
+    return NULL;
+  }
+
+private:
+  const DecodeStepTranslation &m_step;
+  const TranslationSystem* m_system;
+  const TranslationOption &m_input;
+  std::vector<const TargetPhrase*> m_targetPhrases;
+  size_t m_next;
+};
+
+PartialExpansion *DecodeStepTranslation::Expand(const TranslationSystem* system
+    , const TranslationOption &inputPartialTranslOpt
+    , TranslationOptionCollection *toc
+    , bool adhereTableLimit) const
+{
+  if (inputPartialTranslOpt.GetTargetPhrase().GetSize() == 0) {
+    // word deletion
+    return ExpandWordDeletion(system, inputPartialTranslOpt);
+  }
+
+  const WordsRange &sourceWordsRange        = inputPartialTranslOpt.GetSourceWordsRange();
+  const PhraseDictionary* phraseDictionary  = GetPhraseDictionaryFeature()->GetDictionary();
+  const size_t currSize = inputPartialTranslOpt.GetTargetPhrase().GetSize();
+  const size_t tableLimit = phraseDictionary->GetTableLimit();
+
+  const TargetPhraseCollection *phraseColl=
+    phraseDictionary->GetTargetPhraseCollection(toc->GetSource(),sourceWordsRange);
+
+  std::vector<const TargetPhrase*> targetPhrases;
+  if (phraseColl != NULL) {
+    TargetPhraseCollection::const_iterator iterTargetPhrase, iterEnd;
+    iterEnd = (!adhereTableLimit || tableLimit == 0 || phraseColl->GetSize() < tableLimit) ? phraseColl->end() : phraseColl->begin() + tableLimit;
+
+    for (iterTargetPhrase = phraseColl->begin(); iterTargetPhrase != iterEnd; ++iterTargetPhrase) {
+      if ((*iterTargetPhrase)->GetSize() == currSize) {
+        targetPhrases.push_back(*iterTargetPhrase);
+      }
+    }
+  }
+  return new Expansion(*this, system, inputPartialTranslOpt, targetPhrases);
+}
+
+
 void DecodeStepTranslation::ProcessInitialTranslation(const TranslationSystem* system
     , const InputType &source
     ,PartialTranslOptColl &outputPartialTranslOptColl
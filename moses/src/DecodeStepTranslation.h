@@ -46,6 +46,11 @@ public:
                        , TranslationOptionCollection *toc
                        , bool adhereTableLimit) const;
 
+  virtual PartialExpansion *Expand(const TranslationSystem* system
+                                   , const TranslationOption &inputPartialTranslOpt
+                                   , TranslationOptionCollection *toc
+                                   , bool adhereTableLimit) const;
+
 
   /*! initialize list of partial translation options by applying the first translation step
   * Ideally, this function should be in DecodeStepTranslation class
@@ -56,6 +61,8 @@ public:
                                  , size_t startPos, size_t endPos, bool adhereTableLimit) const;
 
 private:
+  class Expansion;
+
   /*! create new TranslationOption from merging oldTO with mergePhrase
   	This function runs IsCompatible() to ensure the two can be merged
   */
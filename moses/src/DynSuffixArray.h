@@ -7,44 +7,77 @@
 #include <utility>
 #include "Util.h"
 #include "File.h"
+#include "ChunkedVector.h"
 #include "DynSAInclude/types.h"
 
 namespace Moses
 {
 
 typedef std::vector<unsigned> vuint_t;
+//! word ids of a corpus, which copies share until they change
+typedef ChunkedVector<unsigned> corpus_t;
 
+/** Suffix array of a corpus, to which text can be inserted.
+ *
+ * Suffixes are sorted on their first SORT_DEPTH words, shorter ones first
+ * where one ends, which is enough to look up phrases of up to that length.
+ * Inserting text changes the order of the suffixes which end within
+ * SORT_DEPTH words of it, so Insert() takes those out and puts them back,
+ * with the new suffixes, by binary search. The suffix array and its F
+ * column (the first word of each suffix) are chunked vectors, so a copy
+ * shares all the chunks an insertion into it leaves unchanged.
+ */
 class DynSuffixArray
 {
 
 public:
+  static const unsigned SORT_DEPTH = 20;
+
   DynSuffixArray();
-  DynSuffixArray(vuint_t*);
+  DynSuffixArray(const corpus_t*);
+  //! a copy of other, over crp, a copy of the corpus of other
+  DynSuffixArray(const DynSuffixArray& other, const corpus_t* crp);
   ~DynSuffixArray();
-  bool GetCorpusIndex(const vuint_t*, vuint_t*);
+  bool GetCorpusIndex(const vuint_t*, vuint_t*) const;
   void Load(FILE*);
   void Save(FILE*);
-  void Insert(vuint_t*, unsigned);
-  void Delete(unsigned, unsigned);
+  //! the corpus must already have newSent at newIndex
+  void Insert(vuint_t* newSent, unsigned newIndex);
+  //! the corpus must still have the words to delete
+  void Delete(unsigned index, unsigned num2del);
   void Substitute(vuint_t*, unsigned);
+  //! the suffix array, for tests
+  void GetSuffixArray(vuint_t& sa) const {
+    m_SA.copy_to(sa);
+  }
 
 private:
-  vuint_t* m_SA;
-  vuint_t* m_ISA;
-  vuint_t* m_F;
-  vuint_t* m_L;
-  vuint_t* m_corpus;
+  // the corpus as it is before or after an update: positions from gapStart
+  // on are gapLength further on in m_corpus
+  struct View {
+    View(const corpus_t* corpus, unsigned gapStart = 0, unsigned gapLength = 0)
+      : corpus(corpus), gapStart(gapStart), gapLength(gapLength)
+      , size(corpus->size() - gapLength) {}
+    unsigned operator[](unsigned pos) const {
+      return (*corpus)[pos < gapStart ? pos : pos + gapLength];
+    }
+    const corpus_t* corpus;
+    unsigned gapStart, gapLength, size;
+  };
+
+  ChunkedVector<unsigned> m_SA;
+  ChunkedVector<unsigned> m_F;
+  const corpus_t* m_corpus;
   void BuildAuxArrays();
-  void Qsort(int* array, int begin, int end);
-  int Compare(int, int, int);
-  void Reorder(unsigned, unsigned);
-  int LastFirstFunc(unsigned);
-  int Rank(unsigned, unsigned);
-  int F_firstIdx(unsigned);
+  void Qsort(const vuint_t& corpus, int* array, int begin, int end);
+  int Compare(const vuint_t& corpus, int, int, int);
+  int Compare(const View& view, unsigned pos1, unsigned pos2) const;
+  void Add(const View& view, unsigned pos);
+  void Remove(const View& view, unsigned pos);
   void PrintAuxArrays() {
-    std::cerr << "SA\tISA\tF\tL\n";
-    for(size_t i=0; i < m_SA->size(); ++i)
-      std::cerr << m_SA->at(i) << "\t" << m_ISA->at(i) << "\t" << m_F->at(i) << "\t" << m_L->at(i) << std::endl;
+    std::cerr << "SA\tF\n";
+    for(size_t i=0; i < m_SA.size(); ++i)
+      std::cerr << m_SA[i] << "\t" << m_F[i] << std::endl;
   }
 };
 
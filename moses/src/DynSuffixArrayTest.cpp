@@ -0,0 +1,178 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+#include "DynSuffixArray.h"
+
+using namespace Moses;
+
+namespace
+{
+
+// sentences of word ids 1..vocab, short enough for phrases to recur
+std::vector<vuint_t> MakeSentences(size_t count, unsigned vocab, unsigned seed)
+{
+  srand(seed);
+  std::vector<vuint_t> sentences(count);
+  for (size_t i = 0; i < count; ++i) {
+    const size_t length = 1 + rand() % 12;
+    for (size_t j = 0; j < length; ++j) {
+      sentences[i].push_back(1 + rand() % vocab);
+    }
+  }
+  return sentences;
+}
+
+// rightmost positions of every occurrence of phrase, by brute force
+vuint_t Occurrences(const corpus_t &corpus, const vuint_t &phrase)
+{
+  vuint_t ret;
+  for (size_t i = 0; i + phrase.size() <= corpus.size(); ++i) {
+    size_t j = 0;
+    while (j < phrase.size() && corpus[i + j] == phrase[j]) ++j;
+    if (j == phrase.size()) ret.push_back(i + phrase.size() - 1);
+  }
+  return ret;
+}
+
+vuint_t Lookup(const DynSuffixArray &sa, const vuint_t &phrase)
+{
+  vuint_t ret;
+  sa.GetCorpusIndex(&phrase, &ret);
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+// every phrase of up to three words in the corpus, and some which aren't
+std::set<vuint_t> Phrases(const corpus_t &corpus, unsigned vocab)
+{
+  std::set<vuint_t> ret;
+  for (size_t i = 0; i < corpus.size(); ++i) {
+    for (size_t length = 1; length <= 3 && i + length <= corpus.size(); ++length) {
+      vuint_t phrase;
+      for (size_t j = 0; j < length; ++j) phrase.push_back(corpus[i + j]);
+      ret.insert(phrase);
+    }
+  }
+  for (unsigned w = 1; w <= vocab; ++w) {
+    ret.insert(vuint_t(3, w));
+  }
+  return ret;
+}
+
+void CheckLookups(const DynSuffixArray &sa, const corpus_t &corpus, unsigned vocab)
+{
+  const std::set<vuint_t> phrases = Phrases(corpus, vocab);
+  for (std::set<vuint_t>::const_iterator i = phrases.begin(); i != phrases.end(); ++i) {
+    const vuint_t expected = Occurrences(corpus, *i);
+    const vuint_t found = Lookup(sa, *i);
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(), expected.begin(), expected.end());
+  }
+}
+
+void Append(corpus_t &corpus, DynSuffixArray &sa, vuint_t &sentence)
+{
+  const unsigned index = corpus.size();
+  for (size_t i = 0; i < sentence.size(); ++i) corpus.push_back(sentence[i]);
+  sa.Insert(&sentence, index);
+}
+
+BOOST_AUTO_TEST_CASE(InsertMatchesRebuild)
+{
+  const unsigned vocab = 8;
+  std::vector<vuint_t> sentences = MakeSentences(120, vocab, 1);
+  corpus_t corpus(16);
+  for (size_t i = 0; i < 60; ++i) {
+    for (size_t j = 0; j < sentences[i].size(); ++j) corpus.push_back(sentences[i][j]);
+  }
+  DynSuffixArray inserted(&corpus);
+  for (size_t i = 60; i < sentences.size(); ++i) {
+    Append(corpus, inserted, sentences[i]);
+  }
+  DynSuffixArray rebuilt(&corpus);
+
+  vuint_t sa;
+  inserted.GetSuffixArray(sa);
+  BOOST_REQUIRE_EQUAL(corpus.size(), sa.size());
+  std::sort(sa.begin(), sa.end());
+  for (size_t i = 0; i < sa.size(); ++i) BOOST_REQUIRE_EQUAL(i, sa[i]);
+
+  CheckLookups(inserted, corpus, vocab);
+  CheckLookups(rebuilt, corpus, vocab);
+}
+
+BOOST_AUTO_TEST_CASE(CopyIsIndependent)
+{
+  const unsigned vocab = 6;
+  std::vector<vuint_t> sentences = MakeSentences(80, vocab, 2);
+  corpus_t corpus(16);
+  for (size_t i = 0; i < 40; ++i) {
+    for (size_t j = 0; j < sentences[i].size(); ++j) corpus.push_back(sentences[i][j]);
+  }
+  DynSuffixArray original(&corpus);
+  vuint_t before;
+  original.GetSuffixArray(before);
+
+  corpus_t copyCorpus(corpus);
+  DynSuffixArray copy(original, &copyCorpus);
+  for (size_t i = 40; i < sentences.size(); ++i) {
+    Append(copyCorpus, copy, sentences[i]);
+  }
+
+  // the copy sees the new sentences, the original is as it was
+  vuint_t after;
+  original.GetSuffixArray(after);
+  BOOST_CHECK_EQUAL_COLLECTIONS(before.begin(), before.end(), after.begin(), after.end());
+  CheckLookups(original, corpus, vocab);
+  CheckLookups(copy, copyCorpus, vocab);
+}
+
+BOOST_AUTO_TEST_CASE(InsertAndDeleteInTheMiddle)
+{
+  const unsigned vocab = 5;
+  std::vector<vuint_t> sentences = MakeSentences(60, vocab, 3);
+  corpus_t corpus(16);
+  for (size_t i = 0; i < 50; ++i) {
+    for (size_t j = 0; j < sentences[i].size(); ++j) corpus.push_back(sentences[i][j]);
+  }
+  DynSuffixArray sa(&corpus);
+  for (size_t i = 50; i < sentences.size(); ++i) {
+    const unsigned index = corpus.size() * (i - 49) / 12;
+    for (size_t j = 0; j < sentences[i].size(); ++j) corpus.insert(index + j, sentences[i][j]);
+    sa.Insert(&sentences[i], index);
+    CheckLookups(sa, corpus, vocab);
+
+    sa.Delete(index, sentences[i].size());
+    for (size_t j = 0; j < sentences[i].size(); ++j) corpus.erase(index);
+    CheckLookups(sa, corpus, vocab);
+
+    for (size_t j = 0; j < sentences[i].size(); ++j) corpus.insert(index + j, sentences[i][j]);
+    sa.Insert(&sentences[i], index);
+  }
+  CheckLookups(sa, corpus, vocab);
+}
+
+}
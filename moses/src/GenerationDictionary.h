@@ -22,33 +22,25 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef moses_GenerationDictionary_h
 #define moses_GenerationDictionary_h
 
-#include <list>
-#include <map>
 #include <vector>
 #include "ScoreComponentCollection.h"
 #include "Phrase.h"
 #include "TypeDef.h"
 #include "Dictionary.h"
 #include "DecodeFeature.h"
+#include "GenerationTable.h"
 
 namespace Moses
 {
 
-class FactorCollection;
-
-typedef std::map < Word , ScoreComponentCollection > OutputWordCollection;
-// 1st = output phrase
-// 2nd = log probability (score)
-
-/** Implementation of a generation table in a trie.
+/** Generation table feature.  The table is read from a text file, or mapped
+ *  from the binary form of processGenerationTable if there is a file with
+ *  the same name and the extension .bingen.
  */
 class GenerationDictionary : public Dictionary, public DecodeFeature
 {
-  typedef std::map<const Word* , OutputWordCollection, WordComparer> Collection;
 protected:
-  Collection m_collection;
-  // 1st = source
-  // 2nd = target
+  GenerationTable m_table;
   std::string						m_filePath;
 
 public:
@@ -78,12 +70,14 @@ public:
   * NOT the number of lines in the generation table
   */
   size_t GetSize() const {
-    return m_collection.size();
+    return m_table.GetNumSources();
   }
-  /** returns a bag of output words, OutputWordCollection, for a particular input word.
-  *	Or NULL if the input word isn't found. The search function used is the WordComparer functor
+  /** returns a bag of output words, OutputWordCollection, for the input factors of a word.
+  *	Empty if the input word isn't found.  A view into the table, not a copy
   */
-  const OutputWordCollection *FindWord(const Word &word) const;
+  OutputWordCollection FindWord(const Word &word) const {
+    return m_table.Find(word);
+  }
   virtual bool ComputeValueInTranslationOption() const;
 };
 
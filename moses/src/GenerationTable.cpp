@@ -0,0 +1,383 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <boost/functional/hash.hpp>
+
+#include "util/exception.hh"
+#include "util/file.hh"
+
+#include "GenerationTable.h"
+#include "FactorCollection.h"
+#include "UserMessage.h"
+#include "Util.h"
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+const char kMagic[8] = {'M', 'o', 's', 'e', 's', 'G', 'e', 'n'};
+const uint32_t kVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t version, numInput, numOutput, numScores;
+  uint64_t vocabBytes, numVocab, numSources, numEntries;
+};
+
+// index of factor in vocab, adding it if it is new
+uint32_t Intern(const Factor *factor, vector<const Factor*> &vocab, boost::unordered_map<const Factor*, uint32_t> &ids)
+{
+  pair<boost::unordered_map<const Factor*, uint32_t>::iterator, bool> ret =
+    ids.insert(make_pair(factor, static_cast<uint32_t>(vocab.size())));
+  if (ret.second) {
+    vocab.push_back(factor);
+  }
+  return ret.first->second;
+}
+
+}
+
+bool GenerationTable::Key::operator==(const Key &other) const
+{
+  for (size_t i = 0; i < MAX_NUM_FACTORS; ++i) {
+    if (factors[i] != other.factors[i]) return false;
+  }
+  return true;
+}
+
+size_t GenerationTable::KeyHash::operator()(const Key &key) const
+{
+  return boost::hash_range(key.factors, key.factors + MAX_NUM_FACTORS);
+}
+
+GenerationTable::GenerationTable(const vector<FactorType> &input, const vector<FactorType> &output, size_t numScores)
+  : m_input(input), m_output(output), m_numScores(numScores)
+  , m_numEntries(0), m_outputIds(NULL), m_scores(NULL)
+{
+  CHECK(m_input.size() <= MAX_NUM_FACTORS);
+}
+
+GenerationTable::Key GenerationTable::MakeKey(const Word &word) const
+{
+  Key key;
+  for (size_t i = 0; i < MAX_NUM_FACTORS; ++i) {
+    key.factors[i] = i < m_input.size() ? word.GetFactor(m_input[i]) : NULL;
+  }
+  return key;
+}
+
+void GenerationTable::Clear()
+{
+  m_vocab.clear();
+  m_sources.clear();
+  m_numEntries = 0;
+  m_outputIds = NULL;
+  m_scores = NULL;
+  m_outputIdStore.clear();
+  m_scoreStore.clear();
+  m_mapping.reset();
+}
+
+OutputWordCollection GenerationTable::Find(const Word &word) const
+{
+  Sources::const_iterator iter = m_sources.find(MakeKey(word));
+  if (iter == m_sources.end()) {
+    return OutputWordCollection();
+  }
+  return OutputWordCollection(*this, iter->second.begin, iter->second.end);
+}
+
+bool GenerationTable::LoadText(istream &in, const string &filePath)
+{
+  Clear();
+  FactorCollection &factorCollection = FactorCollection::Instance();
+  const size_t numOutput = m_output.size();
+
+  boost::unordered_map<const Factor*, uint32_t> vocabIds;
+  // the inputs in the order they are first seen
+  vector<Key> keys;
+  boost::unordered_map<Key, uint32_t, KeyHash> keyIds;
+  // the entries in the order of the file, with the index of their input.
+  // A later line with the same input and output replaces the earlier one.
+  vector<uint32_t> entryKeys, entryOutputIds;
+  vector<float> entryScores;
+  boost::unordered_map<vector<uint32_t>, uint32_t> entryIds;
+  vector<uint32_t> entry(1 + numOutput);
+
+  string line;
+  size_t lineNum = 0;
+  while(getline(in, line)) {
+    ++lineNum;
+    vector<string> token = Tokenize(line);
+    vector<string> inputFactors = Tokenize(token.size() > 0 ? token[0] : "", "|");
+    vector<string> outputFactors = Tokenize(token.size() > 1 ? token[1] : "", "|");
+    if (inputFactors.size() < m_input.size() || outputFactors.size() < numOutput) {
+      stringstream strme;
+      strme << filePath << ":" << lineNum << ": expected " << m_input.size() << " input and "
+            << numOutput << " output factors" << std::endl;
+      UserMessage::Add(strme.str());
+      return false;
+    }
+    size_t numFeaturesInFile = token.size() - 2;
+    if (numFeaturesInFile < m_numScores) {
+      stringstream strme;
+      strme << filePath << ":" << lineNum << ": expected " << m_numScores
+            << " feature values, but found " << numFeaturesInFile << std::endl;
+      UserMessage::Add(strme.str());
+      return false;
+    }
+
+    Key key;
+    for (size_t i = 0; i < MAX_NUM_FACTORS; ++i) {
+      key.factors[i] = i < m_input.size() ? factorCollection.AddFactor(inputFactors[i]) : NULL;
+    }
+    pair<boost::unordered_map<Key, uint32_t, KeyHash>::iterator, bool> keyRet =
+      keyIds.insert(make_pair(key, static_cast<uint32_t>(keys.size())));
+    if (keyRet.second) {
+      keys.push_back(key);
+    }
+    entry[0] = keyRet.first->second;
+    for (size_t i = 0; i < numOutput; ++i) {
+      entry[1 + i] = Intern(factorCollection.AddFactor(outputFactors[i]), m_vocab, vocabIds);
+    }
+
+    pair<boost::unordered_map<vector<uint32_t>, uint32_t>::iterator, bool> entryRet =
+      entryIds.insert(make_pair(entry, static_cast<uint32_t>(entryKeys.size())));
+    const size_t entryId = entryRet.first->second;
+    if (entryRet.second) {
+      entryKeys.push_back(entry[0]);
+      entryOutputIds.insert(entryOutputIds.end(), entry.begin() + 1, entry.end());
+      entryScores.resize(entryScores.size() + m_numScores);
+    }
+    for (size_t i = 0; i < m_numScores; i++)
+      entryScores[entryId * m_numScores + i] = FloorScore(TransformScore(Scan<float>(token[2+i])));
+  }
+
+  // make the entries of each input contiguous, keeping their order
+  vector<uint32_t> begin(keys.size() + 1, 0);
+  for (size_t e = 0; e < entryKeys.size(); ++e) {
+    ++begin[entryKeys[e] + 1];
+  }
+  for (size_t k = 0; k < keys.size(); ++k) {
+    begin[k + 1] += begin[k];
+  }
+  m_numEntries = entryKeys.size();
+  m_outputIdStore.resize(m_numEntries * numOutput);
+  m_scoreStore.resize(m_numEntries * m_numScores);
+  vector<uint32_t> next(begin.begin(), begin.end() - 1);
+  for (size_t e = 0; e < entryKeys.size(); ++e) {
+    const size_t to = next[entryKeys[e]]++;
+    copy(entryOutputIds.begin() + e * numOutput, entryOutputIds.begin() + (e + 1) * numOutput
+         , m_outputIdStore.begin() + to * numOutput);
+    copy(entryScores.begin() + e * m_numScores, entryScores.begin() + (e + 1) * m_numScores
+         , m_scoreStore.begin() + to * m_numScores);
+  }
+  for (size_t k = 0; k < keys.size(); ++k) {
+    Range range;
+    range.begin = begin[k];
+    range.end = begin[k + 1];
+    m_sources.insert(make_pair(keys[k], range));
+  }
+  m_outputIds = m_outputIdStore.empty() ? NULL : &m_outputIdStore[0];
+  m_scores = m_scoreStore.empty() ? NULL : &m_scoreStore[0];
+  return true;
+}
+
+bool GenerationTable::SaveBinary(const string &filePath) const
+{
+  // the input factors are not in the vocabulary of the output words yet
+  vector<const Factor*> vocab(m_vocab);
+  boost::unordered_map<const Factor*, uint32_t> vocabIds;
+  for (size_t i = 0; i < vocab.size(); ++i) {
+    vocabIds[vocab[i]] = i;
+  }
+  vector<uint32_t> sources;
+  sources.reserve(m_sources.size() * (m_input.size() + 2));
+  for (Sources::const_iterator iter = m_sources.begin(); iter != m_sources.end(); ++iter) {
+    for (size_t i = 0; i < m_input.size(); ++i) {
+      sources.push_back(Intern(iter->first.factors[i], vocab, vocabIds));
+    }
+    sources.push_back(iter->second.begin);
+    sources.push_back(iter->second.end);
+  }
+  string strings;
+  for (size_t i = 0; i < vocab.size(); ++i) {
+    strings += vocab[i]->GetString();
+    strings += '\0';
+  }
+  strings.resize((strings.size() + 3) & ~static_cast<size_t>(3), '\0');
+
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.numInput = m_input.size();
+  header.numOutput = m_output.size();
+  header.numScores = m_numScores;
+  header.vocabBytes = strings.size();
+  header.numVocab = vocab.size();
+  header.numSources = m_sources.size();
+  header.numEntries = m_numEntries;
+
+  ofstream out(filePath.c_str(), ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(strings.data(), strings.size());
+  if (!sources.empty()) {
+    out.write(reinterpret_cast<const char*>(&sources[0]), sources.size() * sizeof(uint32_t));
+  }
+  if (m_numEntries) {
+    out.write(reinterpret_cast<const char*>(m_outputIds), m_numEntries * m_output.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(m_scores), m_numEntries * m_numScores * sizeof(float));
+  }
+  out.close();
+  if (!out) {
+    UserMessage::Add(string("Couldn't write ") + filePath);
+    return false;
+  }
+  return true;
+}
+
+bool GenerationTable::LoadBinary(const string &filePath)
+{
+  Clear();
+  try {
+    util::scoped_fd file(util::OpenReadOrThrow(filePath.c_str()));
+    const uint64_t size = util::SizeFile(file.get());
+    if (size == util::kBadSize || size < sizeof(Header)) {
+      UserMessage::Add(filePath + " is not a binary generation table");
+      return false;
+    }
+    util::MapRead(util::LAZY, file.get(), 0, size, m_mapping);
+  } catch (const util::Exception &e) {
+    UserMessage::Add(e.what());
+    return false;
+  }
+
+  const char *data = m_mapping.begin();
+  Header header;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) || header.version != kVersion) {
+    UserMessage::Add(filePath + " is not a binary generation table");
+    return false;
+  }
+  if (header.numInput != m_input.size() || header.numOutput != m_output.size()
+      || header.numScores != m_numScores) {
+    stringstream strme;
+    strme << filePath << " has " << header.numInput << " input factors, " << header.numOutput
+          << " output factors and " << header.numScores << " scores, but the configuration says "
+          << m_input.size() << ", " << m_output.size() << " and " << m_numScores;
+    UserMessage::Add(strme.str());
+    return false;
+  }
+  const size_t recordSize = m_input.size() + 2;
+  // bound the counts by the size first, so that the offsets cannot overflow
+  const uint64_t size = m_mapping.size();
+  const uint64_t entryBytes = max<uint64_t>((m_output.size() + m_numScores) * sizeof(uint32_t), 1);
+  if (header.vocabBytes > size || header.vocabBytes % sizeof(uint32_t) || header.numVocab > header.vocabBytes
+      || header.numSources > size / (recordSize * sizeof(uint32_t))
+      || header.numEntries > size / entryBytes
+      || header.numVocab > numeric_limits<uint32_t>::max()
+      || header.numEntries > numeric_limits<uint32_t>::max()) {
+    UserMessage::Add(filePath + " has broken counts in its header");
+    return false;
+  }
+  const uint64_t sourcesOffset = sizeof(Header) + header.vocabBytes;
+  const uint64_t outputsOffset = sourcesOffset + header.numSources * recordSize * sizeof(uint32_t);
+  const uint64_t scoresOffset = outputsOffset + header.numEntries * m_output.size() * sizeof(uint32_t);
+  if (scoresOffset + header.numEntries * m_numScores * sizeof(float) != size) {
+    UserMessage::Add(filePath + " is truncated");
+    return false;
+  }
+
+  FactorCollection &factorCollection = FactorCollection::Instance();
+  const char *str = data + sizeof(Header);
+  const char *strEnd = data + sourcesOffset;
+  m_vocab.reserve(header.numVocab);
+  for (uint64_t i = 0; i < header.numVocab; ++i) {
+    const char *nul = static_cast<const char*>(memchr(str, '\0', strEnd - str));
+    if (!nul) {
+      UserMessage::Add(filePath + " has a broken vocabulary");
+      return false;
+    }
+    m_vocab.push_back(factorCollection.AddFactor(StringPiece(str, nul - str)));
+    str = nul + 1;
+  }
+  if (strEnd - str >= static_cast<ptrdiff_t>(sizeof(uint32_t))) {
+    UserMessage::Add(filePath + " has a broken vocabulary");
+    return false;
+  }
+
+  // the entries themselves stay in the mapping, only read when they are used
+  const uint32_t *record = reinterpret_cast<const uint32_t*>(data + sourcesOffset);
+  m_sources.rehash(header.numSources);
+  for (uint64_t s = 0; s < header.numSources; ++s, record += recordSize) {
+    Key key;
+    for (size_t i = 0; i < MAX_NUM_FACTORS; ++i) {
+      key.factors[i] = NULL;
+    }
+    for (size_t i = 0; i < m_input.size(); ++i) {
+      if (record[i] >= m_vocab.size()) {
+        UserMessage::Add(filePath + " has a broken input");
+        return false;
+      }
+      key.factors[i] = m_vocab[record[i]];
+    }
+    Range range;
+    range.begin = record[m_input.size()];
+    range.end = record[m_input.size() + 1];
+    if (range.begin > range.end || range.end > header.numEntries) {
+      UserMessage::Add(filePath + " has a broken input");
+      return false;
+    }
+    if (!m_sources.insert(make_pair(key, range)).second) {
+      UserMessage::Add(filePath + " has an input twice");
+      return false;
+    }
+  }
+
+  // one pass over the output ids, so that a broken table fails here rather
+  // than in the decoder
+  const uint32_t *outputIds = reinterpret_cast<const uint32_t*>(data + outputsOffset);
+  const uint64_t numOutputIds = header.numEntries * m_output.size();
+  for (uint64_t i = 0; i < numOutputIds; ++i) {
+    if (outputIds[i] >= m_vocab.size()) {
+      stringstream strme;
+      strme << filePath << " has an output word " << outputIds[i] << " beyond its vocabulary of " << m_vocab.size();
+      UserMessage::Add(strme.str());
+      return false;
+    }
+  }
+  m_numEntries = header.numEntries;
+  m_outputIds = outputIds;
+  m_scores = reinterpret_cast<const float*>(data + scoresOffset);
+  return true;
+}
+
+}
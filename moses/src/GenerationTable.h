@@ -0,0 +1,163 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_GenerationTable_h
+#define moses_GenerationTable_h
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include "util/mmap.hh"
+
+#include "TypeDef.h"
+#include "Word.h"
+
+namespace Moses
+{
+
+class Factor;
+class GenerationTable;
+
+/** The output words of one input word in a generation table, with their
+ *  scores.  A view into the table: it is only valid as long as the table.
+ */
+class OutputWordCollection
+{
+public:
+  OutputWordCollection() : m_table(NULL), m_begin(0), m_end(0) {}
+  OutputWordCollection(const GenerationTable &table, size_t begin, size_t end)
+    : m_table(&table), m_begin(begin), m_end(end) {}
+
+  bool empty() const {
+    return m_begin == m_end;
+  }
+  size_t size() const {
+    return m_end - m_begin;
+  }
+
+  //! set the output factors of the i-th output word in word
+  void SetWord(size_t i, Word &word) const;
+  //! log scores of the i-th output word, one per score component
+  const float *GetScores(size_t i) const;
+
+private:
+  const GenerationTable *m_table;
+  size_t m_begin, m_end;
+};
+
+/** Generation table in flat arrays.  Every factor string is interned once
+ *  in a vocabulary, and the entries with the same input factors are
+ *  contiguous: their output factor ids in one array, their scores in
+ *  another.  A hash of the input factors gives the range of their entries.
+ *
+ *  The binary form, written by SaveBinary() and by processGenerationTable,
+ *  is mapped into memory by LoadBinary(), so the entries are read straight
+ *  from the page cache and shared between decoders.  It is in the byte
+ *  order of the machine that wrote it, like the other binary tables:
+ *
+ *  header   := "MosesGen" version numInput numOutput numScores  (uint32)
+ *              vocabBytes numVocab numSources numEntries         (uint64)
+ *  vocab    := the factor strings, each ending in a NUL, padded to 4 bytes
+ *  sources  := numSources * (numInput vocab ids, begin, end)    (uint32)
+ *  outputs  := numEntries * numOutput vocab ids                 (uint32)
+ *  scores   := numEntries * numScores log scores                (float)
+ */
+class GenerationTable
+{
+public:
+  GenerationTable(const std::vector<FactorType> &input, const std::vector<FactorType> &output, size_t numScores);
+
+  //! read a text generation table, false with a UserMessage on errors
+  bool LoadText(std::istream &in, const std::string &filePath);
+  //! map a binary generation table
+  bool LoadBinary(const std::string &filePath);
+  bool SaveBinary(const std::string &filePath) const;
+
+  //! the output words of the input factors of word, empty if there are none
+  OutputWordCollection Find(const Word &word) const;
+
+  //! number of distinct inputs
+  size_t GetNumSources() const {
+    return m_sources.size();
+  }
+  size_t GetNumEntries() const {
+    return m_numEntries;
+  }
+
+private:
+  friend class OutputWordCollection;
+
+  struct Key {
+    const Factor *factors[MAX_NUM_FACTORS];
+    bool operator==(const Key &other) const;
+  };
+  struct KeyHash : public std::unary_function<const Key&, size_t> {
+    size_t operator()(const Key &key) const;
+  };
+  struct Range {
+    uint32_t begin, end;
+  };
+  typedef boost::unordered_map<Key, Range, KeyHash> Sources;
+
+  GenerationTable(const GenerationTable &);
+  void operator=(const GenerationTable &);
+
+  Key MakeKey(const Word &word) const;
+  void Clear();
+
+  std::vector<FactorType> m_input, m_output;
+  size_t m_numScores;
+
+  std::vector<const Factor*> m_vocab;
+  Sources m_sources;
+  size_t m_numEntries;
+  // m_numEntries * m_output.size() ids, and m_numEntries * m_numScores scores,
+  // in the vectors for a text table and in m_mapping for a binary one
+  const uint32_t *m_outputIds;
+  const float *m_scores;
+  std::vector<uint32_t> m_outputIdStore;
+  std::vector<float> m_scoreStore;
+  util::scoped_memory m_mapping;
+};
+
+inline void OutputWordCollection::SetWord(size_t i, Word &word) const
+{
+  const size_t numOutput = m_table->m_output.size();
+  const uint32_t *ids = m_table->m_outputIds + (m_begin + i) * numOutput;
+  for (size_t j = 0; j < numOutput; ++j) {
+    word.SetFactor(m_table->m_output[j], m_table->m_vocab[ids[j]]);
+  }
+}
+
+inline const float *OutputWordCollection::GetScores(size_t i) const
+{
+  return m_table->m_scores + (m_begin + i) * m_table->m_numScores;
+}
+
+}
+
+#endif
@@ -0,0 +1,233 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "FactorCollection.h"
+#include "GenerationTable.h"
+#include "UserMessage.h"
+
+using namespace Moses;
+using namespace std;
+
+namespace
+{
+
+// offsets of the counts in the header of a binary table
+const size_t kVocabBytesAt = 24, kNumSourcesAt = 40, kNumEntriesAt = 48, kHeaderSize = 56;
+
+const char *kText =
+  "haus N|haus 0.5 0.25\n"
+  "haus V|hausen 0.1 1\n"
+  "das DET|der 1 1\n"
+  "haus N|haus 0.4 0.2\n";
+
+class TempFile
+{
+public:
+  TempFile() {
+    char name[] = "/tmp/moses_generation_table_test_XXXXXX";
+    int fd = mkstemp(name);
+    BOOST_REQUIRE(fd != -1);
+    close(fd);
+    m_name = name;
+  }
+  ~TempFile() {
+    unlink(m_name.c_str());
+  }
+  const string &name() const {
+    return m_name;
+  }
+private:
+  string m_name;
+};
+
+vector<FactorType> Factors(FactorType first, FactorType last)
+{
+  vector<FactorType> factors;
+  for (FactorType f = first; f <= last; ++f) factors.push_back(f);
+  return factors;
+}
+
+// a generation table from factor 0 to factors 1 and 2, with two scores
+struct TextTable {
+  TextTable() : table(Factors(0, 0), Factors(1, 2), 2) {
+    istringstream in(kText);
+    BOOST_REQUIRE(table.LoadText(in, "text"));
+  }
+  GenerationTable table;
+};
+
+Word Input(const string &surface)
+{
+  Word word;
+  word.SetFactor(0, FactorCollection::Instance().AddFactor(surface));
+  return word;
+}
+
+string ReadFile(const string &name)
+{
+  ifstream in(name.c_str(), ios::binary);
+  return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+void WriteFile(const string &name, const string &bytes)
+{
+  ofstream out(name.c_str(), ios::binary);
+  out.write(bytes.data(), bytes.size());
+}
+
+uint64_t GetUint64(const string &bytes, size_t at)
+{
+  uint64_t value;
+  memcpy(&value, bytes.data() + at, sizeof(value));
+  return value;
+}
+
+void SetUint32(string &bytes, size_t at, uint32_t value)
+{
+  memcpy(&bytes[at], &value, sizeof(value));
+}
+
+void SetUint64(string &bytes, size_t at, uint64_t value)
+{
+  memcpy(&bytes[at], &value, sizeof(value));
+}
+
+// whether a table with these bytes loads, with the error message if not
+bool LoadBytes(const string &bytes, string &message, size_t numScores = 2)
+{
+  TempFile file;
+  WriteFile(file.name(), bytes);
+  GenerationTable table(Factors(0, 0), Factors(1, 2), numScores);
+  UserMessage::SetOutput(false, true);
+  const bool loaded = table.LoadBinary(file.name());
+  UserMessage::SetOutput(true, false);
+  message = UserMessage::GetQueue();
+  return loaded;
+}
+
+BOOST_AUTO_TEST_CASE(GenerationTableBinaryRoundTrip)
+{
+  TextTable text;
+  BOOST_CHECK_EQUAL(2, text.table.GetNumSources());
+  // the last line replaced the first
+  BOOST_CHECK_EQUAL(3, text.table.GetNumEntries());
+
+  TempFile file;
+  BOOST_REQUIRE(text.table.SaveBinary(file.name()));
+  GenerationTable binary(Factors(0, 0), Factors(1, 2), 2);
+  BOOST_REQUIRE(binary.LoadBinary(file.name()));
+  BOOST_CHECK_EQUAL(text.table.GetNumSources(), binary.GetNumSources());
+  BOOST_CHECK_EQUAL(text.table.GetNumEntries(), binary.GetNumEntries());
+
+  const char *inputs[] = {"haus", "das", "katze"};
+  for (size_t i = 0; i < 3; ++i) {
+    const OutputWordCollection expect = text.table.Find(Input(inputs[i]));
+    const OutputWordCollection got = binary.Find(Input(inputs[i]));
+    BOOST_REQUIRE_EQUAL(expect.size(), got.size());
+    for (size_t j = 0; j < expect.size(); ++j) {
+      Word expectWord, gotWord;
+      expect.SetWord(j, expectWord);
+      got.SetWord(j, gotWord);
+      BOOST_CHECK(expectWord.GetFactor(1) == gotWord.GetFactor(1));
+      BOOST_CHECK(expectWord.GetFactor(2) == gotWord.GetFactor(2));
+      BOOST_CHECK_EQUAL(expect.GetScores(j)[0], got.GetScores(j)[0]);
+      BOOST_CHECK_EQUAL(expect.GetScores(j)[1], got.GetScores(j)[1]);
+    }
+  }
+  BOOST_CHECK(binary.Find(Input("katze")).empty());
+
+  const OutputWordCollection haus = binary.Find(Input("haus"));
+  BOOST_REQUIRE_EQUAL(2, haus.size());
+  Word word;
+  haus.SetWord(0, word);
+  BOOST_CHECK_EQUAL("N", word.GetFactor(1)->GetString());
+  BOOST_CHECK_EQUAL("haus", word.GetFactor(2)->GetString());
+  BOOST_CHECK_CLOSE(FloorScore(TransformScore(0.4)), haus.GetScores(0)[0], 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(GenerationTableCorruptFiles)
+{
+  TextTable text;
+  TempFile file;
+  BOOST_REQUIRE(text.table.SaveBinary(file.name()));
+  const string good = ReadFile(file.name());
+  const size_t sourcesAt = kHeaderSize + GetUint64(good, kVocabBytesAt);
+  // each source is one input id, then the range of its entries
+  const size_t sourceSize = 3 * sizeof(uint32_t);
+  const size_t outputsAt = sourcesAt + GetUint64(good, kNumSourcesAt) * sourceSize;
+  string message;
+  BOOST_REQUIRE(LoadBytes(good, message));
+
+  BOOST_CHECK(!LoadBytes("", message));
+  BOOST_CHECK(!LoadBytes(good.substr(0, good.size() - 4), message));
+  BOOST_CHECK(message.find("truncated") != string::npos);
+
+  string bytes = good;
+  bytes[0] = 'X';
+  BOOST_CHECK(!LoadBytes(bytes, message));
+
+  BOOST_CHECK(!LoadBytes(good, message, 3));
+  BOOST_CHECK(message.find("configuration") != string::npos);
+
+  // counts so large that the offsets would overflow
+  bytes = good;
+  SetUint64(bytes, kNumEntriesAt, ~static_cast<uint64_t>(0) / 4);
+  BOOST_CHECK(!LoadBytes(bytes, message));
+  BOOST_CHECK(message.find("counts") != string::npos);
+  bytes = good;
+  SetUint64(bytes, kVocabBytesAt, ~static_cast<uint64_t>(0) - 8);
+  BOOST_CHECK(!LoadBytes(bytes, message));
+
+  bytes = good;
+  SetUint32(bytes, sourcesAt, 1000);
+  BOOST_CHECK(!LoadBytes(bytes, message));
+  BOOST_CHECK(message.find("input") != string::npos);
+
+  bytes = good;
+  SetUint32(bytes, sourcesAt + 2 * sizeof(uint32_t), 1000);
+  BOOST_CHECK(!LoadBytes(bytes, message));
+  BOOST_CHECK(message.find("input") != string::npos);
+
+  bytes = good;
+  memcpy(&bytes[sourcesAt + sourceSize], &bytes[sourcesAt], sizeof(uint32_t));
+  BOOST_CHECK(!LoadBytes(bytes, message));
+  BOOST_CHECK(message.find("twice") != string::npos);
+
+  bytes = good;
+  SetUint32(bytes, outputsAt + sizeof(uint32_t), 1000);
+  BOOST_CHECK(!LoadBytes(bytes, message));
+  BOOST_CHECK(message.find("beyond its vocabulary") != string::npos);
+}
+
+}
@@ -25,6 +25,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <limits>
 #include <map>
 #include <set>
+#include <boost/unordered_map.hpp>
 #include "Hypothesis.h"
 #include "BitmapContainer.h"
 #include "HypothesisStack.h"
@@ -36,7 +37,7 @@ class BitmapContainer;
 class TranslationOptionList;
 class Manager;
 
-typedef std::map<WordsBitmap, BitmapContainer*> _BMType;
+typedef boost::unordered_map<WordsBitmap, BitmapContainer*> _BMType;
 
 /** Stack for instances of Hypothesis, includes functions for pruning. */
 class HypothesisStackCubePruning : public HypothesisStack
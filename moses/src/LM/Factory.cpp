@@ -166,6 +166,9 @@ LanguageModel* CreateLanguageModel(LMImplementation lmImplementation
       break;
     }
   }
+  if (lm == NULL) {
+    return NULL;
+  }
 
   return new LMRefCount(scoreIndexManager, lm);
 }
@@ -17,22 +17,56 @@ bool LanguageModelORLM::Load(const std::string &filePath, FactorType factorType,
   m_filePath = filePath;
   m_factorType = factorType;
   m_nGramOrder = nGramOrder;
-  FileHandler fLmIn(m_filePath, std::ios::in|std::ios::binary, true);
-  m_lm = new OnlineRLM<T>(&fLmIn, m_nGramOrder);
-  fLmIn.close();
+  m_lms[m_current] = LoadModel();
   //m_lm = new MultiOnlineRLM<T>(m_filePath, m_nGramOrder);
   // get special word ids
-  m_oov_id = m_lm->vocab_->GetWordID("<unk>");
+  m_oov_id = m_lms[m_current]->vocab_->GetWordID("<unk>");
   CreateFactors();
   return true;
 }
+OnlineRLM<LanguageModelORLM::T>* LanguageModelORLM::LoadModel() const {
+  FileHandler fLmIn(m_filePath, std::ios::in|std::ios::binary, true);
+  OnlineRLM<T>* lm = new OnlineRLM<T>(&fLmIn, m_nGramOrder);
+  fLmIn.close();
+  return lm;
+}
+OnlineRLM<LanguageModelORLM::T>* LanguageModelORLM::GetModel() const {
+#ifdef WITH_THREADS
+  const size_t *pinned = m_pinned.get();
+  if (pinned) return m_lms[*pinned];
+  // not within a sentence, e.g. while the phrase table is loaded
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  return m_lms[m_current];
+}
+void LanguageModelORLM::InitializeBeforeSentenceProcessing() {
+  //m_lm->initThreadSpecificData(); // Creates thread specific data iff
+                                  // compiled with multithreading.
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+  ++m_sentences[m_current];
+  m_pinned.reset(new size_t(m_current));
+#endif
+}
+void LanguageModelORLM::CleanUpAfterSentenceProcessing() {
+  GetModel()->clearCache(); // clear caches
+#ifdef WITH_THREADS
+  const size_t *pinned = m_pinned.get();
+  if (pinned) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (--m_sentences[*pinned] == 0) m_sentenceEnded.notify_all();
+    m_pinned.reset();
+  }
+#endif
+}
 void LanguageModelORLM::CreateFactors() {
   FactorCollection &factorCollection = FactorCollection::Instance();
+  const OnlineRLM<T>* lm = m_lms[m_current];
   size_t maxFactorId = 0; // to create lookup vector later on
   std::map<size_t, wordID_t> m_lmids_map; // map from factor id -> word id
 
-  for(std::map<Word, wordID_t>::const_iterator vIter = m_lm->vocab_->VocabStart();
-      vIter != m_lm->vocab_->VocabEnd(); vIter++){
+  for(std::map<Word, wordID_t>::const_iterator vIter = lm->vocab_->VocabStart();
+      vIter != lm->vocab_->VocabEnd(); vIter++){
     // get word from ORLM vocab and associate with (new) factor id
     size_t factorId = factorCollection.AddFactor(Output,m_factorType,vIter->first.ToString())->GetId();
     m_lmids_map[factorId] = vIter->second;
@@ -59,7 +93,7 @@ void LanguageModelORLM::CreateFactors() {
     lm_ids_vec_[iter->first] = iter->second;
 }
 wordID_t LanguageModelORLM::GetLmID(const std::string& str) const {
-  return m_lm->vocab_->GetWordID(str);
+  return GetModel()->vocab_->GetWordID(str);
 }
 wordID_t LanguageModelORLM::GetLmID(const Factor* factor) const {
   size_t factorId = factor->GetId();
@@ -79,7 +113,7 @@ LMResult LanguageModelORLM::GetValue(const std::vector<const Word*> &contextFact
   }
   //float logprob = FloorScore(TransformLMScore(lm_->getProb(sngram, count, finalState)));
   LMResult ret;
-  ret.score = FloorScore(TransformLMScore(m_lm->getProb(&ngram[0], count, finalState)));
+  ret.score = FloorScore(TransformLMScore(GetModel()->getProb(&ngram[0], count, finalState)));
   ret.unknown = count && (ngram[count - 1] == m_oov_id);
   /*if (finalState)
     std::cout << " = " << logprob << "(" << *finalState << ", " << *len <<")"<< std::endl;
@@ -88,14 +122,43 @@ LMResult LanguageModelORLM::GetValue(const std::vector<const Word*> &contextFact
   */
   return ret;
 }
-bool LanguageModelORLM::UpdateORLM(const std::vector<string>& ngram, const int value) {
-  /*cerr << "Inserting into ORLM: \"";
-  iterate(ngram, nit)
-    cerr << *nit << " ";
-  cerr << "\"\t" << value << endl; */
-  m_lm->vocab_->MakeOpen();
-  bool res = m_lm->update(ngram, value); 
-  m_lm->vocab_->MakeClosed();
+bool LanguageModelORLM::UpdateORLM(const NGramCounts& ngrams) {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock update(m_updateMutex);
+  size_t next;
+  {
+    // the sentences on the other copy started before the last update
+    boost::mutex::scoped_lock lock(m_mutex);
+    next = 1 - m_current;
+    while (m_sentences[next] > 0) m_sentenceEnded.wait(lock);
+  }
+  if (m_lms[next] == 0) {
+    m_lms[next] = LoadModel(); // first update: nothing to catch up on
+  } else {
+    Apply(m_lms[next], m_lagging);
+  }
+  bool res = Apply(m_lms[next], ngrams);
+  m_lagging = ngrams;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_current = next;
+  }
+  return res;
+#else
+  return Apply(m_lms[m_current], ngrams);
+#endif
+}
+bool LanguageModelORLM::Apply(OnlineRLM<T>* lm, const NGramCounts& ngrams) {
+  bool res = true;
+  lm->vocab_->MakeOpen();
+  for (NGramCounts::const_iterator it = ngrams.begin(); it != ngrams.end(); ++it) {
+    /*cerr << "Inserting into ORLM: \"";
+    iterate(it->first, nit)
+      cerr << *nit << " ";
+    cerr << "\"\t" << it->second << endl; */
+    res = lm->update(it->first, it->second) && res;
+  }
+  lm->vocab_->MakeClosed();
   return res;
 }
 }
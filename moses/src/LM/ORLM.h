@@ -2,6 +2,11 @@
 
 #include <string>
 #include <vector>
+#ifdef WITH_THREADS
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#endif
 #include "Factor.h"
 #include "Util.h"
 #include "LM/SingleFactor.h"
@@ -15,33 +20,63 @@ namespace Moses
 class Factor;
 class Phrase;
 
+/** Online randomised LM, to which n-gram counts can be added while decoding.
+ *
+ * Updates are versioned like those of the dynamic suffix array phrase table:
+ * a sentence is decoded on the model as it was when the sentence started.
+ * With threads there are two copies of the model. Sentences start on the
+ * current copy; an update is applied to the other one, once the last
+ * sentence decoded on it has ended, and then makes it the current copy. The
+ * second copy is loaded on the first update.
+ */
 class LanguageModelORLM : public LanguageModelPointerState {
 public:
   typedef count_t T;  // type for ORLM filter
+  typedef std::vector<std::pair<std::vector<string>, int> > NGramCounts;
   LanguageModelORLM()
-    : m_lm(0) {}
+    : m_current(0) {
+    m_lms[0] = m_lms[1] = 0;
+    m_sentences[0] = m_sentences[1] = 0;
+  }
   bool Load(const std::string &filePath, FactorType factorType, size_t nGramOrder);
   virtual LMResult GetValue(const std::vector<const Word*> &contextFactor, State* finalState = NULL) const;
   ~LanguageModelORLM() {
     //save LM with markings
     Utils::rtrim(m_filePath, ".gz");
     FileHandler fout(m_filePath + ".marked.gz", std::ios::out|std::ios::binary, false);
-    m_lm->save(&fout);
+    m_lms[m_current]->save(&fout);
     fout.close();
-    delete m_lm;
-  }
-  void CleanUpAfterSentenceProcessing() {m_lm->clearCache();} // clear caches
-  void InitializeBeforeSentenceProcessing() { // nothing to do
-    //m_lm->initThreadSpecificData(); // Creates thread specific data iff
-                                    // compiled with multithreading.
+    delete m_lms[0];
+    delete m_lms[1];
   }
-  bool UpdateORLM(const std::vector<string>& ngram, const int value);
+  void CleanUpAfterSentenceProcessing();
+  void InitializeBeforeSentenceProcessing();
+  //! adds the counts, lower orders first. sentences which start after it
+  //! returns see all of them, those already being decoded none
+  bool UpdateORLM(const NGramCounts& ngrams);
  protected:
-  OnlineRLM<T>* m_lm;
+  OnlineRLM<T>* m_lms[2];
   //MultiOnlineRLM<T>* m_lm;
+  //! the copy new sentences are decoded on
+  size_t m_current;
+  //! number of sentences being decoded on each copy
+  size_t m_sentences[2];
+  //! the last update, which the other copy hasn't had yet
+  NGramCounts m_lagging;
+#ifdef WITH_THREADS
+  mutable boost::mutex m_mutex;
+  boost::condition_variable m_sentenceEnded;
+  //! held while updating, so that one update is applied at a time
+  boost::mutex m_updateMutex;
+  //! the copy the sentence of a thread is decoded on
+  mutable boost::thread_specific_ptr<size_t> m_pinned;
+#endif
   wordID_t m_oov_id;
   std::vector<wordID_t> lm_ids_vec_;
   void CreateFactors();
+  OnlineRLM<T>* LoadModel() const;
+  OnlineRLM<T>* GetModel() const;
+  static bool Apply(OnlineRLM<T>* lm, const NGramCounts& ngrams);
   wordID_t GetLmID(const std::string &str) const;
   wordID_t GetLmID(const Factor *factor) const;
 };
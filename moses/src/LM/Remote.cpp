@@ -1,20 +1,54 @@
-#include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
+#include <algorithm>
+#include <limits>
+#include <boost/unordered_set.hpp>
+#include "util/check.hh"
 #include "LM/Remote.h"
+#include "LM/Base.h"
 #include "Factor.h"
+#include "FactorCollection.h"
+#include "FFState.h"
+#include "Hypothesis.h"
+#include "Manager.h"
+#include "Phrase.h"
+#include "ScoreComponentCollection.h"
+#include "StaticData.h"
 
 namespace Moses
 {
 
+namespace
+{
+// entries of the n-gram cache; the least recently used half is dropped when full
+const size_t kCacheSize = 1 << 20;
+
+// context ids of the sentence boundaries, next to the ids of the factors
+const size_t kBOSId = std::numeric_limits<size_t>::max();
+const size_t kEOSId = kBOSId - 1;
+
+struct RemoteLMState : public FFState {
+  std::vector<size_t> context;
+
+  int Compare(const FFState& o) const {
+    const RemoteLMState &other = static_cast<const RemoteLMState&>(o);
+    if (context == other.context) return 0;
+    return (context < other.context) ? -1 : 1;
+  }
+};
+}
+
 const Factor* LanguageModelRemote::BOS = NULL;
 const Factor* LanguageModelRemote::EOS = (LanguageModelRemote::BOS + 1);
 
+LanguageModelRemote::LanguageModelRemote()
+  : m_clock(0)
+{
+  m_nullContextState = new RemoteLMState;
+  RemoteLMState *beginSentence = new RemoteLMState;
+  beginSentence->context.push_back(kBOSId);
+  m_beginSentenceState = beginSentence;
+}
+
 bool LanguageModelRemote::Load(const std::string &filePath
                                , FactorType factorType
                                , size_t nGramOrder)
@@ -22,11 +56,23 @@ bool LanguageModelRemote::Load(const std::string &filePath
   m_factorType    = factorType;
   m_nGramOrder    = nGramOrder;
 
+  FactorCollection &factorCollection = FactorCollection::Instance();
+  m_sentenceStart = factorCollection.AddFactor(Output, m_factorType, BOS_);
+  m_sentenceStartArray[m_factorType] = m_sentenceStart;
+  m_sentenceEnd = factorCollection.AddFactor(Output, m_factorType, EOS_);
+  m_sentenceEndArray[m_factorType] = m_sentenceEnd;
+
+  // host:port, optionally followed by :connections
   int cutAt = filePath.find(':',0);
   std::string host = filePath.substr(0,cutAt);
-  //std::cerr << "port string = '" << filePath.substr(cutAt+1,filePath.size()-cutAt) << "'\n";
-  int port = atoi(filePath.substr(cutAt+1,filePath.size()-cutAt).c_str());
-  bool good = start(host,port);
+  std::string rest = filePath.substr(cutAt+1,filePath.size()-cutAt);
+  int port = atoi(rest.c_str());
+  size_t connections = std::max(1, StaticData::Instance().ThreadCount());
+  if (rest.find(':') != std::string::npos) {
+    connections = std::max(1, atoi(rest.substr(rest.find(':') + 1).c_str()));
+  }
+  m_client.reset(new RemoteLMClient(host, port, connections));
+  bool good = m_client->Connect();
   if (!good) {
     std::cerr << "failed to connect to lm server on " << host << " on port " << port << std::endl;
   }
@@ -34,111 +80,313 @@ bool LanguageModelRemote::Load(const std::string &filePath
   return good;
 }
 
+void LanguageModelRemote::ClearSentenceCache()
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_cacheMutex);
+#endif
+  m_cache.clear();
+}
 
-bool LanguageModelRemote::start(const std::string& host, int port)
+const FFState *LanguageModelRemote::GetNullContextState() const
 {
-  //std::cerr << "host = " << host << ", port = " << port << "\n";
-  sock = socket(AF_INET, SOCK_STREAM, 0);
-  hp = gethostbyname(host.c_str());
-  if (hp==NULL) {
-    herror("gethostbyname failed");
-    exit(1);
-  }
+  return m_nullContextState;
+}
 
-  bzero((char *)&server, sizeof(server));
-  bcopy(hp->h_addr, (char *)&server.sin_addr, hp->h_length);
-  server.sin_family = hp->h_addrtype;
-  server.sin_port = htons(port);
+const FFState *LanguageModelRemote::GetBeginSentenceState() const
+{
+  return m_beginSentenceState;
+}
 
-  int errors = 0;
-  while (connect(sock, (struct sockaddr *)&server, sizeof(server)) < 0) {
-    //std::cerr << "Error: connect()\n";
-    sleep(1);
-    errors++;
-    if (errors > 5) return false;
+FFState *LanguageModelRemote::NewState(const FFState *from) const
+{
+  RemoteLMState *state = new RemoteLMState;
+  if (from) {
+    state->context = static_cast<const RemoteLMState*>(from)->context;
   }
-  return true;
+  return state;
 }
 
-LMResult LanguageModelRemote::GetValue(const std::vector<const Word*> &contextFactor, State* finalState) const
+LanguageModelRemote::NGram LanguageModelRemote::MakeNGram(const std::vector<const Word*> &contextFactor) const
 {
-  LMResult ret;
-  ret.unknown = false;
-  size_t count = contextFactor.size();
-  if (count == 0) {
-    if (finalState) *finalState = NULL;
-    ret.score = 0.0;
-    return ret;
-  }
-  //std::cerr << "contextFactor.size() = " << count << "\n";
-  size_t max = m_nGramOrder;
   const FactorType factor = GetFactorType();
-  if (max > count) max = count;
-
-  Cache* cur = &m_cache;
-  int pc = static_cast<int>(count) - 1;
-  for (int i = 0; i < pc; ++i) {
+  NGram ngram(contextFactor.size());
+  const size_t pc = contextFactor.size() - 1;
+  for (size_t i = 0; i < pc; ++i) {
     const Factor* f = contextFactor[i]->GetFactor(factor);
-    cur = &cur->tree[f ? f : BOS];
+    ngram[i] = f ? f : BOS;
   }
   const Factor* event_word = contextFactor[pc]->GetFactor(factor);
-  cur = &cur->tree[event_word ? event_word : EOS];
-  if (cur->prob) {
-    if (finalState) *finalState = cur->boState;
-    ret.score = cur->prob;
+  ngram[pc] = event_word ? event_word : EOS;
+  return ngram;
+}
+
+//! the state after the n-gram: the ids of its last n-1 words
+void LanguageModelRemote::SetContext(const NGram &ngram, FFState &state) const
+{
+  std::vector<size_t> &context = static_cast<RemoteLMState&>(state).context;
+  const size_t length = std::min(ngram.size(), m_nGramOrder - 1);
+  context.resize(length);
+  for (size_t i = 0; i < length; ++i) {
+    const Factor *f = ngram[ngram.size() - length + i];
+    context[i] = (f == BOS) ? kBOSId : (f == EOS) ? kEOSId : f->GetId();
+  }
+}
+
+/* Probabilities of the n-grams.  The ones not in the cache are fetched from
+ * the server, all in one request.
+ */
+void LanguageModelRemote::Lookup(const std::vector<NGram> &ngrams, std::vector<float> &probs) const
+{
+  probs.resize(ngrams.size());
+  std::vector<size_t> missing;
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_cacheMutex);
+#endif
+    for (size_t i = 0; i < ngrams.size(); ++i) {
+      Cache::iterator found = m_cache.find(ngrams[i]);
+      if (found == m_cache.end()) {
+        missing.push_back(i);
+      } else {
+        found->second.lastUsed = ++m_clock;
+        probs[i] = found->second.prob;
+      }
+    }
+  }
+  if (missing.empty()) return;
+
+  std::vector<NGram> fetch;
+  fetch.reserve(missing.size());
+  for (size_t i = 0; i < missing.size(); ++i) {
+    fetch.push_back(ngrams[missing[i]]);
+  }
+  std::sort(fetch.begin(), fetch.end());
+  fetch.erase(std::unique(fetch.begin(), fetch.end()), fetch.end());
+  std::vector<float> fetched;
+  Fetch(fetch, fetched);
+  for (size_t i = 0; i < missing.size(); ++i) {
+    const NGram &ngram = ngrams[missing[i]];
+    probs[missing[i]] = fetched[std::lower_bound(fetch.begin(), fetch.end(), ngram) - fetch.begin()];
+  }
+}
+
+/* Score the n-grams on the server and cache them.  Unknown factors are
+ * first looked up in the vocabulary of the server, also in one request.
+ */
+void LanguageModelRemote::Fetch(const std::vector<NGram> &ngrams, std::vector<float> &probs) const
+{
+  std::vector<const Factor*> newFactors;
+  std::vector<std::string> newWords;
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_cacheMutex);
+#endif
+    boost::unordered_set<const Factor*> seen;
+    for (size_t i = 0; i < ngrams.size(); ++i) {
+      for (size_t j = 0; j < ngrams[i].size(); ++j) {
+        const Factor* f = ngrams[i][j];
+        if (m_vocab.find(f) != m_vocab.end() || !seen.insert(f).second) continue;
+        newFactors.push_back(f);
+        newWords.push_back(f == BOS ? "<s>" : f == EOS ? "</s>" : f->GetString());
+      }
+    }
+  }
+  std::vector<int> newIds;
+  if (!newWords.empty()) {
+    m_client->LookupWords(newWords, newIds);
+  }
+
+  std::vector<std::vector<int> > ids(ngrams.size());
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_cacheMutex);
+#endif
+    for (size_t i = 0; i < newFactors.size(); ++i) {
+      m_vocab[newFactors[i]] = newIds[i];
+    }
+    // the predicted word, then its history from the most recent word
+    for (size_t i = 0; i < ngrams.size(); ++i) {
+      const size_t count = ngrams[i].size();
+      const size_t max = std::min(count, m_nGramOrder);
+      for (size_t j = 0; j < max; ++j) {
+        ids[i].push_back(m_vocab[ngrams[i][count - 1 - j]]);
+      }
+    }
+  }
+  m_client->Score(ids, probs);
+
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_cacheMutex);
+#endif
+  for (size_t i = 0; i < ngrams.size(); ++i) {
+    probs[i] = FloorScore(TransformLMScore(probs[i]));
+    CacheEntry &entry = m_cache[ngrams[i]];
+    entry.prob = probs[i];
+    entry.lastUsed = ++m_clock;
+  }
+  ReduceCache();
+}
+
+//! drop the least recently used half of the cache when it is full; the lock must be held
+void LanguageModelRemote::ReduceCache() const
+{
+  if (m_cache.size() <= kCacheSize) return;
+  std::vector<size_t> lastUsed;
+  lastUsed.reserve(m_cache.size());
+  for (Cache::const_iterator i = m_cache.begin(); i != m_cache.end(); ++i) {
+    lastUsed.push_back(i->second.lastUsed);
+  }
+  std::vector<size_t>::iterator cutoff = lastUsed.begin() + (lastUsed.size() - kCacheSize / 2);
+  std::nth_element(lastUsed.begin(), cutoff, lastUsed.end());
+  for (Cache::iterator i = m_cache.begin(); i != m_cache.end(); ) {
+    if (i->second.lastUsed < *cutoff) {
+      i = m_cache.erase(i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+LMResult LanguageModelRemote::GetValueForgotState(const std::vector<const Word*> &contextFactor, FFState &outState) const
+{
+  LMResult ret;
+  ret.unknown = false;
+  ret.score = 0.0;
+  if (contextFactor.empty()) {
+    static_cast<RemoteLMState&>(outState).context.clear();
     return ret;
   }
-  cur->boState = *reinterpret_cast<const State*>(&m_curId);
-  ++m_curId;
+  std::vector<NGram> ngrams(1, MakeNGram(contextFactor));
+  std::vector<float> probs;
+  Lookup(ngrams, probs);
+  SetContext(ngrams[0], outState);
+  ret.score = probs[0];
+  return ret;
+}
 
-  std::ostringstream os;
-  os << "prob ";
-  if (event_word == NULL) {
-    os << "</s>";
+void LanguageModelRemote::GetState(const std::vector<const Word*> &contextFactor, FFState &outState) const
+{
+  if (contextFactor.empty()) {
+    static_cast<RemoteLMState&>(outState).context.clear();
   } else {
-    os << event_word->GetString();
+    SetContext(MakeNGram(contextFactor), outState);
   }
-  for (size_t i=1; i<max; i++) {
-    const Factor* f = contextFactor[count-1-i]->GetFactor(factor);
-    if (f == NULL) {
-      os << " <s>";
+}
+
+// The n-grams of LanguageModelImplementation::CalcScore, looked up at once
+void LanguageModelRemote::CalcScore(const Phrase &phrase, float &fullScore, float &ngramScore, size_t &oovCount) const
+{
+  fullScore  = 0;
+  ngramScore = 0;
+  oovCount = 0;
+
+  std::vector<NGram> ngrams;
+  std::vector<const Word*> contextFactor;
+  contextFactor.reserve(GetNGramOrder());
+  for (size_t currPos = 0; currPos < phrase.GetSize(); ++currPos) {
+    const Word &word = phrase.GetWord(currPos);
+    if (word.IsNonTerminal()) {
+      // reset the n-gram, for the target phrases of chart rules
+      contextFactor.clear();
     } else {
-      os << ' ' << f->GetString();
+      ShiftOrPush(contextFactor, word);
+      if (word == GetSentenceStartArray()) {
+        // no prob for the <s> unigram, which only starts a sentence
+        CHECK(currPos == 0);
+      } else {
+        ngrams.push_back(MakeNGram(contextFactor));
+      }
     }
   }
-  os << std::endl;
-  std::string out = os.str();
-  write(sock, out.c_str(), out.size());
-  char res[6];
-  int r = read(sock, res, 6);
-  int errors = 0;
-  int cnt = 0;
-  while (1) {
-    if (r < 0) {
-      errors++;
-      sleep(1);
-      //std::cerr << "Error: read()\n";
-      if (errors > 5) exit(1);
-    } else if (r==0 || res[cnt] == '\n') {
-      break;
-    } else {
-      cnt += r;
-      if (cnt==6) break;
-      read(sock, &res[cnt], 6-cnt);
+
+  std::vector<float> probs;
+  Lookup(ngrams, probs);
+  for (size_t i = 0; i < ngrams.size(); ++i) {
+    fullScore += probs[i];
+    if (ngrams[i].size() == GetNGramOrder())
+      ngramScore += probs[i];
+  }
+}
+
+// The n-grams of LanguageModelImplementation::Evaluate, looked up at once
+FFState *LanguageModelRemote::Evaluate(const Hypothesis &hypo, const FFState *ps, ScoreComponentCollection *out, const LanguageModel *feature) const
+{
+  if(GetNGramOrder() <= 1)
+    return NULL;
+
+  clock_t t = 0;
+  IFVERBOSE(2) {
+    t = clock();  // track time
+  }
+
+  // Empty phrase added? nothing to be done
+  if (hypo.GetCurrTargetLength() == 0)
+    return ps ? NewState(ps) : NULL;
+
+  const size_t currEndPos = hypo.GetCurrTargetWordsRange().GetEndPos();
+  const size_t startPos = hypo.GetCurrTargetWordsRange().GetStartPos();
+
+  // the n-grams which overlap the start of the phrase
+  std::vector<NGram> ngrams;
+  std::vector<const Word*> contextFactor(GetNGramOrder());
+  size_t index = 0;
+  for (int currPos = (int) startPos - (int) GetNGramOrder() + 1 ; currPos <= (int) startPos ; currPos++) {
+    contextFactor[index++] = (currPos >= 0) ? &hypo.GetWord(currPos) : &GetSentenceStartArray();
+  }
+  ngrams.push_back(MakeNGram(contextFactor));
+  const size_t endPos = std::min(startPos + GetNGramOrder() - 2, currEndPos);
+  for (size_t currPos = startPos + 1 ; currPos <= endPos ; currPos++) {
+    std::copy(contextFactor.begin() + 1, contextFactor.end(), contextFactor.begin());
+    contextFactor.back() = &hypo.GetWord(currPos);
+    ngrams.push_back(MakeNGram(contextFactor));
+  }
+
+  if (hypo.IsSourceCompleted()) {
+    // end of sentence
+    const size_t size = hypo.GetSize();
+    contextFactor.back() = &GetSentenceEndArray();
+    for (size_t i = 0 ; i < GetNGramOrder() - 1 ; i ++) {
+      int currPos = (int)(size - GetNGramOrder() + i + 1);
+      contextFactor[i] = (currPos < 0) ? &GetSentenceStartArray() : &hypo.GetWord((size_t)currPos);
+    }
+    ngrams.push_back(MakeNGram(contextFactor));
+  } else {
+    // the state is given by the last words of the phrase
+    for (size_t currPos = endPos+1; currPos <= currEndPos; currPos++) {
+      std::copy(contextFactor.begin() + 1, contextFactor.end(), contextFactor.begin());
+      contextFactor.back() = &hypo.GetWord(currPos);
     }
   }
-  cur->prob = FloorScore(TransformLMScore(*reinterpret_cast<float*>(res)));
-  if (finalState) {
-    *finalState = cur->boState;
+
+  std::vector<float> probs;
+  Lookup(ngrams, probs);
+  float lmScore = 0;
+  for (size_t i = 0; i < probs.size(); ++i) {
+    lmScore += probs[i];
   }
-  ret.score = cur->prob;
-  return ret;
+  FFState *res = NewState(ps);
+  SetContext(MakeNGram(contextFactor), *res);
+
+  if (feature->OOVFeatureEnabled()) {
+    std::vector<float> scores(2);
+    scores[0] = lmScore;
+    scores[1] = 0;
+    out->PlusEquals(feature, scores);
+  } else {
+    out->PlusEquals(feature, lmScore);
+  }
+
+  IFVERBOSE(2) {
+    hypo.GetManager().GetSentenceStats().AddTimeCalcLM( clock()-t );
+  }
+  return res;
 }
 
 LanguageModelRemote::~LanguageModelRemote()
 {
-  // Step 8 When finished send all lingering transmissions and close the connection
-  close(sock);
+  delete m_nullContextState;
+  delete m_beginSentenceState;
 }
 
 }
@@ -2,40 +2,67 @@
 #define moses_LanguageModelRemote_h
 
 #include "LM/SingleFactor.h"
+#include "LM/RemoteClient.h"
 #include "TypeDef.h"
 #include "Factor.h"
-#include <sys/socket.h>
-#include <sys/types.h>
-#include <netinet/in.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
 
 namespace Moses
 {
 
-class LanguageModelRemote : public LanguageModelPointerState
+/** Language model served by contrib/lmserver.  The n-grams needed to score a
+ * phrase or to extend a hypothesis are collected first, and the ones not in
+ * the cache are sent to the server in one request.  The state of a
+ * hypothesis is the ids of its last n-1 words, as the server keeps no state.
+ */
+class LanguageModelRemote : public LanguageModelSingleFactor
 {
 private:
-  struct Cache {
-    std::map<const Factor*, Cache> tree;
+  typedef std::vector<const Factor*> NGram;
+  struct CacheEntry {
     float prob;
-    State boState;
-    Cache() : prob(0) {}
+    size_t lastUsed;
   };
+  typedef boost::unordered_map<NGram, CacheEntry> Cache;
 
-  int sock, port;
-  struct hostent *hp;
-  struct sockaddr_in server;
-  mutable size_t m_curId;
+  std::auto_ptr<RemoteLMClient> m_client;
+  FFState *m_nullContextState;
+  FFState *m_beginSentenceState;
   mutable Cache m_cache;
-  bool start(const std::string& host, int port);
+  mutable size_t m_clock; //< counts lookups, for the last use of cache entries
+  // server vocabulary ids of the factors seen so far
+  mutable boost::unordered_map<const Factor*, int> m_vocab;
+#ifdef WITH_THREADS
+  mutable boost::mutex m_cacheMutex;
+#endif
   static const Factor* BOS;
   static const Factor* EOS;
+
+  NGram MakeNGram(const std::vector<const Word*> &contextFactor) const;
+  void SetContext(const NGram &ngram, FFState &state) const;
+  void Lookup(const std::vector<NGram> &ngrams, std::vector<float> &probs) const;
+  void Fetch(const std::vector<NGram> &ngrams, std::vector<float> &probs) const;
+  void ReduceCache() const;
 public:
+  LanguageModelRemote();
   ~LanguageModelRemote();
-  void ClearSentenceCache() {
-    m_cache.tree.clear();
-    m_curId = 1000;
-  }
-  virtual LMResult GetValue(const std::vector<const Word*> &contextFactor, State* finalState = 0) const;
+  void ClearSentenceCache();
+
+  const FFState *GetNullContextState() const;
+  const FFState *GetBeginSentenceState() const;
+  FFState *NewState(const FFState *from = NULL) const;
+  LMResult GetValueForgotState(const std::vector<const Word*> &contextFactor, FFState &outState) const;
+  void GetState(const std::vector<const Word*> &contextFactor, FFState &outState) const;
+
+  void CalcScore(const Phrase &phrase, float &fullScore, float &ngramScore, size_t &oovCount) const;
+  FFState *Evaluate(const Hypothesis &hypo, const FFState *ps, ScoreComponentCollection *out, const LanguageModel *feature) const;
   bool Load(const std::string &filePath
             , FactorType factorType
             , size_t nGramOrder);
@@ -0,0 +1,280 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include "LM/RemoteClient.h"
+#include "util/exception.hh"
+
+namespace Moses
+{
+
+namespace
+{
+
+// items in a frame, and frames sent ahead of their replies.  Small enough
+// that the frames in flight fit in the socket buffers: the server stops
+// reading while it cannot write its replies.
+const size_t kFrameItems = 512;
+const size_t kWindow = 8;
+
+void AppendUint32(std::string &out, uint32_t value)
+{
+  value = htonl(value);
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint32_t ReadUint32(const char *in)
+{
+  uint32_t value;
+  memcpy(&value, in, sizeof(value));
+  return ntohl(value);
+}
+
+// put the header in front of the payload of a frame
+void FinishFrame(std::string &frame, unsigned char op, size_t items)
+{
+  std::string header;
+  header.push_back(static_cast<char>(op));
+  AppendUint32(header, items);
+  AppendUint32(header, frame.size());
+  frame.insert(0, header);
+}
+
+// a server that went away fails the write instead of raising SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+bool WriteAll(int sock, const char *data, size_t size)
+{
+  while (size) {
+    ssize_t written = send(sock, data, size, kSendFlags);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool ReadAll(int sock, char *data, size_t size)
+{
+  while (size) {
+    ssize_t got = read(sock, data, size);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (got == 0) return false;
+    data += got;
+    size -= got;
+  }
+  return true;
+}
+
+}
+
+RemoteLMClient::RemoteLMClient(const std::string &host, int port, size_t connections)
+  : m_host(host), m_port(port), m_connections(connections ? connections : 1), m_busy(0), m_pid(getpid()) {}
+
+RemoteLMClient::~RemoteLMClient()
+{
+  for (size_t i = 0; i < m_idle.size(); ++i) {
+    close(m_idle[i]);
+  }
+}
+
+bool RemoteLMClient::Open(int &sock, int retries) const
+{
+  struct addrinfo hints, *addresses;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  std::ostringstream port;
+  port << m_port;
+  if (getaddrinfo(m_host.c_str(), port.str().c_str(), &hints, &addresses)) {
+    std::cerr << "Unable to resolve lm server " << m_host << std::endl;
+    return false;
+  }
+  int errors = 0;
+  while (true) {
+    for (struct addrinfo *address = addresses; address; address = address->ai_next) {
+      sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+      if (sock < 0) continue;
+      if (connect(sock, address->ai_addr, address->ai_addrlen) == 0) {
+        freeaddrinfo(addresses);
+        return true;
+      }
+      close(sock);
+    }
+    if (++errors > retries) break;
+    sleep(1);
+  }
+  freeaddrinfo(addresses);
+  return false;
+}
+
+bool RemoteLMClient::Connect()
+{
+  m_pid = getpid();
+  for (size_t i = 0; i < m_connections; ++i) {
+    int sock;
+    // the server may still be starting
+    if (!Open(sock, 5)) return false;
+    m_idle.push_back(sock);
+  }
+  return true;
+}
+
+int RemoteLMClient::Acquire()
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  if (getpid() != m_pid) {
+    // forked: the sockets are shared with the parent, whose replies we would read
+    for (size_t i = 0; i < m_idle.size(); ++i) {
+      close(m_idle[i]);
+    }
+    m_idle.clear();
+    m_busy = 0;
+    m_pid = getpid();
+  }
+#ifdef WITH_THREADS
+  while (m_idle.empty() && m_busy >= m_connections) {
+    m_released.wait(lock);
+  }
+#endif
+  int sock;
+  if (m_idle.empty()) {
+    // in place of a connection which was lost, or not opened yet
+    UTIL_THROW_IF(!Open(sock, 0), util::Exception,
+                  "Unable to connect to the lm server on " << m_host << " port " << m_port);
+  } else {
+    sock = m_idle.back();
+    m_idle.pop_back();
+  }
+  ++m_busy;
+  return sock;
+}
+
+void RemoteLMClient::Release(int sock, bool good)
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  --m_busy;
+  if (good) {
+    m_idle.push_back(sock);
+  } else if (sock >= 0) {
+    close(sock);
+  }
+#ifdef WITH_THREADS
+  m_released.notify_one();
+#endif
+}
+
+bool RemoteLMClient::Exchange(int sock, const std::vector<std::string> &frames, const std::vector<size_t> &items,
+                              size_t itemBytes, std::string &replies) const
+{
+  replies.clear();
+  size_t sent = 0;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    for (; sent < frames.size() && sent < i + kWindow; ++sent) {
+      if (!WriteAll(sock, frames[sent].data(), frames[sent].size())) return false;
+    }
+    char count[4];
+    if (!ReadAll(sock, count, sizeof(count)) || ReadUint32(count) != items[i]) return false;
+    const size_t start = replies.size();
+    replies.resize(start + items[i] * itemBytes);
+    if (items[i] && !ReadAll(sock, &replies[start], items[i] * itemBytes)) return false;
+  }
+  return true;
+}
+
+void RemoteLMClient::Request(const std::vector<std::string> &frames, const std::vector<size_t> &items,
+                             size_t itemBytes, std::string &replies)
+{
+  int sock = Acquire();
+  bool done = Exchange(sock, frames, items, itemBytes, replies);
+  if (!done) {
+    // the connection may have been dropped: try once more on a new one
+    close(sock);
+    if (Open(sock, 0)) {
+      done = Exchange(sock, frames, items, itemBytes, replies);
+    } else {
+      sock = -1;
+    }
+  }
+  Release(sock, done);
+  UTIL_THROW_IF(!done, util::Exception,
+                "Lost the connection to the lm server on " << m_host << " port " << m_port);
+}
+
+void RemoteLMClient::LookupWords(const std::vector<std::string> &words, std::vector<int> &ids)
+{
+  std::vector<std::string> frames;
+  std::vector<size_t> items;
+  for (size_t begin = 0; begin < words.size(); begin += kFrameItems) {
+    const size_t end = std::min(words.size(), begin + kFrameItems);
+    std::string frame;
+    for (size_t i = begin; i < end; ++i) {
+      const std::string &word = words[i].size() > 0xffff ? std::string() : words[i];
+      const uint16_t length = htons(word.size());
+      frame.append(reinterpret_cast<const char*>(&length), sizeof(length));
+      frame.append(word);
+    }
+    FinishFrame(frame, kOpVocab, end - begin);
+    frames.push_back(frame);
+    items.push_back(end - begin);
+  }
+  std::string replies;
+  Request(frames, items, 4, replies);
+  ids.resize(words.size());
+  for (size_t i = 0; i < words.size(); ++i) {
+    ids[i] = static_cast<int32_t>(ReadUint32(&replies[4 * i]));
+  }
+}
+
+void RemoteLMClient::Score(const std::vector<std::vector<int> > &ngrams, std::vector<float> &probs)
+{
+  std::vector<std::string> frames;
+  std::vector<size_t> items;
+  for (size_t begin = 0; begin < ngrams.size(); begin += kFrameItems) {
+    const size_t end = std::min(ngrams.size(), begin + kFrameItems);
+    std::string frame;
+    for (size_t i = begin; i < end; ++i) {
+      frame.push_back(static_cast<char>(ngrams[i].size()));
+      for (size_t j = 0; j < ngrams[i].size(); ++j) {
+        AppendUint32(frame, static_cast<uint32_t>(ngrams[i][j]));
+      }
+    }
+    FinishFrame(frame, kOpProb, end - begin);
+    frames.push_back(frame);
+    items.push_back(end - begin);
+  }
+  std::string replies;
+  Request(frames, items, 4, replies);
+  probs.resize(ngrams.size());
+  for (size_t i = 0; i < ngrams.size(); ++i) {
+    const uint32_t bits = ReadUint32(&replies[4 * i]);
+    memcpy(&probs[i], &bits, sizeof(float));
+  }
+}
+
+}
@@ -0,0 +1,84 @@
+#ifndef moses_LanguageModelRemoteClient_h
+#define moses_LanguageModelRemoteClient_h
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#ifdef WITH_THREADS
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#endif
+
+namespace Moses
+{
+
+/** Client of the binary protocol of contrib/lmserver.
+ *
+ * A request is a frame: an op byte, the number of items and the number of
+ * payload bytes (both uint32), then the payload.  All integers are in network
+ * byte order.
+ *   - kOpVocab: each item is a word, a uint16 length and its bytes.  The reply
+ *     is the number of items then an int32 server vocabulary id for each, -1
+ *     for unknown words.
+ *   - kOpProb: each item is an n-gram, a uint8 length and that many int32 ids,
+ *     the predicted word first and then its history, most recent first.  The
+ *     reply is the number of items then the log10 probability of each, as the
+ *     bits of an IEEE float.
+ * The first byte of a frame is never ASCII, so the server tells frames from
+ * the old text commands.  Large requests are split in frames that are sent
+ * ahead of the replies, a few at a time.
+ *
+ * A request which fails, also on a new connection, throws util::Exception.
+ *
+ * Several threads may use the client at once: each request takes one of the
+ * connections of the pool for itself.  A process forked from the one which
+ * connected opens connections of its own on its first request.
+ */
+class RemoteLMClient
+{
+public:
+  static const unsigned char kOpVocab = 0x81;
+  static const unsigned char kOpProb = 0x82;
+
+  RemoteLMClient(const std::string &host, int port, size_t connections);
+  ~RemoteLMClient();
+
+  bool Connect();
+
+  //! server vocabulary ids of the words, -1 for unknown ones
+  void LookupWords(const std::vector<std::string> &words, std::vector<int> &ids);
+
+  //! log10 probabilities of the n-grams, which are in the order of kOpProb
+  void Score(const std::vector<std::vector<int> > &ngrams, std::vector<float> &probs);
+
+private:
+  RemoteLMClient(const RemoteLMClient &);
+  void operator=(const RemoteLMClient &);
+
+  // connect, trying again every second up to retries times
+  bool Open(int &sock, int retries) const;
+  int Acquire();
+  // give back a connection, closing it unless good; sock is -1 if it was closed already
+  void Release(int sock, bool good);
+  // send the frames and read as many replies, of itemBytes per item, or return false
+  bool Exchange(int sock, const std::vector<std::string> &frames, const std::vector<size_t> &items,
+                size_t itemBytes, std::string &replies) const;
+  void Request(const std::vector<std::string> &frames, const std::vector<size_t> &items,
+               size_t itemBytes, std::string &replies);
+
+  std::string m_host;
+  int m_port;
+  size_t m_connections;
+  std::vector<int> m_idle;
+  size_t m_busy; //< connections taken by requests
+  pid_t m_pid; //< process which opened the connections
+#ifdef WITH_THREADS
+  boost::mutex m_mutex;
+  boost::condition_variable m_released;
+#endif
+};
+
+}
+#endif
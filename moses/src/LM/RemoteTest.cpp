@@ -0,0 +1,304 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#ifdef WITH_THREADS
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "FFState.h"
+#include "LM/Remote.h"
+#include "Phrase.h"
+#include "Util.h"
+#include "util/exception.hh"
+
+using namespace Moses;
+
+namespace
+{
+
+bool ReadAll(int sock, char *data, size_t size)
+{
+  while (size) {
+    ssize_t got = read(sock, data, size);
+    if (got <= 0) return false;
+    data += got;
+    size -= got;
+  }
+  return true;
+}
+
+uint32_t ReadUint32(const char *in)
+{
+  uint32_t value;
+  memcpy(&value, in, sizeof(value));
+  return ntohl(value);
+}
+
+void AppendUint32(std::string &out, uint32_t value)
+{
+  value = htonl(value);
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+const char *kVocab[] = {"<s>", "</s>", "a", "b", "c", "d"};
+
+int WordId(const std::string &word)
+{
+  for (size_t i = 0; i < sizeof(kVocab) / sizeof(kVocab[0]); ++i) {
+    if (word == kVocab[i]) return i;
+  }
+  return -1;
+}
+
+// log10 prob of an n-gram, the predicted word first: made up, but different for every n-gram
+float StandInProb(const std::vector<int> &ids)
+{
+  float prob = -0.1 * ids.size();
+  for (size_t i = 0; i < ids.size(); ++i) {
+    prob -= 0.01 * (ids[i] + 2) * (i + 1) * (i + 1);
+  }
+  return prob;
+}
+
+// what the LM makes of the server's answer for the n-gram words, given in text order
+float Expected(const char *w1, const char *w2 = NULL, const char *w3 = NULL)
+{
+  std::vector<int> ids(1, WordId(w1));
+  if (w2) ids.push_back(WordId(w2));
+  if (w3) ids.push_back(WordId(w3));
+  std::reverse(ids.begin(), ids.end());
+  return FloorScore(TransformLMScore(StandInProb(ids)));
+}
+
+/** Speaks the binary protocol of contrib/lmserver on a loopback port, and
+ * counts the requests. */
+class StandInServer
+{
+public:
+  StandInServer() : m_stop(false), m_requests(0) {
+    m_listen = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    BOOST_REQUIRE(bind(m_listen, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    BOOST_REQUIRE(listen(m_listen, 16) == 0);
+    socklen_t length = sizeof(address);
+    getsockname(m_listen, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+    m_thread.reset(new boost::thread(&StandInServer::Serve, this));
+  }
+
+  ~StandInServer() {
+    Stop();
+  }
+
+  //! close the port and all connections
+  void Stop() {
+    if (!m_thread.get()) return;
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      m_stop = true;
+    }
+    m_thread->join();
+    m_thread.reset();
+  }
+
+  std::string Address(size_t connections) const {
+    std::ostringstream address;
+    address << "127.0.0.1:" << m_port << ":" << connections;
+    return address.str();
+  }
+
+  size_t Requests() const {
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_requests;
+  }
+
+private:
+  void Serve() {
+    std::vector<int> clients;
+    while (true) {
+      {
+        boost::mutex::scoped_lock lock(m_mutex);
+        if (m_stop) break;
+      }
+      std::vector<pollfd> fds(1 + clients.size());
+      fds[0].fd = m_listen;
+      for (size_t i = 0; i < clients.size(); ++i) fds[i + 1].fd = clients[i];
+      for (size_t i = 0; i < fds.size(); ++i) fds[i].events = POLLIN;
+      if (poll(&fds[0], fds.size(), 20) <= 0) continue;
+      if (fds[0].revents & POLLIN) {
+        clients.push_back(accept(m_listen, NULL, NULL));
+      }
+      for (size_t i = fds.size() - 1; i > 0; --i) {
+        if (fds[i].revents && !Answer(fds[i].fd)) {
+          close(fds[i].fd);
+          clients.erase(clients.begin() + i - 1);
+        }
+      }
+    }
+    for (size_t i = 0; i < clients.size(); ++i) close(clients[i]);
+    close(m_listen);
+  }
+
+  // read one frame and answer it
+  bool Answer(int sock) {
+    char header[9];
+    if (!ReadAll(sock, header, sizeof(header))) return false;
+    const size_t items = ReadUint32(header + 1);
+    std::string payload(ReadUint32(header + 5), '\0');
+    if (!payload.empty() && !ReadAll(sock, &payload[0], payload.size())) return false;
+
+    std::string reply;
+    AppendUint32(reply, items);
+    const char *in = payload.data();
+    for (size_t i = 0; i < items; ++i) {
+      if (static_cast<unsigned char>(header[0]) == RemoteLMClient::kOpVocab) {
+        uint16_t length;
+        memcpy(&length, in, sizeof(length));
+        length = ntohs(length);
+        AppendUint32(reply, WordId(std::string(in + 2, length)));
+        in += 2 + length;
+      } else {
+        std::vector<int> ids(static_cast<unsigned char>(*in++));
+        for (size_t j = 0; j < ids.size(); ++j, in += 4) {
+          ids[j] = static_cast<int32_t>(ReadUint32(in));
+        }
+        const float prob = StandInProb(ids);
+        uint32_t bits;
+        memcpy(&bits, &prob, sizeof(bits));
+        AppendUint32(reply, bits);
+      }
+    }
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      ++m_requests;
+    }
+    return write(sock, reply.data(), reply.size()) == static_cast<ssize_t>(reply.size());
+  }
+
+  int m_listen;
+  int m_port;
+  bool m_stop;
+  size_t m_requests;
+  mutable boost::mutex m_mutex;
+  std::auto_ptr<boost::thread> m_thread;
+};
+
+Phrase MakePhrase(const char *text)
+{
+  Phrase phrase(0);
+  phrase.CreateFromString(std::vector<FactorType>(1, 0), text, "|");
+  return phrase;
+}
+
+std::vector<const Word*> Context(const Phrase &phrase)
+{
+  std::vector<const Word*> context;
+  for (size_t i = 0; i < phrase.GetSize(); ++i) context.push_back(&phrase.GetWord(i));
+  return context;
+}
+
+BOOST_AUTO_TEST_CASE(RemoteScoresPhraseInOneRequest)
+{
+  StandInServer server;
+  LanguageModelRemote lm;
+  BOOST_REQUIRE(lm.Load(server.Address(2), 0, 3));
+
+  float fullScore, ngramScore;
+  size_t oovCount;
+  lm.CalcScore(MakePhrase("a b c d"), fullScore, ngramScore, oovCount);
+  // the vocabulary, then all n-grams at once
+  BOOST_CHECK_EQUAL(2u, server.Requests());
+  const float trigrams = Expected("a", "b", "c") + Expected("b", "c", "d");
+  BOOST_CHECK_CLOSE(Expected("a") + Expected("a", "b") + trigrams, fullScore, 1e-4);
+  BOOST_CHECK_CLOSE(trigrams, ngramScore, 1e-4);
+  BOOST_CHECK_EQUAL(0u, oovCount);
+
+  // all cached
+  lm.CalcScore(MakePhrase("a b c"), fullScore, ngramScore, oovCount);
+  BOOST_CHECK_EQUAL(2u, server.Requests());
+  BOOST_CHECK_CLOSE(Expected("a") + Expected("a", "b") + Expected("a", "b", "c"), fullScore, 1e-4);
+
+  // known words, new n-grams
+  lm.CalcScore(MakePhrase("d c b a"), fullScore, ngramScore, oovCount);
+  BOOST_CHECK_EQUAL(3u, server.Requests());
+}
+
+BOOST_AUTO_TEST_CASE(RemoteStateIsTheContext)
+{
+  StandInServer server;
+  LanguageModelRemote lm;
+  BOOST_REQUIRE(lm.Load(server.Address(1), 0, 3));
+
+  const Phrase abc = MakePhrase("a b c"), dbc = MakePhrase("d b c"), bc = MakePhrase("b c"),
+               acc = MakePhrase("a c c");
+  std::auto_ptr<FFState> s1(lm.NewState()), s2(lm.NewState()), s3(lm.NewState()), s4(lm.NewState());
+  BOOST_CHECK_CLOSE(Expected("a", "b", "c"), lm.GetValueForgotState(Context(abc), *s1).score, 1e-4);
+  lm.GetValueForgotState(Context(dbc), *s2);
+  lm.GetValueForgotState(Context(bc), *s3);
+  lm.GetValueForgotState(Context(acc), *s4);
+  // the next word only depends on the last two
+  BOOST_CHECK_EQUAL(0, s1->Compare(*s2));
+  BOOST_CHECK_EQUAL(0, s1->Compare(*s3));
+  BOOST_CHECK(s1->Compare(*s4) != 0);
+  BOOST_CHECK_EQUAL(-s1->Compare(*s4), s4->Compare(*s1));
+
+  std::auto_ptr<FFState> copy(lm.NewState(s1.get()));
+  BOOST_CHECK_EQUAL(0, s1->Compare(*copy));
+  BOOST_CHECK(lm.GetNullContextState()->Compare(*lm.GetBeginSentenceState()) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(RemoteLostConnectionThrows)
+{
+  StandInServer server;
+  LanguageModelRemote lm;
+  BOOST_REQUIRE(lm.Load(server.Address(1), 0, 3));
+  float fullScore, ngramScore;
+  size_t oovCount;
+  lm.CalcScore(MakePhrase("a b"), fullScore, ngramScore, oovCount);
+  server.Stop();
+  // cached n-grams need no server
+  lm.CalcScore(MakePhrase("a b"), fullScore, ngramScore, oovCount);
+  BOOST_CHECK_THROW(lm.CalcScore(MakePhrase("b a"), fullScore, ngramScore, oovCount), util::Exception);
+}
+
+}
+
+#endif
@@ -0,0 +1,199 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_LazyKBest_h
+#define moses_LazyKBest_h
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+namespace Moses
+{
+
+/** Lazy k-best extraction from the search graph, algorithm 3 of
+ *  Huang and Chiang, "Better k-best parsing" (IWPT 2005).
+ *
+ *  The nodes of the graph are the winning hypotheses, the incoming edges of
+ *  a node are the winning hypothesis itself and the arcs recombined into it,
+ *  and the tails of an edge are its previous hypotheses. Every node keeps
+ *  its own candidate heap and list of derivations found so far, and both
+ *  are only extended as far as the caller asks for. Derivations share their
+ *  sub-derivations instead of copying paths.
+ *
+ *  Traits provides, for Hypo:
+ *    typedef ... ArcList;  (a container of Hypo pointers)
+ *    static const Hypo *GetWinningHypo(const Hypo &);
+ *    static const ArcList *GetArcList(const Hypo &);
+ *    static size_t GetNumPrevHypos(const Hypo &);
+ *    static const Hypo *GetPrevHypo(const Hypo &, size_t);
+ */
+template <class Hypo, class Traits>
+class LazyKBest
+{
+public:
+  struct Derivation {
+    const Hypo *edge; //< NULL for the derivations of the virtual root
+    std::vector<const Derivation*> children; //< one per previous hypo of edge
+    float score;
+    size_t rank; //< position in the k-best list of its node
+  };
+
+  //! the virtual root has one incoming edge from each of the given hypotheses
+  LazyKBest(const std::vector<const Hypo*> &topHypos)
+    : m_topHypos(topHypos) {
+  }
+
+  //! the k-th best derivation of the whole graph, or NULL if there are not that many
+  const Derivation *Get(size_t k) {
+    return GetKthBest(NULL, k);
+  }
+
+private:
+  struct Node {
+    std::vector<const Derivation*> kbest;
+    std::vector<Derivation*> candidates; //< heap ordered by score
+    size_t numExpanded; //< number of k-best derivations whose successors are candidates
+    bool initialised;
+    Node() : numExpanded(0), initialised(false) {}
+  };
+
+  struct CompareScore {
+    bool operator()(const Derivation *a, const Derivation *b) const {
+      return a->score < b->score;
+    }
+  };
+
+  static const Hypo *GetNodeHypo(const Derivation &derivation) {
+    return Traits::GetWinningHypo(*derivation.edge);
+  }
+
+  Derivation &NewDerivation() {
+    m_derivations.push_back(Derivation());
+    return m_derivations.back();
+  }
+
+  void AddCandidate(Node &node, Derivation &derivation) {
+    node.candidates.push_back(&derivation);
+    std::push_heap(node.candidates.begin(), node.candidates.end(), CompareScore());
+  }
+
+  //! candidates for the best derivation of each incoming edge
+  void Initialise(const Hypo *hypo, Node &node) {
+    node.initialised = true;
+    if (hypo == NULL) {
+      for (size_t i = 0; i < m_topHypos.size(); ++i) {
+        const Derivation *best = GetKthBest(Traits::GetWinningHypo(*m_topHypos[i]), 0);
+        if (best == NULL) continue;
+        Derivation &derivation = NewDerivation();
+        derivation.edge = NULL;
+        derivation.children.push_back(best);
+        derivation.score = best->score;
+        AddCandidate(node, derivation);
+      }
+      return;
+    }
+
+    AddEdge(*hypo, node);
+    const typename Traits::ArcList *arcList = Traits::GetArcList(*hypo);
+    if (arcList) {
+      typename Traits::ArcList::const_iterator iter;
+      for (iter = arcList->begin(); iter != arcList->end(); ++iter) {
+        AddEdge(**iter, node);
+      }
+    }
+  }
+
+  void AddEdge(const Hypo &edge, Node &node) {
+    const size_t numPrevHypos = Traits::GetNumPrevHypos(edge);
+    std::vector<const Derivation*> children(numPrevHypos);
+    for (size_t i = 0; i < numPrevHypos; ++i) {
+      const Hypo *prevHypo = Traits::GetPrevHypo(edge, i);
+      children[i] = GetKthBest(Traits::GetWinningHypo(*prevHypo), 0);
+      if (children[i] == NULL) {
+        return; // can't happen in a well-formed search graph
+      }
+    }
+    Derivation &derivation = NewDerivation();
+    derivation.edge = &edge;
+    derivation.children.swap(children);
+    // The best derivations of the previous hypos are the ones the edge was
+    // built from, so the score is just that of the edge.
+    derivation.score = edge.GetTotalScore();
+    AddCandidate(node, derivation);
+  }
+
+  /** Add the neighbours of derivation, which differ in the rank of one child,
+   *  to the candidates. Only the last child with a non-zero rank or any
+   *  child after it is incremented, so that each rank vector is reached
+   *  from exactly one better neighbour and no candidate is added twice.
+   */
+  void AddSuccessors(Node &node, const Derivation &derivation) {
+    for (size_t i = derivation.children.size(); i-- > 0; ) {
+      const Derivation &child = *derivation.children[i];
+      const Derivation *next = GetKthBest(GetNodeHypo(child), child.rank + 1);
+      if (next != NULL) {
+        Derivation &successor = NewDerivation();
+        successor.edge = derivation.edge;
+        successor.children = derivation.children;
+        successor.children[i] = next;
+        successor.score = derivation.score - child.score + next->score;
+        AddCandidate(node, successor);
+      }
+      if (child.rank != 0) break;
+    }
+  }
+
+  const Derivation *GetKthBest(const Hypo *hypo, size_t k) {
+    // references to the elements of an unordered_map survive rehashing
+    Node &node = hypo ? m_nodes[hypo] : m_root;
+    if (!node.initialised) {
+      Initialise(hypo, node);
+    }
+    while (node.kbest.size() <= k) {
+      if (node.numExpanded < node.kbest.size()) {
+        AddSuccessors(node, *node.kbest.back());
+        node.numExpanded = node.kbest.size();
+      }
+      if (node.candidates.empty()) {
+        return NULL;
+      }
+      std::pop_heap(node.candidates.begin(), node.candidates.end(), CompareScore());
+      Derivation *best = node.candidates.back();
+      node.candidates.pop_back();
+      best->rank = node.kbest.size();
+      node.kbest.push_back(best);
+    }
+    return node.kbest[k];
+  }
+
+  std::vector<const Hypo*> m_topHypos;
+  std::deque<Derivation> m_derivations; //< owns all derivations; addresses are stable
+  boost::unordered_map<const Hypo*, Node> m_nodes;
+  Node m_root;
+};
+
+}
+
+#endif
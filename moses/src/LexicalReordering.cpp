@@ -11,9 +11,9 @@ namespace Moses
 LexicalReordering::LexicalReordering(std::vector<FactorType>& f_factors,
                                      std::vector<FactorType>& e_factors,
                                      const std::string &modelType,
-                                     const std::string &filePath,
                                      const std::vector<float>& weights)
   : m_configuration(this, modelType)
+  , m_table(NULL)
 {
   std::cerr << "Creating lexical reordering...\n";
   std::cerr << "weights: ";
@@ -57,8 +57,12 @@ LexicalReordering::LexicalReordering(std::vector<FactorType>& f_factors,
   // add ScoreProducer - don't do this before our object is set up
   const_cast<ScoreIndexManager&>(StaticData::Instance().GetScoreIndexManager()).AddScoreProducer(this);
   const_cast<StaticData&>(StaticData::Instance()).SetWeightsForScoreProducer(this, weights);
+}
 
+bool LexicalReordering::Load(const std::string &filePath)
+{
   m_table = LexicalReorderingTable::LoadAvailable(filePath, m_factorsF, m_factorsE, std::vector<FactorType>());
+  return m_table != NULL;
 }
 
 LexicalReordering::~LexicalReordering()
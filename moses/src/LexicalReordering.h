@@ -28,10 +28,12 @@ public:
   LexicalReordering(std::vector<FactorType>& f_factors,
                     std::vector<FactorType>& e_factors,
                     const std::string &modelType,
-                    const std::string &filePath,
                     const std::vector<float>& weights);
   virtual ~LexicalReordering();
 
+  //! load the table, which may be done on another thread
+  bool Load(const std::string &filePath);
+
   virtual size_t GetNumScoreComponents() const {
     return m_configuration.GetNumScoreComponents();
   }
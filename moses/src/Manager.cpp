@@ -28,12 +28,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <algorithm>
 #include <limits>
 #include <cmath>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_set.hpp>
 #include "Manager.h"
 #include "TypeDef.h"
 #include "Util.h"
 #include "TargetPhrase.h"
 #include "TrellisPath.h"
-#include "TrellisPathCollection.h"
+#include "LazyKBest.h"
+#include "SearchGraphBinary.h"
 #include "TranslationOption.h"
 #include "LexicalReordering.h"
 #include "LMList.h"
@@ -58,6 +61,7 @@ Manager::Manager(InputType const& source, SearchAlgorithm searchAlgorithm, const
   ,m_start(clock())
   ,interrupted_flag(0)
   ,m_hypoId(0)
+  ,m_outputSearchGraph(StaticData::Instance().GetOutputSearchGraph())
   ,m_source(source)
 {
   m_system->InitializeBeforeSentenceProcessing(source);
@@ -191,11 +195,50 @@ void Manager::printThisHypothesis(long translationId, const Hypothesis* hypo, co
 
 
 
+namespace
+{
+//! the phrase-based search graph, as seen by LazyKBest
+struct HypothesisGraphTraits {
+  typedef Moses::ArcList ArcList;
+  static const Hypothesis *GetWinningHypo(const Hypothesis &hypo) {
+    return hypo.GetWinningHypo();
+  }
+  static const ArcList *GetArcList(const Hypothesis &hypo) {
+    return hypo.GetArcList();
+  }
+  static size_t GetNumPrevHypos(const Hypothesis &hypo) {
+    return hypo.GetPrevHypo() ? 1 : 0;
+  }
+  static const Hypothesis *GetPrevHypo(const Hypothesis &hypo, size_t) {
+    return hypo.GetPrevHypo();
+  }
+};
+
+//! the output factors of a path's target words, for distinct n-best lists.
+//! factors are unique, so equal pointers mean equal strings
+typedef vector<const Factor*> Surface;
+
+void GetSurface(const vector<const Hypothesis*> &edges, const vector<FactorType> &outputFactors, Surface &surface)
+{
+  surface.clear();
+  for (size_t edge = edges.size(); edge-- > 0; ) {
+    const Phrase &phrase = edges[edge]->GetCurrTargetPhrase();
+    for (size_t pos = 0; pos < phrase.GetSize(); ++pos) {
+      for (size_t i = 0; i < outputFactors.size(); ++i) {
+        surface.push_back(phrase.GetFactor(pos, outputFactors[i]));
+      }
+    }
+  }
+}
+}
+
 /**
  * After decoding, the hypotheses in the stacks and additional arcs
  * form a search graph that can be mined for n-best lists.
- * The heavy lifting is done in the TrellisPath and TrellisPathCollection
- * this function controls this for one sentence.
+ * The heavy lifting is done by LazyKBest, which enumerates the paths
+ * in order of score; TrellisPaths (and their score breakdowns) are only
+ * built for the paths that make it into the n-best list.
+ * This function controls this for one sentence.
  *
  * \param count the number of n-best translations to produce
  * \param ret holds the n-best list that was calculated
@@ -212,49 +255,38 @@ void Manager::CalcNBest(size_t count, TrellisPathList &ret,bool onlyDistinct) co
   if (sortedPureHypo.size() == 0)
     return;
 
-  TrellisPathCollection contenders;
+  typedef LazyKBest<Hypothesis, HypothesisGraphTraits> KBest;
+  KBest kBest(sortedPureHypo);
 
-  set<Phrase> distinctHyps;
-
-  // add all pure paths
-  vector<const Hypothesis*>::const_iterator iterBestHypo;
-  for (iterBestHypo = sortedPureHypo.begin()
-                      ; iterBestHypo != sortedPureHypo.end()
-       ; ++iterBestHypo) {
-    contenders.Add(new TrellisPath(*iterBestHypo));
-  }
+  // hashed, and compared word by word when the hashes match
+  boost::unordered_set<Surface> distinctHyps;
+  const vector<FactorType> &outputFactors = StaticData::Instance().GetOutputFactorOrder();
 
   // factor defines stopping point for distinct n-best list if too many candidates identical
   size_t nBestFactor = StaticData::Instance().GetNBestFactor();
   if (nBestFactor < 1) nBestFactor = 1000; // 0 = unlimited
 
   // MAIN loop
-  for (size_t iteration = 0 ; (onlyDistinct ? distinctHyps.size() : ret.GetSize()) < count && contenders.GetSize() > 0 && (iteration < count * nBestFactor) ; iteration++) {
-    // get next best from list of contenders
-    TrellisPath *path = contenders.pop();
-    CHECK(path);
-    // create deviations from current best
-    path->CreateDeviantPaths(contenders);
-    if(onlyDistinct) {
-      Phrase tgtPhrase = path->GetSurfacePhrase();
-      if (distinctHyps.insert(tgtPhrase).second) {
-        ret.Add(path);
-      } else {
-        delete path;
-        path = NULL;
-      }
-    } else {
-      ret.Add(path);
+  vector<const Hypothesis*> edges;
+  Surface surface;
+  for (size_t iteration = 0 ; (onlyDistinct ? distinctHyps.size() : ret.GetSize()) < count && (iteration < count * nBestFactor) ; iteration++) {
+    // get next best path
+    const KBest::Derivation *derivation = kBest.Get(iteration);
+    if (derivation == NULL)
+      break;
+
+    // list of hypos/arcs, from the last to the empty initial hypo
+    edges.clear();
+    for (derivation = derivation->children[0]; derivation != NULL;
+         derivation = derivation->children.empty() ? NULL : derivation->children[0]) {
+      edges.push_back(derivation->edge);
     }
 
-
     if(onlyDistinct) {
-      const size_t nBestFactor = StaticData::Instance().GetNBestFactor();
-      if (nBestFactor > 0)
-        contenders.Prune(count * nBestFactor);
-    } else {
-      contenders.Prune(count);
+      GetSurface(edges, outputFactors, surface);
+      if (!distinctHyps.insert(surface).second) continue;
     }
+    ret.Add(new TrellisPath(vector<const Hypothesis*>(edges.rbegin(), edges.rend())));
   }
 }
 
@@ -899,6 +931,64 @@ void Manager::OutputSearchGraph(long translationId, std::ostream &outputSearchGr
   }
 }
 
+void Manager::OutputSearchGraphBinary(long translationId, std::string &out) const
+{
+  const StaticData &staticData = StaticData::Instance();
+  const vector<FactorType> &outputFactorOrder = staticData.GetOutputFactorOrder();
+
+  vector<SearchGraphNode> searchGraph;
+  GetSearchGraph(searchGraph);
+
+  SearchGraphBinary graph;
+  SearchGraphBinaryWriter writer(graph);
+  graph.translationId = translationId;
+  graph.flags = SearchGraphBinary::PhraseBased;
+  graph.numScores = staticData.GetScoreIndexManager().GetTotalNumberOfScores();
+  graph.edges.resize(searchGraph.size());
+
+  for (size_t i = 0; i < searchGraph.size(); ++i) {
+    const SearchGraphNode &searchNode = searchGraph[i];
+    const Hypothesis &hypo = *searchNode.hypo;
+    const Hypothesis *prevHypo = hypo.GetPrevHypo();
+    SearchGraphBinary::Edge &edge = graph.edges[i];
+
+    edge.id = hypo.GetId();
+    edge.winner = searchNode.recombinationHypo ? searchNode.recombinationHypo->GetId() : edge.id;
+    edge.stack = hypo.GetWordsBitmap().GetNumWordsCovered();
+    edge.forward = searchNode.forward;
+    edge.fscore = searchNode.fscore;
+    edge.score = hypo.GetScore();
+    edge.scores.resize(graph.numScores);
+
+    if (prevHypo == NULL) {
+      // initial hypothesis
+      edge.start = 1;
+      edge.end = 0;
+      edge.transition = 0.0f;
+      continue;
+    }
+
+    edge.start = hypo.GetCurrSourceWordsRange().GetStartPos();
+    edge.end = hypo.GetCurrSourceWordsRange().GetEndPos();
+    edge.tails.push_back(prevHypo->GetId());
+    edge.transition = hypo.GetScore() - prevHypo->GetScore();
+
+    const TargetPhrase &targetPhrase = hypo.GetCurrTargetPhrase();
+    edge.words.resize(targetPhrase.GetSize());
+    for (size_t pos = 0; pos < targetPhrase.GetSize(); ++pos) {
+      edge.words[pos] = writer.AddWord(targetPhrase.GetWord(pos).GetString(outputFactorOrder, false));
+    }
+
+    const ScoreComponentCollection &scores = hypo.GetScoreBreakdown();
+    const ScoreComponentCollection &prevScores = prevHypo->GetScoreBreakdown();
+    for (size_t j = 0; j < graph.numScores; ++j) {
+      edge.scores[j] = scores[j] - prevScores[j];
+    }
+  }
+
+  writer.Encode(out);
+}
+
 void Manager::GetForwardBackwardSearchGraph(std::map< int, bool >* pConnected,
     std::vector< const Hypothesis* >* pConnectedList, std::map < const Hypothesis*, set< const Hypothesis* > >* pOutgoingHyps, vector< float>* pFwdBwdScores) const
 {
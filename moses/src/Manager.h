@@ -108,6 +108,7 @@ protected:
   size_t interrupted_flag;
   std::auto_ptr<SentenceStats> m_sentenceStats;
   int m_hypoId; //used to number the hypos as they are created.
+  bool m_outputSearchGraph; //keep the whole search graph, not just what the n-best list needs
 
   void GetConnectedGraph(
     std::map< int, bool >* pConnected,
@@ -136,11 +137,21 @@ public:
   void printThisHypothesis(long translationId, const Hypothesis* hypo, const std::vector <const TargetPhrase* > & remainingPhrases, float remainingScore , std::ostream& outputStream) const;
   void GetWordGraph(long translationId, std::ostream &outputWordGraphStream) const;
   int GetNextHypoId();
+
+  //! defaults to -output-search-graph; set before ProcessSentence() to override it for this sentence
+  bool GetOutputSearchGraph() const {
+    return m_outputSearchGraph;
+  }
+  void SetOutputSearchGraph(bool outputSearchGraph) {
+    m_outputSearchGraph = outputSearchGraph;
+  }
 #ifdef HAVE_PROTOBUF
   void SerializeSearchGraphPB(long translationId, std::ostream& outputStream) const;
 #endif
 
   void OutputSearchGraph(long translationId, std::ostream &outputSearchGraphStream) const;
+  //! append the search graph as a record of the -output-search-graph-binary format
+  void OutputSearchGraphBinary(long translationId, std::string &out) const;
   void GetSearchGraph(std::vector<SearchGraphNode>& searchGraph) const;
   const InputType& GetSource() const {
     return m_source;
@@ -0,0 +1,161 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <iostream>
+
+#include <boost/bind.hpp>
+
+#include "util/ersatz_progress.hh"
+
+#include "ModelLoader.h"
+#include "StaticData.h"
+#include "Timer.h"
+#include "Util.h"
+
+namespace Moses
+{
+
+ModelLoader::ModelLoader(bool parallel)
+  : m_parallel(parallel)
+{
+#ifndef WITH_THREADS
+  m_parallel = false;
+#endif
+}
+
+ModelLoader::~ModelLoader()
+{
+#ifdef WITH_THREADS
+  m_threads.join_all();
+#endif
+  RemoveAllInColl(m_models);
+}
+
+size_t ModelLoader::Add(const std::string &name, const boost::function<bool ()> &load)
+{
+  Model *model = new Model;
+  model->name = name;
+  model->load = load;
+  model->done = false;
+  model->success = false;
+  model->seconds = 0;
+
+  size_t id;
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    id = m_models.size();
+    m_models.push_back(model);
+  }
+#ifdef WITH_THREADS
+  if (m_parallel) {
+    m_threads.create_thread(boost::bind(&ModelLoader::Load, this, id));
+    return id;
+  }
+#endif
+  Load(id);
+  return id;
+}
+
+void ModelLoader::Load(size_t id)
+{
+  Model *model;
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    model = m_models[id];
+  }
+  Timer timer;
+  timer.start();
+  const bool success = model->load();
+  const double seconds = timer.get_elapsed_time();
+
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  model->success = success;
+  model->seconds = seconds;
+  model->done = true;
+#ifdef WITH_THREADS
+  m_loaded.notify_all();
+#endif
+}
+
+bool ModelLoader::Wait(const std::vector<size_t> &ids)
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+#endif
+  bool success = true;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const Model *model = m_models[ids[i]];
+#ifdef WITH_THREADS
+    while (!model->done) {
+      m_loaded.wait(lock);
+    }
+#endif
+    success = success && model->success;
+  }
+  return success;
+}
+
+bool ModelLoader::WaitAll()
+{
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    size_t done = 0;
+    for (size_t i = 0; i < m_models.size(); ++i) {
+      if (m_models[i]->done) ++done;
+    }
+#ifdef WITH_THREADS
+    if (m_parallel && done < m_models.size()) {
+      util::ErsatzProgress progress(StaticData::Instance().GetVerboseLevel() >= 1 ? &std::cerr : NULL,
+                                    "Loading models", m_models.size());
+      while (done < m_models.size()) {
+        progress.Set(done);
+        m_loaded.wait(lock);
+        done = 0;
+        for (size_t i = 0; i < m_models.size(); ++i) {
+          if (m_models[i]->done) ++done;
+        }
+      }
+      progress.Finished();
+    }
+#endif
+  }
+#ifdef WITH_THREADS
+  m_threads.join_all();
+#endif
+
+  bool success = true;
+  for (size_t i = 0; i < m_models.size(); ++i) {
+    VERBOSE(1, "Loaded " << m_models[i]->name << " in " << m_models[i]->seconds << " seconds"
+            << (m_models[i]->success ? "" : ", which failed") << std::endl);
+    success = success && m_models[i]->success;
+  }
+  return success;
+}
+
+}
@@ -0,0 +1,86 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_ModelLoader_h
+#define moses_ModelLoader_h
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread.hpp>
+#endif
+
+namespace Moses
+{
+
+/** Loads the models of the decoder, and times how long each takes.
+ *
+ * Each load is added with a name and a function returning false on failure.
+ * Sequential loading runs the function straight away.  Parallel loading
+ * runs it on a thread of its own, so that the waits for disk of several
+ * models overlap; Wait() returns once some of them are loaded, for the
+ * models which depend on them.
+ */
+class ModelLoader
+{
+public:
+  explicit ModelLoader(bool parallel);
+  ~ModelLoader();
+
+  //! load a model, returns its id for Wait()
+  size_t Add(const std::string &name, const boost::function<bool ()> &load);
+
+  //! wait for the loads, false if one of them failed
+  bool Wait(const std::vector<size_t> &ids);
+
+  //! wait for all the loads, showing progress, and print the time of each
+  bool WaitAll();
+
+private:
+  ModelLoader(const ModelLoader &);
+  void operator=(const ModelLoader &);
+
+  struct Model {
+    std::string name;
+    boost::function<bool ()> load;
+    bool done;
+    bool success;
+    double seconds;
+  };
+
+  void Load(size_t id);
+
+  bool m_parallel;
+  // pointers, as the models are updated by their thread while more are added
+  std::vector<Model*> m_models;
+#ifdef WITH_THREADS
+  boost::mutex m_mutex;
+  boost::condition_variable m_loaded;
+  boost::thread_group m_threads;
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,221 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include <boost/unordered_map.hpp>
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
+#include "NBestMBR.h"
+#include "util/check.hh"
+#include "util/murmur_hash.hh"
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+const size_t BLEU_ORDER = 4;
+const float SMOOTH = 1;
+
+/** Smoothed BLEU from the clipped n-gram matches of a hypothesis.  Only the
+ *  unigram precision is unsmoothed, if nothing matches the score is 0. */
+float Bleu(const float *matches, size_t hypLength, float refLength)
+{
+  if (matches[0] == 0) {
+    return 0.0f;
+  }
+  float logbleu = 0.0f;
+  for (size_t i = 0; i < BLEU_ORDER; ++i) {
+    const float total = hypLength > i ? hypLength - i : 0;
+    if (i > 0) {
+      logbleu += log(matches[i] + SMOOTH) - log(total + SMOOTH);
+    } else {
+      logbleu += log(matches[i]) - log(total);
+    }
+  }
+  logbleu /= BLEU_ORDER;
+  const float brevity = 1.0f - refLength / hypLength;
+  if (brevity < 0.0f) {
+    logbleu += brevity;
+  }
+  return exp(logbleu);
+}
+
+/** Expected loss of the translations first, first + step, ... against all
+ *  the others.  A translation is abandoned once its loss exceeds the
+ *  smallest one found so far. */
+void FindMinRisk(const vector<MBRNgramStats> &stats, const vector<float> &posteriors,
+                 size_t first, size_t step, float *minLoss, size_t *minIndex)
+{
+  *minLoss = 1000000;
+  *minIndex = first;
+  for (size_t i = first; i < stats.size(); i += step) {
+    float loss = 0;
+    for (size_t j = 0; j < stats.size(); ++j) {
+      if (i != j) {
+        loss += (1 - CalcMBRBleu(stats[i], stats[j])) * posteriors[j];
+        if (loss > *minLoss)
+          break;
+      }
+    }
+    if (loss < *minLoss) {
+      *minLoss = loss;
+      *minIndex = i;
+    }
+  }
+}
+
+}
+
+MBRNgramStats::MBRNgramStats(const vector<const Factor*> &translation)
+  : m_length(translation.size())
+{
+  for (size_t start = 0; start < translation.size(); ++start) {
+    for (size_t order = 1; order <= BLEU_ORDER && start + order <= translation.size(); ++order) {
+      Ngram ngram;
+      ngram.key = util::MurmurHashNative(&translation[start], order * sizeof(const Factor*));
+      ngram.order = order;
+      ngram.count = 1;
+      m_ngrams.push_back(ngram);
+    }
+  }
+  sort(m_ngrams.begin(), m_ngrams.end());
+
+  size_t merged = 0;
+  for (size_t i = 0; i < m_ngrams.size(); ++i) {
+    if (merged > 0 && m_ngrams[merged - 1].key == m_ngrams[i].key) {
+      ++m_ngrams[merged - 1].count;
+    } else {
+      m_ngrams[merged++] = m_ngrams[i];
+    }
+  }
+  m_ngrams.resize(merged);
+}
+
+float CalcMBRBleu(const MBRNgramStats &hyp, const MBRNgramStats &ref)
+{
+  float matches[BLEU_ORDER] = {0};
+  vector<MBRNgramStats::Ngram>::const_iterator hypIter = hyp.GetNgrams().begin();
+  vector<MBRNgramStats::Ngram>::const_iterator refIter = ref.GetNgrams().begin();
+  while (hypIter != hyp.GetNgrams().end() && refIter != ref.GetNgrams().end()) {
+    if (hypIter->key < refIter->key) {
+      ++hypIter;
+    } else if (refIter->key < hypIter->key) {
+      ++refIter;
+    } else {
+      matches[hypIter->order - 1] += min(hypIter->count, refIter->count);
+      ++hypIter;
+      ++refIter;
+    }
+  }
+  return Bleu(matches, hyp.GetLength(), ref.GetLength());
+}
+
+size_t FindMBRTranslation(const vector< vector<const Factor*> > &translations,
+                          const vector<float> &scores, bool expectedBleu, size_t threads)
+{
+  CHECK(!translations.empty() && translations.size() == scores.size());
+
+  // posteriors, taking out the max score to prevent underflow
+  const float maxScore = *max_element(scores.begin(), scores.end());
+  vector<float> posteriors(scores.size());
+  float marginal = 0;
+  for (size_t i = 0; i < scores.size(); ++i) {
+    posteriors[i] = exp(scores[i] - maxScore);
+    marginal += posteriors[i];
+  }
+  for (size_t i = 0; i < posteriors.size(); ++i) {
+    posteriors[i] /= marginal;
+  }
+
+  vector<MBRNgramStats> stats;
+  stats.reserve(translations.size());
+  for (size_t i = 0; i < translations.size(); ++i) {
+    stats.push_back(MBRNgramStats(translations[i]));
+  }
+
+  if (expectedBleu) {
+    // expected n-gram counts and length of the reference
+    boost::unordered_map<uint64_t, float> expectedCounts;
+    float expectedLength = 0;
+    for (size_t i = 0; i < stats.size(); ++i) {
+      const vector<MBRNgramStats::Ngram> &ngrams = stats[i].GetNgrams();
+      for (size_t j = 0; j < ngrams.size(); ++j) {
+        expectedCounts[ngrams[j].key] += posteriors[i] * ngrams[j].count;
+      }
+      expectedLength += posteriors[i] * stats[i].GetLength();
+    }
+
+    float maxBleu = -1;
+    size_t maxBleuIndex = 0;
+    for (size_t i = 0; i < stats.size(); ++i) {
+      float matches[BLEU_ORDER] = {0};
+      const vector<MBRNgramStats::Ngram> &ngrams = stats[i].GetNgrams();
+      for (size_t j = 0; j < ngrams.size(); ++j) {
+        matches[ngrams[j].order - 1] += min<float>(ngrams[j].count, expectedCounts[ngrams[j].key]);
+      }
+      const float bleu = Bleu(matches, stats[i].GetLength(), expectedLength);
+      if (bleu > maxBleu) {
+        maxBleu = bleu;
+        maxBleuIndex = i;
+      }
+    }
+    return maxBleuIndex;
+  }
+
+  threads = max<size_t>(1, min(threads, stats.size()));
+  vector<float> minLosses(threads);
+  vector<size_t> minIndices(threads);
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    boost::thread_group workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.create_thread(boost::bind(&FindMinRisk, boost::cref(stats), boost::cref(posteriors),
+                                        t, threads, &minLosses[t], &minIndices[t]));
+    }
+    workers.join_all();
+  } else
+#endif
+  {
+    threads = 1;
+    FindMinRisk(stats, posteriors, 0, 1, &minLosses[0], &minIndices[0]);
+  }
+
+  // ties go to the translation earlier in the list, as in a single pass
+  size_t best = 0;
+  for (size_t t = 1; t < threads; ++t) {
+    if (minLosses[t] < minLosses[best] ||
+        (minLosses[t] == minLosses[best] && minIndices[t] < minIndices[best])) {
+      best = t;
+    }
+  }
+  return minIndices[best];
+}
+
+}
@@ -0,0 +1,86 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_NBestMBR_h
+#define moses_NBestMBR_h
+
+#include <cstddef>
+#include <vector>
+
+#include <stdint.h>
+
+namespace Moses
+{
+
+class Factor;
+
+/** n-gram counts of one translation of an n-best list, up to order 4.
+ *  N-grams are hashed once and kept sorted by hash, so that the matches
+ *  between two translations are found in a single merge.
+ */
+class MBRNgramStats
+{
+public:
+  struct Ngram {
+    uint64_t key; //< hash of the words
+    unsigned order;
+    unsigned count;
+
+    bool operator<(const Ngram &other) const {
+      return key < other.key;
+    }
+  };
+
+  explicit MBRNgramStats(const std::vector<const Factor*> &translation);
+
+  size_t GetLength() const {
+    return m_length;
+  }
+  const std::vector<Ngram> &GetNgrams() const {
+    return m_ngrams;
+  }
+
+private:
+  size_t m_length;
+  std::vector<Ngram> m_ngrams;
+};
+
+/** Minimum Bayes risk decoding of an n-best list under 1 - sentence BLEU
+ *  (Kumar and Byrne 04).  scores are the scaled log-linear scores of the
+ *  translations.
+ *
+ *  The exact risk compares every pair of translations, which is quadratic
+ *  in the size of the list; it may be spread over several threads.  With
+ *  expectedBleu, each translation is instead scored once against the
+ *  posterior-weighted n-gram counts and length of the whole list (DeNero et
+ *  al 09), which is linear in the size of the list.
+ *
+ *  Returns the index of the chosen translation.
+ */
+size_t FindMBRTranslation(const std::vector< std::vector<const Factor*> > &translations,
+                          const std::vector<float> &scores, bool expectedBleu, size_t threads);
+
+//! smoothed sentence BLEU of hyp, with ref as the reference
+float CalcMBRBleu(const MBRNgramStats &hyp, const MBRNgramStats &ref);
+
+}
+
+#endif
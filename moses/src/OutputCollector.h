@@ -42,8 +42,14 @@ namespace Moses
 class OutputCollector
 {
 public:
-  OutputCollector(std::ostream* outStream= &std::cout, std::ostream* debugStream=&std::cerr) :
-    m_nextOutput(0),m_outStream(outStream),m_debugStream(debugStream)  {}
+  /**
+    * The streams are flushed after each write, so that a reader of the
+    * output gets every sentence as soon as it is done. Batch tools which
+    * only need the whole file can pass flush=false.
+    **/
+  OutputCollector(std::ostream* outStream= &std::cout, std::ostream* debugStream=&std::cerr,
+                  bool flush=true) :
+    m_nextOutput(0),m_outStream(outStream),m_debugStream(debugStream),m_flush(flush)  {}
 
 
   /**
@@ -55,20 +61,24 @@ public:
 #endif
     if (sourceId == m_nextOutput) {
       //This is the one we were expecting
-      *m_outStream << output << std::flush;
-      *m_debugStream << debug << std::flush;
+      *m_outStream << output;
+      *m_debugStream << debug;
       ++m_nextOutput;
       //see if there's any more
       std::map<int,std::string>::iterator iter;
       while ((iter = m_outputs.find(m_nextOutput)) != m_outputs.end()) {
-        *m_outStream << iter->second << std::flush;
+        *m_outStream << iter->second;
         m_outputs.erase(iter);
-        ++m_nextOutput;
-        std::map<int,std::string>::iterator debugIter = m_debugs.find(iter->first);
+        std::map<int,std::string>::iterator debugIter = m_debugs.find(m_nextOutput);
         if (debugIter != m_debugs.end()) {
-          *m_debugStream << debugIter->second << std::flush;
+          *m_debugStream << debugIter->second;
           m_debugs.erase(debugIter);
         }
+        ++m_nextOutput;
+      }
+      if (m_flush) {
+        *m_outStream << std::flush;
+        *m_debugStream << std::flush;
       }
     } else {
       //save for later
@@ -82,6 +92,7 @@ private:
   int m_nextOutput;
   std::ostream* m_outStream;
   std::ostream* m_debugStream;
+  bool m_flush;
 #ifdef WITH_THREADS
   boost::mutex m_mutex;
 #endif
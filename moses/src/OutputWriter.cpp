@@ -0,0 +1,175 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "OutputWriter.h"
+
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#endif
+
+using namespace std;
+
+namespace Moses
+{
+
+OutputWriter::OutputWriter(const std::vector<std::ostream*> &streams, size_t maxPending)
+  : m_streams(streams)
+  , m_block(streams.size())
+  , m_nextOutput(0)
+  , m_pending(0)
+  , m_maxPending(maxPending)
+  , m_closed(false)
+{
+  for (size_t i = 0; i < m_streams.size(); ++i) {
+    m_block[i] = i;
+    for (size_t j = 0; j < i; ++j) {
+      if (m_streams[j] == m_streams[i]) {
+        m_block[i] = j;
+        break;
+      }
+    }
+  }
+#ifdef WITH_THREADS
+  // started last, it reads the members set above
+  m_writer = boost::thread(boost::bind(&OutputWriter::Run, this));
+#endif
+}
+
+OutputWriter::~OutputWriter()
+{
+  Close();
+}
+
+void OutputWriter::TakeReady(std::vector<std::string> &blocks)
+{
+  map<int, vector<string> >::iterator iter = m_outputs.begin();
+  while (iter != m_outputs.end() && (iter->first == m_nextOutput || m_closed)) {
+    const vector<string> &outputs = iter->second;
+    for (size_t i = 0; i < outputs.size() && i < m_streams.size(); ++i) {
+      if (m_streams[i] != NULL) {
+        blocks[m_block[i]] += outputs[i];
+      }
+      m_pending -= outputs[i].size();
+    }
+    m_nextOutput = iter->first + 1;
+    m_outputs.erase(iter++);
+  }
+}
+
+void OutputWriter::WriteBlocks(std::vector<std::string> &blocks)
+{
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    if (!blocks[i].empty()) {
+      m_streams[i]->write(blocks[i].data(), blocks[i].size());
+      // a client on the other end of a pipe waits for its sentence
+      m_streams[i]->flush();
+      blocks[i].clear();
+    }
+  }
+}
+
+void OutputWriter::Write(int sourceId, std::vector<std::string> &outputs)
+{
+  size_t size = 0;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    size += outputs[i].size();
+  }
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+  while (m_pending > m_maxPending && sourceId != m_nextOutput) {
+    m_spaceFree.wait(lock);
+  }
+  m_outputs[sourceId].swap(outputs);
+  m_pending += size;
+  if (sourceId == m_nextOutput) {
+    m_outputReady.notify_one();
+  }
+#else
+  m_outputs[sourceId].swap(outputs);
+  m_pending += size;
+  vector<string> blocks(m_streams.size());
+  TakeReady(blocks);
+  WriteBlocks(blocks);
+#endif
+}
+
+void OutputWriter::Write(int sourceId, std::string &output)
+{
+  vector<string> outputs(1);
+  outputs[0].swap(output);
+  Write(sourceId, outputs);
+}
+
+#ifdef WITH_THREADS
+void OutputWriter::Run()
+{
+  vector<string> blocks(m_streams.size());
+  while (true) {
+    bool closed;
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      while (!m_closed && (m_outputs.empty() || m_outputs.begin()->first != m_nextOutput)) {
+        m_outputReady.wait(lock);
+      }
+      // once closed, whatever is left is written even if there are gaps
+      TakeReady(blocks);
+      closed = m_closed && m_outputs.empty();
+    }
+    m_spaceFree.notify_all();
+    WriteBlocks(blocks);
+    if (closed) {
+      break;
+    }
+  }
+}
+#endif
+
+void OutputWriter::Close()
+{
+#ifdef WITH_THREADS
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (m_closed) {
+      return;
+    }
+    m_closed = true;
+  }
+  m_outputReady.notify_one();
+  if (m_writer.joinable()) {
+    m_writer.join();
+  }
+#else
+  if (m_closed) {
+    return;
+  }
+  m_closed = true;
+  vector<string> blocks(m_streams.size());
+  TakeReady(blocks);
+  WriteBlocks(blocks);
+#endif
+  for (size_t i = 0; i < m_streams.size(); ++i) {
+    if (m_streams[i] != NULL && m_block[i] == i) {
+      m_streams[i]->flush();
+    }
+  }
+}
+
+}
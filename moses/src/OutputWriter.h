@@ -0,0 +1,95 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_OutputWriter_h
+#define moses_OutputWriter_h
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef WITH_THREADS
+#include <boost/thread.hpp>
+#endif
+
+namespace Moses
+{
+
+/**
+  * Writes all the outputs of the decoder (best translation, n-best list,
+  * search graph, ...) in the order of the input.  Each translation hands
+  * over the outputs of one sentence in one call, and a background thread
+  * writes the sentences that are ready in batches, so the translation
+  * threads never wait on disk.  Outputs on the same stream are written
+  * sentence by sentence, as they would be by one OutputCollector each.
+  * Each stream is flushed after every batch written to it.
+  *
+  * Write() blocks while more than maxPending bytes are waiting, unless it is
+  * called with the sentence the writer is waiting for.
+  **/
+class OutputWriter
+{
+public:
+  //! streams[i] receives output i of each sentence, NULL if it is not wanted
+  OutputWriter(const std::vector<std::ostream*> &streams, size_t maxPending = 64 << 20);
+
+  //! write everything still pending and stop the writer thread
+  ~OutputWriter();
+
+  //! outputs has one string per stream; it is swapped out, not copied
+  void Write(int sourceId, std::vector<std::string> &outputs);
+
+  //! for a writer of a single stream
+  void Write(int sourceId, std::string &output);
+
+  //! write everything still pending; no Write() may follow
+  void Close();
+
+private:
+  OutputWriter(const OutputWriter&);
+  void operator=(const OutputWriter&);
+
+  //! append the consecutive sentences starting at m_nextOutput to blocks
+  void TakeReady(std::vector<std::string> &blocks);
+  void WriteBlocks(std::vector<std::string> &blocks);
+
+  std::vector<std::ostream*> m_streams;
+  std::vector<size_t> m_block; //< index of the first output with the same stream
+  std::map<int, std::vector<std::string> > m_outputs;
+  int m_nextOutput;
+  size_t m_pending; //< bytes in m_outputs
+  size_t m_maxPending;
+  bool m_closed;
+#ifdef WITH_THREADS
+  void Run();
+
+  boost::mutex m_mutex;
+  boost::condition_variable m_outputReady;
+  boost::condition_variable m_spaceFree;
+  boost::thread m_writer;
+#endif
+};
+
+}
+
+#endif
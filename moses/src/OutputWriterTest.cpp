@@ -0,0 +1,199 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
+#include "OutputWriter.h"
+
+using namespace Moses;
+
+namespace
+{
+
+std::string Line(char prefix, int sourceId)
+{
+  std::ostringstream line;
+  line << prefix << sourceId << "\n";
+  return line.str();
+}
+
+// a stream buffer which only hands on what it holds when flushed
+class FlushedBuffer : public std::streambuf
+{
+public:
+  std::string Flushed() {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    return m_flushed;
+  }
+
+protected:
+  int overflow(int c) {
+    if (c != traits_type::eof()) {
+      m_buffered += traits_type::to_char_type(c);
+    }
+    return traits_type::not_eof(c);
+  }
+  std::streamsize xsputn(const char *s, std::streamsize n) {
+    m_buffered.append(s, n);
+    return n;
+  }
+  int sync() {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_mutex);
+#endif
+    m_flushed += m_buffered;
+    m_buffered.clear();
+    return 0;
+  }
+
+private:
+  std::string m_buffered, m_flushed;
+#ifdef WITH_THREADS
+  boost::mutex m_mutex;
+#endif
+};
+
+BOOST_AUTO_TEST_CASE(OutputWriterSharedStreams)
+{
+  // the first two outputs share a stream, the third is not wanted
+  std::ostringstream shared, other;
+  std::vector<std::ostream*> streams;
+  streams.push_back(&shared);
+  streams.push_back(&shared);
+  streams.push_back(NULL);
+  streams.push_back(&other);
+  OutputWriter writer(streams);
+  for (int id = 4; id >= 0; --id) {
+    std::vector<std::string> outputs;
+    outputs.push_back(Line('b', id));
+    outputs.push_back(Line('n', id));
+    outputs.push_back(Line('x', id));
+    outputs.push_back(Line('o', id));
+    writer.Write(id, outputs);
+  }
+  writer.Close();
+
+  std::string expectShared, expectOther;
+  for (int id = 0; id < 5; ++id) {
+    expectShared += Line('b', id) + Line('n', id);
+    expectOther += Line('o', id);
+  }
+  BOOST_CHECK_EQUAL(expectShared, shared.str());
+  BOOST_CHECK_EQUAL(expectOther, other.str());
+}
+
+BOOST_AUTO_TEST_CASE(OutputWriterSingleStream)
+{
+  std::ostringstream out;
+  OutputWriter writer(std::vector<std::ostream*>(1, &out));
+  std::string output = "second\n";
+  writer.Write(1, output);
+  output = "first\n";
+  writer.Write(0, output);
+  writer.Close();
+  // closing again, as the destructor does, writes nothing more
+  writer.Close();
+  BOOST_CHECK_EQUAL("first\nsecond\n", out.str());
+}
+
+BOOST_AUTO_TEST_CASE(OutputWriterFlushesBeforeClose)
+{
+  // a client reading the output through a pipe gets each sentence as soon
+  // as it is written, not when the writer closes
+  FlushedBuffer buffer;
+  std::ostream out(&buffer);
+  OutputWriter writer(std::vector<std::ostream*>(1, &out));
+  std::string output = Line('s', 0);
+  writer.Write(0, output);
+  std::string flushed = buffer.Flushed();
+#ifdef WITH_THREADS
+  for (int i = 0; i < 500 && flushed.empty(); ++i) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    flushed = buffer.Flushed();
+  }
+#endif
+  BOOST_CHECK_EQUAL(Line('s', 0), flushed);
+  writer.Close();
+}
+
+#ifdef WITH_THREADS
+
+void WriteEvery(OutputWriter *writer, int first, int step, int count)
+{
+  for (int id = first; id < count; id += step) {
+    std::string output = Line('s', id);
+    writer->Write(id, output);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(OutputWriterOrdersThreads)
+{
+  const int kThreads = 4, kSentences = 2000;
+  std::ostringstream out;
+  {
+    // a limit well below the output, so that the threads wait on each other
+    OutputWriter writer(std::vector<std::ostream*>(1, &out), 64);
+    boost::thread_group threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.create_thread(boost::bind(&WriteEvery, &writer, t, kThreads, kSentences));
+    }
+    threads.join_all();
+  }
+  std::string expect;
+  for (int id = 0; id < kSentences; ++id) {
+    expect += Line('s', id);
+  }
+  BOOST_CHECK(expect == out.str());
+}
+
+BOOST_AUTO_TEST_CASE(OutputWriterLimitsPending)
+{
+  std::ostringstream out;
+  OutputWriter writer(std::vector<std::ostream*>(1, &out), 4);
+  std::string output = "one that is over the limit\n";
+  writer.Write(1, output);
+
+  // sentence 2 waits, as more than 4 bytes are pending and 0 is not written
+  boost::thread ahead(boost::bind(&WriteEvery, &writer, 2, 1, 3));
+  BOOST_CHECK(!ahead.timed_join(boost::posix_time::milliseconds(200)));
+
+  // sentence 0 does not, being the one the writer waits for
+  output = "zero\n";
+  writer.Write(0, output);
+  ahead.join();
+  writer.Close();
+  BOOST_CHECK_EQUAL("zero\none that is over the limit\n" + Line('s', 2), out.str());
+}
+
+#endif
+
+}
@@ -59,6 +59,7 @@ Parameter::Parameter()
   AddParam("lmodel-oov-feature", "add language model oov feature, one per model");
   AddParam("mapping", "description of decoding steps");
   AddParam("max-partial-trans-opt", "maximum number of partial translation options per input span (during mapping steps)");
+  AddParam("lazy-partial-trans-opt", "create the partial translation options of each mapping step best first, and stop at the span limits (default false)");
   AddParam("max-trans-opt-per-coverage", "maximum number of translation options per input span (after applying mapping steps)");
   AddParam("max-phrase-length", "maximum phrase length (default 20)");
   AddParam("n-best-list", "file and size of n-best-list to be generated; specify - as the file in order to write to STDOUT");
@@ -79,6 +80,9 @@ Parameter::Parameter()
   AddParam("stack", "s", "maximum stack size for histogram pruning");
   AddParam("stack-diversity", "sd", "minimum number of hypothesis of each coverage in stack (default 0)");
   AddParam("threads","th", "number of threads to use in decoding (defaults to single-threaded)");
+  AddParam("parallel-load", "load the models on a thread each, instead of one after the other (default false)");
+  AddParam("processes", "number of decoder processes, forked once the models are loaded so that they share them; -threads is per process (default 1)");
+  AddParam("pin-processes", "bind each decoder process to a NUMA node, or to as many cores as it has threads (default false)");
   AddParam("translation-details", "T", "for each best hypothesis, report translation details to the given file");
   AddParam("ttable-file", "location and properties of the translation tables");
   AddParam("ttable-limit", "ttl", "maximum number of translation table entries per input phrase");
@@ -108,6 +112,8 @@ Parameter::Parameter()
   AddParam("consensus-decoding", "con", "use consensus decoding (De Nero et. al. 2009)");
   AddParam("mbr-size", "number of translation candidates considered in MBR decoding (default 200)");
   AddParam("mbr-scale", "scaling factor to convert log linear score probability in MBR decoding (default 1.0)");
+  AddParam("mbr-expected-bleu", "in MBR decoding, score each candidate against the expected n-gram counts of the n-best list instead of every other candidate (linear instead of quadratic in mbr-size)");
+  AddParam("mbr-threads", "number of threads computing the pairwise risk in MBR decoding (default 1)");
   AddParam("lmbr-thetas", "theta(s) for lattice mbr calculation");
   AddParam("lmbr-pruning-factor", "average number of nodes/word wanted in pruned lattice");
   AddParam("lmbr-p", "unigram precision value for lattice mbr");
@@ -122,6 +128,7 @@ Parameter::Parameter()
   AddParam("time-out", "seconds after which is interrupted (-1=no time-out, default is -1)");
   AddParam("output-search-graph", "osg", "Output connected hypotheses of search into specified filename");
   AddParam("output-search-graph-extended", "osgx", "Output connected hypotheses of search into specified filename, in extended format");
+  AddParam("output-search-graph-binary", "osgb", "Output connected hypotheses of search into specified filename, in a compact binary format");
   AddParam("unpruned-search-graph", "usg", "When outputting chart search graph, do not exclude dead ends. Note: stack pruning may have eliminated some hypotheses");
 #ifdef HAVE_PROTOBUF
   AddParam("output-search-graph-pb", "pb", "Write phrase lattice to protocol buffer objects in the specified path.");
@@ -332,6 +339,8 @@ bool Parameter::Validate()
     //raw tables in either un compressed or compressed form
     ext.push_back("");
     ext.push_back(".gz");
+    //binary form
+    ext.push_back(".bingen");
     noErrorFlag = FilesExist("generation-file", 3, ext);
   }
   // distortion
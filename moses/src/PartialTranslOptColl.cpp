@@ -31,6 +31,7 @@ PartialTranslOptColl::PartialTranslOptColl()
   m_worstScore = -std::numeric_limits<float>::infinity();
   m_maxSize = StaticData::Instance().GetMaxNoPartTransOpt();
   m_totalPruned = 0;
+  m_totalCreated = 0;
 }
 
 
@@ -38,6 +39,7 @@ PartialTranslOptColl::PartialTranslOptColl()
 void PartialTranslOptColl::AddNoPrune(const TranslationSystem* system, TranslationOption *partialTranslOpt)
 {
   partialTranslOpt->CalcScore(system);
+  m_totalCreated++;
   if (partialTranslOpt->GetFutureScore() >= m_worstScore) {
     m_list.push_back(partialTranslOpt);
     if (partialTranslOpt->GetFutureScore() > m_bestScore)
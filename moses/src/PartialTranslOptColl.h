@@ -49,6 +49,7 @@ protected:
   float m_worstScore; /**< score of the worse translation option */
   size_t m_maxSize; /**< maximum number of translation options allowed */
   size_t m_totalPruned; /**< number of options pruned */
+  size_t m_totalCreated; /**< number of options added, pruned or not */
 
 public:
   PartialTranslOptColl();
@@ -60,6 +61,10 @@ public:
 
   void AddNoPrune(const TranslationSystem* system, TranslationOption *partialTranslOpt);
   void Add(const TranslationSystem* system, TranslationOption *partialTranslOpt);
+  /** add a partial translation option already scored with CalcScore(), without pruning */
+  void AddScored(TranslationOption *partialTranslOpt) {
+    m_list.push_back(partialTranslOpt);
+  }
   void Prune();
 
   /** returns list of translation options */
@@ -77,6 +82,11 @@ public:
     return m_totalPruned;
   }
 
+  /** return number of partial translation options added, including the pruned ones */
+  size_t GetCreatedCount() const {
+    return m_totalCreated;
+  }
+
 };
 
 }
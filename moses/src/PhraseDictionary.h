@@ -118,6 +118,10 @@ public:
 
   size_t GetNumInputScores() const;
 
+  const std::string &GetFilePath() const {
+    return m_filePath;
+  }
+
   //Initialises the dictionary (may involve loading from file)
   void InitDictionary(const TranslationSystem* system);
 
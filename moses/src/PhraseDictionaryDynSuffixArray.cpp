@@ -2,21 +2,29 @@
 #include "FactorCollection.h"
 #include "StaticData.h"
 #include "TargetPhrase.h"
+#include "Timer.h"
 #include <iomanip>
+#include <queue>
 
 using namespace std;
 
 namespace Moses
 {
+namespace
+{
+const size_t DEFAULT_MAX_CACHE_SIZE = 10000;
+}
+
 PhraseDictionaryDynSuffixArray::PhraseDictionaryDynSuffixArray(size_t numScoreComponent,
-    PhraseDictionaryFeature* feature): PhraseDictionary(numScoreComponent, feature)
+    PhraseDictionaryFeature* feature)
+  : PhraseDictionary(numScoreComponent, feature)
+  , m_cacheMaxSize(DEFAULT_MAX_CACHE_SIZE)
+  , m_latest(new Version(new BilingualDynSuffixArray(), 0))
 {
-  m_biSA = new BilingualDynSuffixArray();
 }
 
 PhraseDictionaryDynSuffixArray::~PhraseDictionaryDynSuffixArray()
 {
-  delete m_biSA;
 }
 
 bool PhraseDictionaryDynSuffixArray::Load(const std::vector<FactorType>& input,
@@ -33,27 +41,76 @@ bool PhraseDictionaryDynSuffixArray::Load(const std::vector<FactorType>& input,
   m_weight = weight;
   m_weightWP = weightWP;
 
-  m_biSA->Load( input, output, source, target, alignments, weight);
+  m_latest->biSA->Load( input, output, source, target, alignments, weight);
 
   return true;
 }
 
-void PhraseDictionaryDynSuffixArray::InitializeForInput(const InputType& input)
+void PhraseDictionaryDynSuffixArray::InitializeForInput(const InputType& /* input */)
 {
-  CHECK(&input == &input);
+  // the whole sentence is decoded on the latest version
+  GetSentenceState().version = GetLatestVersion();
 }
 
 void PhraseDictionaryDynSuffixArray::CleanUp()
 {
-  m_biSA->CleanUp();
+  SentenceState &sentence = GetSentenceState();
+  sentence.collections.clear();
+  if (sentence.version) {
+    sentence.version->biSA->CleanUp();
+  }
+  // deletes the version if it is no longer the latest and this was its last sentence
+  sentence.version.reset();
+}
+
+PhraseDictionaryDynSuffixArray::SentenceState &PhraseDictionaryDynSuffixArray::GetSentenceState() const
+{
+#ifdef WITH_THREADS
+  SentenceState *sentence = m_sentence.get();
+  if (sentence == NULL) {
+    sentence = new SentenceState;
+    m_sentence.reset(sentence);
+  }
+  return *sentence;
+#else
+  return m_sentence;
+#endif
+}
+
+PhraseDictionaryDynSuffixArray::VersionPtr PhraseDictionaryDynSuffixArray::GetLatestVersion() const
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_latestMutex);
+#endif
+  return m_latest;
 }
 
 const TargetPhraseCollection *PhraseDictionaryDynSuffixArray::GetTargetPhraseCollection(const Phrase& src) const
 {
+  SentenceState &sentence = GetSentenceState();
+  if (!sentence.version) {
+    sentence.version = GetLatestVersion();
+  }
+  Version &version = *sentence.version;
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(version.cacheMutex);
+#endif
+    Cache::iterator iter = version.cache.find(src);
+    if (iter != version.cache.end()) {
+      iter->second.second = clock();
+      sentence.collections.push_back(iter->second.first);
+      return iter->second.first.get();
+    }
+  }
+
+  // not cached: sample and score without holding the lock, so that other
+  // threads can carry on looking up phrases in the meantime
   TargetPhraseCollection *ret = new TargetPhraseCollection();
+  CollectionPtr collection(ret);
   std::vector< std::pair< Scores, TargetPhrase*> > trg;
   // extract target phrases and their scores from suffix array
-  m_biSA->GetTargetPhrasesByLexicalWeight( src, trg);
+  version.biSA->GetTargetPhrasesByLexicalWeight( src, trg);
 
   std::vector< std::pair< Scores, TargetPhrase*> >::iterator itr;
   for(itr = trg.begin(); itr != trg.end(); ++itr) {
@@ -66,12 +123,93 @@ const TargetPhraseCollection *PhraseDictionaryDynSuffixArray::GetTargetPhraseCol
     ret->Add(targetPhrase);
   }
   ret->NthElement(m_tableLimit); // sort the phrases for the dcoder
-  return ret;
+
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(version.cacheMutex);
+#endif
+    // if another thread got here first, use its collection
+    std::pair<Cache::iterator, bool> inserted =
+      version.cache.insert(make_pair(src, make_pair(collection, clock())));
+    collection = inserted.first->second.first;
+    ReduceCache(version.cache);
+  }
+  sentence.collections.push_back(collection);
+  return collection.get();
+}
+
+// caller must hold the cacheMutex of the version of the cache
+void PhraseDictionaryDynSuffixArray::ReduceCache(Cache &cache) const
+{
+  if (cache.size() <= m_cacheMaxSize) return; // not full
+
+  // find cutoff for last used time
+  priority_queue< clock_t > lastUsedTimes;
+  Cache::iterator iter;
+  for (iter = cache.begin(); iter != cache.end(); ++iter) {
+    lastUsedTimes.push( iter->second.second );
+  }
+  // the queue shrinks while popping, so count the entries to drop first
+  const size_t numToPop = lastUsedTimes.size() - m_cacheMaxSize/2;
+  for( size_t i=0; i < numToPop; i++ )
+    lastUsedTimes.pop();
+  clock_t cutoffLastUsedTime = lastUsedTimes.top();
+
+  // remove all old entries. collections still used by a sentence are pinned
+  iter = cache.begin();
+  while( iter != cache.end() ) {
+    if (iter->second.second < cutoffLastUsedTime) {
+      cache.erase(iter++);
+    } else iter++;
+  }
 }
 
 void PhraseDictionaryDynSuffixArray::insertSnt(string& source, string& target, string& alignment)
 {
-  m_biSA->addSntPair(source, target, alignment); // insert sentence pair into suffix arrays
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_pendingMutex);
+#endif
+    Update update;
+    update.source = source;
+    update.target = target;
+    update.alignment = alignment;
+    m_pending.push_back(update);
+  }
+
+  // the next version gets all the sentence pairs which arrived while the
+  // previous one was built.  If there are none, the one added above is in
+  // a version built meanwhile, which is the latest by now.
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock build(m_buildMutex);
+#endif
+  std::vector<Update> updates;
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_pendingMutex);
+#endif
+    updates.swap(m_pending);
+  }
+  if (updates.empty()) return;
+
+  Timer timer;
+  timer.start();
+  const VersionPtr latest = GetLatestVersion();
+  BilingualDynSuffixArray *biSA = new BilingualDynSuffixArray(*latest->biSA);
+  for (size_t i = 0; i < updates.size(); ++i) {
+    biSA->addSntPair(updates[i].source, updates[i].target, updates[i].alignment); // insert sentence pair into suffix arrays
+  }
+  // the new sentence pairs change the samples and scores of their phrases,
+  // so the new version starts with an empty cache
+  VersionPtr next(new Version(biSA, latest->number + 1));
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_latestMutex);
+#endif
+    m_latest = next;
+  }
+  VERBOSE(1, "Phrase table version " << next->number << " with " << updates.size()
+          << " new sentence pairs built in " << timer.get_elapsed_time() << " seconds" << std::endl);
   //StaticData::Instance().ClearTransOptionCache(); // clear translation option cache 
 }
 void PhraseDictionaryDynSuffixArray::deleteSnt(unsigned /* idx */, unsigned /* num2Del */)
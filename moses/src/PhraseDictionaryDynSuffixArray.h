@@ -2,6 +2,14 @@
 #define moses_PhraseDictionaryDynSuffixArray_h
 
 #include <map>
+#include <ctime>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#endif
 
 #include "PhraseDictionary.h"
 #include "BilingualDynSuffixArray.h"
@@ -9,6 +17,18 @@
 namespace Moses
 {
 
+/** Phrase table sampled from a suffix array of the training corpus, to which
+ * sentence pairs can be added while decoding.
+ *
+ * Each update makes a new version of the suffix arrays, a copy of the latest
+ * one with the new sentence pairs, and the versions are read without locks.
+ * The copy shares with the latest version the chunks of the corpora, suffix
+ * arrays and alignments which the new sentence pairs leave unchanged, so a
+ * version costs memory in proportion to what its update changed.
+ * A sentence is decoded on the version which was the latest when it started;
+ * a version is deleted once it has been replaced and the last sentence
+ * decoded on it has ended.
+ */
 class PhraseDictionaryDynSuffixArray: public PhraseDictionary
 {
 public:
@@ -27,16 +47,62 @@ public:
   const TargetPhraseCollection* GetTargetPhraseCollection(const Phrase& src) const;
   void InitializeForInput(const InputType& i);
   void CleanUp();
+  //! returns once a version with the sentence pair is the latest
   void insertSnt(string&, string&, string&);
   void deleteSnt(unsigned, unsigned);
   ChartRuleLookupManager *CreateRuleLookupManager(const InputType&, const ChartCellCollection&);
 private:
-  BilingualDynSuffixArray *m_biSA;
+  typedef boost::shared_ptr<const TargetPhraseCollection> CollectionPtr;
+  typedef std::map<Phrase, std::pair<CollectionPtr, clock_t> > Cache;
+  typedef std::vector<CollectionPtr> PinnedCollections;
+
+  //! the suffix arrays after some updates, and the phrases scored on them
+  struct Version {
+    Version(BilingualDynSuffixArray *biSA, size_t number) : biSA(biSA), number(number) {}
+    boost::scoped_ptr<BilingualDynSuffixArray> biSA;
+    size_t number;
+    //! scored target phrases of recently looked up source phrases, shared by all threads
+    Cache cache;
+#ifdef WITH_THREADS
+    boost::mutex cacheMutex;
+#endif
+  };
+  typedef boost::shared_ptr<Version> VersionPtr;
+
+  //! what the sentence of a thread uses, until CleanUp()
+  struct SentenceState {
+    VersionPtr version;
+    //! collections handed out to the sentence, so that evicting them from
+    //! the cache can't pull them out from under the decoder
+    PinnedCollections collections;
+  };
+
+  struct Update {
+    string source, target, alignment;
+  };
+
+  void ReduceCache(Cache &cache) const;
+  SentenceState &GetSentenceState() const;
+  VersionPtr GetLatestVersion() const;
+
   std::vector<float> m_weight;
   size_t m_tableLimit;
   const LMList *m_languageModels;
   float m_weightWP;
+  size_t m_cacheMaxSize;
 
+  VersionPtr m_latest;
+  //! sentence pairs waiting for the next version
+  std::vector<Update> m_pending;
+#ifdef WITH_THREADS
+  mutable boost::mutex m_latestMutex;
+  boost::mutex m_pendingMutex;
+  //! held while a version is built, so that one is built at a time
+  boost::mutex m_buildMutex;
+  mutable boost::thread_specific_ptr<SentenceState> m_sentence;
+#else
+  mutable SentenceState m_sentence;
+#endif
 
 };
 
@@ -113,6 +113,16 @@ public:
     }
   }
 
+  //! Add scores from a single ScoreProducer only, from an array of
+  //! as many values as the score components produced by sp
+  void PlusEquals(const ScoreProducer* sp, const float *scores) {
+    size_t i = m_sim->GetBeginIndex(sp->GetScoreBookkeepingID());
+    const size_t end = m_sim->GetEndIndex(sp->GetScoreBookkeepingID());
+    for (; i < end; ++i) {
+      m_scores[i] += *scores++;
+    }
+  }
+
   //! Add scores from a single ScoreProducer only
   //! The length of scores must be equal to the number of score components
   //! produced by sp
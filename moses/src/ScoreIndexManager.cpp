@@ -17,6 +17,20 @@ using namespace std;
 
 void ScoreIndexManager::AddScoreProducer(const ScoreProducer* sp)
 {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(m_mutex);
+  if (m_reservation.get()) {
+    const size_t id = *m_reservation;
+    m_reservation.reset();
+    CHECK(m_producers[id] == NULL);
+    CHECK(m_ends[id] - m_begins[id] == sp->GetNumScoreComponents());
+    const_cast<ScoreProducer*>(sp)->SetScoreBookkeepingID(id);
+    m_producers[id] = sp;
+    VERBOSE(3,"Added ScoreProducer(" << id << " " << sp->GetScoreProducerDescription()
+            << ") index=" << m_begins[id] << "-" << m_ends[id]-1 << std::endl);
+    return;
+  }
+#endif
   // Producers must be inserted in the order they are created
   const_cast<ScoreProducer*>(sp)->CreateScoreBookkeepingID();
   CHECK(m_begins.size() == (sp->GetScoreBookkeepingID()));
@@ -34,6 +48,26 @@ void ScoreIndexManager::AddScoreProducer(const ScoreProducer* sp)
   
 }
 
+#ifdef WITH_THREADS
+size_t ScoreIndexManager::ReserveScoreProducer(size_t numScoreComponents)
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  const size_t id = ScoreProducer::ReserveScoreBookkeepingID();
+  CHECK(m_begins.size() == id);
+  CHECK(numScoreComponents > 0);
+  m_producers.push_back(NULL);
+  m_begins.push_back(m_last);
+  m_last += numScoreComponents;
+  m_ends.push_back(m_last);
+  return id;
+}
+
+void ScoreIndexManager::UseReservation(size_t scoreBookkeepingID)
+{
+  m_reservation.reset(new size_t(scoreBookkeepingID));
+}
+#endif
+
 void ScoreIndexManager::PrintLabeledScores(std::ostream& os, const ScoreComponentCollection& scores) const
 {
   std::vector<float> weights(scores.m_scores.size(), 1.0f);
@@ -11,6 +11,10 @@
 #ifdef HAVE_PROTOBUF
 #include "hypergraph.pb.h"
 #endif
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#endif
 
 namespace Moses
 {
@@ -32,6 +36,14 @@ public:
 
   //! new score producer to manage. Producers must be inserted in the order they are created
   void AddScoreProducer(const ScoreProducer* producer);
+#ifdef WITH_THREADS
+  /** Keep the place of a producer which is created later on another thread,
+   * such as a language model loaded in parallel with the other models.
+   * Returns its score bookkeeping id. */
+  size_t ReserveScoreProducer(size_t numScoreComponents);
+  //! the next producer added by this thread takes the reserved place
+  void UseReservation(size_t scoreBookkeepingID);
+#endif
   void InitFeatureNames();
 
   //! starting score index for a particular score producer with scoreBookkeepingID
@@ -63,6 +75,10 @@ private:
   std::vector<std::string> m_featureNames;
   std::vector<std::string> m_featureShortNames;
   size_t m_last;
+#ifdef WITH_THREADS
+  boost::mutex m_mutex;
+  boost::thread_specific_ptr<size_t> m_reservation;
+#endif
 };
 
 
@@ -45,6 +45,13 @@ public:
   void CreateScoreBookkeepingID()	{
     m_scoreBookkeepingId = s_globalScoreBookkeepingIdCounter++;
   }
+  //! keep an id for a producer which is created later, see ScoreIndexManager::ReserveScoreProducer()
+  static unsigned int ReserveScoreBookkeepingID() {
+    return s_globalScoreBookkeepingIdCounter++;
+  }
+  void SetScoreBookkeepingID(unsigned int id) {
+    m_scoreBookkeepingId = id;
+  }
   //! returns the number of scores that a subclass produces.
   //! For example, a language model conventionally produces 1, a translation table some arbitrary number, etc
   virtual size_t GetNumScoreComponents() const = 0;
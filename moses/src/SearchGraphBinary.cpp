@@ -0,0 +1,292 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <cstdio>
+#include <cstring>
+
+#include "SearchGraphBinary.h"
+#include "util/exception.hh"
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+const char kMagic[] = "MosesSG";
+const char kVersion = 1;
+
+typedef unsigned long long uint64;
+
+void PutVarint(std::string &out, uint64 value)
+{
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+uint64 ZigZag(long long value)
+{
+  return (static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63);
+}
+
+long long UnZigZag(uint64 value)
+{
+  return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+}
+
+void PutSigned(std::string &out, long long value)
+{
+  PutVarint(out, ZigZag(value));
+}
+
+void PutFloat(std::string &out, float value)
+{
+  unsigned int bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (size_t i = 0; i < 4; ++i) {
+    out += static_cast<char>(bits & 0xff);
+    bits >>= 8;
+  }
+}
+
+class Input
+{
+public:
+  Input(const char *begin, const char *end) : m_cur(begin), m_end(end) {}
+
+  uint64 Varint() {
+    uint64 value = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+      UTIL_THROW_IF(m_cur == m_end || shift > 63, util::Exception, "Truncated search graph record");
+      const unsigned char byte = *m_cur++;
+      value |= static_cast<uint64>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+  }
+
+  long long Signed() {
+    return UnZigZag(Varint());
+  }
+
+  float Float() {
+    UTIL_THROW_IF(m_end - m_cur < 4, util::Exception, "Truncated search graph record");
+    unsigned int bits = 0;
+    for (size_t i = 0; i < 4; ++i) {
+      bits |= static_cast<unsigned int>(static_cast<unsigned char>(*m_cur++)) << (8 * i);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  const char *Bytes(size_t length) {
+    UTIL_THROW_IF(static_cast<size_t>(m_end - m_cur) < length, util::Exception, "Truncated search graph record");
+    const char *ret = m_cur;
+    m_cur += length;
+    return ret;
+  }
+
+  bool AtEnd() const {
+    return m_cur == m_end;
+  }
+
+private:
+  const char *m_cur;
+  const char *m_end;
+};
+
+}
+
+void SearchGraphBinary::Clear()
+{
+  translationId = 0;
+  flags = 0;
+  numScores = 0;
+  vocab.clear();
+  edges.clear();
+}
+
+size_t SearchGraphBinaryWriter::AddWord(const std::string &word)
+{
+  std::pair<boost::unordered_map<std::string, size_t>::iterator, bool> ret =
+    m_wordIds.insert(std::make_pair(word, m_graph.vocab.size()));
+  if (ret.second) {
+    m_graph.vocab.push_back(word);
+  }
+  return ret.first->second;
+}
+
+void SearchGraphBinaryWriter::WriteHeader(std::ostream &out)
+{
+  out.write(kMagic, sizeof(kMagic) - 1);
+  out.put(kVersion);
+}
+
+void SearchGraphBinaryWriter::Encode(std::string &out) const
+{
+  const SearchGraphBinary &graph = m_graph;
+  const bool phraseBased = graph.flags & SearchGraphBinary::PhraseBased;
+
+  string record;
+  PutVarint(record, graph.translationId);
+  PutVarint(record, graph.flags);
+  PutVarint(record, graph.numScores);
+  PutVarint(record, graph.vocab.size());
+  for (size_t i = 0; i < graph.vocab.size(); ++i) {
+    PutVarint(record, graph.vocab[i].size());
+    record += graph.vocab[i];
+  }
+
+  PutVarint(record, graph.edges.size());
+  int prevId = 0;
+  for (size_t i = 0; i < graph.edges.size(); ++i) {
+    const SearchGraphBinary::Edge &edge = graph.edges[i];
+    PutSigned(record, edge.id - prevId);
+    prevId = edge.id;
+    if (edge.winner == edge.id) {
+      PutVarint(record, 0);
+    } else {
+      PutVarint(record, 1 + ZigZag(edge.winner - edge.id));
+    }
+    PutVarint(record, edge.start);
+    PutVarint(record, edge.start > edge.end ? 0 : edge.end - edge.start + 1);
+    PutVarint(record, edge.tails.size());
+    for (size_t j = 0; j < edge.tails.size(); ++j) {
+      PutSigned(record, edge.tails[j] - edge.id);
+    }
+    PutFloat(record, edge.score);
+    PutFloat(record, edge.transition);
+    PutVarint(record, edge.words.size());
+    for (size_t j = 0; j < edge.words.size(); ++j) {
+      PutVarint(record, edge.words[j]);
+    }
+    if (phraseBased) {
+      PutVarint(record, edge.stack);
+      PutVarint(record, edge.forward + 1);
+      PutFloat(record, edge.fscore);
+    }
+    for (size_t j = 0; j < graph.numScores; ++j) {
+      PutFloat(record, j < edge.scores.size() ? edge.scores[j] : 0.0f);
+    }
+  }
+
+  PutVarint(out, record.size());
+  out += record;
+}
+
+SearchGraphBinaryReader::SearchGraphBinaryReader(std::istream &in)
+  : m_in(in)
+{
+  char header[sizeof(kMagic)];
+  m_in.read(header, sizeof(header));
+  UTIL_THROW_IF(!m_in || memcmp(header, kMagic, sizeof(kMagic) - 1) != 0,
+                util::Exception, "Not a binary search graph file");
+  UTIL_THROW_IF(header[sizeof(kMagic) - 1] != kVersion, util::Exception,
+                "Unsupported binary search graph version " << static_cast<int>(header[sizeof(kMagic) - 1]));
+}
+
+bool SearchGraphBinaryReader::Read(SearchGraphBinary &graph)
+{
+  // length prefix
+  uint64 length = 0;
+  for (unsigned shift = 0; ; shift += 7) {
+    const int byte = m_in.get();
+    if (byte == EOF) {
+      UTIL_THROW_IF(shift != 0, util::Exception, "Truncated search graph file");
+      return false;
+    }
+    UTIL_THROW_IF(shift > 63, util::Exception, "Broken search graph record length");
+    length |= static_cast<uint64>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) break;
+  }
+
+  m_record.resize(length);
+  if (length) {
+    m_in.read(&m_record[0], length);
+    UTIL_THROW_IF(static_cast<uint64>(m_in.gcount()) != length, util::Exception, "Truncated search graph file");
+  }
+  Decode(m_record.data(), m_record.data() + length, graph);
+  return true;
+}
+
+void SearchGraphBinaryReader::Decode(const char *begin, const char *end, SearchGraphBinary &graph)
+{
+  Input in(begin, end);
+  graph.translationId = in.Varint();
+  graph.flags = in.Varint();
+  graph.numScores = in.Varint();
+  const bool phraseBased = graph.flags & SearchGraphBinary::PhraseBased;
+
+  graph.vocab.resize(in.Varint());
+  for (size_t i = 0; i < graph.vocab.size(); ++i) {
+    const size_t length = in.Varint();
+    graph.vocab[i].assign(in.Bytes(length), length);
+  }
+
+  graph.edges.resize(in.Varint());
+  int prevId = 0;
+  for (size_t i = 0; i < graph.edges.size(); ++i) {
+    SearchGraphBinary::Edge &edge = graph.edges[i];
+    edge.id = prevId + in.Signed();
+    prevId = edge.id;
+    const uint64 winner = in.Varint();
+    if (winner == 0) {
+      edge.winner = edge.id;
+    } else {
+      edge.winner = edge.id + UnZigZag(winner - 1);
+    }
+    edge.start = in.Varint();
+    const size_t width = in.Varint();
+    edge.end = width ? edge.start + width - 1 : edge.start - 1;
+    edge.tails.resize(in.Varint());
+    for (size_t j = 0; j < edge.tails.size(); ++j) {
+      edge.tails[j] = edge.id + in.Signed();
+    }
+    edge.score = in.Float();
+    edge.transition = in.Float();
+    edge.words.resize(in.Varint());
+    for (size_t j = 0; j < edge.words.size(); ++j) {
+      edge.words[j] = in.Varint();
+      UTIL_THROW_IF(edge.words[j] >= graph.vocab.size(), util::Exception, "Word id out of range in search graph record");
+    }
+    if (phraseBased) {
+      edge.stack = in.Varint();
+      edge.forward = static_cast<int>(in.Varint()) - 1;
+      edge.fscore = in.Float();
+    } else {
+      edge.stack = 0;
+      edge.forward = -1;
+      edge.fscore = 0.0f;
+    }
+    edge.scores.resize(graph.numScores);
+    for (size_t j = 0; j < graph.numScores; ++j) {
+      edge.scores[j] = in.Float();
+    }
+  }
+  UTIL_THROW_IF(!in.AtEnd(), util::Exception, "Trailing bytes in search graph record");
+}
+
+}
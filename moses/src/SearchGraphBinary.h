@@ -0,0 +1,130 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_SearchGraphBinary_h
+#define moses_SearchGraphBinary_h
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+namespace Moses
+{
+
+/** Search graph of one sentence as a hypergraph, in the form written by
+ *  -output-search-graph-binary.  There is one edge per hypothesis, winners
+ *  and recombined ones alike; the tails of an edge are the hypotheses it
+ *  extends (one for phrase-based decoding, one per non-terminal for chart
+ *  decoding).  Target words are indices into a vocabulary shared by all
+ *  edges of the sentence.
+ *
+ *  File layout: the header "MosesSG" followed by a version byte, then one
+ *  record per sentence, each prefixed with its length in bytes so readers
+ *  can skip sentences.  Integers are varints (7 bits per byte, low bits
+ *  first), hypothesis ids are stored as zig-zag coded differences to the
+ *  previous edge's id, and floats are 4-byte little-endian IEEE.
+ *
+ *  record   := translationId flags numScores numVocab word* numEdges edge*
+ *  word     := length byte*
+ *  edge     := id winner start width numTails tail* score transition
+ *              numWords wordId* [stack forward fscore] float[numScores]
+ *
+ *  winner is 0 for a winning hypothesis and 1 + the zig-zag difference to
+ *  id otherwise; tails are zig-zag differences to id; width is 0 for edges
+ *  that cover no source words; forward is the id of the best next
+ *  hypothesis plus one (0 for none).  The bracketed fields are present if
+ *  flags has PhraseBased set, the score vector is the change of the score
+ *  breakdown over the tails.
+ */
+struct SearchGraphBinary {
+  enum Flags {
+    PhraseBased = 1
+  };
+
+  struct Edge {
+    int id;
+    int winner; //< id of the winning hypothesis, == id for winners
+    size_t start, end; //< covered source span; start > end if empty
+    std::vector<int> tails;
+    float score;
+    float transition;
+    std::vector<size_t> words;
+    // PhraseBased only
+    size_t stack;
+    int forward;
+    float fscore;
+    std::vector<float> scores;
+  };
+
+  long translationId;
+  unsigned flags;
+  size_t numScores; //< 0 if edges carry no score breakdown
+  std::vector<std::string> vocab;
+  std::vector<Edge> edges;
+
+  SearchGraphBinary() : translationId(0), flags(0), numScores(0) {}
+
+  void Clear();
+};
+
+//! appends one search graph record, without the file header
+class SearchGraphBinaryWriter
+{
+public:
+  explicit SearchGraphBinaryWriter(SearchGraphBinary &graph)
+    : m_graph(graph) {}
+
+  //! index of word in the graph's vocabulary
+  size_t AddWord(const std::string &word);
+
+  static void WriteHeader(std::ostream &out);
+  void Encode(std::string &out) const;
+
+private:
+  SearchGraphBinary &m_graph;
+  boost::unordered_map<std::string, size_t> m_wordIds;
+};
+
+//! reads the records of a file written with -output-search-graph-binary
+class SearchGraphBinaryReader
+{
+public:
+  //! throws util::Exception if the header is missing
+  explicit SearchGraphBinaryReader(std::istream &in);
+
+  //! false at the end of the file; throws util::Exception on a broken record
+  bool Read(SearchGraphBinary &graph);
+
+  //! decode one record, without its length prefix
+  static void Decode(const char *begin, const char *end, SearchGraphBinary &graph);
+
+private:
+  std::istream &m_in;
+  std::string m_record;
+};
+
+}
+
+#endif
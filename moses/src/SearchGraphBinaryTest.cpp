@@ -0,0 +1,206 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+
+#include "SearchGraphBinary.h"
+#include "util/exception.hh"
+
+using namespace Moses;
+
+namespace
+{
+
+SearchGraphBinary::Edge MakeEdge(int id, int winner, size_t start, size_t end, float score)
+{
+  SearchGraphBinary::Edge edge;
+  edge.id = id;
+  edge.winner = winner;
+  edge.start = start;
+  edge.end = end;
+  edge.score = score;
+  edge.transition = score / 2;
+  edge.stack = 0;
+  edge.forward = -1;
+  edge.fscore = 0.0f;
+  return edge;
+}
+
+// a phrase-based lattice: an empty root, two winners, a hypothesis
+// recombined into the second, and one recombined into a later id
+void MakePhraseGraph(SearchGraphBinaryWriter &writer, SearchGraphBinary &graph)
+{
+  graph.translationId = 7;
+  graph.flags = SearchGraphBinary::PhraseBased;
+  graph.numScores = 3;
+
+  SearchGraphBinary::Edge root = MakeEdge(0, 0, 0, size_t(-1), 0.0f);
+  root.forward = 2;
+  root.scores.resize(3, 0.0f);
+  graph.edges.push_back(root);
+
+  SearchGraphBinary::Edge first = MakeEdge(2, 2, 0, 1, -1.25f);
+  first.tails.push_back(0);
+  first.words.push_back(writer.AddWord("das"));
+  first.words.push_back(writer.AddWord("Haus"));
+  first.stack = 2;
+  first.forward = 9;
+  first.fscore = -3.5f;
+  first.scores.push_back(-0.5f);
+  first.scores.push_back(1.0f);
+  first.scores.push_back(-1e-3f);
+  graph.edges.push_back(first);
+
+  SearchGraphBinary::Edge second = MakeEdge(9, 9, 2, 2, -4.75f);
+  second.tails.push_back(2);
+  second.words.push_back(writer.AddWord("ist"));
+  second.stack = 3;
+  second.fscore = -4.75f;
+  second.scores.push_back(-2.0f);
+  second.scores.push_back(0.0f);
+  second.scores.push_back(3.25f);
+  graph.edges.push_back(second);
+
+  SearchGraphBinary::Edge recombined = MakeEdge(5, 9, 2, 2, -6.0f);
+  recombined.tails.push_back(0);
+  recombined.words.push_back(writer.AddWord("Haus"));
+  recombined.words.push_back(writer.AddWord("ist"));
+  recombined.stack = 3;
+  recombined.forward = 9;
+  recombined.fscore = -6.0f;
+  recombined.scores.resize(3, -1.0f);
+  graph.edges.push_back(recombined);
+
+  SearchGraphBinary::Edge ahead = MakeEdge(4, 12, 0, 2, -8.0f);
+  ahead.tails.push_back(2);
+  ahead.stack = 3;
+  ahead.scores.resize(3, 0.5f);
+  graph.edges.push_back(ahead);
+}
+
+// a chart hypergraph, with an edge that has two tails and no scores
+void MakeChartGraph(SearchGraphBinaryWriter &writer, SearchGraphBinary &graph)
+{
+  graph.translationId = 8;
+  graph.flags = 0;
+  graph.numScores = 0;
+
+  SearchGraphBinary::Edge left = MakeEdge(3, 3, 0, 0, -1.0f);
+  left.words.push_back(writer.AddWord("a"));
+  graph.edges.push_back(left);
+  SearchGraphBinary::Edge right = MakeEdge(1, 1, 1, 1, -2.0f);
+  right.words.push_back(writer.AddWord("b"));
+  graph.edges.push_back(right);
+  SearchGraphBinary::Edge top = MakeEdge(6, 6, 0, 1, -3.0f);
+  top.tails.push_back(1);
+  top.tails.push_back(3);
+  top.words.push_back(writer.AddWord("b"));
+  top.words.push_back(writer.AddWord("a"));
+  graph.edges.push_back(top);
+}
+
+void CheckEqual(const SearchGraphBinary &expected, const SearchGraphBinary &actual)
+{
+  BOOST_CHECK_EQUAL(expected.translationId, actual.translationId);
+  BOOST_CHECK_EQUAL(expected.flags, actual.flags);
+  BOOST_CHECK_EQUAL(expected.numScores, actual.numScores);
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.vocab.begin(), expected.vocab.end(),
+                                actual.vocab.begin(), actual.vocab.end());
+  BOOST_REQUIRE_EQUAL(expected.edges.size(), actual.edges.size());
+  for (size_t i = 0; i < expected.edges.size(); ++i) {
+    const SearchGraphBinary::Edge &e = expected.edges[i], &a = actual.edges[i];
+    BOOST_CHECK_EQUAL(e.id, a.id);
+    BOOST_CHECK_EQUAL(e.winner, a.winner);
+    BOOST_CHECK_EQUAL(e.start, a.start);
+    BOOST_CHECK_EQUAL(e.end, a.end);
+    BOOST_CHECK_EQUAL_COLLECTIONS(e.tails.begin(), e.tails.end(), a.tails.begin(), a.tails.end());
+    BOOST_CHECK_EQUAL(e.score, a.score);
+    BOOST_CHECK_EQUAL(e.transition, a.transition);
+    BOOST_CHECK_EQUAL_COLLECTIONS(e.words.begin(), e.words.end(), a.words.begin(), a.words.end());
+    BOOST_CHECK_EQUAL(e.stack, a.stack);
+    BOOST_CHECK_EQUAL(e.forward, a.forward);
+    BOOST_CHECK_EQUAL(e.fscore, a.fscore);
+    BOOST_CHECK_EQUAL_COLLECTIONS(e.scores.begin(), e.scores.end(), a.scores.begin(), a.scores.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SearchGraphBinaryRoundTrip)
+{
+  SearchGraphBinary phrase, chart;
+  SearchGraphBinaryWriter phraseWriter(phrase), chartWriter(chart);
+  MakePhraseGraph(phraseWriter, phrase);
+  MakeChartGraph(chartWriter, chart);
+  BOOST_CHECK_EQUAL(3u, phrase.vocab.size());
+
+  std::string records;
+  phraseWriter.Encode(records);
+  chartWriter.Encode(records);
+  std::ostringstream file;
+  SearchGraphBinaryWriter::WriteHeader(file);
+  file << records;
+
+  // read as printSearchGraphBinary does
+  std::istringstream in(file.str());
+  SearchGraphBinaryReader reader(in);
+  SearchGraphBinary graph;
+  BOOST_REQUIRE(reader.Read(graph));
+  CheckEqual(phrase, graph);
+  BOOST_REQUIRE(reader.Read(graph));
+  CheckEqual(chart, graph);
+  BOOST_CHECK(!reader.Read(graph));
+}
+
+BOOST_AUTO_TEST_CASE(SearchGraphBinaryBrokenFiles)
+{
+  SearchGraphBinary phrase;
+  SearchGraphBinaryWriter writer(phrase);
+  MakePhraseGraph(writer, phrase);
+  std::ostringstream header;
+  SearchGraphBinaryWriter::WriteHeader(header);
+  std::string record;
+  writer.Encode(record);
+
+  std::istringstream notGraph("MosesXX" + record);
+  BOOST_CHECK_THROW(SearchGraphBinaryReader reader(notGraph), util::Exception);
+
+  SearchGraphBinary graph;
+  {
+    std::istringstream in(header.str() + record.substr(0, record.size() - 1));
+    SearchGraphBinaryReader reader(in);
+    BOOST_CHECK_THROW(reader.Read(graph), util::Exception);
+  }
+  // the record without its length prefix, shortened or with a byte too many
+  size_t prefix = 0;
+  while (record[prefix++] & 0x80) {}
+  const std::string body = record.substr(prefix);
+  SearchGraphBinaryReader::Decode(body.data(), body.data() + body.size(), graph);
+  CheckEqual(phrase, graph);
+  BOOST_CHECK_THROW(SearchGraphBinaryReader::Decode(body.data(), body.data() + body.size() - 1, graph),
+                    util::Exception);
+  const std::string longer = body + '\0';
+  BOOST_CHECK_THROW(SearchGraphBinaryReader::Decode(longer.data(), longer.data() + longer.size(), graph),
+                    util::Exception);
+}
+
+}
@@ -20,8 +20,12 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 ***********************************************************************/
 
+#include <algorithm>
 #include <string>
 #include <iostream>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 #include "SquareMatrix.h"
 #include "TypeDef.h"
 #include "Util.h"
@@ -31,6 +35,53 @@ using namespace std;
 namespace Moses
 {
 
+namespace
+{
+
+//! the best of best and left[k] + right[k] for k < length
+inline float MaxJoinedScore(const float *left, const float *right, size_t length, float best)
+{
+  size_t k = 0;
+#ifdef __SSE__
+  if (length >= 4) {
+    __m128 bestVec = _mm_set1_ps(best);
+    for (; k + 4 <= length; k += 4) {
+      bestVec = _mm_max_ps(bestVec, _mm_add_ps(_mm_loadu_ps(left + k), _mm_loadu_ps(right + k)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, bestVec);
+    best = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+  }
+#endif
+  for (; k < length; ++k) {
+    const float joined = left[k] + right[k];
+    if (joined > best) best = joined;
+  }
+  return best;
+}
+
+}
+
+/**
+ * Fill the strictly upper triangle by increasing span width, like in chart
+ * parsing: [startPos, endPos] may be covered by [startPos, joinAt] and
+ * [joinAt+1, endPos] for any startPos <= joinAt < endPos.  The first are in
+ * the row of startPos and the second in the column of endPos, both in order
+ * of joinAt, so the maximum over joinAt is taken four at a time with SSE.
+ */
+void SquareMatrix::CalcJoinedScores()
+{
+  for (size_t width = 1; width < m_size; ++width) {
+    for (size_t startPos = 0; startPos + width < m_size; ++startPos) {
+      const size_t endPos = startPos + width;
+      const float best = MaxJoinedScore(m_array + RowIndex(startPos, startPos)
+                                        , m_columns + ColumnIndex(startPos + 1, endPos)
+                                        , width, GetScore(startPos, endPos));
+      SetScore(startPos, endPos, best);
+    }
+  }
+}
+
 /**
  * Calculare future score estimate for a given coverage bitmap
  *
@@ -39,25 +90,14 @@ namespace Moses
 
 float SquareMatrix::CalcFutureScore( WordsBitmap const &bitmap ) const
 {
-  const size_t notInGap= numeric_limits<size_t>::max();
-  size_t startGap = notInGap;
+  // the gaps from left to right, found a block of the bitmap at a time
   float futureScore = 0.0f;
-  for(size_t currPos = 0 ; currPos < bitmap.GetSize() ; currPos++) {
-    // start of a new gap?
-    if(bitmap.GetValue(currPos) == false && startGap == notInGap) {
-      startGap = currPos;
-    }
-    // end of a gap?
-    else if(bitmap.GetValue(currPos) == true && startGap != notInGap) {
-      futureScore += GetScore(startGap, currPos - 1);
-      startGap = notInGap;
-    }
-  }
-  // coverage ending with gap?
-  if (startGap != notInGap) {
-    futureScore += GetScore(startGap, bitmap.GetSize() - 1);
+  size_t startGap = bitmap.GetFirstGapPos();
+  while (startGap != NOT_FOUND) {
+    const size_t endGap = bitmap.GetEdgeToTheRightOf(startGap);
+    futureScore += GetScore(startGap, endGap);
+    startGap = bitmap.GetNextGapPos(endGap + 1);
   }
-
   return futureScore;
 }
 
@@ -30,21 +30,36 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 namespace Moses
 {
 
-//! A square array of floats to store future costs
+/** The future costs of the spans of a sentence, an upper triangular matrix.
+ *  The cells are packed twice into one contiguous array: by start position,
+ *  then by end position.  The scores of the spans starting at a position and
+ *  of those ending at one are then both contiguous, for the loop over split
+ *  points in CalcJoinedScores().
+ */
 class SquareMatrix
 {
   friend std::ostream& operator<<(std::ostream &out, const SquareMatrix &matrix);
 protected:
   const size_t m_size; /**< length of the square (sentence length) */
-  float *m_array; /**< two-dimensional array to store floats */
+  float *m_array; /**< the rows of the upper triangle, each from the diagonal on */
+  float *m_columns; /**< its columns, each down to the diagonal, after the rows */
 
   SquareMatrix(); // not implemented
   SquareMatrix(const SquareMatrix &copy); // not implemented
 
+  inline size_t RowIndex(size_t startPos, size_t endPos) const {
+    return startPos * (2 * m_size - startPos + 1) / 2 + endPos - startPos;
+  }
+  inline size_t ColumnIndex(size_t startPos, size_t endPos) const {
+    return endPos * (endPos + 1) / 2 + startPos;
+  }
+
 public:
   SquareMatrix(size_t size)
     :m_size(size) {
-    m_array = (float*) malloc(sizeof(float) * size * size);
+    const size_t cells = size * (size + 1) / 2;
+    m_array = (float*) malloc(sizeof(float) * 2 * cells);
+    m_columns = m_array + cells;
   }
   ~SquareMatrix() {
     free(m_array);
@@ -53,14 +68,19 @@ public:
   inline size_t GetSize() const {
     return m_size;
   }
-  /** Get a future cost score for a span */
+  /** Get a future cost score for a span, startPos <= endPos */
   inline float GetScore(size_t startPos, size_t endPos) const {
-    return m_array[startPos * m_size + endPos];
+    return m_array[RowIndex(startPos, endPos)];
   }
-  /** Set a future cost score for a span */
+  /** Set a future cost score for a span, startPos <= endPos */
   inline void SetScore(size_t startPos, size_t endPos, float value) {
-    m_array[startPos * m_size + endPos] = value;
+    m_array[RowIndex(startPos, endPos)] = value;
+    m_columns[ColumnIndex(startPos, endPos)] = value;
   }
+  /** Set each span's score to the best of its own and the sums of the scores of
+   *  two smaller spans joined, so that it is the best way to cover the span */
+  void CalcJoinedScores();
+
   float CalcFutureScore( WordsBitmap const& ) const;
   float CalcFutureScore( WordsBitmap const&, size_t startPos, size_t endPos ) const;
 
@@ -70,7 +90,7 @@ public:
 inline std::ostream& operator<<(std::ostream &out, const SquareMatrix &matrix)
 {
   for (size_t endPos = 0 ; endPos < matrix.GetSize() ; endPos++) {
-    for (size_t startPos = 0 ; startPos < matrix.GetSize() ; startPos++)
+    for (size_t startPos = 0 ; startPos <= endPos ; startPos++)
       out << matrix.GetScore(startPos, endPos) << " ";
     out << std::endl;
   }
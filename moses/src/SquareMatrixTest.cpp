@@ -0,0 +1,144 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "SquareMatrix.h"
+#include "WordsBitmap.h"
+
+using namespace Moses;
+
+namespace
+{
+
+// the scores of the spans as they were before CalcJoinedScores, by rows
+typedef std::vector<std::vector<float> > Reference;
+
+// span scores, some of them without any translation option
+void Fill(SquareMatrix &matrix, Reference &ref)
+{
+  const size_t size = matrix.GetSize();
+  ref.assign(size, std::vector<float>(size, 0.0f));
+  for (size_t startPos = 0; startPos < size; ++startPos) {
+    for (size_t endPos = startPos; endPos < size; ++endPos) {
+      const float score = rand() % 5 == 0 ? -std::numeric_limits<float>::infinity()
+                          : -(rand() % 100000) / 997.0f;
+      matrix.SetScore(startPos, endPos, score);
+      ref[startPos][endPos] = score;
+    }
+  }
+}
+
+// the loop of TranslationOptionCollection::CalcFutureScore that CalcJoinedScores replaces
+void JoinScores(Reference &ref)
+{
+  const size_t size = ref.size();
+  for(size_t colstart = 1; colstart < size ; colstart++) {
+    for(size_t diagshift = 0; diagshift < size-colstart ; diagshift++) {
+      size_t startPos = diagshift;
+      size_t endPos = colstart+diagshift;
+      for(size_t joinAt = startPos; joinAt < endPos ; joinAt++)  {
+        float joinedScore = ref[startPos][joinAt] + ref[joinAt+1][endPos];
+        if (joinedScore > ref[startPos][endPos])
+          ref[startPos][endPos] = joinedScore;
+      }
+    }
+  }
+}
+
+// the future score as it was computed, word by word
+float FutureScore(const Reference &ref, const WordsBitmap &bitmap)
+{
+  const size_t notInGap= std::numeric_limits<size_t>::max();
+  size_t startGap = notInGap;
+  float futureScore = 0.0f;
+  for(size_t currPos = 0 ; currPos < bitmap.GetSize() ; currPos++) {
+    if(bitmap.GetValue(currPos) == false && startGap == notInGap) {
+      startGap = currPos;
+    } else if(bitmap.GetValue(currPos) == true && startGap != notInGap) {
+      futureScore += ref[startGap][currPos - 1];
+      startGap = notInGap;
+    }
+  }
+  if (startGap != notInGap) {
+    futureScore += ref[startGap][bitmap.GetSize() - 1];
+  }
+  return futureScore;
+}
+
+// sizes around the SSE width and the bitmap block boundaries
+const size_t kSizes[] = {1, 2, 3, 4, 5, 8, 13, 63, 64, 65, 130};
+
+BOOST_AUTO_TEST_CASE(JoinedScoresMatchTheLoop)
+{
+  srand(2);
+  for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+    SquareMatrix matrix(kSizes[s]);
+    Reference ref;
+    Fill(matrix, ref);
+    matrix.CalcJoinedScores();
+    JoinScores(ref);
+    for (size_t startPos = 0; startPos < kSizes[s]; ++startPos) {
+      for (size_t endPos = startPos; endPos < kSizes[s]; ++endPos) {
+        BOOST_REQUIRE_EQUAL(ref[startPos][endPos], matrix.GetScore(startPos, endPos));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FutureScoreIsExact)
+{
+  srand(3);
+  for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+    const size_t size = kSizes[s];
+    SquareMatrix matrix(size);
+    Reference ref;
+    Fill(matrix, ref);
+    matrix.CalcJoinedScores();
+    JoinScores(ref);
+
+    // cover the sentence phrase by phrase, as the search does
+    for (size_t run = 0; run < 20; ++run) {
+      WordsBitmap bitmap(size);
+      while (!bitmap.IsComplete()) {
+        const size_t gap = bitmap.GetFirstGapPos() + rand() % (size - bitmap.GetFirstGapPos());
+        if (bitmap.GetValue(gap)) continue;
+        const size_t startPos = gap;
+        const size_t endPos = startPos + rand() % (bitmap.GetEdgeToTheRightOf(startPos) - startPos + 1);
+
+        const float expected = FutureScore(ref, bitmap);
+        BOOST_REQUIRE_EQUAL(expected, matrix.CalcFutureScore(bitmap));
+
+        WordsBitmap next(bitmap);
+        next.SetValue(startPos, endPos, true);
+        BOOST_REQUIRE_EQUAL(FutureScore(ref, next), matrix.CalcFutureScore(bitmap, startPos, endPos));
+        bitmap.SetValue(startPos, endPos, true);
+      }
+      BOOST_REQUIRE_EQUAL(0.0f, matrix.CalcFutureScore(bitmap));
+    }
+  }
+}
+
+}
@@ -40,11 +40,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "TranslationOption.h"
 #include "DecodeGraph.h"
 #include "InputFileStream.h"
+#include "ModelLoader.h"
 
 #ifdef HAVE_SYNLM
 #include "SyntacticLanguageModel.h"
 #endif
 
+#include <boost/bind.hpp>
+
 #ifdef WITH_THREADS
 #include <boost/thread.hpp>
 #endif
@@ -71,6 +74,60 @@ static size_t CalcMax(size_t x, const vector<size_t>& y, const vector<size_t>& z
   return max;
 }
 
+//! a language model to load, and its place in the list of language models
+struct LanguageModelLoad {
+  LMImplementation implementation;
+  vector<FactorType> factorTypes;
+  size_t nGramOrder;
+  string filePath;
+  int dub;
+  size_t position;
+  // a copy of the model at this position, once that load is done
+  bool copy;
+  size_t copyOf, copyOfLoad;
+  // the score bookkeeping id kept for it, when loading in parallel
+  bool reserved;
+  size_t reservation;
+};
+
+static bool LoadLanguageModel(ModelLoader &loader, const LanguageModelLoad &load
+                              , ScoreIndexManager &scoreIndexManager
+                              , vector<LanguageModel*> &languageModels)
+{
+#ifdef WITH_THREADS
+  if (load.reserved) {
+    scoreIndexManager.UseReservation(load.reservation);
+  }
+#endif
+  LanguageModel *lm;
+  if (load.copy) {
+    if (!loader.Wait(vector<size_t>(1, load.copyOfLoad))) return false;
+    lm = languageModels[load.copyOf]->Duplicate(scoreIndexManager);
+  } else {
+    IFVERBOSE(1)
+    PrintUserTime(string("Start loading LanguageModel ") + load.filePath);
+    lm = LanguageModelFactory::CreateLanguageModel(
+           load.implementation
+           , load.factorTypes
+           , load.nGramOrder
+           , load.filePath
+           , scoreIndexManager
+           , load.dub);
+    if (lm == NULL) {
+      UserMessage::Add("no LM created. We probably don't have it compiled");
+      return false;
+    }
+  }
+  languageModels[load.position] = lm;
+  return true;
+}
+
+static bool InitDictionary(PhraseDictionaryFeature *phraseDictionary, const TranslationSystem *system)
+{
+  phraseDictionary->InitDictionary(system);
+  return true;
+}
+
 StaticData StaticData::s_instance;
 
 StaticData::StaticData()
@@ -218,6 +275,15 @@ bool StaticData::LoadData(Parameter *parameter)
     m_outputSearchGraphExtended = true;
   } else
     m_outputSearchGraph = false;
+  // ... in binary format
+  if (m_parameter->GetParam("output-search-graph-binary").size() > 0) {
+    if (m_parameter->GetParam("output-search-graph-binary").size() != 1) {
+      UserMessage::Add(string("ERROR: wrong format for switch -output-search-graph-binary file"));
+      return false;
+    }
+    m_outputSearchGraphBinary = true;
+  } else
+    m_outputSearchGraphBinary = false;
 #ifdef HAVE_PROTOBUF
   if (m_parameter->GetParam("output-search-graph-pb").size() > 0) {
     if (m_parameter->GetParam("output-search-graph-pb").size() != 1) {
@@ -345,6 +411,8 @@ bool StaticData::LoadData(Parameter *parameter)
   m_maxNoPartTransOpt = (m_parameter->GetParam("max-partial-trans-opt").size() > 0)
                         ? Scan<size_t>(m_parameter->GetParam("max-partial-trans-opt")[0]) : DEFAULT_MAX_PART_TRANS_OPT_SIZE;
 
+  SetBooleanParameter( &m_lazyPartialTransOpt, "lazy-partial-trans-opt", false );
+
   m_maxPhraseLength = (m_parameter->GetParam("max-phrase-length").size() > 0)
                       ? Scan<size_t>(m_parameter->GetParam("max-phrase-length")[0]) : DEFAULT_MAX_PHRASE_LENGTH;
 
@@ -367,6 +435,15 @@ bool StaticData::LoadData(Parameter *parameter)
               Scan<size_t>(m_parameter->GetParam("mbr-size")[0]) : 200;
   m_mbrScale = (m_parameter->GetParam("mbr-scale").size() > 0) ?
                Scan<float>(m_parameter->GetParam("mbr-scale")[0]) : 1.0f;
+  SetBooleanParameter( &m_mbrExpectedBleu, "mbr-expected-bleu", false );
+  m_mbrThreads = (m_parameter->GetParam("mbr-threads").size() > 0) ?
+                 Scan<size_t>(m_parameter->GetParam("mbr-threads")[0]) : 1;
+#ifndef WITH_THREADS
+  if (m_mbrThreads > 1) {
+    UserMessage::Add("Error: mbr-threads > 1 but moses not built with thread support");
+    return false;
+  }
+#endif
 
   //lattice mbr
   SetBooleanParameter( &m_useLatticeMBR, "lminimum-bayes-risk", false );
@@ -434,6 +511,29 @@ bool StaticData::LoadData(Parameter *parameter)
     }
   }
 
+  SetBooleanParameter( &m_parallelLoad, "parallel-load", false );
+#ifndef WITH_THREADS
+  if (m_parallelLoad) {
+    UserMessage::Add("Error: parallel-load specified but moses not built with thread support");
+    return false;
+  }
+#endif
+
+  m_processCount = (m_parameter->GetParam("processes").size() > 0) ?
+                   Scan<int>(m_parameter->GetParam("processes")[0]) : 1;
+  if (m_processCount < 1) {
+    UserMessage::Add("Specify at least one process.");
+    return false;
+  }
+#ifndef WITH_THREADS
+  // the outputs of the processes are collected by threads
+  if (m_processCount > 1) {
+    UserMessage::Add("Error: processes > 1 but moses not built with thread support");
+    return false;
+  }
+#endif
+  SetBooleanParameter( &m_pinProcesses, "pin-processes", false );
+
   m_startTranslationId = (m_parameter->GetParam("start-translation-id").size() > 0) ?
           Scan<long>(m_parameter->GetParam("start-translation-id")[0]) : 0;
 
@@ -499,9 +599,24 @@ bool StaticData::LoadData(Parameter *parameter)
 	}
 #endif
 	
-  if (!LoadLexicalReorderingModel()) return false;
-  if (!LoadLanguageModels()) return false;
-  if (!LoadGenerationTables()) return false;
+  // The models are created in the order of the configuration, which is the
+  // order of their scores.  Their tables may be loaded on threads of their own.
+  vector<LanguageModel*> languageModels;
+  vector<size_t> languageModelLoads;
+  ModelLoader loader(m_parallelLoad);
+  if (!LoadLexicalReorderingModel(loader)) return false;
+  if (!LoadLanguageModels(loader, languageModels, languageModelLoads)) return false;
+  if (!LoadGenerationTables(loader)) return false;
+
+  // phrase tables need the language models to estimate the cost of their phrases
+  if (!loader.Wait(languageModelLoads)) return false;
+  for (size_t i = 0; i < languageModels.size(); ++i) {
+    m_languageModel.Add(languageModels[i]);
+  }
+  m_fLMsLoaded = true;
+  IFVERBOSE(1)
+  PrintUserTime("Finished loading LanguageModels");
+
   if (!LoadPhraseTables()) return false;
   if (!LoadGlobalLexicalModel()) return false;
   if (!LoadDecodeGraphs()) return false;
@@ -529,6 +644,7 @@ bool StaticData::LoadData(Parameter *parameter)
     }
   }
 
+  set<const PhraseDictionaryFeature*> phraseDictionariesLoaded;
   for (size_t i = 0; i < tsConfig.size(); ++i) {
     vector<string> config = Tokenize(tsConfig[i]);
     if (config.size() % 2 != 1) {
@@ -581,8 +697,16 @@ bool StaticData::LoadData(Parameter *parameter)
         return false;
       }
     }
-    //Instigate dictionary loading
-    m_translationSystems.find(config[0])->second.ConfigDictionaries();
+    //Instigate dictionary loading, once for each phrase table
+    TranslationSystem &system = m_translationSystems.find(config[0])->second;
+    system.ConfigDictionaries();
+    const vector<PhraseDictionaryFeature*> &phraseDictionaries = system.GetPhraseDictionaries();
+    for (size_t j = 0; j < phraseDictionaries.size(); ++j) {
+      if (phraseDictionariesLoaded.insert(phraseDictionaries[j]).second) {
+        loader.Add("phrase table " + phraseDictionaries[j]->GetFilePath()
+                   , boost::bind(&InitDictionary, phraseDictionaries[j], &system));
+      }
+    }
 
 
 
@@ -595,6 +719,7 @@ bool StaticData::LoadData(Parameter *parameter)
   }
 
 
+  if (!loader.WaitAll()) return false;
   m_scoreIndexManager.InitFeatureNames();
 
   return true;
@@ -704,7 +829,7 @@ StaticData::~StaticData()
   }
 #endif
 
-bool StaticData::LoadLexicalReorderingModel()
+bool StaticData::LoadLexicalReorderingModel(ModelLoader &loader)
 {
   VERBOSE(1, "Loading lexical distortion models...");
   const vector<string> fileStr    = m_parameter->GetParam("distortion-file");
@@ -771,7 +896,9 @@ bool StaticData::LoadLexicalReorderingModel()
 
     string filePath = spec[3];
 
-    m_reorderModels.push_back(new LexicalReordering(input, output, modelType, filePath, mweights));
+    m_reorderModels.push_back(new LexicalReordering(input, output, modelType, mweights));
+    loader.Add("reordering table " + filePath
+               , boost::bind(&LexicalReordering::Load, m_reorderModels.back(), filePath));
   }
   return true;
 }
@@ -805,7 +932,7 @@ bool StaticData::LoadGlobalLexicalModel()
   return true;
 }
 
-bool StaticData::LoadLanguageModels()
+bool StaticData::LoadLanguageModels(ModelLoader &loader, vector<LanguageModel*> &languageModels, vector<size_t> &loads)
 {
   if (m_parameter->GetParam("lmodel-file").size() > 0) {
     // weights
@@ -825,12 +952,18 @@ bool StaticData::LoadLanguageModels()
     // initialize n-gram order for each factor. populated only by factored lm
     const vector<string> &lmVector = m_parameter->GetParam("lmodel-file");
     //prevent language models from being loaded twice
-    map<string,LanguageModel*> languageModelsLoaded;
+    map<string,size_t> languageModelsLoaded;
 
+    languageModels.resize(lmVector.size(), NULL);
     for(size_t i=0; i<lmVector.size(); i++) {
-      LanguageModel* lm = NULL;
+      LanguageModelLoad load;
+      load.position = i;
+      load.copy = false;
+      load.reserved = false;
       if (languageModelsLoaded.find(lmVector[i]) != languageModelsLoaded.end()) {
-        lm = languageModelsLoaded[lmVector[i]]->Duplicate(m_scoreIndexManager); 
+        load.copy = true;
+        load.copyOf = languageModelsLoaded[lmVector[i]];
+        load.copyOfLoad = loads[load.copyOf];
       } else {
         vector<string>	token		= Tokenize(lmVector[i]);
         if (token.size() != 4 && token.size() != 5 ) {
@@ -838,52 +971,43 @@ bool StaticData::LoadLanguageModels()
           return false;
         }
         // type = implementation, SRI, IRST etc
-        LMImplementation lmImplementation = static_cast<LMImplementation>(Scan<int>(token[0]));
+        load.implementation = static_cast<LMImplementation>(Scan<int>(token[0]));
 
         // factorType = 0 = Surface, 1 = POS, 2 = Stem, 3 = Morphology, etc
-        vector<FactorType> 	factorTypes		= Tokenize<FactorType>(token[1], ",");
+        load.factorTypes = Tokenize<FactorType>(token[1], ",");
 
         // nGramOrder = 2 = bigram, 3 = trigram, etc
-        size_t nGramOrder = Scan<int>(token[2]);
+        load.nGramOrder = Scan<int>(token[2]);
 
-        string &languageModelFile = token[3];
+        load.filePath = token[3];
         if (token.size() == 5) {
-          if (lmImplementation==IRST)
-            languageModelFile += " " + token[4];
+          if (load.implementation==IRST)
+            load.filePath += " " + token[4];
           else {
             UserMessage::Add("Expected format 'LM-TYPE FACTOR-TYPE NGRAM-ORDER filePath [mapFilePath (only for IRSTLM)]'");
             return false;
           }
         }
-        IFVERBOSE(1)
-        PrintUserTime(string("Start loading LanguageModel ") + languageModelFile);
-
-        lm = LanguageModelFactory::CreateLanguageModel(
-               lmImplementation
-               , factorTypes
-               , nGramOrder
-               , languageModelFile
-               , m_scoreIndexManager
-               , LMdub[i]);
-        if (lm == NULL) {
-          UserMessage::Add("no LM created. We probably don't have it compiled");
-          return false;
-        }
-        languageModelsLoaded[lmVector[i]] = lm;
+        load.dub = LMdub[i];
+        languageModelsLoaded[lmVector[i]] = i;
       }
-
-      m_languageModel.Add(lm);
+#ifdef WITH_THREADS
+      // keep the place of its scores, as the models which follow are created
+      // before it is loaded.  It has as many as LanguageModel::GetNumScoreComponents()
+      if (m_parallelLoad) {
+        load.reserved = true;
+        load.reservation = m_scoreIndexManager.ReserveScoreProducer(m_lmEnableOOVFeature ? 2 : 1);
+      }
+#endif
+      loads.push_back(loader.Add("language model " + lmVector[i]
+                                 , boost::bind(&LoadLanguageModel, boost::ref(loader), load
+                                               , boost::ref(m_scoreIndexManager), boost::ref(languageModels))));
     }
   }
-  // flag indicating that language models were loaded,
-  // since phrase table loading requires their presence
-  m_fLMsLoaded = true;
-  IFVERBOSE(1)
-  PrintUserTime("Finished loading LanguageModels");
   return true;
 }
 
-bool StaticData::LoadGenerationTables()
+bool StaticData::LoadGenerationTables(ModelLoader &loader)
 {
   if (m_parameter->GetParam("generation-file").size() > 0) {
     const vector<string> &generationVector = m_parameter->GetParam("generation-file");
@@ -917,10 +1041,8 @@ bool StaticData::LoadGenerationTables()
 
       m_generationDictionary.push_back(new GenerationDictionary(numFeatures, m_scoreIndexManager, input,output));
       CHECK(m_generationDictionary.back() && "could not create GenerationDictionary");
-      if (!m_generationDictionary.back()->Load(filePath, Output)) {
-        delete m_generationDictionary.back();
-        return false;
-      }
+      loader.Add("generation table " + filePath
+                 , boost::bind(&GenerationDictionary::Load, m_generationDictionary.back(), filePath, Output));
       for(size_t i = 0; i < numFeatures; i++) {
         CHECK(currWeightNum < weight.size());
         m_allWeights.push_back(weight[currWeightNum++]);
@@ -1300,7 +1422,9 @@ void StaticData::ReduceTransOptCache() const
     lastUsedTimes.push( iter->second.second );
     iter++;
   }
-  for( size_t i=0; i < lastUsedTimes.size()-m_transOptCacheMaxSize/2; i++ )
+  // the queue shrinks while popping, so count the entries to drop first
+  const size_t numToPop = lastUsedTimes.size() - m_transOptCacheMaxSize/2;
+  for( size_t i=0; i < numToPop; i++ )
     lastUsedTimes.pop();
   clock_t cutoffLastUsedTime = lastUsedTimes.top();
 
@@ -58,6 +58,7 @@ namespace Moses
 class InputType;
 class LexicalReordering;
 class GlobalLexicalModel;
+class ModelLoader;
 class PhraseDictionaryFeature;
 class GenerationDictionary;
 class DistortionScoreProducer;
@@ -165,6 +166,8 @@ protected:
   bool m_useConsensusDecoding; //! Use Consensus decoding  (DeNero et al 2009)
   size_t m_mbrSize; //! number of translation candidates considered
   float m_mbrScale; //! scaling factor for computing marginal probability of candidate translation
+  bool m_mbrExpectedBleu; //! score MBR candidates against expected n-gram counts
+  size_t m_mbrThreads; //! number of threads for pairwise MBR
   size_t m_lmbrPruning; //! average number of nodes per word wanted in pruned lattice
   std::vector<float> m_lmbrThetas; //! theta(s) for lattice mbr calculation
   bool m_useLatticeHypSetForLatticeMBR; //! to use nbest as hypothesis set during lattice MBR
@@ -179,6 +182,7 @@ protected:
   size_t m_timeout_threshold; //! seconds after which time out is activated
 
   bool m_useTransOptCache; //! flag indicating, if the persistent translation option cache should be used
+  bool m_lazyPartialTransOpt; //! create the partial translation options of mapping steps best first
   mutable std::map<std::pair<size_t, Phrase>, std::pair<TranslationOptionList*,clock_t> > m_transOptCache; //! persistent translation option cache
   size_t m_transOptCacheMaxSize; //! maximum size for persistent translation option cache
   //FIXME: Single lock for cache not most efficient. However using a
@@ -192,6 +196,7 @@ protected:
   bool m_outputWordGraph; //! whether to output word graph
   bool m_outputSearchGraph; //! whether to output search graph
   bool m_outputSearchGraphExtended; //! ... in extended format
+  bool m_outputSearchGraphBinary; //! ... in binary format, see SearchGraphBinary.h
 #ifdef HAVE_PROTOBUF
   bool m_outputSearchGraphPB; //! whether to output search graph as a protobuf
 #endif
@@ -211,6 +216,9 @@ protected:
   WordAlignmentSort m_wordAlignmentSort;
 
   int m_threadCount;
+  bool m_parallelLoad;
+  int m_processCount;
+  bool m_pinProcesses;
   long m_startTranslationId;
   
   StaticData();
@@ -221,8 +229,8 @@ protected:
 
   //! helper fn to set bool param from ini file/command line
   void SetBooleanParameter(bool *paramter, std::string parameterName, bool defaultValue);
-  //! load all language models as specified in ini file
-  bool LoadLanguageModels();
+  //! load all language models as specified in ini file, into languageModels once the loads are done
+  bool LoadLanguageModels(ModelLoader &loader, std::vector<LanguageModel*> &languageModels, std::vector<size_t> &loads);
 #ifdef HAVE_SYNLM
   //! load syntactic language model
 	bool LoadSyntacticLanguageModel();
@@ -230,10 +238,10 @@ protected:
   //! load not only the main phrase table but also any auxiliary tables that depend on which features are being used (e.g., word-deletion, word-insertion tables)
   bool LoadPhraseTables();
   //! load all generation tables as specified in ini file
-  bool LoadGenerationTables();
+  bool LoadGenerationTables(ModelLoader &loader);
   //! load decoding steps
   bool LoadDecodeGraphs();
-  bool LoadLexicalReorderingModel();
+  bool LoadLexicalReorderingModel(ModelLoader &loader);
   bool LoadGlobalLexicalModel();
   void ReduceTransOptCache() const;
   bool m_continuePartialTranslation;
@@ -294,6 +302,12 @@ public:
   inline size_t GetMaxNoPartTransOpt() const {
     return m_maxNoPartTransOpt;
   }
+  inline bool IsLazyPartialTransOpt() const {
+    return m_lazyPartialTransOpt;
+  }
+  void SetLazyPartialTransOpt(bool lazy) {
+    m_lazyPartialTransOpt = lazy;
+  }
   inline const Phrase* GetConstrainingPhrase(long sentenceID) const {
     std::map<long,Phrase>::const_iterator iter = m_constraints.find(sentenceID);
     if (iter != m_constraints.end()) {
@@ -410,7 +424,7 @@ public:
     return m_nBestFilePath;
   }
   bool IsNBestEnabled() const {
-    return (!m_nBestFilePath.empty()) || m_mbr || m_useLatticeMBR || m_outputSearchGraph || m_useConsensusDecoding || !m_latticeSamplesFilePath.empty()
+    return (!m_nBestFilePath.empty()) || m_mbr || m_useLatticeMBR || m_outputSearchGraph || m_outputSearchGraphBinary || m_useConsensusDecoding || !m_latticeSamplesFilePath.empty()
 #ifdef HAVE_PROTOBUF
            || m_outputSearchGraphPB
 #endif
@@ -495,6 +509,12 @@ public:
   void SetMBRScale(float scale) {
     m_mbrScale = scale;
   }
+  bool UseMBRExpectedBleu() const {
+    return m_mbrExpectedBleu;
+  }
+  size_t GetMBRThreads() const {
+    return m_mbrThreads;
+  }
   size_t GetLatticeMBRPruningFactor() const {
     return m_lmbrPruning;
   }
@@ -548,6 +568,9 @@ public:
   bool GetOutputSearchGraphExtended() const {
     return m_outputSearchGraphExtended;
   }
+  bool GetOutputSearchGraphBinary() const {
+    return m_outputSearchGraphBinary;
+  }
 #ifdef HAVE_PROTOBUF
   bool GetOutputSearchGraphPB() const {
     return m_outputSearchGraphPB;
@@ -616,6 +639,13 @@ public:
   int ThreadCount() const {
     return m_threadCount;
   }
+
+  int ProcessCount() const {
+    return m_processCount;
+  }
+  bool PinProcesses() const {
+    return m_pinProcesses;
+  }
   
   long GetStartTranslationId() const
   { return m_startTranslationId; }
@@ -74,6 +74,14 @@ public:
    **/
   void Submit(Task* task);
 
+  /**
+    * Bound the number of queued (not yet running) jobs.  Submit() blocks
+    * while the queue is full.  0 (the default) means unbounded.
+    **/
+  void SetQueueLimit(size_t limit) {
+    m_queueLimit = limit;
+  }
+
   /**
     * Wait until all queued jobs have completed, and shut down
     * the ThreadPool.
@@ -99,6 +107,7 @@ private:
   boost::condition_variable m_threadAvailable;
   bool m_stopped;
   bool m_stopping;
+  size_t m_queueLimit;
 
 };
 
@@ -21,6 +21,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 ***********************************************************************/
 
 #include <algorithm>
+#include <queue>
 #include "TranslationOptionCollection.h"
 #include "Sentence.h"
 #include "DecodeStep.h"
@@ -304,22 +305,7 @@ void TranslationOptionCollection::CalcFutureScore()
   // like in chart parsing we want each cell to contain the highest score
   // of the full-span trOpt or the sum of scores of joining two smaller spans
 
-  for(size_t colstart = 1; colstart < size ; colstart++) {
-    for(size_t diagshift = 0; diagshift < size-colstart ; diagshift++) {
-      size_t startPos = diagshift;
-      size_t endPos = colstart+diagshift;
-      for(size_t joinAt = startPos; joinAt < endPos ; joinAt++)  {
-        float joinedScore = m_futureScore.GetScore(startPos, joinAt)
-                            + m_futureScore.GetScore(joinAt+1, endPos);
-        /* // uncomment to see the cell filling scheme
-        TRACE_ERR( "[" <<startPos<<","<<endPos<<"] <-? ["<<startPos<<","<<joinAt<<"]+["<<joinAt+1<<","<<endPos
-          << "] (colstart: "<<colstart<<", diagshift: "<<diagshift<<")"<<endl);
-        */
-        if (joinedScore > m_futureScore.GetScore(startPos, endPos))
-          m_futureScore.SetScore(startPos, endPos, joinedScore);
-      }
-    }
-  }
+  m_futureScore.CalcJoinedScores();
 
   IFVERBOSE(3) {
     int total = 0;
@@ -403,6 +389,14 @@ void TranslationOptionCollection::CreateTranslationOptions()
   // Prune
   Prune();
 
+  IFVERBOSE(2) {
+    TRACE_ERR("Partial translation options created per decode step:");
+    for (size_t i = 0; i < m_partialTranslOptCreated.size(); ++i) {
+      TRACE_ERR(" " << m_partialTranslOptCreated[i]);
+    }
+    TRACE_ERR(endl);
+  }
+
   Sort();
 
   // future score matrix
@@ -476,6 +470,10 @@ void TranslationOptionCollection::CreateTranslationOptionsForRange(
       static_cast<const DecodeStepTranslation&>(decodeStep).ProcessInitialTranslation
       (m_system, m_source, *oldPtoc
        , startPos, endPos, adhereTableLimit );
+      if (m_partialTranslOptCreated.size() < decodeGraph.GetSize()) {
+        m_partialTranslOptCreated.resize(decodeGraph.GetSize(), 0);
+      }
+      m_partialTranslOptCreated[0] += oldPtoc->GetCreatedCount();
 
       // do rest of decode steps
       int indexStep = 0;
@@ -483,16 +481,23 @@ void TranslationOptionCollection::CreateTranslationOptionsForRange(
         const DecodeStep &decodeStep = **iterStep;
         PartialTranslOptColl* newPtoc = new PartialTranslOptColl;
 
-        // go thru each intermediate trans opt just created
-        const vector<TranslationOption*>& partTransOptList = oldPtoc->GetList();
-        vector<TranslationOption*>::const_iterator iterPartialTranslOpt;
-        for (iterPartialTranslOpt = partTransOptList.begin() ; iterPartialTranslOpt != partTransOptList.end() ; ++iterPartialTranslOpt) {
-          TranslationOption &inputPartialTranslOpt = **iterPartialTranslOpt;
-          decodeStep.Process(m_system, inputPartialTranslOpt
-                             , decodeStep
-                             , *newPtoc
-                             , this
-                             , adhereTableLimit);
+        if (StaticData::Instance().IsLazyPartialTransOpt()) {
+          list <const DecodeStep* >::const_iterator nextStep = iterStep;
+          const bool lastStep = (++nextStep == decodeGraph.end());
+          m_partialTranslOptCreated[indexStep + 1] += ExpandBestFirst(decodeStep, *oldPtoc, *newPtoc, lastStep, adhereTableLimit);
+        } else {
+          // go thru each intermediate trans opt just created
+          const vector<TranslationOption*>& partTransOptList = oldPtoc->GetList();
+          vector<TranslationOption*>::const_iterator iterPartialTranslOpt;
+          for (iterPartialTranslOpt = partTransOptList.begin() ; iterPartialTranslOpt != partTransOptList.end() ; ++iterPartialTranslOpt) {
+            TranslationOption &inputPartialTranslOpt = **iterPartialTranslOpt;
+            decodeStep.Process(m_system, inputPartialTranslOpt
+                               , decodeStep
+                               , *newPtoc
+                               , this
+                               , adhereTableLimit);
+          }
+          m_partialTranslOptCreated[indexStep + 1] += newPtoc->GetCreatedCount();
         }
         // last but 1 partial trans not required anymore
         totalEarlyPruned += newPtoc->GetPrunedCount();
@@ -534,6 +539,97 @@ void TranslationOptionCollection::CreateTranslationOptionsForRange(
   }
 }
 
+namespace
+{
+
+// a partial translation option on the frontier of ExpandBestFirst()
+struct FrontierOption {
+  TranslationOption *option;
+  size_t input; //< index of the partial option it extends
+  bool first; //< whether it is the first extension of that option
+  bool operator<(const FrontierOption &other) const {
+    return option->GetFutureScore() < other.option->GetFutureScore();
+  }
+};
+
+}
+
+/** extend the partial translation options of oldPtoc by a decode step, in the
+ * manner of cube pruning.  The inputs are sorted best first, and each yields
+ * its extensions best first: an input's next extension enters the frontier
+ * when its previous one is taken, and the next input's first extension when
+ * its own first one is taken.  Taking the best of the frontier stops at the
+ * limit of partial translation options per span, or for the last step at the
+ * limit and threshold of translation options per span.
+ * \param lastStep whether decodeStep is the last step of its decode graph
+ * \return number of partial translation options created
+ */
+size_t TranslationOptionCollection::ExpandBestFirst(const DecodeStep &decodeStep
+    , const PartialTranslOptColl &oldPtoc
+    , PartialTranslOptColl &newPtoc
+    , bool lastStep
+    , bool adhereTableLimit)
+{
+  size_t limit = StaticData::Instance().GetMaxNoPartTransOpt();
+  float threshold = -std::numeric_limits<float>::infinity();
+  if (lastStep) {
+    if (m_maxNoTransOptPerCoverage > 0 && (limit == 0 || m_maxNoTransOptPerCoverage < limit)) {
+      limit = m_maxNoTransOptPerCoverage;
+    }
+    threshold = m_translationOptionThreshold;
+  }
+
+  vector<TranslationOption*> inputs(oldPtoc.GetList());
+  std::sort(inputs.begin(), inputs.end(), CompareTranslationOption);
+  vector<PartialExpansion*> expansions(inputs.size(), NULL);
+  std::priority_queue<FrontierOption> frontier;
+  size_t created = 0;
+  size_t nextInput = 0;
+  bool startInput = true;
+  float bestScore = -std::numeric_limits<float>::infinity();
+
+  while (true) {
+    if (startInput) {
+      // first extension of the next input that has one
+      for (; nextInput < inputs.size(); ++nextInput) {
+        expansions[nextInput] = decodeStep.Expand(m_system, *inputs[nextInput], this, adhereTableLimit);
+        FrontierOption entry = {expansions[nextInput]->Next(), nextInput, true};
+        if (entry.option != NULL) {
+          ++created;
+          frontier.push(entry);
+          ++nextInput;
+          break;
+        }
+      }
+    }
+    if (frontier.empty() || (limit > 0 && newPtoc.GetList().size() >= limit)) {
+      break;
+    }
+    const FrontierOption best = frontier.top();
+    const float score = best.option->GetFutureScore();
+    if (score < bestScore + threshold) {
+      break;
+    }
+    frontier.pop();
+    bestScore = std::max(bestScore, score);
+    newPtoc.AddScored(best.option);
+
+    FrontierOption entry = {expansions[best.input]->Next(), best.input, false};
+    if (entry.option != NULL) {
+      ++created;
+      frontier.push(entry);
+    }
+    startInput = best.first;
+  }
+
+  while (!frontier.empty()) {
+    delete frontier.top().option;
+    frontier.pop();
+  }
+  RemoveAllInColl(expansions);
+  return created;
+}
+
 /** Check if this range overlaps with any XML options. This doesn't need to be an exact match, only an overlap.
  * by default, we don't support XML options. subclasses need to override this function.
  * called by CreateTranslationOptionsForRange()
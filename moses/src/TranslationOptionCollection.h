@@ -71,6 +71,7 @@ protected:
   const size_t				m_maxNoTransOptPerCoverage; /*< maximum number of translation options per input span */
   const float				m_translationOptionThreshold; /*< threshold for translation options with regard to best option for input span */
   std::vector<Phrase*> m_unksrcs;
+  std::vector<size_t> m_partialTranslOptCreated; /*< partial translation options created by each decode step */
 
 
   TranslationOptionCollection(const TranslationSystem* system, InputType const& src, size_t maxNoTransOptPerCoverage,
@@ -88,6 +89,13 @@ protected:
   //! sort all trans opt in each list for cube pruning */
   void Sort();
 
+  //! extend partial translation options by a decode step best first, returns the number created
+  size_t ExpandBestFirst(const DecodeStep &decodeStep
+                         , const PartialTranslOptColl &oldPtoc
+                         , PartialTranslOptColl &newPtoc
+                         , bool lastStep
+                         , bool adhereTableLimit);
+
   //! list of trans opt for a particular span
   TranslationOptionList &GetTranslationOptionList(size_t startPos, size_t endPos);
   const TranslationOptionList &GetTranslationOptionList(size_t startPos, size_t endPos) const;
@@ -0,0 +1,220 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "Parameter.h"
+#include "Sentence.h"
+#include "StaticData.h"
+#include "TranslationOption.h"
+#include "TranslationOptionCollectionText.h"
+#include "TranslationSystem.h"
+#include "WordsRange.h"
+
+using namespace Moses;
+using namespace std;
+
+namespace
+{
+
+class TempFile
+{
+public:
+  explicit TempFile(const string &contents) {
+    char name[] = "/tmp/moses_translation_option_test_XXXXXX";
+    int fd = mkstemp(name);
+    BOOST_REQUIRE(fd != -1);
+    close(fd);
+    m_name = name;
+    ofstream out(m_name.c_str());
+    out << contents;
+  }
+  ~TempFile() {
+    unlink(m_name.c_str());
+  }
+  const string &name() const {
+    return m_name;
+  }
+private:
+  string m_name;
+};
+
+// two mapping steps: a translation of the surface form, then a generation
+// step for a second output factor, with a choice of outputs for each word
+const char *kPhraseTable =
+  "das ||| the ||| 0.6\n"
+  "das ||| that ||| 0.3\n"
+  "das ||| this ||| 0.1\n"
+  "haus ||| house ||| 0.6\n"
+  "haus ||| home ||| 0.3\n"
+  "haus ||| building ||| 0.1\n"
+  "das haus ||| the house ||| 0.5\n"
+  "das haus ||| this house ||| 0.2\n";
+
+const char *kGenerationTable =
+  "the DET 0.9\n"
+  "the PRO 0.1\n"
+  "that DET 0.5\n"
+  "that PRO 0.5\n"
+  "this DET 0.7\n"
+  "this PRO 0.3\n"
+  "house N 0.8\n"
+  "house V 0.2\n"
+  "home N 0.9\n"
+  "home ADV 0.1\n"
+  "building N 0.6\n"
+  "building V 0.4\n";
+
+// StaticData is loaded once for all the test cases
+const TranslationSystem &LoadModel()
+{
+  static bool loaded = false;
+  if (!loaded) {
+    TempFile phraseTable(kPhraseTable), generationTable(kGenerationTable);
+    TempFile config(
+      "[input-factors]\n0\n"
+      "[output-factors]\n0\n1\n"
+      "[mapping]\n0 T 0\n0 G 0\n"
+      "[ttable-file]\n0 0 0 1 " + phraseTable.name() + "\n"
+      "[generation-file]\n0 1 1 " + generationTable.name() + "\n"
+      "[ttable-limit]\n20\n"
+      "[weight-t]\n1\n"
+      "[weight-generation]\n0.5\n"
+      "[weight-d]\n0.3\n"
+      "[weight-w]\n-1\n");
+    Parameter parameter;
+    BOOST_REQUIRE(parameter.LoadParam(config.name()));
+    BOOST_REQUIRE(StaticData::LoadDataStatic(&parameter));
+    loaded = true;
+  }
+  return StaticData::Instance().GetTranslationSystem(TranslationSystem::DEFAULT);
+}
+
+struct Option {
+  string target;
+  float score;
+  bool operator<(const Option &other) const {
+    return target < other.target;
+  }
+};
+
+typedef vector<vector<Option> > OptionsBySpan;
+
+// the options of each span of "das haus", sorted by their target phrases
+OptionsBySpan CreateOptions(bool lazy, size_t maxPerCoverage, float threshold)
+{
+  const TranslationSystem &system = LoadModel();
+  StaticData &staticData = const_cast<StaticData&>(StaticData::Instance());
+  staticData.SetLazyPartialTransOpt(lazy);
+
+  Sentence sentence;
+  istringstream in("das haus\n");
+  BOOST_REQUIRE(sentence.Read(in, staticData.GetInputFactorOrder()));
+  system.InitializeBeforeSentenceProcessing(sentence);
+  OptionsBySpan ret;
+  {
+    TranslationOptionCollectionText collection(&system, sentence, maxPerCoverage, threshold);
+    collection.CreateTranslationOptions();
+    vector<FactorType> factors;
+    factors.push_back(0);
+    factors.push_back(1);
+    for (size_t start = 0; start < sentence.GetSize(); ++start) {
+      for (size_t end = start; end < sentence.GetSize(); ++end) {
+        const TranslationOptionList &list = collection.GetTranslationOptionList(WordsRange(start, end));
+        ret.push_back(vector<Option>());
+        for (size_t i = 0; i < list.size(); ++i) {
+          Option option = {list.Get(i)->GetTargetPhrase().GetStringRep(factors), list.Get(i)->GetFutureScore()};
+          ret.back().push_back(option);
+        }
+        sort(ret.back().begin(), ret.back().end());
+      }
+    }
+  }
+  system.CleanUpAfterSentenceProcessing();
+  staticData.SetLazyPartialTransOpt(false);
+  return ret;
+}
+
+void CheckEqual(const OptionsBySpan &expected, const OptionsBySpan &actual)
+{
+  BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+  for (size_t span = 0; span < expected.size(); ++span) {
+    BOOST_REQUIRE_EQUAL(expected[span].size(), actual[span].size());
+    for (size_t i = 0; i < expected[span].size(); ++i) {
+      BOOST_CHECK_EQUAL(expected[span][i].target, actual[span][i].target);
+      BOOST_CHECK_CLOSE(expected[span][i].score, actual[span][i].score, 1e-3);
+    }
+  }
+}
+
+size_t CountOptions(const OptionsBySpan &options)
+{
+  size_t count = 0;
+  for (size_t span = 0; span < options.size(); ++span) count += options[span].size();
+  return count;
+}
+
+const float kNoThreshold = -numeric_limits<float>::infinity();
+
+BOOST_AUTO_TEST_CASE(LazyExpansionMatchesProcess)
+{
+  const OptionsBySpan eager = CreateOptions(false, 0, kNoThreshold);
+  const OptionsBySpan lazy = CreateOptions(true, 0, kNoThreshold);
+  // spans "das", "das haus", "haus": every translation with every
+  // generation output of each of its words
+  BOOST_REQUIRE_EQUAL(3u, eager.size());
+  BOOST_CHECK_EQUAL(6u, eager[0].size());
+  BOOST_CHECK_EQUAL(8u, eager[1].size());
+  BOOST_CHECK_EQUAL(6u, eager[2].size());
+  CheckEqual(eager, lazy);
+}
+
+BOOST_AUTO_TEST_CASE(LazyExpansionStopsAtTheLimits)
+{
+  const size_t all = CountOptions(CreateOptions(false, 0, kNoThreshold));
+
+  // the best options of each span, as pruning all of them keeps
+  const OptionsBySpan eagerLimit = CreateOptions(false, 3, kNoThreshold);
+  const OptionsBySpan lazyLimit = CreateOptions(true, 3, kNoThreshold);
+  BOOST_CHECK_EQUAL(9u, CountOptions(eagerLimit));
+  CheckEqual(eagerLimit, lazyLimit);
+
+  // the options within the threshold of the best one of their span
+  const float threshold = log(0.3f);
+  const OptionsBySpan eagerThreshold = CreateOptions(false, 0, threshold);
+  const OptionsBySpan lazyThreshold = CreateOptions(true, 0, threshold);
+  BOOST_CHECK_LT(CountOptions(eagerThreshold), all);
+  BOOST_CHECK_GT(CountOptions(eagerThreshold), 3u);
+  CheckEqual(eagerThreshold, lazyThreshold);
+}
+
+}
@@ -103,7 +103,6 @@ void TranslationSystem::ConfigDictionaries()
       if (pdict) {
         m_phraseDictionaries.push_back(pdict);
         AddFeatureFunction(pdict);
-        const_cast<PhraseDictionaryFeature*>(pdict)->InitDictionary(this);
       }
       GenerationDictionary* gdict = const_cast<GenerationDictionary*>(step->GetGenerationDictionaryFeature());
       if (gdict) {
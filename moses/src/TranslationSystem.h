@@ -63,7 +63,8 @@ public:
   //Insert non-core feature function
   void AddFeatureFunction(const FeatureFunction* featureFunction);
 
-  //Called after adding the tables in order to set up the dictionaries
+  //Called after adding the tables in order to set up the dictionaries.
+  //Their loading is left to the caller, see PhraseDictionaryFeature::InitDictionary()
   void ConfigDictionaries();
 
 
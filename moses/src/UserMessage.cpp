@@ -23,6 +23,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <iostream>
 #include "UserMessage.h"
 
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
 using namespace std;
 
 namespace Moses
@@ -34,8 +38,16 @@ bool UserMessage::m_toStderr	= true;
 bool UserMessage::m_toQueue		= false;
 queue<string> UserMessage::m_msgQueue;
 
+#ifdef WITH_THREADS
+// models loaded in parallel may report errors at the same time
+static boost::mutex s_mutex;
+#endif
+
 void UserMessage::Add(const string &msg)
 {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(s_mutex);
+#endif
   if (m_toStderr) {
     cerr << "ERROR:" << msg << endl;
   }
@@ -48,6 +60,9 @@ void UserMessage::Add(const string &msg)
 
 string UserMessage::GetQueue()
 {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(s_mutex);
+#endif
   stringstream strme("");
   while (!m_msgQueue.empty()) {
     strme << m_msgQueue.front() << endl;
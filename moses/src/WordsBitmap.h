@@ -28,6 +28,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <cstring>
 #include <cmath>
 #include <cstdlib>
+#include <boost/functional/hash.hpp>
 #include "TypeDef.h"
 #include "WordsRange.h"
 
@@ -35,73 +36,134 @@ namespace Moses
 {
 typedef unsigned long WordsBitmapID;
 
-/** vector of boolean used to represent whether a word has been translated or not
-*/
+/** vector of boolean used to represent whether a word has been translated or not.
+ *  The words are packed into 64 bit blocks, with word i in bit (i % 64) of block
+ *  (i / 64); the bits past the end of the sentence are always 0. Sentences of up
+ *  to 128 words are held inline, without a heap allocation.
+ */
 class WordsBitmap
 {
   friend std::ostream& operator<<(std::ostream& out, const WordsBitmap& wordsBitmap);
 protected:
+  typedef uint64_t Block;
+  static const size_t BLOCK_BITS = 64;
+  static const size_t INLINE_BLOCKS = 2;
+
   const size_t m_size; /**< number of words in sentence */
-  bool	*m_bitmap;	/**< ticks of words that have been done */
+  const size_t m_numBlocks;
+  Block	*m_bitmap;	/**< ticks of words that have been done */
+  Block m_inline[INLINE_BLOCKS];
 
   WordsBitmap(); // not implemented
+  WordsBitmap &operator=(const WordsBitmap &); // not implemented
+
+  static size_t NumBlocks(size_t size) {
+    return (size + BLOCK_BITS - 1) / BLOCK_BITS;
+  }
+
+  static size_t PopCount(Block block) {
+#ifdef __GNUC__
+    return __builtin_popcountll(block);
+#else
+    size_t count = 0;
+    for (; block; block &= block - 1) ++count;
+    return count;
+#endif
+  }
+
+  //! position of the lowest set bit; block must not be 0
+  static size_t LowestBit(Block block) {
+#ifdef __GNUC__
+    return __builtin_ctzll(block);
+#else
+    size_t pos = 0;
+    for (; !(block & 1); block >>= 1) ++pos;
+    return pos;
+#endif
+  }
+
+  //! position of the highest set bit; block must not be 0
+  static size_t HighestBit(Block block) {
+#ifdef __GNUC__
+    return BLOCK_BITS - 1 - __builtin_clzll(block);
+#else
+    size_t pos = 0;
+    for (; block >>= 1; ) ++pos;
+    return pos;
+#endif
+  }
+
+  //! bits firstBit to lastBit of a block, inclusive
+  static Block Mask(size_t firstBit, size_t lastBit) {
+    Block upToLast = (lastBit + 1 == BLOCK_BITS) ? ~Block(0) : ((Block(1) << (lastBit + 1)) - 1);
+    return upToLast & (~Block(0) << firstBit);
+  }
+
+  //! the bits of block i that correspond to words of the sentence
+  Block ValidBits(size_t i) const {
+    return (i + 1 < m_numBlocks || m_size % BLOCK_BITS == 0)
+           ? ~Block(0) : Mask(0, m_size % BLOCK_BITS - 1);
+  }
+
+  void Allocate() {
+    m_bitmap = (m_numBlocks <= INLINE_BLOCKS)
+               ? m_inline : (Block*) malloc(sizeof(Block) * m_numBlocks);
+  }
 
   //! set all elements to false
   void Initialize() {
-    for (size_t pos = 0 ; pos < m_size ; pos++) {
-      m_bitmap[pos] = false;
-    }
+    std::memset(m_bitmap, 0, sizeof(Block) * m_numBlocks);
   }
 
   //sets elements by vector
-  void Initialize(std::vector<bool> vector) {
+  void Initialize(const std::vector<bool> &vector) {
+    Initialize();
     size_t vector_size = vector.size();
-    for (size_t pos = 0 ; pos < m_size ; pos++) {
-      if (pos < vector_size && vector[pos] == true) m_bitmap[pos] = true;
-      else m_bitmap[pos] = false;
+    for (size_t pos = 0 ; pos < m_size && pos < vector_size ; pos++) {
+      if (vector[pos]) SetValue(pos, true);
     }
   }
 
-
 public:
   //! create WordsBitmap of length size and initialise with vector
-  WordsBitmap(size_t size, std::vector<bool> initialize_vector)
-    :m_size	(size) {
-    m_bitmap = (bool*) malloc(sizeof(bool) * size);
+  WordsBitmap(size_t size, const std::vector<bool> &initialize_vector)
+    :m_size	(size)
+    ,m_numBlocks(NumBlocks(size)) {
+    Allocate();
     Initialize(initialize_vector);
   }
   //! create WordsBitmap of length size and initialise
   WordsBitmap(size_t size)
-    :m_size	(size) {
-    m_bitmap = (bool*) malloc(sizeof(bool) * size);
+    :m_size	(size)
+    ,m_numBlocks(NumBlocks(size)) {
+    Allocate();
     Initialize();
   }
   //! deep copy
   WordsBitmap(const WordsBitmap &copy)
-    :m_size	(copy.m_size) {
-    m_bitmap = (bool*) malloc(sizeof(bool) * m_size);
-    for (size_t pos = 0 ; pos < copy.m_size ; pos++) {
-      m_bitmap[pos] = copy.GetValue(pos);
-    }
+    :m_size	(copy.m_size)
+    ,m_numBlocks(copy.m_numBlocks) {
+    Allocate();
+    std::memcpy(m_bitmap, copy.m_bitmap, sizeof(Block) * m_numBlocks);
   }
   ~WordsBitmap() {
-    free(m_bitmap);
+    if (m_bitmap != m_inline) free(m_bitmap);
   }
   //! count of words translated
   size_t GetNumWordsCovered() const {
     size_t count = 0;
-    for (size_t pos = 0 ; pos < m_size ; pos++) {
-      if (m_bitmap[pos])
-        count++;
+    for (size_t i = 0 ; i < m_numBlocks ; i++) {
+      count += PopCount(m_bitmap[i]);
     }
     return count;
   }
 
   //! position of 1st word not yet translated, or NOT_FOUND if everything already translated
   size_t GetFirstGapPos() const {
-    for (size_t pos = 0 ; pos < m_size ; pos++) {
-      if (!m_bitmap[pos]) {
-        return pos;
+    for (size_t i = 0 ; i < m_numBlocks ; i++) {
+      Block gaps = ~m_bitmap[i] & ValidBits(i);
+      if (gaps) {
+        return i * BLOCK_BITS + LowestBit(gaps);
       }
     }
     // no starting pos
@@ -109,11 +171,24 @@ public:
   }
 
 
+  //! position of 1st word not yet translated from pos on, or NOT_FOUND if there is none
+  size_t GetNextGapPos(size_t pos) const {
+    if (pos >= m_size) return NOT_FOUND;
+    size_t i = pos / BLOCK_BITS;
+    Block gaps = ~m_bitmap[i] & ValidBits(i) & (~Block(0) << (pos % BLOCK_BITS));
+    while (!gaps && i + 1 < m_numBlocks) {
+      ++i;
+      gaps = ~m_bitmap[i] & ValidBits(i);
+    }
+    return gaps ? i * BLOCK_BITS + LowestBit(gaps) : NOT_FOUND;
+  }
+
   //! position of last word not yet translated, or NOT_FOUND if everything already translated
   size_t GetLastGapPos() const {
-    for (int pos = (int) m_size - 1 ; pos >= 0 ; pos--) {
-      if (!m_bitmap[pos]) {
-        return pos;
+    for (size_t i = m_numBlocks ; i-- > 0 ; ) {
+      Block gaps = ~m_bitmap[i] & ValidBits(i);
+      if (gaps) {
+        return i * BLOCK_BITS + HighestBit(gaps);
       }
     }
     // no starting pos
@@ -123,9 +198,9 @@ public:
 
   //! position of last translated word
   size_t GetLastPos() const {
-    for (int pos = (int) m_size - 1 ; pos >= 0 ; pos--) {
-      if (m_bitmap[pos]) {
-        return pos;
+    for (size_t i = m_numBlocks ; i-- > 0 ; ) {
+      if (m_bitmap[i]) {
+        return i * BLOCK_BITS + HighestBit(m_bitmap[i]);
       }
     }
     // no starting pos
@@ -134,26 +209,42 @@ public:
 
   //! whether a word has been translated at a particular position
   bool GetValue(size_t pos) const {
-    return m_bitmap[pos];
+    return (m_bitmap[pos / BLOCK_BITS] >> (pos % BLOCK_BITS)) & 1;
   }
   //! set value at a particular position
   void SetValue( size_t pos, bool value ) {
-    m_bitmap[pos] = value;
+    const Block bit = Block(1) << (pos % BLOCK_BITS);
+    if (value) {
+      m_bitmap[pos / BLOCK_BITS] |= bit;
+    } else {
+      m_bitmap[pos / BLOCK_BITS] &= ~bit;
+    }
   }
   //! set value between 2 positions, inclusive
   void SetValue( size_t startPos, size_t endPos, bool value ) {
-    for(size_t pos = startPos ; pos <= endPos ; pos++) {
-      m_bitmap[pos] = value;
+    const size_t first = startPos / BLOCK_BITS, last = endPos / BLOCK_BITS;
+    for (size_t i = first ; i <= last ; i++) {
+      size_t firstBit = (i == first) ? startPos % BLOCK_BITS : 0;
+      size_t lastBit = (i == last) ? endPos % BLOCK_BITS : BLOCK_BITS - 1;
+      if (value) {
+        m_bitmap[i] |= Mask(firstBit, lastBit);
+      } else {
+        m_bitmap[i] &= ~Mask(firstBit, lastBit);
+      }
     }
   }
   //! whether every word has been translated
   bool IsComplete() const {
-    return GetSize() == GetNumWordsCovered();
+    return GetFirstGapPos() == NOT_FOUND;
   }
   //! whether the wordrange overlaps with any translated word in this bitmap
   bool Overlap(const WordsRange &compare) const {
-    for (size_t pos = compare.GetStartPos() ; pos <= compare.GetEndPos() ; pos++) {
-      if (m_bitmap[pos])
+    const size_t startPos = compare.GetStartPos(), endPos = compare.GetEndPos();
+    const size_t first = startPos / BLOCK_BITS, last = endPos / BLOCK_BITS;
+    for (size_t i = first ; i <= last ; i++) {
+      size_t firstBit = (i == first) ? startPos % BLOCK_BITS : 0;
+      size_t lastBit = (i == last) ? endPos % BLOCK_BITS : BLOCK_BITS - 1;
+      if (m_bitmap[i] & Mask(firstBit, lastBit))
         return true;
     }
     return false;
@@ -175,27 +266,54 @@ public:
     if (thisSize != compareSize) {
       return (thisSize < compareSize) ? -1 : 1;
     }
-    return std::memcmp(m_bitmap, compare.m_bitmap, thisSize * sizeof(bool));
+    // same order as comparing word by word from the start of the sentence
+    for (size_t i = 0 ; i < m_numBlocks ; i++) {
+      Block diff = m_bitmap[i] ^ compare.m_bitmap[i];
+      if (diff) {
+        return (m_bitmap[i] >> LowestBit(diff)) & 1 ? 1 : -1;
+      }
+    }
+    return 0;
   }
 
   bool operator< (const WordsBitmap &compare) const {
     return Compare(compare) < 0;
   }
 
+  bool operator== (const WordsBitmap &compare) const {
+    return m_size == compare.m_size
+           && std::memcmp(m_bitmap, compare.m_bitmap, sizeof(Block) * m_numBlocks) == 0;
+  }
+
+  //! hash for boost::unordered containers
+  friend size_t hash_value(const WordsBitmap &bitmap) {
+    size_t seed = bitmap.m_size;
+    for (size_t i = 0 ; i < bitmap.m_numBlocks ; i++) {
+      boost::hash_combine(seed, bitmap.m_bitmap[i]);
+    }
+    return seed;
+  }
+
+  //! start of the gap that ends at l-1, l if word l-1 is translated
   inline size_t GetEdgeToTheLeftOf(size_t l) const {
     if (l == 0) return l;
-    while (l && !m_bitmap[l-1]) {
-      --l;
+    size_t i = (l - 1) / BLOCK_BITS;
+    Block done = m_bitmap[i] & Mask(0, (l - 1) % BLOCK_BITS);
+    while (!done && i > 0) {
+      done = m_bitmap[--i];
     }
-    return l;
+    return done ? i * BLOCK_BITS + HighestBit(done) + 1 : 0;
   }
 
+  //! end of the gap that starts at r+1, r if word r+1 is translated
   inline size_t GetEdgeToTheRightOf(size_t r) const {
     if (r+1 == m_size) return r;
-    while (r+1 < m_size && !m_bitmap[r+1]) {
-      ++r;
+    size_t i = (r + 1) / BLOCK_BITS;
+    Block done = m_bitmap[i] & ~Block(0) << ((r + 1) % BLOCK_BITS);
+    while (!done && i + 1 < m_numBlocks) {
+      done = m_bitmap[++i];
     }
-    return r;
+    return done ? i * BLOCK_BITS + LowestBit(done) - 1 : m_size - 1;
   }
 
 
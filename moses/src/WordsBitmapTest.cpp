@@ -0,0 +1,189 @@
+// $Id$
+
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2012 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "WordsBitmap.h"
+
+using namespace Moses;
+
+namespace
+{
+
+// the unpacked bitmap the packed one must agree with
+typedef std::vector<bool> Reference;
+
+size_t FirstGap(const Reference &ref)
+{
+  for (size_t i = 0; i < ref.size(); ++i) {
+    if (!ref[i]) return i;
+  }
+  return NOT_FOUND;
+}
+
+size_t NextGap(const Reference &ref, size_t pos)
+{
+  for (size_t i = pos; i < ref.size(); ++i) {
+    if (!ref[i]) return i;
+  }
+  return NOT_FOUND;
+}
+
+size_t LastGap(const Reference &ref)
+{
+  for (size_t i = ref.size(); i-- > 0; ) {
+    if (!ref[i]) return i;
+  }
+  return NOT_FOUND;
+}
+
+size_t LastPos(const Reference &ref)
+{
+  for (size_t i = ref.size(); i-- > 0; ) {
+    if (ref[i]) return i;
+  }
+  return NOT_FOUND;
+}
+
+size_t EdgeToTheLeftOf(const Reference &ref, size_t l)
+{
+  while (l && !ref[l-1]) --l;
+  return l;
+}
+
+size_t EdgeToTheRightOf(const Reference &ref, size_t r)
+{
+  while (r+1 < ref.size() && !ref[r+1]) ++r;
+  return r;
+}
+
+void CheckEqual(const WordsBitmap &bitmap, const Reference &ref)
+{
+  BOOST_REQUIRE_EQUAL(ref.size(), bitmap.GetSize());
+  for (size_t i = 0; i < ref.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(ref[i], bitmap.GetValue(i));
+  }
+  BOOST_REQUIRE_EQUAL((size_t) std::count(ref.begin(), ref.end(), true), bitmap.GetNumWordsCovered());
+  BOOST_REQUIRE_EQUAL(FirstGap(ref), bitmap.GetFirstGapPos());
+  BOOST_REQUIRE_EQUAL(LastGap(ref), bitmap.GetLastGapPos());
+  BOOST_REQUIRE_EQUAL(LastPos(ref), bitmap.GetLastPos());
+  BOOST_REQUIRE_EQUAL(FirstGap(ref) == NOT_FOUND, bitmap.IsComplete());
+  for (size_t i = 0; i <= ref.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(NextGap(ref, i), bitmap.GetNextGapPos(i));
+  }
+  for (size_t i = 0; i < ref.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(EdgeToTheLeftOf(ref, i), bitmap.GetEdgeToTheLeftOf(i));
+    BOOST_REQUIRE_EQUAL(EdgeToTheRightOf(ref, i), bitmap.GetEdgeToTheRightOf(i));
+  }
+}
+
+int Sign(int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+// sizes around the block boundaries, inline and heap allocated
+const size_t kSizes[] = {1, 5, 63, 64, 65, 127, 128, 129, 200};
+
+BOOST_AUTO_TEST_CASE(MatchesUnpacked)
+{
+  srand(1);
+  for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+    const size_t size = kSizes[s];
+    WordsBitmap bitmap(size);
+    Reference ref(size, false);
+    CheckEqual(bitmap, ref);
+    for (size_t step = 0; step < 200; ++step) {
+      const bool value = rand() % 3 != 0;
+      if (rand() % 2) {
+        const size_t pos = rand() % size;
+        bitmap.SetValue(pos, value);
+        ref[pos] = value;
+      } else {
+        const size_t start = rand() % size;
+        const size_t end = start + rand() % (size - start);
+        bitmap.SetValue(start, end, value);
+        std::fill(ref.begin() + start, ref.begin() + end + 1, value);
+      }
+      CheckEqual(bitmap, ref);
+
+      const size_t start = rand() % size;
+      const size_t end = start + rand() % (size - start);
+      const bool overlap = std::find(ref.begin() + start, ref.begin() + end + 1, true)
+                           != ref.begin() + end + 1;
+      BOOST_REQUIRE_EQUAL(overlap, bitmap.Overlap(WordsRange(start, end)));
+
+      const WordsBitmap copy(bitmap);
+      CheckEqual(copy, ref);
+      BOOST_REQUIRE(copy == bitmap);
+      BOOST_REQUIRE_EQUAL(hash_value(copy), hash_value(bitmap));
+    }
+    bitmap.SetValue(0, size - 1, true);
+    CheckEqual(bitmap, Reference(size, true));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(InitializeFromVector)
+{
+  Reference ref(130, false);
+  ref[0] = ref[64] = ref[129] = true;
+  CheckEqual(WordsBitmap(130, ref), ref);
+  // the vector may be shorter than the sentence
+  ref.resize(70);
+  WordsBitmap bitmap(100, ref);
+  ref.resize(100, false);
+  CheckEqual(bitmap, ref);
+}
+
+// orders as the unpacked bitmap did, comparing word by word from the start
+BOOST_AUTO_TEST_CASE(CompareIsLexicographic)
+{
+  srand(2);
+  for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+    const size_t size = kSizes[s];
+    for (size_t step = 0; step < 200; ++step) {
+      WordsBitmap a(size), b(size);
+      Reference refA(size, false), refB(size, false);
+      for (size_t i = 0; i < size; ++i) {
+        refA[i] = rand() % 2;
+        // mostly equal, so that the first difference is often late
+        refB[i] = (rand() % 8 == 0) ? !refA[i] : refA[i];
+        a.SetValue(i, refA[i]);
+        b.SetValue(i, refB[i]);
+      }
+      const int expected = refA < refB ? -1 : (refB < refA ? 1 : 0);
+      BOOST_REQUIRE_EQUAL(expected, Sign(a.Compare(b)));
+      BOOST_REQUIRE_EQUAL(-expected, Sign(b.Compare(a)));
+      BOOST_REQUIRE_EQUAL(expected < 0, a < b);
+      BOOST_REQUIRE_EQUAL(expected == 0, a == b);
+    }
+  }
+  // shorter sentences sort first whatever they cover
+  WordsBitmap shorter(64), longer(65);
+  shorter.SetValue(0, 63, true);
+  BOOST_REQUIRE(shorter < longer);
+}
+
+}
@@ -109,6 +109,7 @@ my $___RANDOM_DIRECTIONS = 0; # search in random directions only
 my $___NUM_RANDOM_DIRECTIONS = 0; # number of random directions, also works with default optimizer [Cer&al.,2008]
 my $___PAIRWISE_RANKED_OPTIMIZER = 0; # use Hopkins&May[2011]
 my $___PRO_STARTING_POINT = 0; # get a starting point from pairwise ranked optimizer
+my $___PRO_BUILTIN_OPTIMIZER = 0; # train the PRO classifier in pro itself instead of megam
 my $___RANDOM_RESTARTS = 20;
 my $___HISTORIC_INTERPOLATION = 0; # interpolate optimize weights with previous iteration's weights [Hopkins&May,2011,5.4.3]
 my $__THREADS = 0;
@@ -197,6 +198,7 @@ GetOptions(
   "maximum-iterations=i" => \$maximum_iterations,
   "pairwise-ranked" => \$___PAIRWISE_RANKED_OPTIMIZER,
   "pro-starting-point" => \$___PRO_STARTING_POINT,
+  "pro-builtin-optimizer" => \$___PRO_BUILTIN_OPTIMIZER,
   "historic-interpolation=f" => \$___HISTORIC_INTERPOLATION,
   "threads=i" => \$__THREADS
 ) or exit(1);
@@ -280,6 +282,7 @@ Options:
                                         (also works with regular optimizer, default: 0)
   --pairwise-ranked         ... Use PRO for optimisation (Hopkins and May, emnlp 2011)
   --pro-starting-point      ... Use PRO to get a starting point for MERT
+  --pro-builtin-optimizer   ... Train the PRO classifier in pro instead of megam
   --threads=NUMBER          ... Use multi-threaded mert (must be compiled in).
   --historic-interpolation  ... Interpolate optimized weights with prior iterations' weight
                                 (parameter sets factor [0;1] given to current weights)
@@ -320,7 +323,7 @@ die "Not executable: $mert_mert_cmd" if ! -x $mert_mert_cmd;
 die "Not executable: $mert_pro_cmd" if ! -x $mert_pro_cmd;
 
 my $pro_optimizer = "$mertdir/megam_i686.opt"; # or set to your installation
-if (($___PAIRWISE_RANKED_OPTIMIZER || $___PRO_STARTING_POINT) && ! -x $pro_optimizer) {
+if (($___PAIRWISE_RANKED_OPTIMIZER || $___PRO_STARTING_POINT) && ! $___PRO_BUILTIN_OPTIMIZER && ! -x $pro_optimizer) {
   print "did not find $pro_optimizer, installing it in $mertdir\n";
   `cd $mertdir; wget http://www.cs.utah.edu/~hal/megam/megam_i686.opt.gz;`;
   `gunzip $pro_optimizer.gz`;
@@ -714,8 +717,10 @@ while(1) {
   if ($___NUM_RANDOM_DIRECTIONS) {
     $mert_settings .= " -m $___NUM_RANDOM_DIRECTIONS";
   }
+  my $pro_settings = $seed_settings;
   if ($__THREADS) {
     $mert_settings .= " --threads $__THREADS";
+    $pro_settings .= " --threads $__THREADS";
   }
 
   my $ffiles = "";
@@ -746,16 +751,21 @@ while(1) {
 
   $cmd .= $file_settings;
 
+  # the pairs are either written for megam or classified by pro itself
+  my $pro_train_cmd = "$mert_pro_cmd $pro_settings $pro_file_settings -o run$run.pro.data ; $pro_optimizer -fvals -maxi 30 -nobias binary run$run.pro.data";
+  if ($___PRO_BUILTIN_OPTIMIZER) {
+    $pro_train_cmd = "$mert_pro_cmd $pro_settings $pro_file_settings --train --iterations 30";
+  }
+
   # pro optimization
   if ($___PAIRWISE_RANKED_OPTIMIZER) {
-    $cmd = "$mert_pro_cmd $seed_settings $pro_file_settings -o run$run.pro.data ; echo 'not used' > $weights_out_file; $pro_optimizer -fvals -maxi 30 -nobias binary run$run.pro.data";
+    $cmd = "echo 'not used' > $weights_out_file; $pro_train_cmd";
     &submit_or_exec($cmd,$mert_outfile,$mert_logfile);
   }
   # first pro, then mert
   elsif ($___PRO_STARTING_POINT) {
     # run pro...
-    my $pro_cmd = "$mert_pro_cmd $seed_settings $pro_file_settings -o run$run.pro.data ; $pro_optimizer -fvals -maxi 30 -nobias binary run$run.pro.data";
-    &submit_or_exec($pro_cmd,"run$run.pro.out","run$run.pro.err");
+    &submit_or_exec($pro_train_cmd,"run$run.pro.out","run$run.pro.err");
     # ... get results ...
     my %dummy;
     ($bestpoint,$devbleu) = &get_weights_from_mert("run$run.pro.out","run$run.pro.err",scalar @{$featlist->{"names"}},\%dummy);
@@ -23,11 +23,14 @@
 #include "Node.h"
 #include "Options.h"
 #include "ParseTree.h"
+#include "ScfgRule.h"
+#include "ScfgRuleWriter.h"
 #include "Subgraph.h"
 
 #include <algorithm>
 #include <cassert>
 #include <memory>
+#include <queue>
 #include <stack>
 
 namespace Moses {
@@ -145,18 +148,45 @@ void AlignmentGraph::ExtractMinimalRules(const Options &options)
   }
 }
 
-void AlignmentGraph::ExtractComposedRules(const Options &options)
+void AlignmentGraph::ExtractComposedRules(const Options &options,
+                                          ScfgRuleWriter &writer)
 {
-  ExtractComposedRules(m_root, options);
+  ExtractComposedRules(m_root, options, writer);
 }
 
-void AlignmentGraph::ExtractComposedRules(Node *node, const Options &options)
+namespace {
+
+void WriteRule(const Subgraph &rule, const Options &options,
+               ScfgRuleWriter &writer)
+{
+  ScfgRule r(rule);
+  // TODO Can scope pruning be done earlier?
+  if (r.Scope() <= options.maxScope) {
+    writer.Write(r);
+  }
+}
+
+// Whether a rule can be composed into a larger one at a node above its root.
+// The rule of that node adds at least a level of depth, two nodes (of which
+// the attachment point is shared) and a non-preterminal root.
+bool IsComposable(const Subgraph &rule, const Options &options)
+{
+  return !options.minimal
+      && rule.GetDepth() < options.maxRuleDepth
+      && rule.GetNodeCount() < options.maxNodes
+      && rule.GetSize() < options.maxRuleSize;
+}
+
+}  // namespace
+
+void AlignmentGraph::ExtractComposedRules(Node *node, const Options &options,
+                                          ScfgRuleWriter &writer)
 {
   // Extract composed rules for all children first.
   const std::vector<Node *> &children = node->GetChildren();
   for (std::vector<Node *>::const_iterator p(children.begin());
        p != children.end(); ++p) {
-    ExtractComposedRules(*p, options);
+    ExtractComposedRules(*p, options, writer);
   }
 
   // If there is no minimal rule for this node then there are no composed
@@ -166,42 +196,75 @@ void AlignmentGraph::ExtractComposedRules(Node *node, const Options &options)
   if (rules.empty()) {
     return;
   }
+  const Subgraph *minimalRule = rules[0];
+  WriteRule(*minimalRule, options, writer);
 
   // Construct an initial composition candidate from the minimal rule.
-  ComposedRule cr(*(rules[0]));
-  if (!cr.GetOpenAttachmentPoint()) {
-    // No composition possible.
-    return;
-  }
-
-  std::queue<ComposedRule> queue;
-  queue.push(cr);
-  while (!queue.empty()) {
-    ComposedRule cr = queue.front();
-    queue.pop();
-    const Node *attachmentPoint = cr.GetOpenAttachmentPoint();
-    assert(attachmentPoint);
-    assert(attachmentPoint != node);
-    // Create all possible rules by composing this node's minimal rule with the
-    // existing rules (both minimal and composed) rooted at the first open
-    // attachment point.
-    const std::vector<const Subgraph*> &rules = attachmentPoint->GetRules();
-    for (std::vector<const Subgraph*>::const_iterator p = rules.begin();
-         p != rules.end(); ++p) {
-      assert((*p)->GetRoot()->GetType() == TREE);
-      ComposedRule *cr2 = cr.AttemptComposition(**p, options);
-      if (cr2) {
-        node->AddRule(new Subgraph(cr2->CreateSubgraph()));
-        if (cr2->GetOpenAttachmentPoint()) {
-          queue.push(*cr2);
+  std::vector<const Node *> attachmentPoints;
+  ComposedRule cr(*minimalRule, attachmentPoints);
+  if (!options.minimal && cr.GetOpenAttachmentPoint()) {
+    // The minimal rule stays first in the node's rule set while this node's
+    // compositions are built, which only add to it.
+    std::queue<ComposedRule> queue;
+    queue.push(cr);
+    while (!queue.empty()) {
+      ComposedRule cr = queue.front();
+      queue.pop();
+      const Node *attachmentPoint = cr.GetOpenAttachmentPoint();
+      assert(attachmentPoint);
+      assert(attachmentPoint != node);
+      // Create all possible rules by composing this node's minimal rule with
+      // the existing rules (both minimal and composed) rooted at the first
+      // open attachment point.
+      const std::vector<const Subgraph*> &rules = attachmentPoint->GetRules();
+      for (std::vector<const Subgraph*>::const_iterator p = rules.begin();
+           p != rules.end(); ++p) {
+        assert((*p)->GetRoot()->GetType() == TREE);
+        ComposedRule *cr2 = cr.AttemptComposition(**p, options);
+        if (cr2) {
+          Subgraph *composed = new Subgraph(cr2->CreateSubgraph());
+          WriteRule(*composed, options, writer);
+          if (IsComposable(*composed, options)) {
+            node->AddRule(composed);
+          } else {
+            delete composed;
+          }
+          if (cr2->GetOpenAttachmentPoint()) {
+            queue.push(*cr2);
+          }
+          delete cr2;
         }
-        delete cr2;
+      }
+      // Done with this attachment point.  Advance to the next, if any.
+      cr.CloseAttachmentPoint();
+      if (cr.GetOpenAttachmentPoint()) {
+        queue.push(cr);
       }
     }
-    // Done with this attachment point.  Advance to the next, if any.
-    cr.CloseAttachmentPoint();
-    if (cr.GetOpenAttachmentPoint()) {
-      queue.push(cr);
+  }
+
+  if (!IsComposable(*minimalRule, options)) {
+    // Composition only adds depth, nodes and size, so none of this node's
+    // composed rules were kept either.
+    node->ReleaseRules();
+  }
+
+  // No node above this one can reach the rules maxRuleDepth levels down.
+  ReleaseRules(node, options.maxRuleDepth);
+}
+
+// Releases the rules of the tree nodes the given number of levels below node.
+void AlignmentGraph::ReleaseRules(Node *node, int levels) const
+{
+  if (levels == 0) {
+    node->ReleaseRules();
+    return;
+  }
+  const std::vector<Node *> &children = node->GetChildren();
+  for (std::vector<Node *>::const_iterator p(children.begin());
+       p != children.end(); ++p) {
+    if ((*p)->GetType() != SOURCE) {
+      ReleaseRules(*p, levels-1);
     }
   }
 }
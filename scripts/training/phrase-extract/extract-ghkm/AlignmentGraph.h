@@ -33,6 +33,7 @@ namespace GHKM {
 
 class Node;
 class ParseTree;
+class ScfgRuleWriter;
 class Subgraph;
 
 class AlignmentGraph
@@ -48,7 +49,14 @@ class AlignmentGraph
   const std::vector<Node *> &GetTargetNodes() { return m_targetNodes; }
 
   void ExtractMinimalRules(const Options &);
-  void ExtractComposedRules(const Options &);
+
+  // Extracts the composed rules (unless options.minimal is set) and writes
+  // all rules, subject to scope pruning.  Nodes are visited bottom-up and
+  // each node's rules are written as soon as they are complete.  Only the
+  // rules that a node above could still compose with are kept, and they are
+  // released once every node within maxRuleDepth above them is done, so the
+  // memory held does not grow with the size of the tree.
+  void ExtractComposedRules(const Options &, ScfgRuleWriter &);
 
  private:
   // Disallow copying
@@ -63,7 +71,8 @@ class AlignmentGraph
   Node *DetermineAttachmentPoint(int);
   Subgraph ComputeMinimalFrontierGraphFragment(Node *,
                                                const std::set<Node *> &);
-  void ExtractComposedRules(Node *, const Options &);
+  void ExtractComposedRules(Node *, const Options &, ScfgRuleWriter &);
+  void ReleaseRules(Node *, int) const;
 
   Node *m_root;
   std::vector<Node *> m_sourceNodes;
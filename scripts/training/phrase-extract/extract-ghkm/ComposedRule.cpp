@@ -23,24 +23,28 @@
 #include "Options.h"
 #include "Subgraph.h"
 
+#include <cassert>
 #include <set>
 #include <vector>
-#include <queue>
 
 namespace Moses {
 namespace GHKM {
 
-ComposedRule::ComposedRule(const Subgraph &baseRule)
+ComposedRule::ComposedRule(const Subgraph &baseRule,
+                           std::vector<const Node *> &attachmentPoints)
     : m_baseRule(baseRule)
+    , m_attachmentPoints(&attachmentPoints)
+    , m_nextAttachmentPoint(0)
     , m_depth(baseRule.GetDepth())
-    , m_size(baseRule.GetSize())
     , m_nodeCount(baseRule.GetNodeCount())
+    , m_size(baseRule.GetSize())
 {
+  attachmentPoints.clear();
   const std::set<const Node *> &leaves = baseRule.GetLeaves();
   for (std::set<const Node *>::const_iterator p = leaves.begin();
        p != leaves.end(); ++p) {
     if ((*p)->GetType() == TREE) {
-      m_openAttachmentPoints.push(*p);
+      attachmentPoints.push_back(*p);
     }
   }
 }
@@ -49,25 +53,26 @@ ComposedRule::ComposedRule(const ComposedRule &other, const Subgraph &rule,
                            int depth)
     : m_baseRule(other.m_baseRule)
     , m_attachedRules(other.m_attachedRules)
-    , m_openAttachmentPoints(other.m_openAttachmentPoints)
+    , m_attachmentPoints(other.m_attachmentPoints)
+    , m_nextAttachmentPoint(other.m_nextAttachmentPoint+1)
     , m_depth(depth)
-    , m_size(other.m_size+rule.GetSize())
     , m_nodeCount(other.m_nodeCount+rule.GetNodeCount()-1)
+    , m_size(other.m_size+rule.GetSize())
 {
   m_attachedRules.push_back(&rule);
-  m_openAttachmentPoints.pop();
 }
 
 const Node *ComposedRule::GetOpenAttachmentPoint()
 {
-  return m_openAttachmentPoints.empty() ? 0 : m_openAttachmentPoints.front();
+  return m_nextAttachmentPoint < m_attachmentPoints->size()
+      ? (*m_attachmentPoints)[m_nextAttachmentPoint] : 0;
 }
 
 void ComposedRule::CloseAttachmentPoint()
 {
-  assert(!m_openAttachmentPoints.empty());
+  assert(m_nextAttachmentPoint < m_attachmentPoints->size());
   m_attachedRules.push_back(0);
-  m_openAttachmentPoints.pop();
+  ++m_nextAttachmentPoint;
 }
 
 ComposedRule *ComposedRule::AttemptComposition(const Subgraph &rule,
@@ -24,7 +24,6 @@
 #include "Subgraph.h"
 
 #include <vector>
-#include <queue>
 
 namespace Moses {
 namespace GHKM {
@@ -35,8 +34,11 @@ class Options;
 class ComposedRule
 {
  public:
-  // Form a 'trivial' ComposedRule from a single existing rule.
-  ComposedRule(const Subgraph &baseRule);
+  // Form a 'trivial' ComposedRule from a single existing rule.  The
+  // attachment points of baseRule are written to attachmentPoints, which must
+  // outlive this object and all compositions derived from it.
+  ComposedRule(const Subgraph &baseRule,
+               std::vector<const Node *> &attachmentPoints);
 
   // Returns the first open attachment point if any exist or 0 otherwise.
   const Node *GetOpenAttachmentPoint();
@@ -58,7 +60,11 @@ class ComposedRule
 
   const Subgraph &m_baseRule;
   std::vector<const Subgraph *> m_attachedRules;
-  std::queue<const Node *> m_openAttachmentPoints;
+  // The attachment points are fixed by the base rule, so they are shared
+  // between all compositions of that rule rather than copied into each
+  // candidate; m_nextAttachmentPoint indexes the first open one.
+  const std::vector<const Node *> *m_attachmentPoints;
+  size_t m_nextAttachmentPoint;
   int m_depth;
   int m_nodeCount;
   int m_size;
@@ -30,6 +30,9 @@
 #include "Span.h"
 #include "XmlTreeParser.h"
 
+#include "../../../../moses/src/OutputCollector.h"
+#include "../../../../moses/src/ThreadPool.h"
+
 #include <boost/program_options.hpp>
 
 #include <cassert>
@@ -41,9 +44,61 @@
 #include <sstream>
 #include <vector>
 
+#include <sys/time.h>
+
 namespace Moses {
 namespace GHKM {
 
+// Extracts the rules for a single sentence pair.  The rules are buffered
+// and handed to the output collectors, which write them in corpus order.
+class ExtractGHKM::ExtractTask : public Moses::Task
+{
+ public:
+  ExtractTask(ExtractGHKM &tool, size_t lineNum, const std::string &targetLine,
+              const std::string &sourceLine, const std::string &alignmentLine,
+              const Options &options, OutputCollector &extractCollector,
+              OutputCollector &invExtractCollector)
+      : m_tool(tool)
+      , m_lineNum(lineNum)
+      , m_targetLine(targetLine)
+      , m_sourceLine(sourceLine)
+      , m_alignmentLine(alignmentLine)
+      , m_options(options)
+      , m_extractCollector(extractCollector)
+      , m_invExtractCollector(invExtractCollector) {}
+
+  void Run() {
+    std::ostringstream fwd;
+    std::ostringstream inv;
+    m_tool.ProcessSentence(m_lineNum, m_targetLine, m_sourceLine,
+                           m_alignmentLine, m_options, fwd, inv);
+    // OutputCollector ids start at 0.
+    m_extractCollector.Write(m_lineNum-1, fwd.str());
+    m_invExtractCollector.Write(m_lineNum-1, inv.str());
+  }
+
+ private:
+  ExtractGHKM &m_tool;
+  size_t m_lineNum;
+  std::string m_targetLine;
+  std::string m_sourceLine;
+  std::string m_alignmentLine;
+  const Options &m_options;
+  OutputCollector &m_extractCollector;
+  OutputCollector &m_invExtractCollector;
+};
+
+namespace {
+
+double WallClockSeconds()
+{
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+}  // namespace
+
 int ExtractGHKM::Main(int argc, char *argv[])
 {
   // Process command-line options.
@@ -73,18 +128,22 @@ int ExtractGHKM::Main(int argc, char *argv[])
     OpenOutputFileOrDie(options.unknownWordFile, unknownWordStream);
   }
 
-  // Target label sets for producing glue grammar.
-  std::set<std::string> labelSet;
-  std::set<std::string> topLabelSet;
+  // The rules of each sentence are written in input order, whichever thread
+  // extracted them.  The files are not flushed after each sentence.
+  OutputCollector extractCollector(&extractStream, &std::cerr, false);
+  OutputCollector invExtractCollector(&invExtractStream, &std::cerr, false);
 
-  // Word count statistics for producing unknown word labels.
-  std::map<std::string, int> wordCount;
-  std::map<std::string, std::string> wordLabel;
+#ifdef WITH_THREADS
+  ThreadPool pool(options.threads);
+  // Bound the number of sentences held in memory awaiting extraction.
+  pool.SetQueueLimit(options.threads * 100);
+#endif
+
+  const double startTime = WallClockSeconds();
 
   std::string targetLine;
   std::string sourceLine;
   std::string alignmentLine;
-  ScfgRuleWriter writer(extractStream, invExtractStream, options);
   size_t lineNum = 0;
   while (true) {
     std::getline(targetStream, targetLine);
@@ -101,86 +160,118 @@ int ExtractGHKM::Main(int argc, char *argv[])
 
     ++lineNum;
 
-    // Parse target tree.
-    std::auto_ptr<ParseTree> t(ParseXmlTree(targetLine));
-    if (!t.get()) {
-      std::ostringstream s;
-      s << "Failed to parse XML tree at line " << lineNum;
-      Error(s.str());
-    }
+    ExtractTask *task = new ExtractTask(*this, lineNum, targetLine, sourceLine,
+                                        alignmentLine, options,
+                                        extractCollector, invExtractCollector);
+#ifdef WITH_THREADS
+    pool.Submit(task);
+#else
+    task->Run();
+    delete task;
+#endif
+  }
 
-    // Read source tokens.
-    std::vector<std::string> sourceTokens(ReadTokens(sourceLine));
-
-    // Read word alignments.
-    Alignment alignment;
-    try {
-      alignment = ReadAlignment(alignmentLine);
-    } catch (const Exception &e) {
-      std::ostringstream s;
-      s << "Failed to read alignment at line " << lineNum << ": ";
-      s << e.GetMsg();
-      Error(s.str());
-    }
+#ifdef WITH_THREADS
+  pool.Stop(true);
+#endif
 
-    // Record tree labels for use in glue grammar.
-    if (!options.glueGrammarFile.empty()) {
-      // Record labels that cover the full sentence to topLabelSet.
-      ParseTree *p = t.get();
-      topLabelSet.insert(p->GetLabel());
-      while (p->GetChildren().size() == 1) {
-        p = p->GetChildren()[0];
-        if (p->IsLeaf()) {
-          break;
-        }
-        topLabelSet.insert(p->GetLabel());
-      }
-      // Record all labels to labelSet.
-      RecordTreeLabels(*t, labelSet);
-    }
+  const double elapsed = WallClockSeconds() - startTime;
+  std::cerr << GetName() << ": processed " << lineNum << " trees in "
+            << elapsed << " seconds";
+  if (elapsed > 0) {
+    std::cerr << " (" << lineNum / elapsed << " trees/sec)";
+  }
+  std::cerr << std::endl;
 
-    // Record word counts.
-    if (!options.unknownWordFile.empty()) {
-      CollectWordLabelCounts(*t, wordCount, wordLabel);
-    }
+  if (!options.glueGrammarFile.empty()) {
+    WriteGlueGrammar(m_labelSet, m_topLabelSet, glueGrammarStream);
+  }
 
-    // Form an alignment graph from the target tree, source words, and
-    // alignment.
-    AlignmentGraph graph(t.get(), sourceTokens, alignment);
+  if (!options.unknownWordFile.empty()) {
+    WriteUnknownWordLabel(m_wordCount, m_wordLabel, unknownWordStream);
+  }
 
-    // Extract minimal rules, adding each rule to its root node's rule set.
-    graph.ExtractMinimalRules(options);
+  return 0;
+}
 
-    // Extract composed rules.
-    if (!options.minimal) {
-      graph.ExtractComposedRules(options);
-    }
+void ExtractGHKM::ProcessSentence(size_t lineNum,
+                                  const std::string &targetLine,
+                                  const std::string &sourceLine,
+                                  const std::string &alignmentLine,
+                                  const Options &options,
+                                  std::ostream &fwd, std::ostream &inv)
+{
+  // Parse target tree.
+  std::auto_ptr<ParseTree> t(ParseXmlTree(targetLine));
+  if (!t.get()) {
+    std::ostringstream s;
+    s << "Failed to parse XML tree at line " << lineNum;
+    Error(s.str());
+  }
 
-    // Write the rules, subject to scope pruning.
-    const std::vector<Node *> &targetNodes = graph.GetTargetNodes();
-    for (std::vector<Node *>::const_iterator p = targetNodes.begin();
-         p != targetNodes.end(); ++p) {
-      const std::vector<const Subgraph *> &rules = (*p)->GetRules();
-      for (std::vector<const Subgraph *>::const_iterator q = rules.begin();
-           q != rules.end(); ++q) {
-        ScfgRule r(**q);
-        // TODO Can scope pruning be done earlier?
-        if (r.Scope() <= options.maxScope) {
-          writer.Write(r);
-        }
-      }
-    }
+  // Read source tokens.
+  std::vector<std::string> sourceTokens(ReadTokens(sourceLine));
+
+  // Read word alignments.
+  Alignment alignment;
+  try {
+    alignment = ReadAlignment(alignmentLine);
+  } catch (const Exception &e) {
+    std::ostringstream s;
+    s << "Failed to read alignment at line " << lineNum << ": ";
+    s << e.GetMsg();
+    Error(s.str());
   }
 
+  // Record tree labels for use in glue grammar.
+  std::set<std::string> labelSet;
+  std::set<std::string> topLabelSet;
   if (!options.glueGrammarFile.empty()) {
-    WriteGlueGrammar(labelSet, topLabelSet, glueGrammarStream);
+    // Record labels that cover the full sentence to topLabelSet.
+    ParseTree *p = t.get();
+    topLabelSet.insert(p->GetLabel());
+    while (p->GetChildren().size() == 1) {
+      p = p->GetChildren()[0];
+      if (p->IsLeaf()) {
+        break;
+      }
+      topLabelSet.insert(p->GetLabel());
+    }
+    // Record all labels to labelSet.
+    RecordTreeLabels(*t, labelSet);
   }
 
+  // Record word counts.
+  std::map<std::string, int> wordCount;
+  std::map<std::string, std::string> wordLabel;
   if (!options.unknownWordFile.empty()) {
-    WriteUnknownWordLabel(wordCount, wordLabel, unknownWordStream);
+    CollectWordLabelCounts(*t, wordCount, wordLabel);
   }
 
-  return 0;
+  // Merge this sentence's statistics into the corpus-wide ones.
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_statsMutex);
+#endif
+    m_labelSet.insert(labelSet.begin(), labelSet.end());
+    m_topLabelSet.insert(topLabelSet.begin(), topLabelSet.end());
+    for (std::map<std::string, int>::const_iterator p = wordCount.begin();
+         p != wordCount.end(); ++p) {
+      m_wordCount[p->first] += p->second;
+      m_wordLabel[p->first] = wordLabel[p->first];
+    }
+  }
+
+  // Form an alignment graph from the target tree, source words, and
+  // alignment.
+  AlignmentGraph graph(t.get(), sourceTokens, alignment);
+
+  // Extract minimal rules, adding each rule to its root node's rule set.
+  graph.ExtractMinimalRules(options);
+
+  // Extract composed rules, writing the rules of each node as it is done.
+  ScfgRuleWriter writer(fwd, inv, options);
+  graph.ExtractComposedRules(options, writer);
 }
 
 void ExtractGHKM::OpenInputFileOrDie(const std::string &filename,
@@ -272,6 +363,11 @@ void ExtractGHKM::ProcessOptions(int argc, char *argv[],
     ("UnknownWordLabel",
         po::value(&options.unknownWordFile),
         "write unknown word labels to named file")
+#ifdef WITH_THREADS
+    ("Threads",
+        po::value(&options.threads)->default_value(options.threads),
+        "set number of extraction threads")
+#endif
     ("UnpairedExtractFormat",
         "do not pair non-terminals in extract files")
   ;
@@ -335,6 +431,10 @@ void ExtractGHKM::ProcessOptions(int argc, char *argv[],
     std::exit(1);
   }
 
+  if (options.threads < 1) {
+    Error("--Threads must be at least 1");
+  }
+
   // Process Boolean options.
   if (vm.count("AllowUnary")) {
     options.allowUnary = true;
@@ -27,6 +27,10 @@
 #include <string>
 #include <vector>
 
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
 namespace Moses {
 namespace GHKM {
 
@@ -40,6 +44,8 @@ class ExtractGHKM
   const std::string &GetName() const { return m_name; }
   int Main(int argc, char *argv[]);
  private:
+  class ExtractTask;
+
   void Error(const std::string &) const;
   void OpenInputFileOrDie(const std::string &, std::ifstream &);
   void OpenOutputFileOrDie(const std::string &, std::ofstream &);
@@ -55,10 +61,27 @@ class ExtractGHKM
                         const std::set<std::string> &,
                         std::ostream &);
   std::vector<std::string> ReadTokens(const std::string &);
-  
+  void ProcessSentence(size_t, const std::string &, const std::string &,
+                       const std::string &, const Options &,
+                       std::ostream &, std::ostream &);
+
   void ProcessOptions(int, char *[], Options &) const;
 
   std::string m_name;
+
+  // Target label sets for producing glue grammar.
+  std::set<std::string> m_labelSet;
+  std::set<std::string> m_topLabelSet;
+
+  // Word count statistics for producing unknown word labels.
+  std::map<std::string, int> m_wordCount;
+  std::map<std::string, std::string> m_wordLabel;
+
+#ifdef WITH_THREADS
+  // Guards the label sets and word counts when sentences are processed
+  // concurrently.
+  boost::mutex m_statsMutex;
+#endif
 };
 
 }  // namespace GHKM
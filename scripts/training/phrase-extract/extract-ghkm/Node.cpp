@@ -25,11 +25,17 @@ namespace Moses {
 namespace GHKM {
 
 Node::~Node()
+{
+  ReleaseRules();
+}
+
+void Node::ReleaseRules()
 {
   for (std::vector<const Subgraph*>::const_iterator p(m_rules.begin());
        p != m_rules.end(); ++p) {
     delete *p;
   }
+  m_rules.clear();
 }
 
 bool Node::IsPreterminal() const
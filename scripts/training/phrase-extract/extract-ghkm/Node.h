@@ -62,6 +62,7 @@ class Node
   void AddChild(Node *c) { m_children.push_back(c); }
   void AddParent(Node *p) { m_parents.push_back(p); }
   void AddRule(const Subgraph *s) { m_rules.push_back(s); }
+  void ReleaseRules();
 
   bool IsSink() const { return m_children.empty(); }
   bool IsPreterminal() const;
@@ -35,6 +35,7 @@ struct Options {
       , maxRuleSize(3)
       , maxScope(3)
       , minimal(false)
+      , threads(1)
       , unpairedExtractFormat(false) {}
 
   // Positional options
@@ -51,6 +52,7 @@ struct Options {
   int maxRuleSize;
   int maxScope;
   bool minimal;
+  int threads;
   bool unpairedExtractFormat;
   std::string unknownWordFile;
 };
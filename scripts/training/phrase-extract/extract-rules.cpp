@@ -45,6 +45,8 @@
 #include "tables-core.h"
 #include "XmlTree.h"
 #include "InputFileStream.h"
+#include "../../../moses/src/OutputCollector.h"
+#include "../../../moses/src/ThreadPool.h"
 
 #define LINE_MAX_LENGTH 500000
 
@@ -53,21 +55,68 @@ using namespace std;
 typedef vector< int > LabelIndex;
 typedef map< int, int > WordIndex;
 
-vector< ExtractedRule > extractedRules;
+/**
+ * Extracts the rules of one sentence pair.  Each task owns its rule list and
+ * label collections, so tasks can run on the thread pool concurrently; the
+ * labels are merged into the global collections once the sentence is done
+ * and the rules are passed to the output collectors, which restore corpus
+ * order.
+ */
+class ExtractTask : public Moses::Task
+{
+public:
+  ExtractTask(int id, const string &target, const string &source, const string &alignment,
+              Moses::OutputCollector &extractCollector,
+              Moses::OutputCollector &extractCollectorInv,
+              Moses::OutputCollector &spanCollector)
+    : m_id(id)
+    , m_targetString(target)
+    , m_sourceString(source)
+    , m_alignmentString(alignment)
+    , m_extractCollector(extractCollector)
+    , m_extractCollectorInv(extractCollectorInv)
+    , m_spanCollector(spanCollector)
+  {}
+
+  void Run();
+
+private:
+  void extractRules(SentenceAlignmentWithSyntax & );
+  void addRuleToCollection(ExtractedRule &rule);
+  void consolidateRules();
+  void writeRulesToFile();
+  void collectWordLabelCounts(SentenceAlignmentWithSyntax &sentence );
+  void mergeLabelCollections();
+
+  void addRule( SentenceAlignmentWithSyntax &, int, int, int, int
+                , RuleExist &ruleExist);
+  void addHieroRule( SentenceAlignmentWithSyntax &sentence, int startT, int endT, int startS, int endS
+                     , RuleExist &ruleExist, const HoleCollection &holeColl, int numHoles, int initStartF, int wordCountT, int wordCountS);
+  void printHieroPhrase( SentenceAlignmentWithSyntax &sentence, int startT, int endT, int startS, int endS
+                         , HoleCollection &holeColl, LabelIndex &labelIndex);
+  void printAllHieroPhrases( SentenceAlignmentWithSyntax &sentence
+                             , int startT, int endT, int startS, int endS
+                             , HoleCollection &holeColl);
+
+  int m_id;
+  string m_targetString, m_sourceString, m_alignmentString;
+  Moses::OutputCollector &m_extractCollector;
+  Moses::OutputCollector &m_extractCollectorInv;
+  Moses::OutputCollector &m_spanCollector;
+
+  vector< ExtractedRule > m_extractedRules;
+  ostringstream m_extractOut, m_extractOutInv, m_spanOut;
+
+  // sentence-local label collections, merged after extraction
+  set< string > m_targetLabelCollection, m_sourceLabelCollection;
+  map< string, int > m_targetTopLabelCollection, m_sourceTopLabelCollection;
+  map< string, int > m_wordCount;
+  map< string, string > m_wordLabel;
+};
 
-void extractRules(SentenceAlignmentWithSyntax & );
-void addRuleToCollection(ExtractedRule &rule);
-void consolidateRules();
-void writeRulesToFile();
 void writeGlueGrammar(const string &);
-void collectWordLabelCounts(SentenceAlignmentWithSyntax &sentence );
 void writeUnknownWordLabel(const string &);
 
-void addRule( SentenceAlignmentWithSyntax &, int, int, int, int
-              , RuleExist &ruleExist);
-void addHieroRule( SentenceAlignmentWithSyntax &sentence, int startT, int endT, int startS, int endS
-                   , RuleExist &ruleExist, const HoleCollection &holeColl, int numHoles, int initStartF, int wordCountT, int wordCountS);
-
 inline string IntToString( int i )
 {
   stringstream out;
@@ -79,6 +128,11 @@ ofstream extractFile;
 ofstream extractFileInv;
 set< string > targetLabelCollection, sourceLabelCollection;
 map< string, int > targetTopLabelCollection, sourceTopLabelCollection;
+map< string, int > wordCount;
+map< string, string > wordLabel;
+#ifdef WITH_THREADS
+boost::mutex labelCollectionMutex;
+#endif
 
 RuleExtractionOptions options;
 
@@ -102,6 +156,9 @@ int main(int argc, char* argv[])
          << " | --MaxNonTerm[" << options.maxNonTerm << "]"
          << " | --MaxScope[" << options.maxScope << "]"
          << " | --SourceSyntax | --TargetSyntax"
+#ifdef WITH_THREADS
+         << " | --Threads[1]"
+#endif
          << " | --AllowOnlyUnalignedWords | --DisallowNonTermConsecTarget |--NonTermConsecSource |  --NoNonTermFirstWord | --NoFractionalCounting ]\n";
     exit(1);
   }
@@ -113,6 +170,7 @@ int main(int argc, char* argv[])
   string fileNameExtract = string(argv[4]);
 
   int optionInd = 5;
+  int threads = 1;
 
   for(int i=optionInd; i<argc; i++) {
     // maximum span length
@@ -218,6 +276,14 @@ int main(int argc, char* argv[])
       options.fractionalCounting = false;
     } else if (strcmp(argv[i],"--OutputNTLengths") == 0) {
       options.outputNTLengths = true;
+#ifdef WITH_THREADS
+    } else if (strcmp(argv[i],"--Threads") == 0) {
+      threads = atoi(argv[++i]);
+      if (threads < 1) {
+        cerr << "extract error: --Threads should be at least 1" << endl;
+        exit(1);
+      }
+#endif
     } else {
       cerr << "extract: syntax error, unknown option '" << string(argv[i]) << "'\n";
       exit(1);
@@ -241,45 +307,48 @@ int main(int argc, char* argv[])
   if (!options.onlyDirectFlag)
     extractFileInv.open(fileNameExtractInv.c_str());
 
+  // rules of each sentence are written in corpus order, whichever thread
+  // extracted them, and are not flushed after each sentence
+  Moses::OutputCollector extractCollector(&extractFile, &cerr, false);
+  Moses::OutputCollector extractCollectorInv(&extractFileInv, &cerr, false);
+  Moses::OutputCollector spanCollector(&cout, &cerr, false);
+
+#ifdef WITH_THREADS
+  Moses::ThreadPool pool(threads);
+  // keep memory bounded when reading is faster than extraction
+  pool.SetQueueLimit(threads * 100);
+#endif
+
   // loop through all sentence pairs
   int i=0;
+  char targetString[LINE_MAX_LENGTH];
+  char sourceString[LINE_MAX_LENGTH];
+  char alignmentString[LINE_MAX_LENGTH];
   while(true) {
     i++;
     if (i%1000 == 0) cerr << "." << flush;
     if (i%10000 == 0) cerr << ":" << flush;
     if (i%100000 == 0) cerr << "!" << flush;
-    char targetString[LINE_MAX_LENGTH];
-    char sourceString[LINE_MAX_LENGTH];
-    char alignmentString[LINE_MAX_LENGTH];
     SAFE_GETLINE((*tFileP), targetString, LINE_MAX_LENGTH, '\n', __FILE__);
     if (tFileP->eof()) break;
     SAFE_GETLINE((*sFileP), sourceString, LINE_MAX_LENGTH, '\n', __FILE__);
     SAFE_GETLINE((*aFileP), alignmentString, LINE_MAX_LENGTH, '\n', __FILE__);
-    SentenceAlignmentWithSyntax sentence(targetLabelCollection,
-                                         sourceLabelCollection,
-                                         targetTopLabelCollection,
-                                         sourceTopLabelCollection,
-                                         options);
-    //az: output src, tgt, and alingment line
-    if (options.onlyOutputSpanInfo) {
-      cout << "LOG: SRC: " << sourceString << endl;
-      cout << "LOG: TGT: " << targetString << endl;
-      cout << "LOG: ALT: " << alignmentString << endl;
-      cout << "LOG: PHRASES_BEGIN:" << endl;
-    }
 
-    if (sentence.create(targetString, sourceString, alignmentString, i)) {
-      if (options.unknownWordLabelFlag) {
-        collectWordLabelCounts(sentence);
-      }
-      extractRules(sentence);
-      consolidateRules();
-      writeRulesToFile();
-      extractedRules.clear();
-    }
-    if (options.onlyOutputSpanInfo) cout << "LOG: PHRASES_END:" << endl; //az: mark end of phrases
+    // output collectors count from 0, sentence ids from 1
+    ExtractTask *task = new ExtractTask(i-1, targetString, sourceString, alignmentString,
+                                        extractCollector, extractCollectorInv, spanCollector);
+#ifdef WITH_THREADS
+    pool.Submit(task);
+#else
+    task->Run();
+    delete task;
+#endif
   }
 
+#ifdef WITH_THREADS
+  pool.Stop(true);
+#endif
+
   tFile.Close();
   sFile.Close();
   aFile.Close();
@@ -296,7 +365,66 @@ int main(int argc, char* argv[])
     writeUnknownWordLabel(fileNameUnknownWordLabel);
 }
 
-void extractRules( SentenceAlignmentWithSyntax &sentence )
+void ExtractTask::Run()
+{
+  SentenceAlignmentWithSyntax sentence(m_targetLabelCollection,
+                                       m_sourceLabelCollection,
+                                       m_targetTopLabelCollection,
+                                       m_sourceTopLabelCollection,
+                                       options);
+  //az: output src, tgt, and alingment line
+  if (options.onlyOutputSpanInfo) {
+    m_spanOut << "LOG: SRC: " << m_sourceString << endl;
+    m_spanOut << "LOG: TGT: " << m_targetString << endl;
+    m_spanOut << "LOG: ALT: " << m_alignmentString << endl;
+    m_spanOut << "LOG: PHRASES_BEGIN:" << endl;
+  }
+
+  // SentenceAlignment::create() expects writable buffers
+  vector<char> targetString(m_targetString.begin(), m_targetString.end());
+  vector<char> sourceString(m_sourceString.begin(), m_sourceString.end());
+  vector<char> alignmentString(m_alignmentString.begin(), m_alignmentString.end());
+  targetString.push_back('\0');
+  sourceString.push_back('\0');
+  alignmentString.push_back('\0');
+
+  if (sentence.create(&targetString[0], &sourceString[0], &alignmentString[0], m_id+1)) {
+    if (options.unknownWordLabelFlag) {
+      collectWordLabelCounts(sentence);
+    }
+    extractRules(sentence);
+    consolidateRules();
+    writeRulesToFile();
+    m_extractedRules.clear();
+  }
+  if (options.onlyOutputSpanInfo) m_spanOut << "LOG: PHRASES_END:" << endl; //az: mark end of phrases
+
+  mergeLabelCollections();
+
+  m_extractCollector.Write(m_id, m_extractOut.str());
+  m_extractCollectorInv.Write(m_id, m_extractOutInv.str());
+  m_spanCollector.Write(m_id, m_spanOut.str());
+}
+
+void ExtractTask::mergeLabelCollections()
+{
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(labelCollectionMutex);
+#endif
+  targetLabelCollection.insert(m_targetLabelCollection.begin(), m_targetLabelCollection.end());
+  sourceLabelCollection.insert(m_sourceLabelCollection.begin(), m_sourceLabelCollection.end());
+  typedef map<string,int>::const_iterator I;
+  for(I i = m_targetTopLabelCollection.begin(); i != m_targetTopLabelCollection.end(); i++)
+    targetTopLabelCollection[ i->first ] += i->second;
+  for(I i = m_sourceTopLabelCollection.begin(); i != m_sourceTopLabelCollection.end(); i++)
+    sourceTopLabelCollection[ i->first ] += i->second;
+  for(I i = m_wordCount.begin(); i != m_wordCount.end(); i++) {
+    wordCount[ i->first ] += i->second;
+    wordLabel[ i->first ] = m_wordLabel[ i->first ];
+  }
+}
+
+void ExtractTask::extractRules( SentenceAlignmentWithSyntax &sentence )
 {
   int countT = sentence.target.size();
   int countS = sentence.source.size();
@@ -561,8 +689,8 @@ void printHieroAlignment(SentenceAlignmentWithSyntax &sentence
   }
 }
 
-void printHieroPhrase( SentenceAlignmentWithSyntax &sentence, int startT, int endT, int startS, int endS
-                       , HoleCollection &holeColl, LabelIndex &labelIndex)
+void ExtractTask::printHieroPhrase( SentenceAlignmentWithSyntax &sentence, int startT, int endT, int startS, int endS
+                                    , HoleCollection &holeColl, LabelIndex &labelIndex)
 {
   WordIndex indexS, indexT; // to keep track of word positions in rule
 
@@ -593,9 +721,9 @@ void printHieroPhrase( SentenceAlignmentWithSyntax &sentence, int startT, int en
   addRuleToCollection( rule );
 }
 
-void printAllHieroPhrases( SentenceAlignmentWithSyntax &sentence
-                           , int startT, int endT, int startS, int endS
-                           , HoleCollection &holeColl)
+void ExtractTask::printAllHieroPhrases( SentenceAlignmentWithSyntax &sentence
+                                        , int startT, int endT, int startS, int endS
+                                        , HoleCollection &holeColl)
 {
   LabelIndex labelIndex,labelCount;
 
@@ -646,10 +774,10 @@ void printAllHieroPhrases( SentenceAlignmentWithSyntax &sentence
 
 // this function is called recursively
 // it pokes a new hole into the phrase pair, and then calls itself for more holes
-void addHieroRule( SentenceAlignmentWithSyntax &sentence
-                   , int startT, int endT, int startS, int endS
-                   , RuleExist &ruleExist, const HoleCollection &holeColl
-                   , int numHoles, int initStartT, int wordCountT, int wordCountS)
+void ExtractTask::addHieroRule( SentenceAlignmentWithSyntax &sentence
+                                , int startT, int endT, int startS, int endS
+                                , RuleExist &ruleExist, const HoleCollection &holeColl
+                                , int numHoles, int initStartT, int wordCountT, int wordCountS)
 {
   // done, if already the maximum number of non-terminals in phrase pair
   if (numHoles >= options.maxNonTerm)
@@ -771,13 +899,13 @@ void addHieroRule( SentenceAlignmentWithSyntax &sentence
   }
 }
 
-void addRule( SentenceAlignmentWithSyntax &sentence, int startT, int endT, int startS, int endS
-              , RuleExist &ruleExist)
+void ExtractTask::addRule( SentenceAlignmentWithSyntax &sentence, int startT, int endT, int startS, int endS
+                           , RuleExist &ruleExist)
 {
   // source
 
   if (options.onlyOutputSpanInfo) {
-    cout << startS << " " << endS << " " << startT << " " << endT << endl;
+    m_spanOut << startS << " " << endS << " " << startT << " " << endT << endl;
     return;
   }
 
@@ -821,13 +949,13 @@ void addRule( SentenceAlignmentWithSyntax &sentence, int startT, int endT, int s
   addRuleToCollection( rule );
 }
 
-void addRuleToCollection( ExtractedRule &newRule )
+void ExtractTask::addRuleToCollection( ExtractedRule &newRule )
 {
 
   // no double-counting of identical rules from overlapping spans
   if (!options.duplicateRules) {
     vector<ExtractedRule>::const_iterator rule;
-    for(rule = extractedRules.begin(); rule != extractedRules.end(); rule++ ) {
+    for(rule = m_extractedRules.begin(); rule != m_extractedRules.end(); rule++ ) {
       if (rule->source.compare( newRule.source ) == 0 &&
           rule->target.compare( newRule.target ) == 0 &&
           !(rule->endT < newRule.startT || rule->startT > newRule.endT)) { // overlapping
@@ -835,31 +963,31 @@ void addRuleToCollection( ExtractedRule &newRule )
       }
     }
   }
-  extractedRules.push_back( newRule );
+  m_extractedRules.push_back( newRule );
 }
 
-void consolidateRules()
+void ExtractTask::consolidateRules()
 {
   typedef vector<ExtractedRule>::iterator R;
   map<int, map<int, map<int, map<int,int> > > > spanCount;
 
   // compute number of rules per span
   if (options.fractionalCounting) {
-    for(R rule = extractedRules.begin(); rule != extractedRules.end(); rule++ ) {
+    for(R rule = m_extractedRules.begin(); rule != m_extractedRules.end(); rule++ ) {
       spanCount[ rule->startT ][ rule->endT ][ rule->startS ][ rule->endS ]++;
     }
   }
 
   // compute fractional counts
-  for(R rule = extractedRules.begin(); rule != extractedRules.end(); rule++ ) {
+  for(R rule = m_extractedRules.begin(); rule != m_extractedRules.end(); rule++ ) {
     rule->count =    1.0/(float) (options.fractionalCounting ? spanCount[ rule->startT ][ rule->endT ][ rule->startS ][ rule->endS ] : 1.0 );
   }
 
   // consolidate counts
-  for(R rule = extractedRules.begin(); rule != extractedRules.end(); rule++ ) {
+  for(R rule = m_extractedRules.begin(); rule != m_extractedRules.end(); rule++ ) {
     if (rule->count == 0)
       continue;
-    for(R r2 = rule+1; r2 != extractedRules.end(); r2++ ) {
+    for(R r2 = rule+1; r2 != m_extractedRules.end(); r2++ ) {
       if (rule->source.compare( r2->source ) == 0 &&
           rule->target.compare( r2->target ) == 0 &&
           rule->alignment.compare( r2->alignment ) == 0) {
@@ -870,27 +998,27 @@ void consolidateRules()
   }
 }
 
-void writeRulesToFile()
+void ExtractTask::writeRulesToFile()
 {
   vector<ExtractedRule>::const_iterator rule;
-  for(rule = extractedRules.begin(); rule != extractedRules.end(); rule++ ) {
+  for(rule = m_extractedRules.begin(); rule != m_extractedRules.end(); rule++ ) {
     if (rule->count == 0)
       continue;
 
-    extractFile << rule->source << " ||| "
-                << rule->target << " ||| "
-                << rule->alignment << " ||| "
-                << rule->count;
+    m_extractOut << rule->source << " ||| "
+                 << rule->target << " ||| "
+                 << rule->alignment << " ||| "
+                 << rule->count;
     if (options.outputNTLengths) {
-      extractFile << " ||| ";
-      rule->OutputNTLengths(extractFile); 
+      m_extractOut << " ||| ";
+      rule->OutputNTLengths(m_extractOut); 
     }
-    extractFile << "\n";
+    m_extractOut << "\n";
 
     if (!options.onlyDirectFlag) {
-      extractFileInv << rule->target << " ||| "
-                     << rule->source << " ||| "
-                     << rule->alignmentInv << " ||| "
+      m_extractOutInv << rule->target << " ||| "
+                      << rule->source << " ||| "
+                      << rule->alignmentInv << " ||| "
                       << rule->count << "\n";
     }
   }
@@ -937,17 +1065,15 @@ void writeGlueGrammar( const string & fileName )
 // ( labels of singleton words are used to estimate
 //   distribution oflabels for unknown words )
 
-map<string,int> wordCount;
-map<string,string> wordLabel;
-void collectWordLabelCounts( SentenceAlignmentWithSyntax &sentence )
+void ExtractTask::collectWordLabelCounts( SentenceAlignmentWithSyntax &sentence )
 {
   int countT = sentence.target.size();
   for(int ti=0; ti < countT; ti++) {
     string &word = sentence.target[ ti ];
     const vector< SyntaxNode* >& labels = sentence.targetTree.GetNodes(ti,ti);
     if (labels.size() > 0) {
-      wordCount[ word ]++;
-      wordLabel[ word ] = labels[0]->GetLabel();
+      m_wordCount[ word ]++;
+      m_wordLabel[ word ] = labels[0]->GetLabel();
     }
   }
 }